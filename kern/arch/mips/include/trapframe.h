@@ -35,6 +35,10 @@
  * the exception handler.
  *
  * This must agree with the code in exception.S.
+ *
+ * For interrupts and TLB faults (EX_IRQ through EX_TLBS) tf_s0
+ * through tf_s6 are not saved, to make those traps cheaper; nothing
+ * handling them needs the values.
  */
 
 struct trapframe {
@@ -101,10 +105,12 @@ struct trapframe {
 void mips_usermode(struct trapframe *tf);
 
 /*
- * Arrays used to load the kernel stack and curthread on trap entry.
+ * Arrays used to load the kernel stack and curthread on trap entry,
+ * and the page table for fast TLB refill.
  */
 extern vaddr_t cpustacks[];
 extern vaddr_t cputhreads[];
+extern vaddr_t cpupagetables[];
 
 
 #endif /* _MIPS_TRAPFRAME_H_ */
@@ -101,6 +101,7 @@
 void ram_bootstrap(void);
 paddr_t ram_stealmem(unsigned long npages);
 void ram_getsize(paddr_t *lo, paddr_t *hi);
+paddr_t ram_getfirstfree(void);
 
 /*
  * TLB shootdown bits.
@@ -118,5 +119,11 @@ struct tlbshootdown {
 
 #define TLBSHOOTDOWN_MAX 16
 
+/*
+ * vm_tlbinvalidate probes for ranges of up to this many pages, and
+ * reads through the whole TLB for bigger ones.
+ */
+#define VM_TLBSCAN 16
+
 
 #endif /* _MIPS_VM_H_ */
@@ -40,6 +40,7 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
+#include <kstat.h>
 
 
 /* in exception.S */
@@ -67,6 +68,43 @@ static const char *const trapcodenames[NTRAPCODES] = {
 	"Arithmetic overflow",
 };
 
+/*
+ * How many of each exception, per CPU, and how many TLB misses the
+ * fast refill path in exception-mips1.S handled without coming here.
+ * (That code counts into trap_utlbrefill directly.)
+ */
+static struct kstat trapstats[NTRAPCODES] = {
+	{ "trap.irq",  NULL, { 0 }, NULL },
+	{ "trap.mod",  NULL, { 0 }, NULL },
+	{ "trap.tlbl", NULL, { 0 }, NULL },
+	{ "trap.tlbs", NULL, { 0 }, NULL },
+	{ "trap.adel", NULL, { 0 }, NULL },
+	{ "trap.ades", NULL, { 0 }, NULL },
+	{ "trap.ibe",  NULL, { 0 }, NULL },
+	{ "trap.dbe",  NULL, { 0 }, NULL },
+	{ "trap.sys",  NULL, { 0 }, NULL },
+	{ "trap.bp",   NULL, { 0 }, NULL },
+	{ "trap.ri",   NULL, { 0 }, NULL },
+	{ "trap.cpu",  NULL, { 0 }, NULL },
+	{ "trap.ovf",  NULL, { 0 }, NULL },
+};
+KSTAT_COUNTER(trap_utlbrefill, "trap.utlbrefill");
+
+void
+trap_bootstrap(void)
+{
+	unsigned i;
+
+	/* The refill code knows where the counts are; see KS_COUNT */
+	KASSERT((char *)&trap_utlbrefill.ks_count[0] - (char *)&trap_utlbrefill
+		== 8);
+
+	for (i=0; i<NTRAPCODES; i++) {
+		kstat_register(&trapstats[i]);
+	}
+	kstat_register(&trap_utlbrefill);
+}
+
 /*
  * Function called when user-level code hits a fatal fault.
  */
@@ -190,6 +228,9 @@ mips_trap(struct trapframe *tf)
 
 		mainbus_interrupt(tf);
 
+		/* spl is high either way, so kstat_inc won't unmask */
+		kstat_inc(&trapstats[EX_IRQ]);
+
 		if (doadjust) {
 			KASSERT(curthread->t_curspl == IPL_HIGH);
 			KASSERT(curthread->t_iplhigh_count == 1);
@@ -215,6 +256,8 @@ mips_trap(struct trapframe *tf)
 	spl = splhigh();
 	splx(spl);
 
+	kstat_inc(&trapstats[code]);
+
 	/* Syscall? Call the syscall handler and return. */
 	if (code == EX_SYS) {
 		/* Interrupts should have been on while in user mode. */
@@ -318,6 +361,14 @@ mips_trap(struct trapframe *tf)
 	panic("I can't handle this... I think I'll just die now...\n");
 
  done:
+	/*
+	 * Going back to user mode, with no locks held: this is where a
+	 * process suspended for memory waits.
+	 */
+	if (!iskern) {
+		vm_wswait();
+	}
+
 	/*
 	 * Turn interrupts off on the processor, without affecting the
 	 * stored interrupt state.
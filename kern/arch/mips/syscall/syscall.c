@@ -138,6 +138,29 @@ syscall(struct trapframe *tf)
 			&retval);
 		break;
 
+	    case SYS_getrlimit:
+		err = sys_getrlimit(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS_setrlimit:
+		err = sys_setrlimit(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS_getwsinfo:
+		err = sys_getwsinfo((userptr_t)tf->tf_a0);
+		break;
+
+	    case SYS_getloadinfo:
+		err = sys_getloadinfo((userptr_t)tf->tf_a0);
+		break;
+
+	    case SYS_madvise:
+		err = sys_madvise(
+			(userptr_t)tf->tf_a0,
+			tf->tf_a1,
+			tf->tf_a2);
+		break;
+
 	    case SYS_getpid:
 		err = sys_getpid(&retval);
 		break;
@@ -211,6 +234,21 @@ syscall(struct trapframe *tf)
 		}	
 		break;
 
+	    case SYS_ioctl:
+		err = sys_ioctl(
+			tf->tf_a0,
+			tf->tf_a1,
+			(userptr_t)tf->tf_a2);
+		break;
+
+	    case SYS_fcntl:
+		err = sys_fcntl(
+			tf->tf_a0,
+			tf->tf_a1,
+			tf->tf_a2,
+			&retval);
+		break;
+
 	    case SYS_chdir:
 		err = sys_chdir((userptr_t)tf->tf_a0);
 		break;
@@ -223,6 +261,50 @@ syscall(struct trapframe *tf)
 		break;
 
 
+	    /* batched submission */
+
+	    case SYS_ioring_setup:
+		err = sys_ioring_setup((userptr_t)tf->tf_a0);
+		break;
+
+	    case SYS_ioring_enter:
+		err = sys_ioring_enter(
+			tf->tf_a0,
+			tf->tf_a1,
+			&retval);
+		break;
+
+
+	    /* asynchronous I/O */
+
+	    case SYS_aio_read:
+		err = sys_aio_read((userptr_t)tf->tf_a0);
+		break;
+
+	    case SYS_aio_write:
+		err = sys_aio_write((userptr_t)tf->tf_a0);
+		break;
+
+	    case SYS_aio_error:
+		err = sys_aio_error((userptr_t)tf->tf_a0, &retval);
+		break;
+
+	    case SYS_aio_return:
+		err = sys_aio_return((userptr_t)tf->tf_a0, &retval);
+		break;
+
+	    case SYS_aio_suspend:
+		err = sys_aio_suspend((userptr_t)tf->tf_a0, tf->tf_a1);
+		break;
+
+	    case SYS_aio_waitcomplete:
+		err = sys_aio_waitcomplete(
+			(userptr_t)tf->tf_a0,
+			tf->tf_a1,
+			&retval);
+		break;
+
+
 	    /* Even more system calls will go here */
 
  
@@ -54,10 +54,14 @@
  *
  * These arrays are also used to start up new CPUs, for roughly the
  * same reasons.
+ *
+ * cpupagetables[] holds the first-level page table of the address
+ * space active on each CPU, or 0, for the fast TLB refill code.
  */
 
 vaddr_t cpustacks[MAXCPUS];
 vaddr_t cputhreads[MAXCPUS];
+vaddr_t cpupagetables[MAXCPUS];
 
 /*
  * Do machine-dependent initialization of the cpu structure or things
@@ -106,6 +106,33 @@ vm_tlbshootdown(const struct tlbshootdown *ts)
 	panic("dumbvm tried to do tlb shootdown?!\n");
 }
 
+/*
+ * dumbvm doesn't estimate working sets.
+ */
+
+void
+vm_wstick(void)
+{
+}
+
+void
+vm_wscheck(void)
+{
+}
+
+void
+vm_wswait(void)
+{
+}
+
+int
+vm_getwsinfo(struct addrspace *as, struct wsinfo *wi)
+{
+	(void)as;
+	(void)wi;
+	return ENOSYS;
+}
+
 int
 vm_fault(int faulttype, vaddr_t faultaddress)
 {
@@ -214,6 +241,8 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_rsslimit.rlim_cur = RLIM_INFINITY;
+	as->as_rsslimit.rlim_max = RLIM_INFINITY;
 
 	return as;
 }
@@ -332,6 +361,68 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, vaddr_t *kvaddr)
+{
+	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+	paddr_t paddr;
+
+	vbase1 = as->as_vbase1;
+	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
+	vbase2 = as->as_vbase2;
+	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	stacktop = USERSTACK;
+
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		paddr = (vaddr - vbase1) + as->as_pbase1;
+	}
+	else if (vaddr >= vbase2 && vaddr < vtop2) {
+		paddr = (vaddr - vbase2) + as->as_pbase2;
+	}
+	else if (vaddr >= stackbase && vaddr < stacktop) {
+		paddr = (vaddr - stackbase) + as->as_stackpbase;
+	}
+	else {
+		return EFAULT;
+	}
+
+	*kvaddr = PADDR_TO_KVADDR(paddr);
+	return 0;
+}
+
+/*
+ * dumbvm ignores madvise() advice, which it is allowed to do.
+ */
+int
+as_advise(struct addrspace *as, vaddr_t vaddr, size_t len, int advice)
+{
+	(void)as;
+	(void)vaddr;
+	(void)len;
+	(void)advice;
+	return 0;
+}
+
+/*
+ * dumbvm never takes pages away, so there is nothing to pin against.
+ */
+void
+as_pin(struct addrspace *as, struct as_pin *pin, vaddr_t vaddr, size_t len)
+{
+	(void)as;
+	(void)pin;
+	(void)vaddr;
+	(void)len;
+}
+
+void
+as_unpin(struct addrspace *as, struct as_pin *pin)
+{
+	(void)as;
+	(void)pin;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
@@ -346,6 +437,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	new->as_npages1 = old->as_npages1;
 	new->as_vbase2 = old->as_vbase2;
 	new->as_npages2 = old->as_npages2;
+	new->as_rsslimit = old->as_rsslimit;
 
 	/* (Mis)use as_prepare_load to allocate some physical memory. */
 	if (as_prepare_load(new)) {
@@ -109,6 +109,16 @@ ram_stealmem(unsigned long npages)
 	return paddr;
 }
 
+/*
+ * Return the first physical address not yet used by the kernel.
+ * Only meaningful before ram_getsize is called.
+ */
+paddr_t
+ram_getfirstfree(void)
+{
+	return firstpaddr;
+}
+
 /*
  * This function is intended to be called by the VM system when it
  * initializes in order to find out what memory it has available to
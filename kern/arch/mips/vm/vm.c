@@ -1,14 +1,31 @@
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/mman.h>
 #include <lib.h>
 #include <thread.h>
 #include <current.h>
+#include <synch.h>
 #include <addrspace.h>
 #include <vm.h>
 #include <machine/tlb.h>
+#include <mips/trapframe.h>
+#include <platform/maxcpus.h>
+#include <cpu.h>
 #include <spl.h>
 #include <spinlock.h>
 #include <elf.h>
+#include <vmalloc.h>
+#include <workingset.h>
+#include <execprof.h>
+#include <kstat.h>
+#include <pageop.h>
+
+static unsigned long vm_freepages(void);
+
+static KSTAT_COUNTER(vm_faults, "vm.faults");
+static KSTAT_COUNTER(vm_zerofills, "vm.zerofills");
+static KSTAT_COUNTER(vm_tlbupgrades, "vm.tlbupgrades");
+static KSTAT_GAUGE(vm_nfree, "vm.freepages", vm_freepages);
 
 /*
  * Initialise the frame table
@@ -16,14 +33,262 @@
 void
 vm_bootstrap(void)
 {
+	/* the vmalloc page table is stolen, so must come first */
+	vmalloc_bootstrap();
 	frametable_bootstrap();
+	execprof_bootstrap();
+	pageop_bootstrap();
+
+	kstat_register(&vm_faults);
+	kstat_register(&vm_zerofills);
+	kstat_register(&vm_tlbupgrades);
+	kstat_register(&vm_nfree);
+}
+
+static
+unsigned long
+vm_freepages(void)
+{
+	return frametable_nfree();
+}
+
+/*
+ * Load a translation into the TLB.
+ * If the page is in the TLB already, rewrite that entry in place, so
+ * a changed mapping or permission never leaves two entries for one
+ * page. Otherwise if there is an empty TLB entry, use it; otherwise
+ * randomly select one and throw it out.
+ */
+static
+void
+vm_tlbupdate(uint32_t ehi, uint32_t elo)
+{
+	uint32_t oldhi, oldlo;
+	int i, spl;
+
+	spl = splhigh();
+	i = tlb_probe(ehi, 0);
+	if (i >= 0) {
+		tlb_write(ehi, elo, i);
+		splx(spl);
+		return;
+	}
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_read(&oldhi, &oldlo, i);
+		if (oldlo & TLBLO_VALID) {
+			continue;
+		}
+		tlb_write(ehi, elo, i);
+		splx(spl);
+		return;
+	}
+
+	// FIXME, TLB replacement algo.
+	tlb_random(ehi, elo);
+	splx(spl);
+}
+
+/*
+ * vm_tlbupdate for a page of AS, the current address space; unless
+ * vm_wscheck has started a new window and emptied the TLB since
+ * ws_fault turned the fast refill path on. Then leave it out, so the
+ * next access faults again and the process gets sampled. This also
+ * means a CPU only holds entries for the address space named in its
+ * cpupagetables[] slot, which vm_tlbinvalidate_as relies on.
+ */
+static
+void
+vm_tlbupdate_as(struct addrspace *as, uint32_t ehi, uint32_t elo)
+{
+	int spl;
+
+	spl = splhigh();
+	if (cpupagetables[curcpu->c_number] == as->as_pagetable) {
+		vm_tlbupdate(ehi, elo);
+	}
+	splx(spl);
+}
+
+/*
+ * Turn on write permission for the page at VADDR in this CPU's TLB,
+ * in place. Returns false if the page isn't in the TLB.
+ */
+static
+bool
+vm_tlbupgrade(vaddr_t vaddr)
+{
+	uint32_t ehi, elo;
+	int i, spl;
+
+	spl = splhigh();
+	i = tlb_probe(vaddr, 0);
+	if (i < 0) {
+		splx(spl);
+		return false;
+	}
+	tlb_read(&ehi, &elo, i);
+	tlb_write(ehi, elo | TLBLO_DIRTY, i);
+	splx(spl);
+	kstat_inc(&vm_tlbupgrades);
+	return true;
+}
+
+/*
+ * Drop this CPU's TLB entries for the NPAGES pages from VADDR.
+ * A short range is probed for page by page; past VM_TLBSCAN pages
+ * it's cheaper to read through the whole TLB once.
+ */
+void
+vm_tlbinvalidate(vaddr_t vaddr, unsigned npages)
+{
+	uint32_t ehi, elo;
+	unsigned k;
+	int i, spl;
+
+	vaddr &= PAGE_FRAME;
+
+	spl = splhigh();
+	if (npages <= VM_TLBSCAN) {
+		for (k=0; k<npages; k++) {
+			i = tlb_probe(vaddr + k * PAGE_SIZE, 0);
+			if (i >= 0) {
+				tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+			}
+		}
+	}
+	else {
+		for (i=0; i<NUM_TLB; i++) {
+			tlb_read(&ehi, &elo, i);
+			if ((elo & TLBLO_VALID) == 0) {
+				continue;
+			}
+			ehi &= TLBHI_VPAGE;
+			if (ehi >= vaddr &&
+			    (ehi - vaddr) / PAGE_SIZE < npages) {
+				tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+			}
+		}
+	}
+	splx(spl);
+}
+
+/*
+ * Find the PTE for user address VADDR in AS. If the page isn't mapped
+ * yet, allocate and zero a frame for it, creating the second-level
+ * page table first if that doesn't exist either. If PB isn't NULL the
+ * zeroing is added to it instead, and the page mustn't be used until
+ * the batch has run. The caller must hold as_lock.
+ */
+static
+int
+vm_getpte(struct addrspace *as, vaddr_t vaddr, vaddr_t **ret,
+	  struct pagebatch *pb)
+{
+	vaddr_t *vaddr1, *vaddr2, page, table;
+	int index1, index2;
+
+	KASSERT(lock_do_i_hold(as->as_lock));
+
+	index1 = (vaddr & TOP_TEN) >> 22;
+	index2 = (vaddr & MID_TEN) >> 12;
+
+	vaddr1 = (vaddr_t *)(as->as_pagetable + index1 * 4);
+	if (*vaddr1) {
+		vaddr2 = (vaddr_t *)(*vaddr1 + index2 * 4);
+		// If the mapping exits in page table, we're done
+		if (*vaddr2 & PTE_VALID) {
+			*ret = vaddr2;
+			return 0;
+		}
+	}
+
+	// New page; may suspend the process until memory frees up,
+	// but it doesn't wait here (see workingset.c)
+	ws_admit(as);
+
+	// If second page table even doesn't exists, 
+	// create second page table; zero it before the TLB refill
+	// code can see it
+	if (*vaddr1 == 0) {
+		table = alloc_kpages(1);
+		if (table == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(table, 1);
+		*vaddr1 = table;
+	}
+	vaddr2 = (vaddr_t *)(*vaddr1 + index2 * 4);
+
+	// Do the mapping and update the PTE
+	page = alloc_upage(as, vaddr);
+	if (page == 0) {
+		// out of memory, or over the RSS limit
+		return ENOMEM;
+	}
+	if (pb != NULL) {
+		pagebatch_zero(pb, page);
+	}
+	else {
+		as_zero_region(page, 1);
+	}
+	*vaddr2 |= (page | PTE_VALID);
+	kstat_inc(&vm_zerofills);
+
+	if (as->as_exectrace != NULL) {
+		execprof_record(as, vaddr);
+	}
+
+	*ret = vaddr2;
+	return 0;
+}
+
+/*
+ * Make sure the page at VADDR in AS is resident, without loading it
+ * into the TLB. For madvise(MADV_WILLNEED). A new page is zeroed as
+ * part of PB, if given, so a caller bringing in many pages can have
+ * idle CPUs help. The caller must hold as_lock, until the batch has
+ * run if there is one; new pages aren't marked referenced, so the
+ * fast TLB refill won't load them before then.
+ */
+int
+vm_prefault(struct addrspace *as, vaddr_t vaddr, struct pagebatch *pb)
+{
+	vaddr_t *pte;
+
+	return vm_getpte(as, vaddr & PAGE_FRAME, &pte, pb);
+}
+
+/*
+ * Fault-around for regions advised MADV_SEQUENTIAL: after a fault at
+ * VADDR in region S, bring in the next few pages of S as well, unless
+ * memory is short. Failures don't matter; the pages will be faulted
+ * in the ordinary way.
+ */
+static
+void
+vm_faultahead(struct addrspace *as, struct as_region *s, vaddr_t vaddr)
+{
+	vaddr_t vtop;
+	int i;
+
+	vtop = s->as_vbase + s->as_npages * PAGE_SIZE;
+	for (i = 0; i < VM_FAULTAHEAD; i++) {
+		vaddr += PAGE_SIZE;
+		if (vaddr >= vtop || frametable_low()) {
+			break;
+		}
+		if (vm_prefault(as, vaddr, NULL)) {
+			break;
+		}
+	}
 }
 
 /*
  * When TLB miss happening, a page fault will be trigged.
  * The way to handle it is as follow:
- * 1. check what page fault it is, if it is READONLY fault, 
- *    then do nothing just pop up an exception and kill the process
+ * 1. check what page fault it is, if it is READONLY fault on a region
+ *    that is writable now, upgrade the TLB entry in place; on any other
+ *    region pop up an exception and kill the process
  * 2. if it is a read fault or write fault
  *    1. first check whether this virtual address is within any of the regions
  *       or stack of the current addrspace. if it is not, pop up a exception and
@@ -32,21 +297,23 @@ vm_bootstrap(void)
  *       if a page table entry exists for this virtual address insert it into TLB 
  *    3. if this virtual address is not mapped yet, mapping this address,
  *	 update the pagetable, then insert it into TLB
+ *    4. if the region is advised MADV_SEQUENTIAL, map the next few pages
+ *       as well
  */
 int
 vm_fault(int faulttype, vaddr_t faultaddress)
 {
-	vaddr_t *vaddr1, *vaddr2, vaddr, vbase, vtop, faultadd = 0;
+	vaddr_t *pte, vbase, vtop, faultadd = 0;
 	paddr_t paddr;
 	struct addrspace *as;
 	struct as_region *s;
-	uint32_t ehi, elo;
-	int i, index1, index2, spl;
 	unsigned int permis = 0;
+	int result;
 	
+	kstat_inc(&vm_faults);
+
 	switch (faulttype) {
 		case VM_FAULT_READONLY:
-			return EFAULT;
 		case VM_FAULT_READ:
 		case VM_FAULT_WRITE:
 			break;
@@ -54,6 +321,16 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			return EINVAL;
 	}
 	
+	// Kernel vmalloc space; always readable and writable
+	if (faultaddress >= MIPS_KSEG2) {
+		faultaddress &= PAGE_FRAME;
+		if (vmalloc_translate(faultaddress, &paddr)) {
+			return EFAULT;
+		}
+		vm_tlbupdate(faultaddress, paddr | TLBLO_DIRTY | TLBLO_VALID);
+		return 0;
+	}
+
 	as = curthread -> t_addrspace;
 	if (as == NULL) {
 		return EFAULT;
@@ -62,6 +339,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	// Align faultaddress
 	faultaddress &= PAGE_FRAME;
 	
+	// I/O workers may be faulting on this address space too, and
+	// madvise may be splitting its regions
+	lock_acquire(as->as_lock);
+	
 	// Go through the link list of regions 
 	// Check the validation of the faultaddress
 	KASSERT(as->as_regions_start != 0);
@@ -91,106 +372,148 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		
 		// faultaddress is not within any range of the regions and stack
 		if (faultadd == 0) {
+			lock_release(as->as_lock);
 			return EFAULT;
 		}
 	}
 	
-	index1 = (faultaddress & TOP_TEN) >> 22;
-	index2 = (faultaddress & MID_TEN) >> 12;
-
-	vaddr1 = (vaddr_t *)(as->as_pagetable + index1 * 4);
-	if (*vaddr1) {
-		vaddr2 = (vaddr_t *)(*vaddr1 + index2 * 4);
-		// If the mapping exits in page table,
-		// get the address stores in PTE, 
-		// translate it into physical address, 
-		// check writeable flag,
-		// and prepare the physical address for TLBLO
-		if (*vaddr2 & PTE_VALID) {
-			vaddr = *vaddr2 & PAGE_FRAME;
-			paddr = KVADDR_TO_PADDR(vaddr);
-			if (permis & PF_W) {
-				paddr |= TLBLO_DIRTY;
-			}
+	// A write to a page loaded read-only. Fine if the region has
+	// been made writable since; then just upgrade the entry.
+	if (faulttype == VM_FAULT_READONLY) {
+		if ((permis & PF_W) == 0) {
+			lock_release(as->as_lock);
+			return EFAULT;
 		}
-		// If not exists, do the mapping, 
-		// update the PTE of the second page table,
-		// check writeable flag,
-		// and prepare the physical address for TLBLO
-		else {
-			vaddr = alloc_kpages(1);
-			KASSERT(vaddr != 0);
-			
-			as_zero_region(vaddr, 1);
-			*vaddr2 |= (vaddr | PTE_VALID);
-			
-			paddr = KVADDR_TO_PADDR(vaddr);
-			if (permis & PF_W) {
-				paddr |= TLBLO_DIRTY;
-			}
+		result = vm_getpte(as, faultaddress, &pte, NULL);
+		if (result) {
+			lock_release(as->as_lock);
+			return result;
+		}
+		*pte |= PTE_WRITABLE;
+		if (vm_tlbupgrade(faultaddress)) {
+			lock_release(as->as_lock);
+			return 0;
 		}
 	}
-	// If second page table even doesn't exists, 
-	// create second page table,
-	// do the mapping,
-	// update the PTE,
-	// and prepare the physical address.
+	
+	// Count the fault; may start a new working-set window
+	ws_fault(as);
+	
+	// Find the page, mapping it if it isn't mapped yet
+	result = vm_getpte(as, faultaddress, &pte, NULL);
+	if (result) {
+		lock_release(as->as_lock);
+		return result;
+	}
+	*pte |= PTE_REFERENCED;
+	
+	// Translate it into physical address, 
+	// check writeable flag,
+	// and prepare the physical address for TLBLO
+	// (the fast refill in exception-mips1.S goes by PTE_WRITABLE)
+	paddr = KVADDR_TO_PADDR(*pte & PAGE_FRAME);
+	if (permis & PF_W) {
+		paddr |= TLBLO_DIRTY;
+		*pte |= PTE_WRITABLE;
+	}
 	else {
-		*vaddr1 = alloc_kpages(1);
-		KASSERT(*vaddr1 != 0);
-		as_zero_region(*vaddr1, 1);
-		
-		vaddr2 = (vaddr_t *)(*vaddr1 + index2 * 4);
-		vaddr = alloc_kpages(1);
-		KASSERT(vaddr != 0);
-		as_zero_region(vaddr, 1);
-		*vaddr2 |= (vaddr | PTE_VALID);
+		*pte &= ~(vaddr_t)PTE_WRITABLE;
+	}
+	
+	if (s != 0 && s->as_advice == MADV_SEQUENTIAL) {
+		vm_faultahead(as, s, faultaddress);
+	}
+	
+	vm_tlbupdate_as(as, faultaddress, paddr | TLBLO_VALID);
+	lock_release(as->as_lock);
+	return 0;
+}
 
-		paddr = KVADDR_TO_PADDR(vaddr);
-		if (permis & PF_W) {
-			paddr |= TLBLO_DIRTY;
+/*
+ * Fast TLB refill support. The refill code walks the page table in
+ * cpupagetables[] for the CPU it's on; as_activate sets it, and
+ * as_destroy clears it everywhere the table is still named, in case
+ * a CPU has gone on to run only kernel threads since. It is left
+ * clear for an address space that hasn't been sampled in the current
+ * working-set window, so that its next TLB miss goes to vm_fault.
+ */
+void
+vm_setpagetable(struct addrspace *as)
+{
+	int spl;
+
+	spl = splhigh();
+	cpupagetables[curcpu->c_number] =
+		as == NULL || !ws_current(as) ? 0 : as->as_pagetable;
+	splx(spl);
+}
+
+void
+vm_droppagetable(struct addrspace *as)
+{
+	unsigned i;
+
+	for (i=0; i<MAXCPUS; i++) {
+		if (cpupagetables[i] == as->as_pagetable) {
+			cpupagetables[i] = 0;
 		}
 	}
-		
-	spl = splhigh();
-	
-	// update TLB entry
-	// if there still a empty TLB entry, insert new one in
-	// if not, randomly select one, throw it, insert new one in
-	for (i=0; i<NUM_TLB; i++) {
-		tlb_read(&ehi, &elo, i);
-		if (elo & TLBLO_VALID) {
+}
+
+/*
+ * Take NPAGES pages of AS from VADDR out of this CPU's TLB and out of
+ * any other CPU's that is running AS right now: an I/O worker that
+ * has borrowed it (iowork.c). Waits for the other CPUs, so the frames
+ * can be freed afterwards. A CPU that switches to AS later starts
+ * with an empty TLB, so the caller must already have made sure the
+ * fast refill path can't load the pages again (PTE_REFERENCED clear).
+ */
+void
+vm_tlbinvalidate_as(struct addrspace *as, vaddr_t vaddr, unsigned npages)
+{
+	struct tlbshootdown ts;
+	struct cpu *c;
+	unsigned i, k, numcpus;
+
+	vm_tlbinvalidate(vaddr, npages);
+
+	ts.ts_addrspace = as;
+	numcpus = thread_numcpus();
+	for (i=0; i<numcpus; i++) {
+		c = thread_getcpu(i);
+		if (c == curcpu->c_self ||
+		    cpupagetables[c->c_number] != as->as_pagetable) {
 			continue;
 		}
-		ehi = faultaddress;
-		elo = paddr | TLBLO_VALID;
-		tlb_write(ehi, elo, i);
-		splx(spl);
-		return 0;
+		/* one more than TLBSHOOTDOWN_MAX turns into a full flush */
+		for (k=0; k<npages && k<=TLBSHOOTDOWN_MAX; k++) {
+			ts.ts_vaddr = vaddr + k * PAGE_SIZE;
+			ipi_tlbshootdown(c, &ts);
+		}
+		ipi_tlbshootdown_wait(c);
 	}
-	
-	// FIXME, TLB replacement algo.
-	ehi = faultaddress;
-	elo = paddr | TLBLO_VALID;
-	tlb_random(ehi, elo);
-	splx(spl);
-	return 0;
 }
 
 /*
- * SMP-specific functions.  Unused in our configuration.
+ * SMP-specific functions. vfree sends shootdowns for single kernel
+ * pages, and vm_tlbinvalidate_as for user pages.
  */
 
 void
 vm_tlbshootdown_all(void)
 {
-	panic("vm tried to do tlb shootdown?!\n");
+	int i, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	splx(spl);
 }
 
 void
 vm_tlbshootdown(const struct tlbshootdown *ts)
 {
-	(void)ts;
-	panic("vm tried to do tlb shootdown?!\n");
+	vm_tlbinvalidate(ts->ts_vaddr, 1);
 }
 
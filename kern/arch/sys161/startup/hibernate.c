@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Hibernation: save everything in use to disk and power off, and
+ * resume from that image on the next boot.
+ *
+ * The image is written to the raw disk. Sector 0 holds the header;
+ * after it come the physical addresses of the pages saved,
+ * HIBERNATE_PERSECT to a sector, and then the pages themselves in
+ * the same order. The header is written last, so an image is only
+ * ever found complete, and it is wiped as soon as resume starts, so
+ * an image is only ever used once.
+ *
+ * Resume depends on the booting kernel being the very same binary:
+ * loading the image overwrites the booting kernel's code with the
+ * same bytes and its data with the saved kernel's, and then jumps
+ * back into the saved context with longjmp. So the loader runs on a
+ * stack in a page that was free in the saved system and is still
+ * unused in the booting one, and touches nothing else but the disk.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <bitmap.h>
+#include <setjmp.h>
+#include <spl.h>
+#include <thread.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <bufcache.h>
+#include <vm.h>
+#include <mainbus.h>
+#include <machine/tlb.h>
+#include <generic/console.h>
+#include <lamebus/emu.h>
+#include <lamebus/lhd.h>
+#include <hibernate.h>
+
+/* These come from vers.c, which is generated at link time */
+extern const int buildversion;
+extern const char buildconfig[];
+
+#define HIBERNATE_MAGIC		0x68696265	/* "hibe" */
+#define HIBERNATE_PERSECT	(LHD_SECTSIZE / sizeof(uint32_t))
+#define HIBERNATE_PAGESECTS	(PAGE_SIZE / LHD_SECTSIZE)
+
+struct hibernate_header {
+	uint32_t hh_magic;
+	int32_t hh_buildversion;	/* must be the same kernel */
+	char hh_buildconfig[32];
+	uint32_t hh_ramsize;		/* and the same amount of memory */
+	uint32_t hh_npages;		/* number of pages saved */
+	paddr_t hh_scratch;		/* a page that was free */
+	jmp_buf hh_context;		/* where to resume */
+};
+
+union hibernate_sector {
+	struct hibernate_header hs_hdr;
+	uint32_t hs_list[HIBERNATE_PERSECT];
+};
+
+/* What hibernate_load needs, copied onto the scratch stack */
+struct hibernate_load_args {
+	void *hl_busdata;
+	uint32_t hl_buspos;
+	struct hibernate_header hl_hdr;
+};
+
+/* In hibstack.S */
+void hibernate_onstack(vaddr_t stacktop, void (*func)(void *), void *arg);
+
+/*
+ * Throw away all TLB entries. The TLB was set up by the booting
+ * kernel, not the one we are resuming.
+ */
+static
+void
+hibernate_tlbflush(void)
+{
+	unsigned i;
+
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+}
+
+/*
+ * Write the image: every page not marked in FREEMAP. Runs at
+ * splhigh, so nothing else changes memory meanwhile; this means no
+ * kprintf either, since it would change the console's state.
+ *
+ * Returns with *RESUMED false once the image is written, or with
+ * *RESUMED true when hibernate_load longjmps back into the context
+ * saved here.
+ */
+static
+int
+hibernate_save(struct lhd_softc *lh, struct bitmap *freemap,
+	       unsigned npages, paddr_t scratch, bool *resumed)
+{
+	union hibernate_sector hdr, list;
+	void *busdata = lh->lh_busdata;
+	uint32_t buspos = lh->lh_buspos;
+	uint32_t listsect, datasect;
+	unsigned i, n, j;
+	vaddr_t kva;
+	int result;
+
+	bzero(&hdr, sizeof(hdr));
+	hdr.hs_hdr.hh_magic = HIBERNATE_MAGIC;
+	hdr.hs_hdr.hh_buildversion = buildversion;
+	snprintf(hdr.hs_hdr.hh_buildconfig, sizeof(hdr.hs_hdr.hh_buildconfig),
+		 "%s", buildconfig);
+	hdr.hs_hdr.hh_ramsize = mainbus_ramsize();
+	hdr.hs_hdr.hh_npages = npages;
+	hdr.hs_hdr.hh_scratch = scratch;
+
+	listsect = 1;
+	datasect = listsect + DIVROUNDUP(npages, HIBERNATE_PERSECT);
+	if (datasect + npages * HIBERNATE_PAGESECTS > lh->lh_dev.d_blocks) {
+		return ENOSPC;
+	}
+
+	*resumed = false;
+	if (setjmp(hdr.hs_hdr.hh_context)) {
+		/*
+		 * We're back. Only the locals that were already set
+		 * when we saved the stack page can be trusted now.
+		 */
+		*resumed = true;
+		return 0;
+	}
+
+	n = 0;
+	for (i=0; i < hdr.hs_hdr.hh_ramsize / PAGE_SIZE; i++) {
+		if (bitmap_isset(freemap, i)) {
+			continue;
+		}
+
+		list.hs_list[n % HIBERNATE_PERSECT] = i * PAGE_SIZE;
+		n++;
+		if (n % HIBERNATE_PERSECT == 0 || n == npages) {
+			result = lhd_pollio(busdata, buspos, listsect++,
+					    &list, true);
+			if (result) {
+				return result;
+			}
+		}
+
+		kva = PADDR_TO_KVADDR(i * PAGE_SIZE);
+		for (j=0; j<HIBERNATE_PAGESECTS; j++) {
+			result = lhd_pollio(busdata, buspos, datasect++,
+					    (void *)(kva + j * LHD_SECTSIZE),
+					    true);
+			if (result) {
+				return result;
+			}
+		}
+	}
+	KASSERT(n == npages);
+
+	return lhd_pollio(busdata, buspos, 0, &hdr, true);
+}
+
+/*
+ * Save the system to HIBERNATE_DEVICE and power off.
+ */
+int
+hibernate(void)
+{
+	struct lhd_softc *lh;
+	struct bitmap *freemap;
+	struct vnode *v;
+	unsigned i, nframes, npages;
+	paddr_t scratch;
+	bool resumed;
+	int spl, result;
+
+	if (thread_numcpus() > 1) {
+		return EUNIMP;
+	}
+
+	lh = lhd_find(HIBERNATE_DEVICE);
+	if (lh == NULL) {
+		return ENODEV;
+	}
+
+	nframes = mainbus_ramsize() / PAGE_SIZE;
+	freemap = bitmap_create(nframes);
+	if (freemap == NULL) {
+		return ENOMEM;
+	}
+
+	/*
+	 * Holding the big lock keeps filesystem operations out until
+	 * we're done (or have resumed).
+	 */
+	vfs_biglock_acquire();
+
+	result = vfs_sync();
+	if (result) {
+		goto fail;
+	}
+
+	/* Don't write the image over a mounted filesystem. */
+	result = vfs_getroot(HIBERNATE_DEVICE, &v);
+	if (result == 0) {
+		VOP_DECREF(v);
+		result = EBUSY;
+		goto fail;
+	}
+	if (result != ENXIO) {
+		goto fail;
+	}
+
+	/* Nothing cached for the device may outlive the image. */
+	result = bufcache_invalidate(&lh->lh_dev);
+	if (result) {
+		goto fail;
+	}
+
+	result = emu_suspend();
+	if (result) {
+		goto fail;
+	}
+
+	kprintf("Hibernating to %s...\n", HIBERNATE_DEVICE);
+	lhd_suspend();
+	con_suspend();
+
+	spl = splhigh();
+
+	scratch = frametable_getfree(freemap);
+	npages = 0;
+	for (i=0; i<nframes; i++) {
+		if (!bitmap_isset(freemap, i)) {
+			npages++;
+		}
+	}
+
+	if (scratch == 0) {
+		result = ENOMEM;
+	}
+	else {
+		result = hibernate_save(lh, freemap, npages, scratch,
+					&resumed);
+	}
+	if (result == 0 && !resumed) {
+		mainbus_poweroff();
+		panic("hibernate: poweroff failed\n");
+	}
+
+	if (result == 0) {
+		hibernate_tlbflush();
+	}
+	splx(spl);
+
+	con_resume();
+	lhd_resume();
+	emu_resume();
+	vfs_biglock_release();
+	bitmap_destroy(freemap);
+
+	if (result) {
+		kprintf("hibernate: %s\n", strerror(result));
+	}
+	else {
+		kprintf("Resumed from %s (%u pages)\n", HIBERNATE_DEVICE,
+			npages);
+	}
+	return result;
+
+ fail:
+	vfs_biglock_release();
+	bitmap_destroy(freemap);
+	return result;
+}
+
+/*
+ * Load the image and jump into it. Runs on the scratch stack with
+ * interrupts off, and never returns: once the first page is read the
+ * booting kernel is gone, so if the disk fails partway all we can do
+ * is power off.
+ */
+static
+void
+hibernate_load(void *data)
+{
+	struct hibernate_load_args args;
+	union hibernate_sector list;
+	uint32_t listsect, datasect;
+	unsigned n, j;
+	vaddr_t kva;
+
+	/* Copy everything we need off the old stack before it goes. */
+	args = *(struct hibernate_load_args *)data;
+
+	listsect = 1;
+	datasect = listsect + DIVROUNDUP(args.hl_hdr.hh_npages,
+					 HIBERNATE_PERSECT);
+
+	for (n=0; n<args.hl_hdr.hh_npages; n++) {
+		if (n % HIBERNATE_PERSECT == 0) {
+			if (lhd_pollio(args.hl_busdata, args.hl_buspos,
+				       listsect++, &list, false)) {
+				mainbus_poweroff();
+			}
+		}
+
+		kva = PADDR_TO_KVADDR(list.hs_list[n % HIBERNATE_PERSECT]);
+		for (j=0; j<HIBERNATE_PAGESECTS; j++) {
+			if (lhd_pollio(args.hl_busdata, args.hl_buspos,
+				       datasect++,
+				       (void *)(kva + j * LHD_SECTSIZE),
+				       false)) {
+				mainbus_poweroff();
+			}
+		}
+	}
+
+	longjmp(args.hl_hdr.hh_context, 1);
+}
+
+/*
+ * Check the image header for one we can resume.
+ */
+static
+bool
+hibernate_valid(const struct hibernate_header *hh)
+{
+	if (hh->hh_magic != HIBERNATE_MAGIC ||
+	    hh->hh_buildversion != buildversion ||
+	    hh->hh_buildconfig[sizeof(hh->hh_buildconfig) - 1] != 0 ||
+	    strcmp(hh->hh_buildconfig, buildconfig) != 0) {
+		return false;
+	}
+	if (hh->hh_ramsize != mainbus_ramsize()) {
+		return false;
+	}
+
+	/*
+	 * The scratch page must not be in use by us either. Nothing
+	 * has been allocated above ram_getfirstfree() yet.
+	 */
+	if (hh->hh_scratch < ram_getfirstfree() ||
+	    hh->hh_scratch >= hh->hh_ramsize) {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Called from boot() once devices are attached: if HIBERNATE_DEVICE
+ * holds an image, resume it.
+ */
+void
+hibernate_resume(void)
+{
+	struct lhd_softc *lh;
+	union hibernate_sector sect;
+	struct hibernate_load_args args;
+	int spl, result;
+
+	lh = lhd_find(HIBERNATE_DEVICE);
+	if (lh == NULL) {
+		return;
+	}
+
+	spl = splhigh();
+	result = lhd_pollio(lh->lh_busdata, lh->lh_buspos, 0, &sect, false);
+	splx(spl);
+	if (result || !hibernate_valid(&sect.hs_hdr)) {
+		return;
+	}
+
+	args.hl_busdata = lh->lh_busdata;
+	args.hl_buspos = lh->lh_buspos;
+	args.hl_hdr = sect.hs_hdr;
+
+	/* Use the image only once, whatever happens. */
+	bzero(&sect, sizeof(sect));
+	spl = splhigh();
+	result = lhd_pollio(lh->lh_busdata, lh->lh_buspos, 0, &sect, true);
+	splx(spl);
+	if (result) {
+		return;
+	}
+
+	kprintf("Resuming from %s (%u pages)...\n", HIBERNATE_DEVICE,
+		args.hl_hdr.hh_npages);
+
+	/*
+	 * Let the console finish that line, so no write-complete
+	 * interrupt turns up after the saved kernel takes over.
+	 */
+	con_suspend();
+
+	splhigh();
+	hibernate_onstack(PADDR_TO_KVADDR(args.hl_hdr.hh_scratch) + PAGE_SIZE,
+			  hibernate_load, &args);
+	panic("hibernate: resume returned\n");
+}
@@ -46,17 +46,27 @@
  * and (2) if the system crashes before we find a console, no output
  * at all may appear.
  *
- * Note that we have no input buffering; characters typed too rapidly
- * will be lost.
+ * Input is collected at interrupt time in a ring of
+ * CONSOLE_INPUT_BUFFER_SIZE characters; once that fills up, further
+ * characters are lost. User reads go through a simple line
+ * discipline: in canonical mode (TTY_CANON, the default) the input is
+ * edited a line at a time, and a read completes only once a whole
+ * line is available; otherwise a read returns whatever has been typed
+ * so far. Input is echoed in either mode if TTY_ECHO is set. The
+ * modes are set with ioctl (see <kern/ioctl.h>). getch, for the
+ * kernel's own use, always reads raw characters without echo.
  */
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/ioctl.h>
 #include <lib.h>
 #include <uio.h>
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <wchan.h>
+#include <copyinout.h>
 #include <generic/console.h>
 #include <vfs.h>
 #include <device.h>
@@ -74,6 +84,17 @@ static struct con_softc *the_console = NULL;
 static struct lock *con_userlock_read = NULL;
 static struct lock *con_userlock_write = NULL;
 
+/*
+ * Line discipline state. con_userlock_read protects all of it except
+ * con_mode, which is a single word set by ioctl.
+ */
+#define CON_LINE_MAX	256
+static volatile int con_mode = TTY_CANON | TTY_ECHO;
+static char con_line[CON_LINE_MAX];	/* the line being edited */
+static size_t con_linelen;		/* characters in con_line */
+static size_t con_linepos;		/* characters of it already read */
+static bool con_lineready;		/* line finished and can be read */
+
 //////////////////////////////////////////////////
 
 /*
@@ -154,29 +175,37 @@ putch_intr(struct con_softc *cs, int ch)
 }
 
 /*
- * Read a character, using interrupts to wait for I/O completion.
+ * Take up to LEN characters of input out of the ring, waiting until
+ * there is at least one. Returns the number taken.
  */
 static
-int
-getch_intr(struct con_softc *cs)
+size_t
+con_getchars(struct con_softc *cs, char *buf, size_t len)
 {
-	unsigned char ret;
-
-	P(cs->cs_rsem);
-	ret = cs->cs_gotchars[cs->cs_gotchars_tail];
-	cs->cs_gotchars_tail =
-		(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
-	return ret;
+	size_t n = 0;
+
+	spinlock_acquire(&cs->cs_rlock);
+	while (cs->cs_gotchars_head == cs->cs_gotchars_tail) {
+		/* as in P() */
+		wchan_lock(cs->cs_rwchan);
+		spinlock_release(&cs->cs_rlock);
+		wchan_sleep(cs->cs_rwchan);
+		spinlock_acquire(&cs->cs_rlock);
+	}
+	while (n < len && cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+		buf[n++] = cs->cs_gotchars[cs->cs_gotchars_tail];
+		cs->cs_gotchars_tail =
+			(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
+	}
+	spinlock_release(&cs->cs_rlock);
+	return n;
 }
 
 /*
  * Called from underlying device when a read-ready interrupt occurs.
  *
  * Note: if gotchars_head == gotchars_tail, the buffer is empty. Thus
- * if gotchars_head+1 == gotchars_tail, the buffer is full. A slightly
- * tidier way to implement this check (that avoids wasting a slot,
- * too) would be with a second semaphore used with a nonblocking P,
- * but we don't have that in OS/161.
+ * if gotchars_head+1 == gotchars_tail, the buffer is full.
  */
 void
 con_input(void *vcs, int ch)
@@ -184,16 +213,19 @@ con_input(void *vcs, int ch)
 	struct con_softc *cs = vcs;
 	unsigned nexthead;
 
+	spinlock_acquire(&cs->cs_rlock);
 	nexthead = (cs->cs_gotchars_head + 1) % CONSOLE_INPUT_BUFFER_SIZE;
 	if (nexthead == cs->cs_gotchars_tail) {
 		/* overflow; drop character */
+		spinlock_release(&cs->cs_rlock);
 		return;
 	}
 
 	cs->cs_gotchars[cs->cs_gotchars_head] = ch;
 	cs->cs_gotchars_head = nexthead;
-		
-	V(cs->cs_rsem);
+
+	wchan_wakeall(cs->cs_rwchan);
+	spinlock_release(&cs->cs_rlock);
 }
 
 /*
@@ -265,14 +297,43 @@ putch_complete(void)
 	}
 }
 
+/*
+ * Quiesce console output for hibernation. Once we hold the write
+ * semaphore no character is in flight, so no write-complete interrupt
+ * is pending; other threads wait in putch_intr until con_resume.
+ * Output at splhigh still goes out polled.
+ */
+void
+con_suspend(void)
+{
+	struct con_softc *cs = the_console;
+
+	if (cs != NULL) {
+		P(cs->cs_wsem);
+	}
+}
+
+void
+con_resume(void)
+{
+	struct con_softc *cs = the_console;
+
+	if (cs != NULL) {
+		V(cs->cs_wsem);
+	}
+}
+
 int
 getch(void)
 {
 	struct con_softc *cs = the_console;
+	char ch;
+
 	KASSERT(cs != NULL);
 	KASSERT(!curthread->t_in_interrupt && curthread->t_iplhigh_count == 0);
 
-	return getch_intr(cs);
+	con_getchars(cs, &ch, 1);
+	return (unsigned char)ch;
 }
 
 ////////////////////////////////////////////////////////////
@@ -298,54 +359,155 @@ con_close(struct device *dev)
 	return 0;
 }
 
+/*
+ * Canonical-mode input processing for one character CH: line editing,
+ * echoing, and noticing the end of the line. Backspace (or DEL)
+ * erases a character, ^U the whole line, and ^D ends the line without
+ * a newline, so it reads as end of file if the line is empty. There
+ * is always room for the newline.
+ */
+static
+void
+con_canon(int ch, bool echo)
+{
+	switch (ch) {
+	    case '\r':
+	    case '\n':
+		con_line[con_linelen++] = '\n';
+		con_lineready = true;
+		if (echo) {
+			putch('\r');
+			putch('\n');
+		}
+		break;
+	    case 4: /* ^D */
+		con_lineready = true;
+		break;
+	    case '\b':
+	    case 127:
+		if (con_linelen > 0) {
+			con_linelen--;
+			if (echo) {
+				putch('\b');
+				putch(' ');
+				putch('\b');
+			}
+		}
+		break;
+	    case 21: /* ^U */
+		while (con_linelen > 0) {
+			con_linelen--;
+			if (echo) {
+				putch('\b');
+				putch(' ');
+				putch('\b');
+			}
+		}
+		break;
+	    default:
+		if (con_linelen < CON_LINE_MAX - 1) {
+			con_line[con_linelen++] = ch;
+			if (echo) {
+				putch(ch);
+			}
+		}
+		else if (echo) {
+			/* line full; alert (bell) */
+			putch('\a');
+		}
+		break;
+	}
+}
+
+/*
+ * Read from the console. In canonical mode, wait until a line has
+ * been finished and return as much of it as fits; the rest is kept
+ * for the next read. Otherwise, return whatever has been typed,
+ * waiting for at least one character.
+ */
+static
+int
+con_read(struct con_softc *cs, struct uio *uio)
+{
+	char buf[64];
+	char ch;
+	size_t i, n;
+	int mode, result;
+
+	KASSERT(lock_do_i_hold(con_userlock_read));
+
+	if (uio->uio_resid == 0) {
+		return 0;
+	}
+
+	mode = con_mode;
+	if ((mode & TTY_CANON) == 0 && con_linelen > 0) {
+		/* canonical mode was turned off partway through a line */
+		con_lineready = true;
+	}
+
+	if (con_lineready || (mode & TTY_CANON)) {
+		while (!con_lineready) {
+			con_getchars(cs, &ch, 1);
+			con_canon(ch, (mode & TTY_ECHO) != 0);
+		}
+
+		n = con_linelen - con_linepos;
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(con_line + con_linepos, n, uio);
+		if (result) {
+			return result;
+		}
+		con_linepos += n;
+		if (con_linepos == con_linelen) {
+			con_linelen = con_linepos = 0;
+			con_lineready = false;
+		}
+		return 0;
+	}
+
+	n = uio->uio_resid < sizeof(buf) ? uio->uio_resid : sizeof(buf);
+	n = con_getchars(cs, buf, n);
+	if (mode & TTY_ECHO) {
+		for (i=0; i<n; i++) {
+			putch(buf[i]);
+		}
+	}
+	return uiomove(buf, n, uio);
+}
+
 static
 int
 con_io(struct device *dev, struct uio *uio)
 {
 	int result;
 	char ch;
-	struct lock *lk;
-
-	(void)dev;  // unused
 
 	if (uio->uio_rw==UIO_READ) {
-		lk = con_userlock_read;
-	}
-	else {
-		lk = con_userlock_write;
+		KASSERT(con_userlock_read != NULL);
+		lock_acquire(con_userlock_read);
+		result = con_read(dev->d_data, uio);
+		lock_release(con_userlock_read);
+		return result;
 	}
 
-	KASSERT(lk != NULL);
-	lock_acquire(lk);
+	KASSERT(con_userlock_write != NULL);
+	lock_acquire(con_userlock_write);
 
 	while (uio->uio_resid > 0) {
-		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
-			if (ch=='\r') {
-				ch = '\n';
-			}
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				break;
-			}
+		result = uiomove(&ch, 1, uio);
+		if (result) {
+			lock_release(con_userlock_write);
+			return result;
 		}
-		else {
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				putch('\r');
-			}
-			putch(ch);
+		if (ch=='\n') {
+			putch('\r');
 		}
+		putch(ch);
 	}
-	lock_release(lk);
+	lock_release(con_userlock_write);
 	return 0;
 }
 
@@ -353,11 +515,26 @@ static
 int
 con_ioctl(struct device *dev, int op, userptr_t data)
 {
-	/* No ioctls. */
+	int mode, result;
+
 	(void)dev;
-	(void)op;
-	(void)data;
-	return EINVAL;
+
+	switch (op) {
+	    case TIOCGETMODE:
+		mode = con_mode;
+		return copyout(&mode, data, sizeof(mode));
+	    case TIOCSETMODE:
+		result = copyin(data, &mode, sizeof(mode));
+		if (result) {
+			return result;
+		}
+		if (mode & ~(TTY_CANON | TTY_ECHO)) {
+			return EINVAL;
+		}
+		con_mode = mode;
+		return 0;
+	}
+	return EIOCTL;
 }
 
 static
@@ -398,7 +575,8 @@ attach_console_to_vfs(struct con_softc *cs)
 int
 config_con(struct con_softc *cs, int unit)
 {
-	struct semaphore *rsem, *wsem;
+	struct wchan *rwchan;
+	struct semaphore *wsem;
 	struct lock *rlk, *wlk;
 
 	/*
@@ -414,30 +592,31 @@ config_con(struct con_softc *cs, int unit)
 	}
 	KASSERT(the_console==NULL);
 
-	rsem = sem_create("console read", 0);
-	if (rsem == NULL) {
+	rwchan = wchan_create("console read");
+	if (rwchan == NULL) {
 		return ENOMEM;
 	}
 	wsem = sem_create("console write", 1);
 	if (wsem == NULL) {
-		sem_destroy(rsem);
+		wchan_destroy(rwchan);
 		return ENOMEM;
 	}
 	rlk = lock_create("console-lock-read");
 	if (rlk == NULL) {
-		sem_destroy(rsem);
+		wchan_destroy(rwchan);
 		sem_destroy(wsem);
 		return ENOMEM;
 	}
 	wlk = lock_create("console-lock-write");
 	if (wlk == NULL) {
 		lock_destroy(rlk);
-		sem_destroy(rsem);
+		wchan_destroy(rwchan);
 		sem_destroy(wsem);
 		return ENOMEM;
 	}
 
-	cs->cs_rsem = rsem; 
+	spinlock_init(&cs->cs_rlock);
+	cs->cs_rwchan = rwchan;
 	cs->cs_wsem = wsem; 
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
@@ -37,7 +37,9 @@
  * device, and are to be initialized by the attach routine.
  */
 
-#define CONSOLE_INPUT_BUFFER_SIZE 32
+#include <spinlock.h>
+
+#define CONSOLE_INPUT_BUFFER_SIZE 256
 
 struct con_softc {
 	/* initialized by attach routine */
@@ -48,7 +50,8 @@ struct con_softc {
 	void (*cs_endpolling)(void *devdata);
 
 	/* initialized by config routine */
-	struct semaphore *cs_rsem;
+	struct spinlock cs_rlock;	/* protects cs_gotchars */
+	struct wchan *cs_rwchan;	/* readers waiting for input */
 	struct semaphore *cs_wsem;
 	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
 	unsigned cs_gotchars_head;	/* next slot to put a char in */
@@ -66,5 +69,7 @@ void con_start(/*struct con_softc*/ void *cs);
  *
  * putch/getch - see <lib.h>
  */
+void con_suspend(void);
+void con_resume(void);
 
 #endif /* _GENERIC_CONSOLE_H_ */
@@ -90,6 +90,9 @@
 #define EMU_RES_UNKNOWN      12
 #define EMU_RES_UNSUPP       13
 
+/* All emufs instances, for hibernation */
+static struct emufs_fs *emufs_all;
+
 ////////////////////////////////////////////////////////////
 //
 // Hardware ops
@@ -1317,8 +1320,50 @@ emufs_addtovfs(struct emu_softc *sc, const char *devname)
 	if (result) {
 		VOP_DECREF(&ef->ef_root->ev_v);
 		kfree(ef);
+		return result;
+	}
+
+	ef->ef_next = emufs_all;
+	emufs_all = ef;
+	return 0;
+}
+
+/*
+ * Get ready for hibernation. The emulator's file handles don't
+ * survive a reboot, so fail with EBUSY if any file other than a root
+ * directory (whose handle is always the same) is loaded. Otherwise,
+ * hold every device lock so no operation is in progress until
+ * emu_resume.
+ *
+ * The caller holds the VFS big lock, so vnodes can't come or go
+ * while we look.
+ */
+int
+emu_suspend(void)
+{
+	struct emufs_fs *ef;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	for (ef = emufs_all; ef != NULL; ef = ef->ef_next) {
+		if (vnodearray_num(ef->ef_vnodes) > 1) {
+			return EBUSY;
+		}
+	}
+	for (ef = emufs_all; ef != NULL; ef = ef->ef_next) {
+		lock_acquire(ef->ef_emu->e_lock);
+	}
+	return 0;
+}
+
+void
+emu_resume(void)
+{
+	struct emufs_fs *ef;
+
+	for (ef = emufs_all; ef != NULL; ef = ef->ef_next) {
+		lock_release(ef->ef_emu->e_lock);
 	}
-	return result;
 }
 
 //
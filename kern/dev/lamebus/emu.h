@@ -58,5 +58,9 @@ struct emu_softc {
 /* Functions called by lower-level drivers */
 void emu_irq(/*struct emu_softc*/ void *);
 
+/* Functions used for hibernation */
+int emu_suspend(void);
+void emu_resume(void);
+
 
 #endif /* _LAMEBUS_EMU_H_ */
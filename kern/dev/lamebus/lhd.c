@@ -59,6 +59,9 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+/* All attached lhds */
+static struct lhd_softc *lhd_all;
+
 /*
  * Shortcut for reading a register.
  */
@@ -282,6 +285,7 @@ int
 config_lhd(struct lhd_softc *lh, int lhdno)
 {
 	char name[32];
+	int result;
 
 	/* Figure out what our name is. */
 	snprintf(name, sizeof(name), "lhd%d", lhdno);
@@ -312,5 +316,99 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 	lh->lh_dev.d_data = lh;
 
 	/* Add the VFS device structure to the VFS device list. */
-	return vfs_adddev(name, &lh->lh_dev, 1);
+	result = vfs_adddev(name, &lh->lh_dev, 1);
+	if (result) {
+		return result;
+	}
+
+	lh->lh_next = lhd_all;
+	lhd_all = lh;
+	return 0;
+}
+
+/*
+ * Find the lhd called NAME (e.g. "lhd1"), or return NULL.
+ */
+struct lhd_softc *
+lhd_find(const char *name)
+{
+	struct lhd_softc *lh;
+	char lhname[32];
+
+	for (lh = lhd_all; lh != NULL; lh = lh->lh_next) {
+		snprintf(lhname, sizeof(lhname), "lhd%d", lh->lh_unit);
+		if (!strcmp(lhname, name)) {
+			return lh;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Stop all disk I/O, for hibernation. Once we hold each disk's
+ * clear-to-go semaphore nothing is in progress and nothing else can
+ * start until lhd_resume.
+ */
+void
+lhd_suspend(void)
+{
+	struct lhd_softc *lh;
+
+	for (lh = lhd_all; lh != NULL; lh = lh->lh_next) {
+		P(lh->lh_clear);
+	}
+}
+
+void
+lhd_resume(void)
+{
+	struct lhd_softc *lh;
+
+	for (lh = lhd_all; lh != NULL; lh = lh->lh_next) {
+		V(lh->lh_clear);
+	}
+}
+
+/*
+ * Polled I/O of one sector between BUF and the disk at BUSPOS. Call
+ * with interrupts off and the disk suspended. Clearing the status
+ * register when we're done also clears the interrupt, so lhd_irq
+ * never sees this operation.
+ *
+ * This touches nothing but the device, BUF, and the stack.
+ */
+int
+lhd_pollio(void *busdata, uint32_t buspos, uint32_t sector,
+	   void *buf, bool iswrite)
+{
+	void *cardbuf;
+	uint32_t val;
+
+	cardbuf = bus_map_area(busdata, buspos, LHD_BUFFER);
+
+	if (iswrite) {
+		memcpy(cardbuf, buf, LHD_SECTSIZE);
+	}
+
+	bus_write_register(busdata, buspos, LHD_REG_SECT, sector);
+	bus_write_register(busdata, buspos, LHD_REG_STAT,
+			   LHD_WORKING | (iswrite ? LHD_ISWRITE : 0));
+	do {
+		val = bus_read_register(busdata, buspos, LHD_REG_STAT);
+	} while ((val & LHD_STATEMASK) == LHD_WORKING);
+	bus_write_register(busdata, buspos, LHD_REG_STAT, 0);
+
+	switch (val & LHD_STATEMASK) {
+	    case LHD_OK:
+		break;
+	    case LHD_INVSECT:
+		return EINVAL;
+	    default:
+		return EIO;
+	}
+
+	if (!iswrite) {
+		memcpy(buf, cardbuf, LHD_SECTSIZE);
+	}
+	return 0;
 }
@@ -56,9 +56,23 @@ struct lhd_softc {
 	struct semaphore *lh_done;
 
 	struct device lh_dev;		/* VFS device structure */
+
+	struct lhd_softc *lh_next;	/* All lhds, for hibernation */
 };
 
 /* Functions called by lower-level drivers */
 void lhd_irq(/*struct lhd_softc*/ void *);	/* Interrupt handler */
 
+/*
+ * Functions used for hibernation. lhd_pollio does one sector of I/O
+ * with interrupts off, waiting for the disk in a loop; it takes the
+ * bus position rather than the softc, so it keeps working while the
+ * memory the softc lives in is being overwritten.
+ */
+struct lhd_softc *lhd_find(const char *name);
+void lhd_suspend(void);
+void lhd_resume(void);
+int lhd_pollio(void *busdata, uint32_t buspos, uint32_t sector,
+	       void *buf, bool iswrite);
+
 #endif /* _LAMEBUS_LHD_H_ */
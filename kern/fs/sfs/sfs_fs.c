@@ -43,55 +43,44 @@
 #include <device.h>
 #include <sfs.h>
 
-/* Shortcuts for the size macros in kern/sfs.h */
-#define SFS_FS_BITMAPSIZE(sfs)  SFS_BITMAPSIZE((sfs)->sfs_super.sp_nblocks)
-#define SFS_FS_BITBLOCKS(sfs)   SFS_BITBLOCKS((sfs)->sfs_super.sp_nblocks)
-
 /*
  * Routine for doing I/O (reads or writes) on the free block bitmap.
  * We always do the whole bitmap at once; writing individual sectors
  * might or might not be a worthwhile optimization.
  *
- * The free block bitmap consists of SFS_BITBLOCKS 512-byte sectors of
- * bits, one bit for each sector on the filesystem. The number of
- * blocks in the bitmap is thus rounded up to the nearest multiple of
- * 512*8 = 4096. (This rounded number is SFS_BITMAPSIZE.) This means
- * that the bitmap will (in general) contain space for some number of
- * invalid sectors that are actually beyond the end of the disk
- * device. This is ok. These sectors are supposed to be marked "in
- * use" by mksfs and never get marked "free".
+ * The free block bitmap consists of SFS_BITBLOCKS blocks of bits, one
+ * bit for each block on the filesystem. The number of blocks in the
+ * bitmap is thus rounded up to the nearest multiple of the number of
+ * bits in a block (4096 for 512-byte blocks). (This rounded number is
+ * SFS_BITMAPSIZE.) This means that the bitmap will (in general)
+ * contain space for some number of invalid blocks that are actually
+ * beyond the end of the disk device. This is ok. These blocks are
+ * supposed to be marked "in use" by mksfs and never get marked "free".
  *
  * The sectors used by the superblock and the bitmap itself are
  * likewise marked in use by mksfs.
+ *
+ * In memory each sector of the bitmap is a separate bitmap (see
+ * SFS_MAPCHUNK), so the I/O is done a sector at a time.
  */
 
 static
 int
 sfs_mapio(struct sfs_fs *sfs, enum uio_rw rw)
 {
-	uint32_t j, mapsize;
-	char *bitdata;
+	unsigned j, sectsperblock;
 	int result;
 
-	/* Number of blocks in the bitmap. */
-	mapsize = SFS_FS_BITBLOCKS(sfs);
+	sectsperblock = sfs->sfs_blocksize / SFS_BLOCKSIZE;
 
-	/* Pointer to our bitmap data in memory. */
-	bitdata = bitmap_getdata(sfs->sfs_freemap);
-	
 	/* For each sector in the bitmap... */
-	for (j=0; j<mapsize; j++) {
+	for (j=0; j<sfs->sfs_freemapchunks; j++) {
 
-		/* Get a pointer to its data */
-		void *ptr = bitdata + j*SFS_BLOCKSIZE;
-
-		/* and read or write it. The bitmap starts at sector 2. */ 
-		if (rw == UIO_READ) {
-			result = sfs_rblock(sfs, ptr, SFS_MAP_LOCATION+j);
-		}
-		else {
-			result = sfs_wblock(sfs, ptr, SFS_MAP_LOCATION+j);
-		}
+		/* read or write it. The bitmap starts at block 2. */
+		result = sfs_rwsector(sfs,
+				      bitmap_getdata(sfs->sfs_freemap[j]),
+				      SFS_MAP_LOCATION + j / sectsperblock,
+				      j % sectsperblock, rw);
 
 		/* If we failed, stop. */
 		if (result) {
@@ -101,6 +90,54 @@ sfs_mapio(struct sfs_fs *sfs, enum uio_rw rw)
 	return 0;
 }
 
+/*
+ * Free the in-memory freemap.
+ */
+static
+void
+sfs_mapdestroy(struct sfs_fs *sfs)
+{
+	unsigned j;
+
+	for (j=0; j<sfs->sfs_freemapchunks; j++) {
+		if (sfs->sfs_freemap[j] != NULL) {
+			bitmap_destroy(sfs->sfs_freemap[j]);
+		}
+	}
+	kfree(sfs->sfs_freemap);
+	sfs->sfs_freemap = NULL;
+	sfs->sfs_freemapchunks = 0;
+}
+
+/*
+ * Allocate the in-memory freemap, one bitmap per sector.
+ */
+static
+int
+sfs_mapcreate(struct sfs_fs *sfs)
+{
+	unsigned j, nchunks;
+
+	nchunks = SFS_FS_BITMAPSIZE(sfs) / SFS_MAPCHUNKBITS;
+
+	sfs->sfs_freemap = kmalloc(nchunks * sizeof(struct bitmap *));
+	if (sfs->sfs_freemap == NULL) {
+		return ENOMEM;
+	}
+	sfs->sfs_freemapchunks = nchunks;
+	for (j=0; j<nchunks; j++) {
+		sfs->sfs_freemap[j] = NULL;
+	}
+	for (j=0; j<nchunks; j++) {
+		sfs->sfs_freemap[j] = bitmap_create(SFS_MAPCHUNKBITS);
+		if (sfs->sfs_freemap[j] == NULL) {
+			sfs_mapdestroy(sfs);
+			return ENOMEM;
+		}
+	}
+	return 0;
+}
+
 /*
  * Sync routine. This is what gets invoked if you do FS_SYNC on the
  * sfs filesystem structure.
@@ -111,7 +148,8 @@ int
 sfs_sync(struct fs *fs)
 {
 	struct sfs_fs *sfs; 
-	unsigned i, num;
+	struct sfs_vnode *sv;
+	struct hashiter iter;
 	int result;
 
 	vfs_biglock_acquire();
@@ -148,11 +186,10 @@ sfs_sync(struct fs *fs)
 
 	sfs = fs->fs_data;
 
-	/* Go over the array of loaded vnodes, syncing as we go. */
-	num = vnodearray_num(sfs->sfs_vnodes);
-	for (i=0; i<num; i++) {
-		struct vnode *v = vnodearray_get(sfs->sfs_vnodes, i);
-		VOP_FSYNC(v);
+	/* Go over the table of loaded vnodes, syncing as we go. */
+	sfs_vnodetable_iterinit(&sfs->sfs_vnodes, &iter);
+	while ((sv = sfs_vnodetable_iternext(&sfs->sfs_vnodes, &iter)) != NULL) {
+		VOP_FSYNC(&sv->sv_v);
 	}
 
 	/* If the free block map needs to be written, write it. */
@@ -167,7 +204,7 @@ sfs_sync(struct fs *fs)
 
 	/* If the superblock needs to be written, write it. */
 	if (sfs->sfs_superdirty) {
-		result = sfs_wblock(sfs, &sfs->sfs_super, SFS_SB_LOCATION);
+		result = sfs_whead(sfs, &sfs->sfs_super, SFS_SB_LOCATION);
 		if (result) {
 			vfs_biglock_release();
 			return result;
@@ -212,7 +249,7 @@ sfs_unmount(struct fs *fs)
 	vfs_biglock_acquire();
 	
 	/* Do we have any files open? If so, can't unmount. */
-	if (vnodearray_num(sfs->sfs_vnodes) > 0) {
+	if (sfs_vnodetable_num(&sfs->sfs_vnodes) > 0) {
 		vfs_biglock_release();
 		return EBUSY;
 	}
@@ -222,8 +259,8 @@ sfs_unmount(struct fs *fs)
 	KASSERT(sfs->sfs_freemapdirty == false);
 
 	/* Once we start nuking stuff we can't fail. */
-	vnodearray_destroy(sfs->sfs_vnodes);
-	bitmap_destroy(sfs->sfs_freemap);
+	sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
+	sfs_mapdestroy(sfs);
 	
 	/* The vfs layer takes care of the device for us */
 	(void)sfs->sfs_device;
@@ -270,12 +307,13 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	KASSERT(SFS_BLOCKSIZE % sizeof(struct sfs_dir) == 0);
 
 	/*
-	 * We can't mount on devices with the wrong sector size.
+	 * We can't mount on devices with the wrong sector size: the
+	 * device must have SFS_BLOCKSIZE (512-byte) sectors.
 	 *
-	 * (Note: for all intents and purposes here, "sector" and
-	 * "block" are interchangeable terms. Technically a filesystem
-	 * block may be composed of several hardware sectors, but we
-	 * don't do that in sfs.)
+	 * (The filesystem block size may be a multiple of this; it's
+	 * recorded in the superblock, and each filesystem block is then
+	 * several device sectors. But the superblock and the in-memory
+	 * freemap are handled a sector at a time.)
 	 */
 	if (dev->d_blocksize != SFS_BLOCKSIZE) {
 		vfs_biglock_release();
@@ -289,21 +327,22 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 		return ENOMEM;
 	}
 
-	/* Allocate array */
-	sfs->sfs_vnodes = vnodearray_create();
-	if (sfs->sfs_vnodes == NULL) {
+	/* Set up the vnode table */
+	result = sfs_vnodetable_init(&sfs->sfs_vnodes, 0, 0);
+	if (result) {
 		kfree(sfs);
 		vfs_biglock_release();
-		return ENOMEM;
+		return result;
 	}
 
-	/* Set the device so we can use sfs_rblock() */
+	/* Set the device so we can use sfs_rhead() */
 	sfs->sfs_device = dev;
+	sfs->sfs_blocksize = SFS_BLOCKSIZE;
 
 	/* Load superblock */
-	result = sfs_rblock(sfs, &sfs->sfs_super, SFS_SB_LOCATION);
+	result = sfs_rhead(sfs, &sfs->sfs_super, SFS_SB_LOCATION);
 	if (result) {
-		vnodearray_destroy(sfs->sfs_vnodes);
+		sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
 		kfree(sfs);
 		vfs_biglock_release();
 		return result;
@@ -316,32 +355,48 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 			"(0x%x, should be 0x%x)\n", 
 			sfs->sfs_super.sp_magic,
 			SFS_MAGIC);
-		vnodearray_destroy(sfs->sfs_vnodes);
+		sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
 		kfree(sfs);
 		vfs_biglock_release();
 		return EINVAL;
 	}
 	
-	if (sfs->sfs_super.sp_nblocks > dev->d_blocks) {
-		kprintf("sfs: warning - fs has %u blocks, device has %u\n",
-			sfs->sfs_super.sp_nblocks, dev->d_blocks);
+	/* Now we know the real block size. */
+	if (sfs->sfs_super.sp_blocksize != 0) {
+		sfs->sfs_blocksize = sfs->sfs_super.sp_blocksize;
+	}
+	if (!SFS_BLOCKSIZE_OK(sfs->sfs_blocksize)) {
+		kprintf("sfs: Invalid block size %u in superblock\n",
+			sfs->sfs_blocksize);
+		sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
+		kfree(sfs);
+		vfs_biglock_release();
+		return EINVAL;
+	}
+
+	if (sfs->sfs_super.sp_nblocks >
+	    dev->d_blocks / (sfs->sfs_blocksize / SFS_BLOCKSIZE)) {
+		kprintf("sfs: warning - fs has %u %u-byte blocks, "
+			"device has %u sectors\n",
+			sfs->sfs_super.sp_nblocks, sfs->sfs_blocksize,
+			dev->d_blocks);
 	}
 
 	/* Ensure null termination of the volume name */
 	sfs->sfs_super.sp_volname[sizeof(sfs->sfs_super.sp_volname)-1] = 0;
 
 	/* Load free space bitmap */
-	sfs->sfs_freemap = bitmap_create(SFS_FS_BITMAPSIZE(sfs));
-	if (sfs->sfs_freemap == NULL) {
-		vnodearray_destroy(sfs->sfs_vnodes);
+	result = sfs_mapcreate(sfs);
+	if (result) {
+		sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
 		kfree(sfs);
 		vfs_biglock_release();
-		return ENOMEM;
+		return result;
 	}
 	result = sfs_mapio(sfs, UIO_READ);
 	if (result) {
-		bitmap_destroy(sfs->sfs_freemap);
-		vnodearray_destroy(sfs->sfs_vnodes);
+		sfs_mapdestroy(sfs);
+		sfs_vnodetable_cleanup(&sfs->sfs_vnodes);
 		kfree(sfs);
 		vfs_biglock_release();
 		return result;
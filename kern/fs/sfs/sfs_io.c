@@ -33,16 +33,17 @@
 #include <uio.h>
 #include <vfs.h>
 #include <device.h>
+#include <bufcache.h>
 #include <sfs.h>
 
 ////////////////////////////////////////////////////////////
 //
 // Basic block-level I/O routines
 //
-// Note: sfs_rblock is used to read the superblock
+// Note: sfs_rhead is used to read the superblock
 // early in mount, before sfs is fully (or even mostly)
 // initialized, and so may not use anything from sfs
-// except sfs_device.
+// except sfs_device and sfs_blocksize.
 
 int
 sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
@@ -54,10 +55,15 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 
 	DEBUG(DB_SFS, "sfs: %s %llu\n", 
 	      uio->uio_rw == UIO_READ ? "read" : "write",
-	      uio->uio_offset / SFS_BLOCKSIZE);
+	      uio->uio_offset / sfs->sfs_blocksize);
 
  retry:
-	result = sfs->sfs_device->d_io(sfs->sfs_device, uio);
+	if (bufcache_cancache(sfs->sfs_device)) {
+		result = bufcache_io(sfs->sfs_device, uio, false);
+	}
+	else {
+		result = sfs->sfs_device->d_io(sfs->sfs_device, uio);
+	}
 	if (result == EINVAL) {
 		/*
 		 * This means the sector we requested was out of range,
@@ -70,7 +76,7 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 		if (tries == 0) {
 			tries++;
 			kprintf("sfs: block %llu I/O error, retrying\n",
-				uio->uio_offset / SFS_BLOCKSIZE);
+				uio->uio_offset / sfs->sfs_blocksize);
 			goto retry;
 		}
 		else if (tries < 10) {
@@ -80,7 +86,7 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 		else {
 			kprintf("sfs: block %llu I/O error, giving up after "
 				"%d retries\n",
-				uio->uio_offset / SFS_BLOCKSIZE, tries);
+				uio->uio_offset / sfs->sfs_blocksize, tries);
 		}
 	}
 	return result;
@@ -92,7 +98,7 @@ sfs_rblock(struct sfs_fs *sfs, void *data, uint32_t block)
 	struct iovec iov;
 	struct uio ku;
 
-	SFSUIO(&iov, &ku, data, block, UIO_READ);
+	SFSUIO(sfs, &iov, &ku, data, block, UIO_READ);
 	return sfs_rwblock(sfs, &ku);
 }
 
@@ -102,6 +108,47 @@ sfs_wblock(struct sfs_fs *sfs, void *data, uint32_t block)
 	struct iovec iov;
 	struct uio ku;
 
-	SFSUIO(&iov, &ku, data, block, UIO_WRITE);
+	SFSUIO(sfs, &iov, &ku, data, block, UIO_WRITE);
+	return sfs_rwblock(sfs, &ku);
+}
+
+int
+sfs_rhead(struct sfs_fs *sfs, void *data, uint32_t block)
+{
+	struct iovec iov;
+	struct uio ku;
+
+	uio_kinit(&iov, &ku, data, SFS_BLOCKSIZE,
+		  ((off_t)block)*sfs->sfs_blocksize, UIO_READ);
+	return sfs_rwblock(sfs, &ku);
+}
+
+int
+sfs_whead(struct sfs_fs *sfs, void *data, uint32_t block)
+{
+	struct iovec iov;
+	struct uio ku;
+
+	uio_kinit(&iov, &ku, data, SFS_BLOCKSIZE,
+		  ((off_t)block)*sfs->sfs_blocksize, UIO_WRITE);
+	return sfs_rwblock(sfs, &ku);
+}
+
+/*
+ * I/O on the SECTORth SFS_BLOCKSIZE sector of BLOCK. Used for the
+ * freemap, which is kept in memory a sector at a time.
+ */
+int
+sfs_rwsector(struct sfs_fs *sfs, void *data, uint32_t block,
+	     unsigned sector, enum uio_rw rw)
+{
+	struct iovec iov;
+	struct uio ku;
+
+	KASSERT(sector < sfs->sfs_blocksize / SFS_BLOCKSIZE);
+
+	uio_kinit(&iov, &ku, data, SFS_BLOCKSIZE,
+		  ((off_t)block)*sfs->sfs_blocksize + sector*SFS_BLOCKSIZE,
+		  rw);
 	return sfs_rwblock(sfs, &ku);
 }
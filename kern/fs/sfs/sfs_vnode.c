@@ -32,6 +32,10 @@
  *
  * File-level (vnode) interface routines.
  */
+
+/* Make sure the vnode table functions get compiled out-of-line here. */
+#define SFSINLINE
+
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
@@ -59,7 +63,7 @@ int
 sfs_clearblock(struct sfs_fs *sfs, uint32_t block)
 {
 	/* static -> automatically initialized to zero */
-	static char zeros[SFS_BLOCKSIZE];
+	static char zeros[SFS_MAXBLOCKSIZE];
 	return sfs_wblock(sfs, zeros, block);
 }
 
@@ -70,7 +74,7 @@ sfs_sync_inode(struct sfs_vnode *sv)
 {
 	if (sv->sv_dirty) {
 		struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
-		int result = sfs_wblock(sfs, &sv->sv_i, sv->sv_ino);
+		int result = sfs_whead(sfs, &sv->sv_i, sv->sv_ino);
 		if (result) {
 			return result;
 		}
@@ -90,12 +94,20 @@ static
 int
 sfs_balloc(struct sfs_fs *sfs, uint32_t *diskblock)
 {
+	unsigned j, bit;
 	int result;
 
-	result = bitmap_alloc(sfs->sfs_freemap, diskblock);
+	result = ENOSPC;
+	for (j=0; j<sfs->sfs_freemapchunks; j++) {
+		result = bitmap_alloc(sfs->sfs_freemap[j], &bit);
+		if (result == 0) {
+			break;
+		}
+	}
 	if (result) {
 		return result;
 	}
+	*diskblock = j * SFS_MAPCHUNKBITS + bit;
 	sfs->sfs_freemapdirty = true;
 
 	if (*diskblock >= sfs->sfs_super.sp_nblocks) {
@@ -113,7 +125,7 @@ static
 void
 sfs_bfree(struct sfs_fs *sfs, uint32_t diskblock)
 {
-	bitmap_unmark(sfs->sfs_freemap, diskblock);
+	bitmap_unmark(SFS_MAPCHUNK(sfs, diskblock), SFS_MAPBIT(diskblock));
 	sfs->sfs_freemapdirty = true;
 }
 
@@ -128,7 +140,7 @@ sfs_bused(struct sfs_fs *sfs, uint32_t diskblock)
 		panic("sfs: sfs_bused called on out of range block %u\n", 
 		      diskblock);
 	}
-	return bitmap_isset(sfs->sfs_freemap, diskblock);
+	return bitmap_isset(SFS_MAPCHUNK(sfs, diskblock), SFS_MAPBIT(diskblock));
 }
 
 ////////////////////////////////////////////////////////////
@@ -153,7 +165,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 	 * you would get space from the disk buffer cache for this,
 	 * not use a static area.
 	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	static uint32_t idbuf[SFS_DBPERIDB(SFS_MAXBLOCKSIZE)];
 
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 	uint32_t block;
@@ -161,8 +173,6 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 	uint32_t idnum, idoff;
 	int result;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
-
 	/*
 	 * If the block we want is one of the direct blocks...
 	 */
@@ -206,8 +216,8 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 	fileblock -= SFS_NDIRECT;
 
 	/* Get the indirect block number and offset w/i that indirect block */
-	idnum = fileblock / SFS_DBPERIDB;
-	idoff = fileblock % SFS_DBPERIDB;
+	idnum = fileblock / SFS_FS_DBPERIDB(sfs);
+	idoff = fileblock % SFS_FS_DBPERIDB(sfs);
 
 	/*
 	 * We only have one indirect block. If the offset we were asked for
@@ -248,7 +258,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 		sv->sv_dirty = true;
 
 		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
+		bzero(idbuf, sfs->sfs_blocksize);
 	}
 	else {
 		/*
@@ -315,7 +325,7 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	 * you would get space from the disk buffer cache for this,
 	 * not use a static area.
 	 */
-	static char iobuf[SFS_BLOCKSIZE];
+	static char iobuf[SFS_MAXBLOCKSIZE];
 
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 	uint32_t diskblock;
@@ -325,10 +335,10 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	/* Allocate missing blocks if and only if we're writing */
 	int doalloc = (uio->uio_rw==UIO_WRITE);
 
-	KASSERT(skipstart + len <= SFS_BLOCKSIZE);
+	KASSERT(skipstart + len <= sfs->sfs_blocksize);
 
 	/* Compute the block offset of this block in the file */
-	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
+	fileblock = uio->uio_offset / sfs->sfs_blocksize;
 
 	/* Get the disk block number */
 	result = sfs_bmap(sv, fileblock, doalloc, &diskblock);
@@ -342,7 +352,7 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 		 * Zero the buffer.
 		 */
 		KASSERT(uio->uio_rw == UIO_READ);
-		bzero(iobuf, sizeof(iobuf));
+		bzero(iobuf, sfs->sfs_blocksize);
 	}
 	else {
 		/*
@@ -393,7 +403,7 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	off_t diskres;
 
 	/* Get the block number within the file */
-	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
+	fileblock = uio->uio_offset / sfs->sfs_blocksize;
 
 	/* Look up the disk block number */
 	result = sfs_bmap(sv, fileblock, doalloc, &diskblock);
@@ -409,7 +419,7 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 		 * allocated a block for us.
 		 */
 		KASSERT(uio->uio_rw == UIO_READ);
-		return uiomovezeros(SFS_BLOCKSIZE, uio);
+		return uiomovezeros(sfs->sfs_blocksize, uio);
 	}
 
 	/*
@@ -417,15 +427,15 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	 * and substitute one that makes sense to the device.
 	 */
 	saveoff = uio->uio_offset;
-	diskoff = diskblock * SFS_BLOCKSIZE;
+	diskoff = (off_t)diskblock * sfs->sfs_blocksize;
 	uio->uio_offset = diskoff;
 
 	/*
 	 * Temporarily set the residue to be one block size.
 	 */
-	KASSERT(uio->uio_resid >= SFS_BLOCKSIZE);
+	KASSERT(uio->uio_resid >= sfs->sfs_blocksize);
 	saveres = uio->uio_resid;
-	diskres = SFS_BLOCKSIZE;
+	diskres = sfs->sfs_blocksize;
 	uio->uio_resid = diskres;
 	
 	result = sfs_rwblock(sfs, uio);
@@ -447,6 +457,7 @@ static
 int
 sfs_io(struct sfs_vnode *sv, struct uio *uio)
 {
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 	uint32_t blkoff;
 	uint32_t nblocks, i;
 	int result = 0;
@@ -476,13 +487,13 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	/*
 	 * First, do any leading partial block.
 	 */
-	blkoff = uio->uio_offset % SFS_BLOCKSIZE;
+	blkoff = uio->uio_offset % sfs->sfs_blocksize;
 	if (blkoff != 0) {
 		/* Number of bytes at beginning of block to skip */
 		uint32_t skip = blkoff;
 
 		/* Number of bytes to read/write after that point */
-		uint32_t len = SFS_BLOCKSIZE - blkoff;
+		uint32_t len = sfs->sfs_blocksize - blkoff;
 
 		/* ...which might be less than the rest of the block */
 		if (len > uio->uio_resid) {
@@ -504,8 +515,8 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	/*
 	 * Now we should be block-aligned. Do the remaining whole blocks.
 	 */
-	KASSERT(uio->uio_offset % SFS_BLOCKSIZE == 0);
-	nblocks = uio->uio_resid / SFS_BLOCKSIZE;
+	KASSERT(uio->uio_offset % sfs->sfs_blocksize == 0);
+	nblocks = uio->uio_resid / sfs->sfs_blocksize;
 	for (i=0; i<nblocks; i++) {
 		result = sfs_blockio(sv, uio);
 		if (result) {
@@ -516,7 +527,7 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	/*
 	 * Now do any remaining partial block at the end.
 	 */
-	KASSERT(uio->uio_resid < SFS_BLOCKSIZE);
+	KASSERT(uio->uio_resid < sfs->sfs_blocksize);
 
 	if (uio->uio_resid > 0) {
 		result = sfs_partialio(sv, uio, 0, uio->uio_resid);
@@ -890,7 +901,6 @@ sfs_reclaim(struct vnode *v)
 {
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_fs *sfs = v->vn_fs->fs_data;
-	unsigned ix, i, num;
 	int result;
 
 	vfs_biglock_acquire();
@@ -932,21 +942,11 @@ sfs_reclaim(struct vnode *v)
 	}
 
 	/* Remove the vnode structure from the table in the struct sfs_fs. */
-	num = vnodearray_num(sfs->sfs_vnodes);
-	ix = num;
-	for (i=0; i<num; i++) {
-		struct vnode *v2 = vnodearray_get(sfs->sfs_vnodes, i);
-		struct sfs_vnode *sv2 = v2->vn_data;
-		if (sv2 == sv) {
-			ix = i;
-			break;
-		}
-	}
-	if (ix == num) {
+	if (sfs_vnodetable_lookup(&sfs->sfs_vnodes, sv->sv_ino) != sv) {
 		panic("sfs: reclaim vnode %u not in vnode pool\n",
 		      sv->sv_ino);
 	}
-	vnodearray_remove(sfs->sfs_vnodes, ix);
+	sfs_vnodetable_remove(&sfs->sfs_vnodes, sv);
 
 	VOP_CLEANUP(&sv->sv_v);
 
@@ -1034,6 +1034,7 @@ sfs_stat(struct vnode *v, struct stat *statbuf)
 	}
 
 	statbuf->st_size = sv->sv_i.sfi_size;
+	statbuf->st_ino = sv->sv_ino;
 
 	/* We don't support these yet; you get to implement them */
 	statbuf->st_nlink = 0;
@@ -1134,21 +1135,19 @@ sfs_truncate(struct vnode *v, off_t len)
 	 * you would get space from the disk buffer cache for this,
 	 * not use a static area.
 	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	static uint32_t idbuf[SFS_DBPERIDB(SFS_MAXBLOCKSIZE)];
 
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 
 	/* Length in blocks (divide rounding up) */
-	uint32_t blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
+	uint32_t blocklen = DIVROUNDUP(len, sfs->sfs_blocksize);
 
 	uint32_t i, j, block;
 	uint32_t idblock, baseblock, highblock;
 	int result;
 	int hasnonzero, iddirty;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
-
 	vfs_biglock_acquire();
 
 	/*
@@ -1171,7 +1170,7 @@ sfs_truncate(struct vnode *v, off_t len)
 	baseblock = SFS_NDIRECT;
 
 	/* The highest block in the indirect block */
-	highblock = baseblock + SFS_DBPERIDB - 1;
+	highblock = baseblock + SFS_FS_DBPERIDB(sfs) - 1;
 
 	if (blocklen < highblock && idblock != 0) {
 		/* We're past the proposed EOF; may need to free stuff */
@@ -1185,7 +1184,7 @@ sfs_truncate(struct vnode *v, off_t len)
 		
 		hasnonzero = 0;
 		iddirty = 0;
-		for (j=0; j<SFS_DBPERIDB; j++) {
+		for (j=0; j<SFS_FS_DBPERIDB(sfs); j++) {
 			/* Discard any blocks that are past the new EOF */
 			if (blocklen < baseblock+j && idbuf[j] != 0) {
 				sfs_bfree(sfs, idbuf[j]);
@@ -1651,36 +1650,25 @@ int
 sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		 struct sfs_vnode **ret)
 {
-	struct vnode *v;
 	struct sfs_vnode *sv;
 	const struct vnode_ops *ops = NULL;
-	unsigned i, num;
 	int result;
 
 	/* Look in the vnodes table */
-	num = vnodearray_num(sfs->sfs_vnodes);
-
-	/* Linear search. Is this too slow? You decide. */
-	for (i=0; i<num; i++) {
-		v = vnodearray_get(sfs->sfs_vnodes, i);
-		sv = v->vn_data;
-
+	sv = sfs_vnodetable_lookup(&sfs->sfs_vnodes, ino);
+	if (sv != NULL) {
 		/* Every inode in memory must be in an allocated block */
 		if (!sfs_bused(sfs, sv->sv_ino)) {
 			panic("sfs: Found inode %u in unallocated block\n",
 			      sv->sv_ino);
 		}
 
-		if (sv->sv_ino==ino) {
-			/* Found */
-
-			/* May only be set when creating new objects */
-			KASSERT(forcetype==SFS_TYPE_INVAL);
+		/* May only be set when creating new objects */
+		KASSERT(forcetype==SFS_TYPE_INVAL);
 
-			VOP_INCREF(&sv->sv_v);
-			*ret = sv;
-			return 0;
-		}
+		VOP_INCREF(&sv->sv_v);
+		*ret = sv;
+		return 0;
 	}
 
 	/* Didn't have it loaded; load it */
@@ -1696,8 +1684,8 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		      ino);
 	}
 
-	/* Read the block the inode is in */
-	result = sfs_rblock(sfs, &sv->sv_i, ino);
+	/* Read the inode from the head of its block */
+	result = sfs_rhead(sfs, &sv->sv_i, ino);
 	if (result) {
 		kfree(sv);
 		return result;
@@ -1744,12 +1732,7 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	sv->sv_ino = ino;
 
 	/* Add it to our table */
-	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_v, NULL);
-	if (result) {
-		VOP_CLEANUP(&sv->sv_v);
-		kfree(sv);
-		return result;
-	}
+	sfs_vnodetable_insert(&sfs->sfs_vnodes, sv);
 
 	/* Hand it back */
 	*ret = sv;
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * tmpfs filesystem
+ *
+ * Filesystem-level interface routines.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <vfs.h>
+#include <tmpfs.h>
+
+/*
+ * Sync routine. There's no backing store, so there's nothing to do.
+ */
+static
+int
+tmpfs_sync(struct fs *fs)
+{
+	(void)fs;
+	return 0;
+}
+
+/*
+ * Routine to retrieve the volume name.
+ */
+static
+const char *
+tmpfs_getvolname(struct fs *fs)
+{
+	struct tmpfs_fs *tf = fs->fs_data;
+	return tf->tf_name;
+}
+
+/*
+ * Get the root directory vnode.
+ */
+struct vnode *
+tmpfs_getroot(struct fs *fs)
+{
+	struct tmpfs_fs *tf = fs->fs_data;
+
+	VOP_INCREF(&tf->tf_root->tn_v);
+	return &tf->tf_root->tn_v;
+}
+
+/*
+ * Unmount code.
+ *
+ * A tmpfs is attached with vfs_addfs, which makes it permanent; it
+ * goes away when the system shuts down, along with its contents.
+ */
+static
+int
+tmpfs_unmount(struct fs *fs)
+{
+	(void)fs;
+	return EBUSY;
+}
+
+/*
+ * Create a tmpfs instance and attach it to the VFS.
+ */
+int
+tmpfs_create(const char *name, unsigned maxpages)
+{
+	struct tmpfs_fs *tf;
+	struct tmpfs_node *root;
+	int result;
+
+	if (maxpages == 0) {
+		return EINVAL;
+	}
+
+	tf = kmalloc(sizeof(struct tmpfs_fs));
+	if (tf == NULL) {
+		return ENOMEM;
+	}
+
+	tf->tf_absfs.fs_sync = tmpfs_sync;
+	tf->tf_absfs.fs_getvolname = tmpfs_getvolname;
+	tf->tf_absfs.fs_getroot = tmpfs_getroot;
+	tf->tf_absfs.fs_unmount = tmpfs_unmount;
+	tf->tf_absfs.fs_data = tf;
+
+	spinlock_init(&tf->tf_lock);
+	tf->tf_npages = 0;
+	tf->tf_maxpages = maxpages;
+	tf->tf_root = NULL;
+
+	tf->tf_name = kstrdup(name);
+	if (tf->tf_name == NULL) {
+		spinlock_cleanup(&tf->tf_lock);
+		kfree(tf);
+		return ENOMEM;
+	}
+
+	vfs_biglock_acquire();
+
+	result = tmpfs_makenode(tf, TMPFS_TYPE_DIR, &root);
+	if (result) {
+		vfs_biglock_release();
+		kfree(tf->tf_name);
+		spinlock_cleanup(&tf->tf_lock);
+		kfree(tf);
+		return result;
+	}
+
+	/*
+	 * The root has no name in any directory, but give it a link
+	 * count anyway so it never gets reclaimed. It is its own
+	 * parent.
+	 */
+	root->tn_linkcount = 1;
+	root->tn_parent = root;
+	tf->tf_root = root;
+
+	/* Drop the reference tmpfs_makenode gave us. */
+	VOP_DECREF(&root->tn_v);
+
+	vfs_biglock_release();
+
+	result = vfs_addfs(name, &tf->tf_absfs);
+	if (result) {
+		/* Unname the root and let reclaim throw it away. */
+		vfs_biglock_acquire();
+		root->tn_linkcount = 0;
+		VOP_INCREF(&root->tn_v);
+		VOP_DECREF(&root->tn_v);
+		vfs_biglock_release();
+
+		kfree(tf->tf_name);
+		spinlock_cleanup(&tf->tf_lock);
+		kfree(tf);
+		return result;
+	}
+
+	kprintf("tmpfs: %s: created, limit %u pages\n", name, maxpages);
+	return 0;
+}
@@ -0,0 +1,1543 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * tmpfs filesystem
+ *
+ * File-level (vnode) interface routines.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <limits.h>
+#include <stat.h>
+#include <lib.h>
+#include <array.h>
+#include <uio.h>
+#include <synch.h>
+#include <spinlock.h>
+#include <vm.h>
+#include <vfs.h>
+#include <tmpfs.h>
+
+/*
+ * Largest file we support: the page array is grown with kmalloc,
+ * which can't give us more than one page for it.
+ */
+#define TMPFS_MAXFILEPAGES  (PAGE_SIZE / sizeof(void *))
+
+static const struct vnode_ops tmpfs_fileops;
+static const struct vnode_ops tmpfs_dirops;
+static const struct vnode_ops tmpfs_linkops;
+
+////////////////////////////////////////////////////////////
+//
+// Page accounting and file data
+
+/*
+ * Charge one page against the filesystem's limit.
+ */
+static
+int
+tmpfs_chargepage(struct tmpfs_fs *tf)
+{
+	int result = 0;
+
+	spinlock_acquire(&tf->tf_lock);
+	if (tf->tf_npages >= tf->tf_maxpages) {
+		result = ENOSPC;
+	}
+	else {
+		tf->tf_npages++;
+	}
+	spinlock_release(&tf->tf_lock);
+	return result;
+}
+
+/*
+ * Give back a page charged with tmpfs_chargepage.
+ */
+static
+void
+tmpfs_unchargepage(struct tmpfs_fs *tf)
+{
+	spinlock_acquire(&tf->tf_lock);
+	KASSERT(tf->tf_npages > 0);
+	tf->tf_npages--;
+	spinlock_release(&tf->tf_lock);
+}
+
+/*
+ * Find the page holding byte PAGENO*PAGE_SIZE of the file, and hand
+ * back its kernel address. If there isn't one yet, allocate it if
+ * DOALLOC is set; otherwise hand back 0 (a hole, which reads as
+ * zeros).
+ *
+ * Must hold tn_lock.
+ */
+static
+int
+tmpfs_getpage(struct tmpfs_node *tn, unsigned pageno, bool doalloc,
+	      vaddr_t *ret)
+{
+	struct tmpfs_fs *tf = tn->tn_v.vn_fs->fs_data;
+	unsigned i, oldnum;
+	vaddr_t page;
+	int result;
+
+	KASSERT(lock_do_i_hold(tn->tn_lock));
+
+	oldnum = array_num(tn->tn_pages);
+	if (pageno < oldnum) {
+		page = (vaddr_t)array_get(tn->tn_pages, pageno);
+		if (page != 0 || !doalloc) {
+			*ret = page;
+			return 0;
+		}
+	}
+	else if (!doalloc) {
+		*ret = 0;
+		return 0;
+	}
+
+	if (pageno >= TMPFS_MAXFILEPAGES) {
+		return EFBIG;
+	}
+
+	result = tmpfs_chargepage(tf);
+	if (result) {
+		return result;
+	}
+	page = alloc_kpages(1);
+	if (page == 0) {
+		tmpfs_unchargepage(tf);
+		return ENOMEM;
+	}
+	bzero((void *)page, PAGE_SIZE);
+
+	if (pageno >= oldnum) {
+		result = array_setsize(tn->tn_pages, pageno+1);
+		if (result) {
+			free_kpages(page);
+			tmpfs_unchargepage(tf);
+			return result;
+		}
+		for (i=oldnum; i<pageno; i++) {
+			array_set(tn->tn_pages, i, NULL);
+		}
+	}
+	array_set(tn->tn_pages, pageno, (void *)page);
+	tn->tn_npages++;
+
+	*ret = page;
+	return 0;
+}
+
+/*
+ * Throw away every page of the file from page number FIRST on.
+ *
+ * Must hold tn_lock.
+ */
+static
+void
+tmpfs_freepages(struct tmpfs_node *tn, unsigned first)
+{
+	struct tmpfs_fs *tf = tn->tn_v.vn_fs->fs_data;
+	unsigned i, num;
+	vaddr_t page;
+	int result;
+
+	num = array_num(tn->tn_pages);
+	for (i=first; i<num; i++) {
+		page = (vaddr_t)array_get(tn->tn_pages, i);
+		if (page != 0) {
+			free_kpages(page);
+			tmpfs_unchargepage(tf);
+			KASSERT(tn->tn_npages > 0);
+			tn->tn_npages--;
+		}
+	}
+	if (first < num) {
+		/* shrinking never allocates, so can't fail */
+		result = array_setsize(tn->tn_pages, first);
+		KASSERT(result == 0);
+	}
+}
+
+/*
+ * Do I/O (either read or write) on a file.
+ */
+static
+int
+tmpfs_io(struct tmpfs_node *tn, struct uio *uio)
+{
+	size_t extraresid = 0;
+	size_t len;
+	off_t pgoff;
+	vaddr_t page;
+	int result = 0;
+
+	lock_acquire(tn->tn_lock);
+
+	/*
+	 * If reading, check for EOF. If we can read a partial area,
+	 * remember how much extra there was in EXTRARESID so we can
+	 * add it back to uio_resid at the end.
+	 */
+	if (uio->uio_rw == UIO_READ) {
+		off_t size = tn->tn_size;
+		off_t endpos = uio->uio_offset + uio->uio_resid;
+
+		if (uio->uio_offset >= size) {
+			/* At or past EOF - just return */
+			lock_release(tn->tn_lock);
+			return 0;
+		}
+
+		if (endpos > size) {
+			extraresid = endpos - size;
+			KASSERT(uio->uio_resid > extraresid);
+			uio->uio_resid -= extraresid;
+		}
+	}
+
+	while (uio->uio_resid > 0) {
+		/* don't let the page number wrap */
+		if (uio->uio_offset >= (off_t)TMPFS_MAXFILEPAGES * PAGE_SIZE) {
+			KASSERT(uio->uio_rw == UIO_WRITE);
+			result = EFBIG;
+			break;
+		}
+		pgoff = uio->uio_offset % PAGE_SIZE;
+		len = PAGE_SIZE - pgoff;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+
+		result = tmpfs_getpage(tn, uio->uio_offset / PAGE_SIZE,
+				       uio->uio_rw == UIO_WRITE, &page);
+		if (result) {
+			break;
+		}
+
+		if (page == 0) {
+			/* hole */
+			KASSERT(uio->uio_rw == UIO_READ);
+			result = uiomovezeros(len, uio);
+		}
+		else {
+			result = uiomove((char *)page + pgoff, len, uio);
+		}
+		if (result) {
+			break;
+		}
+	}
+
+	/* If writing, adjust file length */
+	if (uio->uio_rw == UIO_WRITE && uio->uio_offset > tn->tn_size) {
+		tn->tn_size = uio->uio_offset;
+	}
+
+	lock_release(tn->tn_lock);
+
+	/* Fix uio_resid to account for any extra we trimmed off */
+	uio->uio_resid += extraresid;
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Directories
+//
+// All of these must be called with the vfs biglock held.
+
+/*
+ * Hash function for names.
+ */
+static
+unsigned
+tmpfs_hashname(const char *name)
+{
+	unsigned h = 0;
+
+	while (*name) {
+		h = h*33 + (unsigned char)*name++;
+	}
+	return h % TMPFS_NHASH;
+}
+
+/*
+ * Find NAME in directory DIR. Returns NULL if it isn't there.
+ */
+static
+struct tmpfs_dirent *
+tmpfs_dir_find(struct tmpfs_node *dir, const char *name)
+{
+	struct tmpfs_dirent *td;
+
+	KASSERT(dir->tn_type == TMPFS_TYPE_DIR);
+
+	for (td = dir->tn_hash[tmpfs_hashname(name)]; td; td = td->td_next) {
+		if (!strcmp(td->td_name, name)) {
+			return td;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Check that NAME is something we're willing to enter in a
+ * directory.
+ */
+static
+int
+tmpfs_checkname(const char *name)
+{
+	if (name[0] == 0 || !strcmp(name, ".") || !strcmp(name, "..")) {
+		return EINVAL;
+	}
+	if (strchr(name, '/') != NULL) {
+		return EINVAL;
+	}
+	if (strlen(name) > NAME_MAX) {
+		return ENAMETOOLONG;
+	}
+	return 0;
+}
+
+/*
+ * Allocate a directory entry for NAME. This is split from
+ * tmpfs_dir_insert so that rename can do everything that might fail
+ * before changing anything.
+ */
+static
+int
+tmpfs_dirent_create(const char *name, struct tmpfs_dirent **ret)
+{
+	struct tmpfs_dirent *td;
+	int result;
+
+	result = tmpfs_checkname(name);
+	if (result) {
+		return result;
+	}
+
+	td = kmalloc(sizeof(struct tmpfs_dirent));
+	if (td == NULL) {
+		return ENOMEM;
+	}
+	td->td_name = kstrdup(name);
+	if (td->td_name == NULL) {
+		kfree(td);
+		return ENOMEM;
+	}
+	td->td_node = NULL;
+	td->td_next = NULL;
+
+	*ret = td;
+	return 0;
+}
+
+static
+void
+tmpfs_dirent_destroy(struct tmpfs_dirent *td)
+{
+	kfree(td->td_name);
+	kfree(td);
+}
+
+/*
+ * Enter TD, referring to TN, into directory DIR. The name must not
+ * already be present.
+ */
+static
+void
+tmpfs_dir_insert(struct tmpfs_node *dir, struct tmpfs_dirent *td,
+		 struct tmpfs_node *tn)
+{
+	unsigned h;
+
+	KASSERT(tmpfs_dir_find(dir, td->td_name) == NULL);
+
+	h = tmpfs_hashname(td->td_name);
+	td->td_node = tn;
+	td->td_next = dir->tn_hash[h];
+	dir->tn_hash[h] = td;
+	dir->tn_nentries++;
+
+	tn->tn_linkcount++;
+	if (tn->tn_type == TMPFS_TYPE_DIR) {
+		tn->tn_parent = dir;
+	}
+}
+
+/*
+ * Create a link named NAME to TN in directory DIR.
+ */
+static
+int
+tmpfs_dir_link(struct tmpfs_node *dir, const char *name,
+	       struct tmpfs_node *tn)
+{
+	struct tmpfs_dirent *td;
+	int result;
+
+	if (dir->tn_linkcount == 0) {
+		/* directory has been removed */
+		return ENOENT;
+	}
+	if (tmpfs_dir_find(dir, name) != NULL) {
+		return EEXIST;
+	}
+
+	result = tmpfs_dirent_create(name, &td);
+	if (result) {
+		return result;
+	}
+	tmpfs_dir_insert(dir, td, tn);
+	return 0;
+}
+
+/*
+ * Remove NAME from directory DIR and drop the link count of the
+ * object it referred to. The caller should hold a vnode reference to
+ * the object, so that dropping it afterwards cleans up if this was
+ * the last name.
+ */
+static
+void
+tmpfs_dir_unlink(struct tmpfs_node *dir, const char *name)
+{
+	struct tmpfs_dirent **tdp, *td;
+
+	tdp = &dir->tn_hash[tmpfs_hashname(name)];
+	while (*tdp != NULL && strcmp((*tdp)->td_name, name)) {
+		tdp = &(*tdp)->td_next;
+	}
+	td = *tdp;
+	KASSERT(td != NULL);
+
+	*tdp = td->td_next;
+	KASSERT(dir->tn_nentries > 0);
+	dir->tn_nentries--;
+
+	KASSERT(td->td_node->tn_linkcount > 0);
+	td->td_node->tn_linkcount--;
+
+	tmpfs_dirent_destroy(td);
+}
+
+/*
+ * Look up one name in DIR, handling "." and "..". Does not take a
+ * reference.
+ */
+static
+int
+tmpfs_lookonce(struct tmpfs_node *dir, const char *name,
+	       struct tmpfs_node **ret)
+{
+	struct tmpfs_dirent *td;
+
+	if (dir->tn_type != TMPFS_TYPE_DIR) {
+		return ENOTDIR;
+	}
+	if (!strcmp(name, ".")) {
+		*ret = dir;
+		return 0;
+	}
+	if (!strcmp(name, "..")) {
+		if (dir->tn_linkcount == 0) {
+			/* removed; tn_parent may be stale */
+			return ENOENT;
+		}
+		*ret = dir->tn_parent;
+		return 0;
+	}
+
+	td = tmpfs_dir_find(dir, name);
+	if (td == NULL) {
+		return ENOENT;
+	}
+	*ret = td->td_node;
+	return 0;
+}
+
+/*
+ * Look up a whole (relative) path starting at DIR. Empty components
+ * are skipped, so "" names DIR itself. Does not take a reference.
+ */
+static
+int
+tmpfs_walk(struct tmpfs_node *dir, char *path, struct tmpfs_node **ret)
+{
+	struct tmpfs_node *cur = dir;
+	char *name, *context;
+	int result;
+
+	for (name = strtok_r(path, "/", &context);
+	     name != NULL;
+	     name = strtok_r(NULL, "/", &context)) {
+		result = tmpfs_lookonce(cur, name, &cur);
+		if (result) {
+			return result;
+		}
+	}
+
+	*ret = cur;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Node lifecycle
+
+/*
+ * Create a new object. It has no names and one vnode reference.
+ */
+int
+tmpfs_makenode(struct tmpfs_fs *tf, int type, struct tmpfs_node **ret)
+{
+	const struct vnode_ops *ops;
+	struct tmpfs_node *tn;
+	int result;
+
+	switch (type) {
+	    case TMPFS_TYPE_FILE: ops = &tmpfs_fileops; break;
+	    case TMPFS_TYPE_DIR: ops = &tmpfs_dirops; break;
+	    case TMPFS_TYPE_SYMLINK: ops = &tmpfs_linkops; break;
+	    default:
+		panic("tmpfs: makenode: invalid type %d\n", type);
+	}
+
+	tn = kmalloc(sizeof(struct tmpfs_node));
+	if (tn == NULL) {
+		return ENOMEM;
+	}
+	bzero(tn, sizeof(struct tmpfs_node));
+	tn->tn_type = type;
+
+	if (type == TMPFS_TYPE_FILE) {
+		tn->tn_lock = lock_create("tmpfs");
+		if (tn->tn_lock == NULL) {
+			kfree(tn);
+			return ENOMEM;
+		}
+		tn->tn_pages = array_create();
+		if (tn->tn_pages == NULL) {
+			lock_destroy(tn->tn_lock);
+			kfree(tn);
+			return ENOMEM;
+		}
+	}
+
+	result = VOP_INIT(&tn->tn_v, ops, &tf->tf_absfs, tn);
+	if (result) {
+		if (tn->tn_pages != NULL) {
+			array_destroy(tn->tn_pages);
+			lock_destroy(tn->tn_lock);
+		}
+		kfree(tn);
+		return result;
+	}
+
+	*ret = tn;
+	return 0;
+}
+
+/*
+ * Free an object that has neither names nor references.
+ */
+static
+void
+tmpfs_destroynode(struct tmpfs_node *tn)
+{
+	KASSERT(tn->tn_linkcount == 0);
+
+	switch (tn->tn_type) {
+	    case TMPFS_TYPE_FILE:
+		lock_acquire(tn->tn_lock);
+		tmpfs_freepages(tn, 0);
+		lock_release(tn->tn_lock);
+		KASSERT(tn->tn_npages == 0);
+		array_destroy(tn->tn_pages);
+		lock_destroy(tn->tn_lock);
+		break;
+	    case TMPFS_TYPE_DIR:
+		KASSERT(tn->tn_nentries == 0);
+		break;
+	    case TMPFS_TYPE_SYMLINK:
+		kfree(tn->tn_target);
+		break;
+	}
+
+	VOP_CLEANUP(&tn->tn_v);
+	kfree(tn);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Vnode operations.
+
+/*
+ * This is called on *each* open().
+ */
+static
+int
+tmpfs_open(struct vnode *v, int openflags)
+{
+	/*
+	 * At this level we do not need to handle O_CREAT, O_EXCL, or
+	 * O_TRUNC. As in sfs, O_APPEND isn't supported.
+	 */
+	if (openflags & O_APPEND) {
+		return EUNIMP;
+	}
+
+	(void)v;
+	return 0;
+}
+
+/*
+ * This is called on *each* open() of a directory.
+ * Directories may only be open for read.
+ */
+static
+int
+tmpfs_opendir(struct vnode *v, int openflags)
+{
+	switch (openflags & O_ACCMODE) {
+	    case O_RDONLY:
+		break;
+	    case O_WRONLY:
+	    case O_RDWR:
+	    default:
+		return EISDIR;
+	}
+	if (openflags & O_APPEND) {
+		return EISDIR;
+	}
+
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called on the *last* close(). Nothing to flush.
+ */
+static
+int
+tmpfs_close(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called when the vnode refcount (in-memory usage count) hits zero.
+ *
+ * If the object still has names, it has to stay; leave it with a
+ * zero refcount for the next lookup to pick up. Otherwise it's gone
+ * for good.
+ */
+static
+int
+tmpfs_reclaim(struct vnode *v)
+{
+	struct tmpfs_node *tn = v->vn_data;
+
+	vfs_biglock_acquire();
+
+	/*
+	 * Make sure someone else hasn't picked up the vnode since the
+	 * decision was made to reclaim it.
+	 */
+	if (v->vn_refcount != 1) {
+
+		/* consume the reference VOP_DECREF gave us */
+		KASSERT(v->vn_refcount>1);
+		v->vn_refcount--;
+
+		vfs_biglock_release();
+		return EBUSY;
+	}
+
+	if (tn->tn_linkcount > 0) {
+		v->vn_refcount = 0;
+	}
+	else {
+		tmpfs_destroynode(tn);
+	}
+
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * Called for read(). tmpfs_io() does the work.
+ */
+static
+int
+tmpfs_read(struct vnode *v, struct uio *uio)
+{
+	struct tmpfs_node *tn = v->vn_data;
+
+	KASSERT(uio->uio_rw==UIO_READ);
+	return tmpfs_io(tn, uio);
+}
+
+/*
+ * Called for write(). tmpfs_io() does the work.
+ */
+static
+int
+tmpfs_write(struct vnode *v, struct uio *uio)
+{
+	struct tmpfs_node *tn = v->vn_data;
+
+	KASSERT(uio->uio_rw==UIO_WRITE);
+	return tmpfs_io(tn, uio);
+}
+
+/*
+ * Called for readlink().
+ */
+static
+int
+tmpfs_readlink(struct vnode *v, struct uio *uio)
+{
+	struct tmpfs_node *tn = v->vn_data;
+
+	KASSERT(uio->uio_rw==UIO_READ);
+	return uiomove(tn->tn_target, strlen(tn->tn_target), uio);
+}
+
+/*
+ * Called for getdirentry(). The offset is the index of the entry,
+ * counting along the hash chains; it is only stable as long as the
+ * directory isn't modified, which is the usual deal.
+ */
+static
+int
+tmpfs_getdirentry(struct vnode *v, struct uio *uio)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_dirent *td = NULL;
+	off_t index, pos;
+	unsigned h;
+	int result;
+
+	KASSERT(uio->uio_rw==UIO_READ);
+
+	vfs_biglock_acquire();
+
+	index = uio->uio_offset;
+	pos = 0;
+	for (h=0; h<TMPFS_NHASH; h++) {
+		for (td = dir->tn_hash[h]; td; td = td->td_next) {
+			if (pos == index) {
+				goto found;
+			}
+			pos++;
+		}
+	}
+
+	/* EOF */
+	vfs_biglock_release();
+	return 0;
+
+ found:
+	result = uiomove(td->td_name, strlen(td->td_name), uio);
+	if (result == 0) {
+		uio->uio_offset = index + 1;
+	}
+	vfs_biglock_release();
+	return result;
+}
+
+/*
+ * Called for ioctl()
+ */
+static
+int
+tmpfs_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	/*
+	 * No ioctls.
+	 */
+
+	(void)v;
+	(void)op;
+	(void)data;
+
+	return EINVAL;
+}
+
+/*
+ * Called for stat/fstat/lstat.
+ */
+static
+int
+tmpfs_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct tmpfs_node *tn = v->vn_data;
+	int result;
+
+	/* Fill in the stat structure */
+	bzero(statbuf, sizeof(struct stat));
+
+	result = VOP_GETTYPE(v, &statbuf->st_mode);
+	if (result) {
+		return result;
+	}
+
+	switch (tn->tn_type) {
+	    case TMPFS_TYPE_FILE:
+		statbuf->st_size = tn->tn_size;
+		break;
+	    case TMPFS_TYPE_DIR:
+		statbuf->st_size = tn->tn_nentries;
+		break;
+	    case TMPFS_TYPE_SYMLINK:
+		statbuf->st_size = strlen(tn->tn_target);
+		break;
+	}
+	statbuf->st_nlink = tn->tn_linkcount;
+	statbuf->st_blocks = tn->tn_npages;
+	statbuf->st_blksize = PAGE_SIZE;
+
+	return 0;
+}
+
+/*
+ * Return the type of the file (types as per kern/stat.h)
+ */
+static
+int
+tmpfs_gettype(struct vnode *v, uint32_t *ret)
+{
+	struct tmpfs_node *tn = v->vn_data;
+
+	switch (tn->tn_type) {
+	    case TMPFS_TYPE_FILE:
+		*ret = S_IFREG;
+		return 0;
+	    case TMPFS_TYPE_DIR:
+		*ret = S_IFDIR;
+		return 0;
+	    case TMPFS_TYPE_SYMLINK:
+		*ret = S_IFLNK;
+		return 0;
+	}
+	panic("tmpfs: gettype: Invalid node type %d\n", tn->tn_type);
+	return EINVAL;
+}
+
+/*
+ * Check for legal seeks. Allow anything non-negative; files may
+ * have holes.
+ */
+static
+int
+tmpfs_tryseek(struct vnode *v, off_t pos)
+{
+	if (pos<0) {
+		return EINVAL;
+	}
+
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called for fsync(). Nothing to do.
+ */
+static
+int
+tmpfs_fsync(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called for mmap().
+ */
+static
+int
+tmpfs_mmap(struct vnode *v   /* add stuff as needed */)
+{
+	(void)v;
+	return EUNIMP;
+}
+
+/*
+ * Called for ftruncate(). Growing just moves the size, leaving a
+ * hole; shrinking frees whole pages past the end and zeroes the tail
+ * of the last one, so growing again later reads zeros.
+ */
+static
+int
+tmpfs_truncate(struct vnode *v, off_t len)
+{
+	struct tmpfs_node *tn = v->vn_data;
+	vaddr_t page;
+	off_t pgoff;
+	int result;
+
+	if (len < 0) {
+		return EINVAL;
+	}
+	if (len > (off_t)TMPFS_MAXFILEPAGES * PAGE_SIZE) {
+		return EFBIG;
+	}
+
+	lock_acquire(tn->tn_lock);
+
+	if (len < tn->tn_size) {
+		tmpfs_freepages(tn, DIVROUNDUP(len, PAGE_SIZE));
+
+		pgoff = len % PAGE_SIZE;
+		if (pgoff != 0) {
+			result = tmpfs_getpage(tn, len / PAGE_SIZE, false,
+					       &page);
+			KASSERT(result == 0);
+			if (page != 0) {
+				bzero((char *)page + pgoff,
+				      PAGE_SIZE - pgoff);
+			}
+		}
+	}
+	tn->tn_size = len;
+
+	lock_release(tn->tn_lock);
+	return 0;
+}
+
+/*
+ * Get the pathname of a directory relative to the filesystem root,
+ * by walking up the parent pointers and finding each directory's
+ * name in its parent.
+ */
+static
+int
+tmpfs_namefile(struct vnode *v, struct uio *uio)
+{
+	struct tmpfs_node *tn = v->vn_data;
+	struct tmpfs_fs *tf = v->vn_fs->fs_data;
+	struct tmpfs_node *parent;
+	struct tmpfs_dirent *td;
+	char *buf;
+	size_t pos, len;
+	unsigned h;
+	int result;
+
+	if (tn == tf->tf_root) {
+		/* send back the empty string - just return */
+		return 0;
+	}
+
+	buf = kmalloc(PATH_MAX);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+
+	vfs_biglock_acquire();
+
+	/* Build the name backwards from the end of BUF. */
+	pos = PATH_MAX;
+	while (tn != tf->tf_root) {
+		if (tn->tn_linkcount == 0) {
+			result = ENOENT;
+			goto out;
+		}
+		parent = tn->tn_parent;
+
+		td = NULL;
+		for (h=0; h<TMPFS_NHASH && td == NULL; h++) {
+			for (td = parent->tn_hash[h]; td; td = td->td_next) {
+				if (td->td_node == tn) {
+					break;
+				}
+			}
+		}
+		KASSERT(td != NULL);
+
+		len = strlen(td->td_name);
+		if (len + 1 > pos) {
+			result = ENAMETOOLONG;
+			goto out;
+		}
+		if (pos < PATH_MAX) {
+			buf[--pos] = '/';
+		}
+		pos -= len;
+		memcpy(buf + pos, td->td_name, len);
+
+		tn = parent;
+	}
+
+	result = uiomove(buf + pos, PATH_MAX - pos, uio);
+
+ out:
+	vfs_biglock_release();
+	kfree(buf);
+	return result;
+}
+
+/*
+ * Create a file. If EXCL is set, insist that the filename not already
+ * exist; otherwise, if it already exists, just open it.
+ */
+static
+int
+tmpfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
+	    struct vnode **ret)
+{
+	struct tmpfs_fs *tf = v->vn_fs->fs_data;
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_dirent *td;
+	struct tmpfs_node *newguy;
+	int result;
+
+	/* We don't support file permissions; ignore MODE */
+	(void)mode;
+
+	vfs_biglock_acquire();
+
+	td = tmpfs_dir_find(dir, name);
+	if (td != NULL) {
+		if (excl) {
+			vfs_biglock_release();
+			return EEXIST;
+		}
+		VOP_INCREF(&td->td_node->tn_v);
+		*ret = &td->td_node->tn_v;
+		vfs_biglock_release();
+		return 0;
+	}
+
+	result = tmpfs_makenode(tf, TMPFS_TYPE_FILE, &newguy);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
+	result = tmpfs_dir_link(dir, name, newguy);
+	if (result) {
+		VOP_DECREF(&newguy->tn_v);
+		vfs_biglock_release();
+		return result;
+	}
+
+	*ret = &newguy->tn_v;
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * Create a symlink.
+ */
+static
+int
+tmpfs_symlink(struct vnode *v, const char *contents, const char *name)
+{
+	struct tmpfs_fs *tf = v->vn_fs->fs_data;
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_node *newguy;
+	int result;
+
+	vfs_biglock_acquire();
+
+	result = tmpfs_makenode(tf, TMPFS_TYPE_SYMLINK, &newguy);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
+	newguy->tn_target = kstrdup(contents);
+	if (newguy->tn_target == NULL) {
+		VOP_DECREF(&newguy->tn_v);
+		vfs_biglock_release();
+		return ENOMEM;
+	}
+
+	result = tmpfs_dir_link(dir, name, newguy);
+
+	/* The name (if any) keeps it alive now. */
+	VOP_DECREF(&newguy->tn_v);
+
+	vfs_biglock_release();
+	return result;
+}
+
+/*
+ * Create a directory.
+ */
+static
+int
+tmpfs_mkdir(struct vnode *v, const char *name, mode_t mode)
+{
+	struct tmpfs_fs *tf = v->vn_fs->fs_data;
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_node *newguy;
+	int result;
+
+	(void)mode;
+
+	vfs_biglock_acquire();
+
+	result = tmpfs_makenode(tf, TMPFS_TYPE_DIR, &newguy);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
+	result = tmpfs_dir_link(dir, name, newguy);
+
+	/* The name (if any) keeps it alive now. */
+	VOP_DECREF(&newguy->tn_v);
+
+	vfs_biglock_release();
+	return result;
+}
+
+/*
+ * Make a hard link to a file.
+ * The VFS layer should prevent this being called unless both
+ * vnodes are ours.
+ */
+static
+int
+tmpfs_link(struct vnode *v, const char *name, struct vnode *file)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_node *tn = file->vn_data;
+	int result;
+
+	KASSERT(file->vn_fs == v->vn_fs);
+
+	/* No hard links to directories. */
+	if (tn->tn_type == TMPFS_TYPE_DIR) {
+		return EPERM;
+	}
+
+	vfs_biglock_acquire();
+	result = tmpfs_dir_link(dir, name, tn);
+	vfs_biglock_release();
+
+	return result;
+}
+
+/*
+ * Delete a non-directory.
+ */
+static
+int
+tmpfs_remove(struct vnode *v, const char *name)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_dirent *td;
+	struct tmpfs_node *victim;
+
+	vfs_biglock_acquire();
+
+	td = tmpfs_dir_find(dir, name);
+	if (td == NULL) {
+		vfs_biglock_release();
+		return ENOENT;
+	}
+	victim = td->td_node;
+	if (victim->tn_type == TMPFS_TYPE_DIR) {
+		vfs_biglock_release();
+		return EISDIR;
+	}
+
+	/* Hold a reference so dropping it frees the file if need be. */
+	VOP_INCREF(&victim->tn_v);
+	tmpfs_dir_unlink(dir, name);
+	VOP_DECREF(&victim->tn_v);
+
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * Delete an (empty) directory.
+ */
+static
+int
+tmpfs_rmdir(struct vnode *v, const char *name)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_dirent *td;
+	struct tmpfs_node *victim;
+
+	if (!strcmp(name, ".") || !strcmp(name, "..")) {
+		return EINVAL;
+	}
+
+	vfs_biglock_acquire();
+
+	td = tmpfs_dir_find(dir, name);
+	if (td == NULL) {
+		vfs_biglock_release();
+		return ENOENT;
+	}
+	victim = td->td_node;
+	if (victim->tn_type != TMPFS_TYPE_DIR) {
+		vfs_biglock_release();
+		return ENOTDIR;
+	}
+	if (victim->tn_nentries > 0) {
+		vfs_biglock_release();
+		return ENOTEMPTY;
+	}
+
+	VOP_INCREF(&victim->tn_v);
+	tmpfs_dir_unlink(dir, name);
+	VOP_DECREF(&victim->tn_v);
+
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * Rename a file or directory. If the target name exists it is
+ * replaced, subject to the usual rules: a directory can only replace
+ * an empty directory, and a non-directory only a non-directory.
+ */
+static
+int
+tmpfs_rename(struct vnode *v1, const char *n1,
+	     struct vnode *v2, const char *n2)
+{
+	struct tmpfs_fs *tf = v1->vn_fs->fs_data;
+	struct tmpfs_node *d1 = v1->vn_data;
+	struct tmpfs_node *d2 = v2->vn_data;
+	struct tmpfs_node *src, *dst, *p;
+	struct tmpfs_dirent *td, *newtd;
+	int result;
+
+	KASSERT(v1->vn_fs == v2->vn_fs);
+
+	if (!strcmp(n1, ".") || !strcmp(n1, "..")) {
+		return EINVAL;
+	}
+
+	vfs_biglock_acquire();
+
+	td = tmpfs_dir_find(d1, n1);
+	if (td == NULL) {
+		vfs_biglock_release();
+		return ENOENT;
+	}
+	src = td->td_node;
+
+	/*
+	 * A removed directory can't be renamed into; check this before
+	 * walking its parents, which may have been freed since.
+	 */
+	if (d2->tn_linkcount == 0) {
+		vfs_biglock_release();
+		return ENOENT;
+	}
+
+	/* Don't move a directory underneath itself. */
+	if (src->tn_type == TMPFS_TYPE_DIR) {
+		for (p = d2; p != tf->tf_root; p = p->tn_parent) {
+			if (p == src) {
+				vfs_biglock_release();
+				return EINVAL;
+			}
+		}
+	}
+
+	dst = NULL;
+	td = tmpfs_dir_find(d2, n2);
+	if (td != NULL) {
+		dst = td->td_node;
+		if (dst == src) {
+			/* Same object; nothing to do. */
+			vfs_biglock_release();
+			return 0;
+		}
+		if (src->tn_type == TMPFS_TYPE_DIR) {
+			if (dst->tn_type != TMPFS_TYPE_DIR) {
+				vfs_biglock_release();
+				return ENOTDIR;
+			}
+			if (dst->tn_nentries > 0) {
+				vfs_biglock_release();
+				return ENOTEMPTY;
+			}
+		}
+		else if (dst->tn_type == TMPFS_TYPE_DIR) {
+			vfs_biglock_release();
+			return EISDIR;
+		}
+	}
+
+	/* Get everything that can fail out of the way first. */
+	result = tmpfs_dirent_create(n2, &newtd);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
+	if (dst != NULL) {
+		VOP_INCREF(&dst->tn_v);
+		tmpfs_dir_unlink(d2, n2);
+	}
+
+	/* Link under the new name first, so SRC always has a name. */
+	tmpfs_dir_insert(d2, newtd, src);
+	tmpfs_dir_unlink(d1, n1);
+
+	if (dst != NULL) {
+		VOP_DECREF(&dst->tn_v);
+	}
+
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * lookparent returns the last path component as a string and the
+ * directory it's in as a vnode.
+ */
+static
+int
+tmpfs_lookparent(struct vnode *v, char *path, struct vnode **ret,
+		 char *buf, size_t buflen)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_node *parent;
+	char *s;
+	int result;
+
+	vfs_biglock_acquire();
+
+	s = strrchr(path, '/');
+	if (s == NULL) {
+		/* just a last component, no directory part */
+		s = path;
+		parent = dir;
+	}
+	else {
+		*s = 0;
+		s++;
+		result = tmpfs_walk(dir, path, &parent);
+		if (result) {
+			vfs_biglock_release();
+			return result;
+		}
+	}
+
+	if (parent->tn_type != TMPFS_TYPE_DIR) {
+		vfs_biglock_release();
+		return ENOTDIR;
+	}
+
+	if (strlen(s)+1 > buflen) {
+		vfs_biglock_release();
+		return ENAMETOOLONG;
+	}
+	strcpy(buf, s);
+
+	VOP_INCREF(&parent->tn_v);
+	*ret = &parent->tn_v;
+
+	vfs_biglock_release();
+	return 0;
+}
+
+/*
+ * Lookup gets a vnode for a pathname.
+ */
+static
+int
+tmpfs_lookup(struct vnode *v, char *path, struct vnode **ret)
+{
+	struct tmpfs_node *dir = v->vn_data;
+	struct tmpfs_node *final;
+	int result;
+
+	vfs_biglock_acquire();
+
+	result = tmpfs_walk(dir, path, &final);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
+	VOP_INCREF(&final->tn_v);
+	*ret = &final->tn_v;
+
+	vfs_biglock_release();
+	return 0;
+}
+
+//////////////////////////////////////////////////
+
+static
+int
+tmpfs_notdir(void)
+{
+	return ENOTDIR;
+}
+
+static
+int
+tmpfs_isdir(void)
+{
+	return EISDIR;
+}
+
+static
+int
+tmpfs_inval(void)
+{
+	return EINVAL;
+}
+
+/*
+ * Casting through void * prevents warnings.
+ * All of the vnode ops return int, and it's ok to cast functions that
+ * take args to functions that take no args.
+ */
+
+#define ISDIR ((void *)tmpfs_isdir)
+#define NOTDIR ((void *)tmpfs_notdir)
+#define INVAL ((void *)tmpfs_inval)
+
+/*
+ * Function table for tmpfs files.
+ */
+static const struct vnode_ops tmpfs_fileops = {
+	VOP_MAGIC,	/* mark this a valid vnode ops table */
+
+	tmpfs_open,
+	tmpfs_close,
+	tmpfs_reclaim,
+
+	tmpfs_read,
+	INVAL,   /* readlink */
+	NOTDIR,  /* getdirentry */
+	tmpfs_write,
+	tmpfs_ioctl,
+	tmpfs_stat,
+	tmpfs_gettype,
+	tmpfs_tryseek,
+	tmpfs_fsync,
+	tmpfs_mmap,
+	tmpfs_truncate,
+	NOTDIR,  /* namefile */
+
+	NOTDIR,  /* creat */
+	NOTDIR,  /* symlink */
+	NOTDIR,  /* mkdir */
+	NOTDIR,  /* link */
+	NOTDIR,  /* remove */
+	NOTDIR,  /* rmdir */
+	NOTDIR,  /* rename */
+
+	NOTDIR,  /* lookup */
+	NOTDIR,  /* lookparent */
+};
+
+/*
+ * Function table for tmpfs directories.
+ */
+static const struct vnode_ops tmpfs_dirops = {
+	VOP_MAGIC,	/* mark this a valid vnode ops table */
+
+	tmpfs_opendir,
+	tmpfs_close,
+	tmpfs_reclaim,
+
+	ISDIR,   /* read */
+	ISDIR,   /* readlink */
+	tmpfs_getdirentry,
+	ISDIR,   /* write */
+	tmpfs_ioctl,
+	tmpfs_stat,
+	tmpfs_gettype,
+	tmpfs_tryseek,
+	tmpfs_fsync,
+	ISDIR,   /* mmap */
+	ISDIR,   /* truncate */
+	tmpfs_namefile,
+
+	tmpfs_creat,
+	tmpfs_symlink,
+	tmpfs_mkdir,
+	tmpfs_link,
+	tmpfs_remove,
+	tmpfs_rmdir,
+	tmpfs_rename,
+
+	tmpfs_lookup,
+	tmpfs_lookparent,
+};
+
+/*
+ * Function table for tmpfs symlinks.
+ */
+static const struct vnode_ops tmpfs_linkops = {
+	VOP_MAGIC,	/* mark this a valid vnode ops table */
+
+	tmpfs_open,
+	tmpfs_close,
+	tmpfs_reclaim,
+
+	INVAL,   /* read */
+	tmpfs_readlink,
+	NOTDIR,  /* getdirentry */
+	INVAL,   /* write */
+	tmpfs_ioctl,
+	tmpfs_stat,
+	tmpfs_gettype,
+	INVAL,   /* tryseek */
+	tmpfs_fsync,
+	INVAL,   /* mmap */
+	INVAL,   /* truncate */
+	NOTDIR,  /* namefile */
+
+	NOTDIR,  /* creat */
+	NOTDIR,  /* symlink */
+	NOTDIR,  /* mkdir */
+	NOTDIR,  /* link */
+	NOTDIR,  /* remove */
+	NOTDIR,  /* rmdir */
+	NOTDIR,  /* rename */
+
+	NOTDIR,  /* lookup */
+	NOTDIR,  /* lookparent */
+};
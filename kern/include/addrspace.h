@@ -35,16 +35,26 @@
  */
 
 
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <vm.h>
 #include "opt-dumbvm.h"
 
+// The PTE bits are also used by the TLB refill code in exception-mips1.S
+#define PTE_WRITABLE	0x00000100	// page was last loaded into the TLB writable
 #define PTE_VALID	0x00000200	// used to indicate that this PTE records a physical frame
+#define PTE_REFERENCED	0x00000400	// page loaded into the TLB since the last working-set sample
 #define TOP_TEN		0xFFC00000	// used to get the index of the first_level page table
 #define MID_TEN		0x003FF000	// used to get the index of the second_level page table
+// user address mapped by slot j of the second-level table in slot i
+#define PT_VADDR(i, j)	(((vaddr_t)(i) << 22) | ((vaddr_t)(j) << 12))
 
 #define VM_STACKPAGES 16		// the maximum stack size for a process in terms of pages
+#define VM_FAULTAHEAD 4			// pages mapped ahead of a fault in MADV_SEQUENTIAL regions
 
 struct vnode;
+struct lock;
+struct execprof_trace;
 
 
 /* 
@@ -61,9 +71,21 @@ struct as_region {
 	vaddr_t as_vbase;	/* the started virtual address for one region */
 	size_t as_npages;	/* how many pages this region occupied from the vbase */
 	unsigned int as_permissions;	/* does this region readable? writable? executable? */
+	int as_advice;			/* MADV_NORMAL, MADV_SEQUENTIAL or MADV_RANDOM */
 	struct as_region *as_next_region;	/* address of the following region */
 };
 
+/*
+ * A range of user memory the kernel is using behind the process's
+ * back: a buffer with I/O in flight, or a ring mapped into the kernel
+ * (iowork.c, ioring.c). The caller provides the storage.
+ */
+struct as_pin {
+	vaddr_t ap_start;		/* first address */
+	vaddr_t ap_end;			/* one past the last address */
+	struct as_pin *ap_next;		/* list link */
+};
+
 struct addrspace {
 #if OPT_DUMBVM
         vaddr_t as_vbase1;
@@ -77,9 +99,30 @@ struct addrspace {
         /* Put stuff here for your VM system */
 	struct as_region *as_regions_start;	/* header of the regions linked list */
 	vaddr_t as_pagetable;		   	/* address of the first-level page table */
+	struct lock *as_lock;			/* serializes page table changes */
+	struct as_pin *as_pins;			/* pinned ranges (as_lock) */
+	unsigned as_rss;			/* user frames resident (frametable_lock) */
+	/* working-set estimate; see workingset.c */
+	unsigned as_wsepoch;			/* window of the last sample */
+	unsigned as_faults;			/* faults since the last sample */
+	unsigned as_pff;			/* faults per window */
+	unsigned as_ws;				/* pages referenced per window */
+	bool as_suspended;			/* waiting for memory */
+	unsigned as_nsuspend;			/* times suspended */
+	struct execprof_trace *as_exectrace;	/* startup pages, if recording */
 #endif
+	struct rlimit as_rsslimit;		/* RLIMIT_RSS, in bytes */
 };
 
+/*
+ * The page table can be changed by the owning process and, at the
+ * same time, by I/O worker threads that have borrowed the address
+ * space (see iowork.c). Anything that creates, drops or changes a PTE
+ * or a second-level table must hold as_lock. The TLB refill code in
+ * exception-mips1.S reads the table without it, so a new second-level
+ * table is zeroed before it is linked in.
+ */
+
 /*
  * The structure of PTE in page table:
  * |		address	         |  PTE_VALID      |	PE_W        |	PF_R        |	PF_X
@@ -124,6 +167,16 @@ struct addrspace {
  *    as_zero_region - zero out a new allocated page.
  *
  *    as_destroy_regions - free all the space allocated for regions storeage.
+ *
+ *    as_advise - apply madvise() ADVICE to the pages from VADDR to
+ *                VADDR+LEN, which must all be in defined regions.
+ *
+ *    as_translate - find the kernel (KSEG0) address of the memory behind
+ *                user address VADDR, which must already be resident.
+ *                Returns EFAULT if it isn't.
+ *
+ *    as_pin    - record that the kernel is using VADDR..VADDR+LEN, so
+ *                MADV_DONTNEED refuses to drop it; as_unpin undoes it.
  */
 
 struct addrspace *as_create(void);
@@ -141,14 +194,23 @@ int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
 void		  as_zero_region(vaddr_t vaddr, unsigned npages);
 void		  as_destroy_regions(struct as_region *ar);
+int		  as_advise(struct addrspace *as, vaddr_t vaddr, size_t len,
+			    int advice);
+int		  as_translate(struct addrspace *as, vaddr_t vaddr,
+			       vaddr_t *kvaddr);
+void		  as_pin(struct addrspace *as, struct as_pin *pin,
+			 vaddr_t vaddr, size_t len);
+void		  as_unpin(struct addrspace *as, struct as_pin *pin);
 /*
  * Functions in loadelf.c
  *    load_elf - load an ELF user program executable into the current
  *               address space. Returns the entry point (initial PC)
  *               in the space pointed to by ENTRYPOINT.
+ *    load_elf_bootstrap - register the header cache's counters.
  */
 
 int load_elf(struct vnode *v, vaddr_t *entrypoint);
+void load_elf_bootstrap(void);
 
 
 #endif /* _ADDRSPACE_H_ */
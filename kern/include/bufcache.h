@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _BUFCACHE_H_
+#define _BUFCACHE_H_
+
+/*
+ * Block cache for block devices (kern/vfs/bufcache.c).
+ *
+ * A small cache of device blocks, shared by everything that goes
+ * through it: sfs does all its block I/O this way, and so do raw
+ * device vnodes (lhd0raw: and the like) that have been switched to
+ * buffered mode with the DIOCSBUFFER ioctl. Because they share it, a
+ * tool reading a raw device in buffered mode sees what the mounted
+ * filesystem last wrote and vice versa.
+ *
+ * A read that misses brings in a run of up to BUFCACHE_MAXRUN blocks
+ * with one call to d_io, going past the end of the request when reads
+ * on the device are sequential. Writes are either write-through (sfs,
+ * which expects its writes to be on disk) or write-behind (buffered
+ * raw devices); write-behind blocks are written out in runs of
+ * consecutive blocks, when they are evicted, when the device is
+ * closed or fsync'd, and by vfs_sync.
+ *
+ *    bufcache_bootstrap  - set up the cache.
+ *    bufcache_cancache   - true if D is a block device we can cache.
+ *    bufcache_io         - do block-aligned I/O on D through the cache.
+ *                          On error the uio is left as it was.
+ *    bufcache_flush      - write out D's dirty blocks (all devices' if
+ *                          D is NULL).
+ *    bufcache_forget     - drop D's cached copies of NBLOCKS blocks
+ *                          from BLOCK, after they were written behind
+ *                          the cache's back.
+ *    bufcache_invalidate - flush and then drop everything for D.
+ *
+ * Devices with blocks bigger than BUFCACHE_BLOCKSIZE aren't cached.
+ */
+
+struct device;
+struct uio;
+
+#define BUFCACHE_NBUFS		64	/* blocks cached */
+#define BUFCACHE_BLOCKSIZE	512	/* largest block size cached */
+#define BUFCACHE_MAXRUN		8	/* most blocks per d_io call */
+
+void bufcache_bootstrap(void);
+bool bufcache_cancache(struct device *d);
+int bufcache_io(struct device *d, struct uio *uio, bool writebehind);
+int bufcache_flush(struct device *d);
+void bufcache_forget(struct device *d, uint32_t block, uint32_t nblocks);
+int bufcache_invalidate(struct device *d);
+
+#endif /* _BUFCACHE_H_ */
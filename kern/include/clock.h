@@ -39,7 +39,8 @@
  * when the CPU is not idle, for scheduling.
  *
  * timerclock() is called on one CPU once a second to allow simple
- * timed operations. (This is a fairly simpleminded interface.)
+ * timed operations. (This is a fairly simpleminded interface.) It
+ * also updates the load averages, which clock_getload() fetches.
  *
  * gettime() may be used to fetch the current time of day.
  * getinterval() computes the time from time1 to time2.
@@ -60,6 +61,7 @@ void hardclock_bootstrap(void);
 
 void hardclock(void);
 void timerclock(void);
+unsigned clock_getload(unsigned *load);
 
 void gettime(time_t *seconds, uint32_t *nanoseconds);
 
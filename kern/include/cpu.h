@@ -34,6 +34,9 @@
 #include <spinlock.h>
 #include <threadlist.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
+#include <dmesg.h>
+#include <kern/time.h>
+#include <kern/resource.h>  /* for LATENCY_NBUCKETS */
 
 
 /*
@@ -46,6 +49,8 @@
  * a pointer with a fixed address and a per-cpu mapping in the MMU.
  */
 
+struct pageop_chunk;	/* from <pageop.h> */
+
 struct cpu {
 	/*
 	 * Fixed after allocation.
@@ -60,6 +65,7 @@ struct cpu {
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
+	unsigned c_wsepoch;		/* Working-set window last seen */
 
 	/*
 	 * Accessed by other cpus.
@@ -68,6 +74,7 @@ struct cpu {
 	bool c_isidle;			/* True if this cpu is idle */
 	struct threadlist c_runqueue;	/* Run queue for this cpu */
 	struct spinlock c_runqueue_lock;
+	unsigned c_latency[LATENCY_NBUCKETS]; /* Run queue wait histogram */
 
 	/*
 	 * Accessed by other cpus.
@@ -87,6 +94,18 @@ struct cpu {
 	struct tlbshootdown c_shootdown[TLBSHOOTDOWN_MAX];
 	int c_numshootdown;
 	struct spinlock c_ipi_lock;
+
+	/*
+	 * Accessed by other cpus.
+	 * Protected by the pageop lock.
+	 */
+	struct pageop_chunk *c_pageops;	/* Page work handed to us */
+	struct spinlock c_pageop_lock;
+
+	/*
+	 * Written by this cpu, read by the kprintf drain thread.
+	 */
+	struct dmesg c_dmesg;		/* kprintf output not yet printed */
 };
 
 #define TLBSHOOTDOWN_ALL  (-1)
@@ -114,6 +133,11 @@ void cpu_hatch(unsigned software_number);
  */
 const char *cpu_identify(void);
 
+/*
+ * Register the per-exception-type counters kept by the trap code.
+ */
+void trap_bootstrap(void);
+
 /*
  * Hardware-level interrupt on/off, for the current CPU.
  *
@@ -152,6 +176,9 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_broadcast is ipi_tlbshootdown to all other CPUs.
+ * ipi_tlbshootdown_wait waits for another CPU to finish the shootdowns
+ * sent to it.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -166,6 +193,8 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_wait(struct cpu *target);
 
 void interprocessor_interrupt(void);
 
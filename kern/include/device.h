@@ -51,6 +51,7 @@ struct device {
 	blksize_t d_blocksize;
 
 	dev_t d_devnumber;	/* serial number for this device */
+	bool d_buffered;	/* raw I/O goes through the block cache */
 
 	void *d_data;		/* device-specific data */
 };
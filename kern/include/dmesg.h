@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef _DMESG_H_
+#define _DMESG_H_
+
+/*
+ * Kernel message buffer (in kern/lib/kprintf.c).
+ *
+ * Once dmesg_bootstrap has run, kprintf doesn't wait for the console:
+ * it appends the message to a ring belonging to the current CPU, with
+ * interrupts off but without taking any lock, and returns. A kernel
+ * thread copies the rings out to the console; hardclock wakes it
+ * every DMESG_HARDCLOCKS ticks if there is anything to print. Each
+ * ring has one writer (its CPU) and one reader at a time (usually the
+ * drain thread; whoever holds the claim in kprintf.c), so the head and
+ * tail counters need no locking.
+ *
+ * If a ring fills up, kprintf called from a thread drains the rings
+ * itself first; output from interrupt handlers that doesn't fit is
+ * dropped, and the loss is reported.
+ *
+ *    dmesg_init      - set up the ring for a new CPU.
+ *    dmesg_bootstrap - start the drain thread; kprintf buffers after this.
+ *    dmesg_tick      - called from hardclock to wake the drain thread.
+ *    dmesg_flush     - print everything buffered, and go back to printing
+ *                      synchronously. For panic and shutdown.
+ */
+
+#define DMESG_SIZE		4096	/* bytes per CPU; a power of 2 */
+#define DMESG_HARDCLOCKS	2	/* how often to check for output */
+
+struct dmesg {
+	char dm_buf[DMESG_SIZE];
+	volatile unsigned dm_head;	/* bytes appended (by the CPU) */
+	volatile unsigned dm_tail;	/* bytes printed (by the drainer) */
+	volatile unsigned dm_lost;	/* bytes dropped (by the CPU) */
+	unsigned dm_lostseen;		/* dm_lost last reported */
+	struct dmesg *dm_next;		/* all the rings */
+};
+
+void dmesg_init(struct dmesg *dm);
+void dmesg_bootstrap(void);
+void dmesg_tick(void);
+void dmesg_flush(void);
+
+#endif /* _DMESG_H_ */
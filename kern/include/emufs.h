@@ -52,6 +52,7 @@ struct emufs_fs {
 	struct emu_softc *ef_emu;	/* device */
 	struct emufs_vnode *ef_root;	/* root vnode */
 	struct vnodearray *ef_vnodes;	/* table of loaded vnodes */
+	struct emufs_fs *ef_next;	/* all emufs, for hibernation */
 };
 
 
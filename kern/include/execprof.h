@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef _EXECPROF_H_
+#define _EXECPROF_H_
+
+/*
+ * Exec prefetch profiles (kern/vm/execprof.c).
+ *
+ * The pages a program is given during its first EXECPROF_MSEC
+ * milliseconds are remembered against the executable it was loaded
+ * from, and prefaulted in address order the next time that
+ * executable is run, so it doesn't start with a burst of faults.
+ *
+ *    execprof_bootstrap - set up the profile table.
+ *    execprof_start     - called by exec with the new address space
+ *                         AS loaded from V. Prefaults V's profile if
+ *                         there is one, otherwise starts recording.
+ *    execprof_record    - note that AS was given the page at VADDR.
+ *    execprof_finish    - stop recording AS and save its profile.
+ *
+ * Under dumbvm there is nothing to prefault and exec just skips it.
+ */
+
+#include "opt-dumbvm.h"
+
+#define EXECPROF_MSEC		250	/* how long to record for */
+#define EXECPROF_MAXPAGES	64	/* pages per profile */
+#define EXECPROF_NPROFILES	16	/* executables remembered */
+
+struct addrspace;
+struct vnode;
+
+#if OPT_DUMBVM
+
+#define execprof_start(as, v)	((void)(as), (void)(v))
+
+#else
+
+void execprof_bootstrap(void);
+void execprof_start(struct addrspace *as, struct vnode *v);
+void execprof_record(struct addrspace *as, vaddr_t vaddr);
+void execprof_finish(struct addrspace *as);
+
+#endif /* OPT_DUMBVM */
+
+#endif /* _EXECPROF_H_ */
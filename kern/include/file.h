@@ -6,6 +6,8 @@
 #define _FILE_H_
 
 #include <limits.h>
+#include <spinlock.h>
+#include <uio.h>
 
 struct lock;
 struct vnode;
@@ -34,17 +36,37 @@ int file_open(char *filename, int flags, int mode, int *retfd);
 /* closes a file */
 int file_close(int fd);
 
+/* extra references for holders outside the filetable */
+void file_incref(struct openfile *file);
+void file_decref(struct openfile *file);
+
+/*
+ * reads or writes a user buffer in the current address space; an offset
+ * of FILE_CUROFF means use (and advance) the file's seek position.
+ */
+#define FILE_CUROFF	((off_t)-1)
+int file_doio(struct openfile *file, userptr_t buf, size_t size, off_t offset,
+	      enum uio_rw rw, int *retval);
+
 
 /*** file table section ***/
 
 /*
  * filetable struct
- * just an array of open files.  nice and simple.  doesn't require
- * synchronization, because a table can only be owned by a single process (on
- * inheritance in fork, the table is copied).
+ * an array of open files, plus the close-on-exec flag for each slot.
+ *
+ * on fork the table is not copied; the child shares the parent's table and
+ * ft_refcount counts the processes using it.  a process that wants to change
+ * its table (open, close, dup2, fcntl, or the close-on-exec pass in execv)
+ * first takes a private copy if the table is shared.  a shared table is
+ * therefore never modified, so lookups need no synchronization; only the
+ * refcount is protected, by ft_lock.
  */
 struct filetable {
 	struct openfile *ft_openfiles[OPEN_MAX];
+	bool ft_cloexec[OPEN_MAX];
+	unsigned ft_refcount;
+	struct spinlock ft_lock;
 };
 
 /* these all have an implicit arg of the curthread's filetable */
@@ -54,6 +76,9 @@ int filetable_copy(struct filetable **copy);
 int filetable_placefile(struct openfile *file, int *fd);
 int filetable_findfile(int fd, struct openfile **file);
 int filetable_dup2file(int oldfd, int newfd);
+int filetable_getcloexec(int fd, bool *cloexec);
+int filetable_setcloexec(int fd, bool cloexec);
+int filetable_execclose(void);
 void filetable_destroy(struct filetable *ft);
 
 
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+/*
+ * Intrusive hash table.
+ *
+ * Objects to be stored embed a struct hashlink; the table chains the
+ * links, so inserting never allocates and can't fail. The bucket
+ * array is a power of two in size. It grows when the load factor
+ * passes HASH_MAXLOAD and shrinks when it drops below 1/HASH_MINLOAD.
+ * Entries move to the new bucket array a few buckets at a time
+ * (HASH_MIGRATESTEP per insert) rather than all at once, so no single
+ * operation pays for a whole rehash; until the move is done, lookups
+ * check both arrays. Resizing is only ever started or advanced by
+ * insert.
+ *
+ * The bucket array is one kmalloc block, so it's capped at a page
+ * worth of pointers; past that the chains just get longer.
+ *
+ * Locking: by default the table does none, and the caller must
+ * serialize all access (as with arrays). With HASH_LOCKED the table
+ * protects itself with a set of spinlocks, each covering the buckets
+ * whose index is congruent to it mod HASH_NLOCKS; since the bucket
+ * count never drops below HASH_NLOCKS, a given key always maps to the
+ * same lock, in the old and new bucket arrays alike. Resizing takes
+ * all of them. Note that HASH_LOCKED only keeps the table itself
+ * consistent; whatever keeps an object from being freed out from
+ * under a lookup is the caller's business.
+ *
+ * Iteration (hashtable_iterinit/hashtable_iternext) requires the
+ * caller to exclude other users, and no inserts may happen while
+ * iterating. The entry just returned may be removed.
+ *
+ * Base operations:
+ *
+ * init - initialize a table in space externally allocated. MINBUCKETS
+ *       is the initial and smallest bucket count (0 for a default); it
+ *       is rounded up to a power of two. May fail with ENOMEM.
+ * cleanup - clean up; the table must be empty.
+ * num - return the number of entries.
+ * insert - add LINK with hash value HASH.
+ * remove - remove LINK, which must be in the table.
+ * lookup - return the first link with hash HASH for which
+ *       MATCH(link, KEY) is true, or NULL.
+ */
+
+struct spinlock;	/* from <spinlock.h> */
+
+struct hashlink {
+	struct hashlink *hl_next;
+	uint32_t hl_hash;
+};
+
+struct hashtable {
+	struct hashlink **ht_buckets;	/* current bucket array */
+	unsigned ht_nbuckets;		/* size of ht_buckets (power of 2) */
+	struct hashlink **ht_old;	/* array being drained, or NULL */
+	unsigned ht_nold;		/* size of ht_old */
+	unsigned ht_migrate;		/* next ht_old bucket to move */
+	unsigned ht_moved;		/* ht_old buckets finished moving */
+	unsigned ht_minbuckets;		/* never shrink below this */
+	unsigned ht_count;		/* number of entries */
+	struct spinlock *ht_locks;	/* HASH_NLOCKS+1 locks, or NULL */
+};
+
+struct hashiter {
+	unsigned hi_table;		/* 0: ht_old, 1: ht_buckets */
+	unsigned hi_bucket;		/* bucket number in that table */
+	struct hashlink *hi_next;	/* next link to return */
+};
+
+/* Flags for hashtable_init */
+#define HASH_LOCKED	1
+
+#define HASH_DEFBUCKETS		16
+#define HASH_NLOCKS		16
+#define HASH_MAXLOAD		2	/* grow above 2 entries per bucket */
+#define HASH_MINLOAD		8	/* shrink below 1 per 8 buckets */
+#define HASH_MIGRATESTEP	2	/* old buckets moved per insert */
+
+int hashtable_init(struct hashtable *ht, unsigned minbuckets, int flags);
+void hashtable_cleanup(struct hashtable *ht);
+unsigned hashtable_num(const struct hashtable *ht);
+void hashtable_insert(struct hashtable *ht, struct hashlink *hl,
+		      uint32_t hash);
+void hashtable_remove(struct hashtable *ht, struct hashlink *hl);
+struct hashlink *hashtable_lookup(struct hashtable *ht, uint32_t hash,
+			bool (*match)(const struct hashlink *, const void *),
+			const void *key);
+void hashtable_iterinit(struct hashtable *ht, struct hashiter *hi);
+struct hashlink *hashtable_iternext(struct hashtable *ht,
+				   struct hashiter *hi);
+
+/*
+ * Hash functions for common key types.
+ */
+uint32_t hash_u32(uint32_t val);
+uint32_t hash_string(const char *str);
+
+/*
+ * Bits for declaring and defining typed hash tables, in the style of
+ * DECLARRAY in <array.h>.
+ *
+ * DECLHASH(NAME, T, KEYT) declares "struct NAME", a table of T
+ * (a struct type) indexed by keys of type KEYT, and its operations:
+ *
+ *    int NAME_init(struct NAME *h, unsigned minbuckets, int flags);
+ *    void NAME_cleanup(struct NAME *h);
+ *    unsigned NAME_num(const struct NAME *h);
+ *    void NAME_insert(struct NAME *h, T *obj);
+ *    void NAME_remove(struct NAME *h, T *obj);
+ *    T *NAME_lookup(struct NAME *h, KEYT key);
+ *    void NAME_iterinit(struct NAME *h, struct hashiter *hi);
+ *    T *NAME_iternext(struct NAME *h, struct hashiter *hi);
+ *
+ * DEFHASH(NAME, T, KEYT, LINK, KEYOF, HASHFN, KEYEQ, INLINE) defines
+ * them. LINK is the name of the struct hashlink member of T; KEYOF(obj)
+ * yields an object's key; HASHFN(key) hashes a key to uint32_t; and
+ * KEYEQ(k1, k2) compares two keys. (These may be function-like
+ * macros.) INLINE is used as for DEFARRAY.
+ *
+ * Example, for a table of struct proc keyed by pid_t:
+ *
+ * #define proc_pid(p) ((p)->p_pid)
+ * #define pid_eq(a, b) ((a) == (b))
+ * DECLHASH(proctable, struct proc, pid_t);
+ * DEFHASH(proctable, struct proc, pid_t, p_hashlink,
+ *         proc_pid, hash_u32, pid_eq, PROCINLINE);
+ */
+
+#define HASH_OFFSETOF(T, F) ((size_t)&((T *)0)->F)
+
+#define DECLHASH(NAME, T, KEYT) \
+	struct NAME {						\
+		struct hashtable ht;				\
+	};							\
+								\
+	int NAME##_init(struct NAME *h, unsigned minbuckets, int flags); \
+	void NAME##_cleanup(struct NAME *h);			\
+	unsigned NAME##_num(const struct NAME *h);		\
+	void NAME##_insert(struct NAME *h, T *obj);		\
+	void NAME##_remove(struct NAME *h, T *obj);		\
+	T *NAME##_lookup(struct NAME *h, KEYT key);		\
+	void NAME##_iterinit(struct NAME *h, struct hashiter *hi); \
+	T *NAME##_iternext(struct NAME *h, struct hashiter *hi)
+
+#define DEFHASH(NAME, T, KEYT, LINK, KEYOF, HASHFN, KEYEQ, INLINE) \
+	static inline T *					\
+	NAME##_obj(const struct hashlink *hl)			\
+	{							\
+		return (T *)((char *)hl - HASH_OFFSETOF(T, LINK));\
+	}							\
+								\
+	static inline bool					\
+	NAME##_match(const struct hashlink *hl, const void *key) \
+	{							\
+		return KEYEQ(KEYOF(NAME##_obj(hl)),		\
+			     *(const KEYT *)key);		\
+	}							\
+								\
+	INLINE int						\
+	NAME##_init(struct NAME *h, unsigned minbuckets, int flags) \
+	{							\
+		return hashtable_init(&h->ht, minbuckets, flags); \
+	}							\
+								\
+	INLINE void						\
+	NAME##_cleanup(struct NAME *h)				\
+	{							\
+		hashtable_cleanup(&h->ht);			\
+	}							\
+								\
+	INLINE unsigned						\
+	NAME##_num(const struct NAME *h)			\
+	{							\
+		return hashtable_num(&h->ht);			\
+	}							\
+								\
+	INLINE void						\
+	NAME##_insert(struct NAME *h, T *obj)			\
+	{							\
+		hashtable_insert(&h->ht, &obj->LINK,		\
+				 HASHFN(KEYOF(obj)));		\
+	}							\
+								\
+	INLINE void						\
+	NAME##_remove(struct NAME *h, T *obj)			\
+	{							\
+		hashtable_remove(&h->ht, &obj->LINK);		\
+	}							\
+								\
+	INLINE T *						\
+	NAME##_lookup(struct NAME *h, KEYT key)			\
+	{							\
+		struct hashlink *hl;				\
+								\
+		hl = hashtable_lookup(&h->ht, HASHFN(key),	\
+				      NAME##_match, &key);	\
+		return hl == NULL ? NULL : NAME##_obj(hl);	\
+	}							\
+								\
+	INLINE void						\
+	NAME##_iterinit(struct NAME *h, struct hashiter *hi)	\
+	{							\
+		hashtable_iterinit(&h->ht, hi);			\
+	}							\
+								\
+	INLINE T *						\
+	NAME##_iternext(struct NAME *h, struct hashiter *hi)	\
+	{							\
+		struct hashlink *hl;				\
+								\
+		hl = hashtable_iternext(&h->ht, hi);		\
+		return hl == NULL ? NULL : NAME##_obj(hl);	\
+	}
+
+#endif /* _HASH_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _HIBERNATE_H_
+#define _HIBERNATE_H_
+
+/*
+ * Hibernation (kern/arch/sys161/startup/hibernate.c).
+ *
+ * hibernate writes every frame in use, and the context to come back
+ * to, to the disk HIBERNATE_DEVICE and powers off. The next boot
+ * looks for the image as soon as devices are probed and, if it finds
+ * one, loads it in place of the rest of initialization, so the system
+ * comes back where it left off in time proportional to the memory
+ * that was in use rather than to the full boot path.
+ *
+ *    hibernate        - save the system and power off. Returns 0 after
+ *                       the system has been resumed, or an error if
+ *                       it couldn't be saved.
+ *    hibernate_resume - called from boot(). Doesn't return if there
+ *                       is an image to resume.
+ *
+ * The whole of HIBERNATE_DEVICE is given over to the image, so it
+ * must not be mounted. Only a uniprocessor can hibernate, and emufs
+ * file handles don't survive a reboot, so files open on emu devices
+ * (other than their root directories) make hibernate fail with EBUSY.
+ *
+ * Under dumbvm there is no frame table and hibernate fails.
+ */
+
+#include <kern/errno.h>
+#include "opt-dumbvm.h"
+
+#define HIBERNATE_DEVICE	"lhd1"
+
+#if OPT_DUMBVM
+
+#define hibernate()		EUNIMP
+#define hibernate_resume()	((void)0)
+
+#else
+
+int hibernate(void);
+void hibernate_resume(void);
+
+#endif /* OPT_DUMBVM */
+
+#endif /* _HIBERNATE_H_ */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _IOWORK_H_
+#define _IOWORK_H_
+
+/*
+ * I/O worker threads.
+ *
+ * A small pool of kernel threads that perform file reads and writes on
+ * behalf of user processes, so that a process can have I/O in progress
+ * without being blocked in it. Used by the submission ring (ioring.c).
+ *
+ * The submitter sets up a struct iowork with iowork_prepare, fills in
+ * IW_COMPLETE, and hands it to iowork_submit.
+ * A worker borrows the submitter's address space for the transfer (so
+ * IW_BUF is an ordinary user pointer), then calls IW_COMPLETE with
+ * IW_RESULT and IW_RETVAL filled in. The completion function owns the
+ * iowork from then on and is responsible for freeing it.
+ *
+ * Because the worker uses the address space from another thread, the
+ * user buffer is faulted in up front by iowork_prepare, and pinned
+ * (as_pin) until the worker is done with it so MADV_DONTNEED can't
+ * take it away; and the address space must not be destroyed until
+ * all work against it has completed.
+ */
+
+#include <uio.h>
+#include <addrspace.h>
+
+struct openfile;
+
+struct iowork {
+	struct openfile *iw_file;	/* holds a reference; dropped when done */
+	struct addrspace *iw_as;	/* address space IW_BUF is in */
+	userptr_t iw_buf;		/* user buffer */
+	size_t iw_len;			/* length of IW_BUF */
+	off_t iw_offset;		/* file offset, or FILE_CUROFF */
+	enum uio_rw iw_rw;		/* read or write */
+	struct as_pin iw_pin;		/* keeps IW_BUF in place */
+
+	int iw_result;			/* errno, or 0 on success */
+	int iw_retval;			/* bytes transferred */
+	void (*iw_complete)(struct iowork *);
+
+	struct iowork *iw_next;		/* queue link */
+};
+
+/* Start the worker threads. */
+void iowork_bootstrap(void);
+
+/*
+ * Look up FD in the current filetable and fill in IW for a transfer
+ * against it, faulting in BUF and taking a reference to the file.
+ */
+int iowork_prepare(struct iowork *iw, int fd, userptr_t buf, size_t len,
+		   off_t offset, enum uio_rw rw);
+
+/* Queue work. */
+void iowork_submit(struct iowork *iw);
+
+#endif /* _IOWORK_H_ */
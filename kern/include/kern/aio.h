@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_AIO_H_
+#define _KERN_AIO_H_
+
+/*
+ * Asynchronous I/O control block, as passed to aio_read/aio_write.
+ *
+ * The kernel copies the control block when the request is queued and
+ * identifies the request by the address of the control block from
+ * then on, so the same block must be passed to aio_error, aio_return,
+ * and so forth, and must not be reused until aio_return (or
+ * aio_waitcomplete) has collected its result.
+ */
+struct aiocb {
+	int aio_fildes;			/* file handle */
+	__off_t aio_offset;		/* file offset to transfer at */
+#ifdef _KERNEL
+	userptr_t aio_buf;		/* data buffer */
+#else
+	volatile void *aio_buf;
+#endif
+	__size_t aio_nbytes;		/* length of aio_buf */
+};
+
+/* Flags for aio_waitcomplete */
+#define AIO_NOWAIT	1		/* fail with EAGAIN instead of waiting */
+
+/* Requests a process may have outstanding at once */
+#define AIO_MAX		32
+
+#endif /* _KERN_AIO_H_ */
@@ -34,6 +34,16 @@
  * ioctl operation codes
  */
 
-/* (none yet) */
+/* console line discipline; the argument is a pointer to int */
+#define TIOCGETMODE	1	/* get the mode */
+#define TIOCSETMODE	2	/* set the mode */
+
+/* console modes */
+#define TTY_CANON	0x1	/* edit lines; read returns a line at a time */
+#define TTY_ECHO	0x2	/* echo input as it is read */
+
+/* block devices; the argument is a pointer to int, 1 for buffered */
+#define DIOCGBUFFER	3	/* get buffered mode */
+#define DIOCSBUFFER	4	/* set buffered mode */
 
 #endif /* _KERN_IOCTL_H_*/
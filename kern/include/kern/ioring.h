@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_IORING_H_
+#define _KERN_IORING_H_
+
+/*
+ * Submission/completion ring, shared between a process and the kernel.
+ *
+ * The process allocates a struct ioring (which must not cross a page
+ * boundary) and registers it with ioring_setup(). It then queues
+ * requests by filling in ir_sq[ir_sqtail % IORING_ENTRIES] and
+ * advancing ir_sqtail, and calls ioring_enter() to have the kernel
+ * take up to TO_SUBMIT of them in one trap. Results are posted to
+ * ir_cq at ir_cqtail; the process reaps them and advances ir_cqhead.
+ *
+ * Indexes run freely and wrap; only the low bits select a slot. The
+ * process writes ir_sqtail and ir_cqhead; the kernel writes ir_sqhead
+ * and ir_cqtail.
+ *
+ * Reads and writes are carried out by kernel worker threads, so they
+ * may complete out of order and after ioring_enter returns; use
+ * sqe_user to match completions to requests. Opens, closes, and
+ * no-ops complete before ioring_enter returns.
+ */
+
+#define IORING_ENTRIES	64	/* slots in each ring; power of 2 */
+
+/* Operations */
+#define IORING_OP_NOP	0	/* complete with result 0 */
+#define IORING_OP_READ	1	/* read(sqe_fd, sqe_buf, sqe_len) */
+#define IORING_OP_WRITE	2	/* write(sqe_fd, sqe_buf, sqe_len) */
+#define IORING_OP_OPEN	3	/* open(sqe_buf, sqe_flags) */
+#define IORING_OP_CLOSE	4	/* close(sqe_fd) */
+
+/* sqe_offset value meaning "at the file's seek position" */
+#define IORING_CUROFF	((__off_t)-1)
+
+/* Submission queue entry */
+struct ioring_sqe {
+	int sqe_op;			/* IORING_OP_* */
+	int sqe_fd;			/* file handle */
+#ifdef _KERNEL
+	userptr_t sqe_buf;		/* data buffer, or path for OPEN */
+#else
+	void *sqe_buf;
+#endif
+	__size_t sqe_len;		/* length of sqe_buf */
+	__off_t sqe_offset;		/* file offset, or IORING_CUROFF */
+	int sqe_flags;			/* open flags for OPEN */
+	unsigned sqe_user;		/* copied to cqe_user */
+};
+
+/* Completion queue entry */
+struct ioring_cqe {
+	unsigned cqe_user;		/* sqe_user of the request */
+	int cqe_result;			/* return value, or -1 */
+	int cqe_error;			/* errno if cqe_result is -1 */
+};
+
+struct ioring {
+	volatile unsigned ir_sqhead;	/* next SQE the kernel takes */
+	volatile unsigned ir_sqtail;	/* next SQE the process fills */
+	volatile unsigned ir_cqhead;	/* next CQE the process reaps */
+	volatile unsigned ir_cqtail;	/* next CQE the kernel posts */
+	struct ioring_sqe ir_sq[IORING_ENTRIES];
+	struct ioring_cqe ir_cq[IORING_ENTRIES];
+};
+
+#endif /* _KERN_IORING_H_ */
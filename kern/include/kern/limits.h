@@ -55,7 +55,7 @@
 #define __PATH_MAX      1024
 
 /* Max bytes for an exec function */
-#define __ARG_MAX       (4 * 1024)
+#define __ARG_MAX       (16 * 1024)
 
 
 /*
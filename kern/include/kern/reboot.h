@@ -40,6 +40,7 @@
 #define RB_REBOOT     0      /* Reboot system */
 #define RB_HALT       1      /* Halt system and do not reboot */
 #define RB_POWEROFF   2      /* Halt system and power off */
+#define RB_HIBERNATE  3      /* Save system to disk and power off */
 
 
 #endif /* _KERN_REBOOT_H_ */
@@ -89,4 +89,39 @@ struct rlimit {
 
 #define RLIM_INFINITY	(~(__rlim_t)0)
 
+/* working-set figures from getwsinfo(), in pages */
+struct wsinfo {
+	unsigned wi_ws;			/* pages referenced in last window */
+	unsigned wi_faults;		/* page faults per window */
+	unsigned wi_rss;		/* pages resident */
+	unsigned wi_nsuspend;		/* times suspended for memory */
+	unsigned wi_totalws;		/* working sets of running processes */
+	unsigned wi_ram;		/* pages available for user memory */
+	unsigned wi_nsuspended;		/* processes suspended right now */
+};
+
+/*
+ * Scheduler load figures from getloadinfo().
+ *
+ * The load averages are the number of threads running or waiting to
+ * run, decayed exponentially over 1, 5 and 15 seconds, in fixed
+ * point with li_fscale as 1.0.
+ *
+ * Bucket 0 of li_latency counts the times a thread waited less than
+ * LATENCY_MIN_USEC microseconds on a run queue before getting a CPU;
+ * bucket i counts waits of LATENCY_MIN_USEC << (i-1) and up to twice
+ * that. The last bucket also takes everything longer.
+ */
+#define LATENCY_NBUCKETS	16
+#define LATENCY_MIN_USEC	16
+
+struct loadinfo {
+	unsigned li_load[3];		/* 1, 5, 15 second load averages */
+	unsigned li_fscale;		/* fixed-point 1.0 for li_load */
+	unsigned li_nactive;		/* threads running or runnable now */
+	unsigned li_latency[LATENCY_NBUCKETS];	/* wait histogram */
+	unsigned li_mywaits;		/* times this thread waited */
+	unsigned li_mywaitms;		/* its total wait, in ms */
+};
+
 #endif /* _KERN_RESOURCE_H_ */
@@ -37,27 +37,44 @@
  */
 
 #define SFS_MAGIC         0xabadf001    /* magic number identifying us */
-#define SFS_BLOCKSIZE     512           /* size of our blocks */
+#define SFS_BLOCKSIZE     512           /* default (and smallest) blk size */
+#define SFS_MAXBLOCKSIZE  8192          /* largest block size */
 #define SFS_VOLNAME_SIZE  32            /* max length of volume name */
 #define SFS_NDIRECT       15            /* # of direct blocks in inode */
-#define SFS_DBPERIDB      128           /* # direct blks per indirect blk */
 #define SFS_NAMELEN       60            /* max length of filename */
 #define SFS_SB_LOCATION    0            /* block the superblock lives in */
 #define SFS_ROOT_LOCATION  1            /* loc'n of the root dir inode */
 #define SFS_MAP_LOCATION   2            /* 1st block of the freemap */
 #define SFS_NOINO          0            /* inode # for free dir entry */
 
+/*
+ * The block size is chosen when the volume is made and recorded in
+ * the superblock. It must be a power of two between SFS_BLOCKSIZE and
+ * SFS_MAXBLOCKSIZE. Volumes from before the field existed have 0
+ * there, which means SFS_BLOCKSIZE.
+ *
+ * The superblock and inodes are always SFS_BLOCKSIZE bytes and sit at
+ * the start of their block; the rest of the block is unused.
+ */
+#define SFS_BLOCKSIZE_OK(bs) \
+	((bs) >= SFS_BLOCKSIZE && (bs) <= SFS_MAXBLOCKSIZE && \
+	 ((bs) & ((bs)-1)) == 0)
+
+/* # direct blks per indirect blk, for block size BS */
+#define SFS_DBPERIDB(bs)  ((bs) / sizeof(uint32_t))
+
 /* Number of bits in a block */
-#define SFS_BLOCKBITS (SFS_BLOCKSIZE * CHAR_BIT)
+#define SFS_BLOCKBITS(bs) ((bs) * CHAR_BIT)
 
 /* Utility macro */
-#define SFS_ROUNDUP(a,b)       ((((a)+(b)-1)/(b))*b)
+#define SFS_ROUNDUP(a,b)       ((((a)+(b)-1)/(b))*(b))
 
 /* Size of bitmap (in bits) */
-#define SFS_BITMAPSIZE(nblocks) SFS_ROUNDUP(nblocks, SFS_BLOCKBITS)
+#define SFS_BITMAPSIZE(nblocks, bs) SFS_ROUNDUP(nblocks, SFS_BLOCKBITS(bs))
 
 /* Size of bitmap (in blocks) */
-#define SFS_BITBLOCKS(nblocks)  (SFS_BITMAPSIZE(nblocks)/SFS_BLOCKBITS)
+#define SFS_BITBLOCKS(nblocks, bs) \
+	(SFS_BITMAPSIZE(nblocks, bs)/SFS_BLOCKBITS(bs))
 
 /* File types for sfi_type */
 #define SFS_TYPE_INVAL    0       /* Should not appear on disk */
@@ -71,7 +88,8 @@ struct sfs_super {
 	uint32_t sp_magic;		/* Magic number, should be SFS_MAGIC */
 	uint32_t sp_nblocks;			/* Number of blocks in fs */
 	char sp_volname[SFS_VOLNAME_SIZE];	/* Name of this volume */
-	uint32_t reserved[118];
+	uint32_t sp_blocksize;			/* Block size (0: default) */
+	uint32_t reserved[117];
 };
 
 /*
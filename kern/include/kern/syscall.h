@@ -59,7 +59,7 @@
 #define SYS_mmap         8
 #define SYS_munmap       9
 #define SYS_mprotect     10
-//#define SYS_madvise    11
+#define SYS_madvise      11
 //#define SYS_mincore    12
 //#define SYS_mlock      13
 //#define SYS_munlock    14
@@ -88,8 +88,8 @@
 //#define SYS_wait4      34
 //#define SYS_getrusage  35
 //                              (resource limits)
-//#define SYS_getrlimit  36
-//#define SYS_setrlimit  37
+#define SYS_getrlimit    36
+#define SYS_setrlimit    37
 //                              (process priority control)
 //#define SYS_getpriority 38
 //#define SYS_setpriority 39
@@ -196,6 +196,20 @@
 #define SYS_sync         118
 #define SYS_reboot       119
 //#define SYS___sysctl   120
+//                              (batched submission)
+#define SYS_ioring_setup 121
+#define SYS_ioring_enter 122
+//                              (asynchronous I/O)
+#define SYS_aio_read     123
+#define SYS_aio_write    124
+#define SYS_aio_error    125
+#define SYS_aio_return   126
+#define SYS_aio_suspend  127
+#define SYS_aio_waitcomplete 128
+//                              (working sets)
+#define SYS_getwsinfo    129
+//                              (scheduler load)
+#define SYS_getloadinfo  130
 
 /*CALLEND*/
 
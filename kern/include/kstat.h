@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef _KSTAT_H_
+#define _KSTAT_H_
+
+/*
+ * Kernel statistics (kern/lib/kstat.c, kern/vfs/kstatfs.c).
+ *
+ * A kstat is a named counter. Each CPU bumps its own copy with
+ * interrupts off, so counting takes no lock; the copies are only
+ * added up when someone reads the total. A kstat
+ * may instead have a KS_READ function, for values that are worked
+ * out when asked for (free memory, run queue lengths).
+ *
+ * Subsystems define their kstats statically with KSTAT_COUNTER or
+ * KSTAT_GAUGE and register them at bootstrap time. Registered kstats
+ * never go away. Each one appears as a read-only text file in the
+ * "kstat:" filesystem, holding its value in decimal.
+ *
+ *    kstat_register - make KS visible. Names should be unique.
+ *    kstat_inc      - add 1 to KS; safe in interrupt handlers.
+ *    kstat_add      - add N to KS.
+ *    kstat_value    - the current total.
+ *    kstat_find     - look up a kstat by name, or NULL.
+ *    kstat_get      - the Nth registered kstat, or NULL; for listing.
+ *
+ *    kstatfs_create - attach the "kstat:" filesystem. Called from
+ *                     vfs_bootstrap.
+ */
+
+/* CPUs with separate counts; beyond this, CPUs share slots */
+#define KSTAT_MAXCPUS	32
+
+struct kstat {
+	const char *ks_name;
+	unsigned long (*ks_read)(void);
+	volatile unsigned long ks_count[KSTAT_MAXCPUS];
+	struct kstat *ks_next;
+};
+
+#define KSTAT_COUNTER(var, name) \
+	struct kstat var = { name, NULL, { 0 }, NULL }
+#define KSTAT_GAUGE(var, name, func) \
+	struct kstat var = { name, func, { 0 }, NULL }
+
+void kstat_register(struct kstat *ks);
+void kstat_inc(struct kstat *ks);
+void kstat_add(struct kstat *ks, unsigned long n);
+unsigned long kstat_value(struct kstat *ks);
+struct kstat *kstat_find(const char *name);
+struct kstat *kstat_get(unsigned index);
+
+void kstatfs_create(void);
+
+#endif /* _KSTAT_H_ */
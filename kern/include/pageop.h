@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PAGEOP_H_
+#define _PAGEOP_H_
+
+/*
+ * Bulk page copying and zeroing, shared with idle CPUs
+ * (kern/vm/pageop.c).
+ *
+ * The caller collects page operations in a struct pagebatch and runs
+ * them with pagebatch_run. If other CPUs are idle, the batch is cut
+ * into chunks, one per CPU, and each idle CPU is handed a chunk
+ * through its pageop queue (c_pageops) and woken; the caller does
+ * its own chunk, takes back any chunk that hasn't been started, and
+ * waits for the rest. An idle CPU looks at its queue from the idle
+ * loop in thread_switch, before halting.
+ *
+ *    pagebatch_init    - set up an empty batch.
+ *    pagebatch_copy    - add a copy of the page at SRC to DST.
+ *    pagebatch_zero    - add zeroing the page at DST.
+ *    pagebatch_run     - do everything in the batch and empty it.
+ *    pagebatch_cleanup - run anything left over and clean up.
+ *
+ * pagebatch_copy and pagebatch_zero run the batch themselves when it
+ * fills up. Pages are given as kernel virtual addresses, and nothing
+ * is done to them until the batch runs, so the caller must not use
+ * them (or let anyone else) until then.
+ *
+ *    pageop_bootstrap  - set things up.
+ *    pageop_idle       - called by an idle CPU; does one queued chunk,
+ *                        returning false if there was none.
+ *
+ * Under dumbvm nothing uses this and idle CPUs just halt.
+ */
+
+#include <spinlock.h>
+#include "opt-dumbvm.h"
+
+#define PAGEBATCH_MAX		32	/* pages per batch */
+#define PAGEOP_MINCHUNK		4	/* fewest pages worth handing off */
+#define PAGEOP_MAXHELPERS	(PAGEBATCH_MAX / PAGEOP_MINCHUNK - 1)
+
+struct pagebatch;
+
+struct pageop_chunk {
+	struct pagebatch *pc_batch;
+	unsigned pc_start;		/* first op */
+	unsigned pc_end;		/* one past last op */
+	struct pageop_chunk *pc_next;	/* c_pageops link */
+};
+
+struct pagebatch {
+	unsigned pb_n;			/* ops in the batch */
+	vaddr_t pb_dst[PAGEBATCH_MAX];
+	vaddr_t pb_src[PAGEBATCH_MAX];	/* 0 to zero instead */
+
+	/* While running */
+	struct spinlock pb_lock;	/* protects pb_pending */
+	unsigned pb_pending;		/* chunks handed off, not done */
+	struct pageop_chunk pb_chunks[PAGEOP_MAXHELPERS];
+};
+
+#if OPT_DUMBVM
+
+#define pageop_idle()		false
+
+#else
+
+void pageop_bootstrap(void);
+bool pageop_idle(void);
+
+void pagebatch_init(struct pagebatch *pb);
+void pagebatch_copy(struct pagebatch *pb, vaddr_t dst, vaddr_t src);
+void pagebatch_zero(struct pagebatch *pb, vaddr_t dst);
+void pagebatch_run(struct pagebatch *pb);
+void pagebatch_cleanup(struct pagebatch *pb);
+
+#endif /* OPT_DUMBVM */
+
+#endif /* _PAGEOP_H_ */
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _RAID0_H_
+#define _RAID0_H_
+
+/*
+ * RAID-0 (striped) virtual block device.
+ *
+ * A raid0 device glues several disks of the same sector size together
+ * into one bigger one. The address space is cut into chunks of
+ * CHUNK sectors, and consecutive chunks are dealt out round-robin to
+ * the member disks, so a large transfer keeps every member busy at
+ * once. Each member has its own worker thread; a request is split
+ * into per-member sub-requests that run concurrently and the caller
+ * waits for all of them to finish.
+ *
+ * There is no redundancy: losing one member loses the whole device.
+ */
+
+/* Maximum number of member disks in one stripe set. */
+#define RAID0_MAXDISKS   8
+
+/* Default chunk size, in sectors. */
+#define RAID0_DEFCHUNK   8
+
+/*
+ * Create a stripe set named NAME over the NDISKS raw devices named in
+ * DISKS (e.g. "lhd1raw:") with a chunk size of CHUNK sectors, and
+ * register it with the VFS as a mountable device. Returns an error
+ * code.
+ */
+int raid0_create(const char *name, unsigned chunk,
+		 unsigned ndisks, char **disks);
+
+
+#endif /* _RAID0_H_ */
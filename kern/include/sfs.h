@@ -41,6 +41,7 @@
  */
 #include <fs.h>
 #include <vnode.h>
+#include <hash.h>
 
 /*
  * Get on-disk structures and constants that are made available to 
@@ -53,15 +54,32 @@ struct sfs_vnode {
 	struct sfs_inode sv_i;		/* on-disk inode */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	struct hashlink sv_hashlink;    /* link in sfs_fs->sfs_vnodes */
 };
 
+/*
+ * Table of loaded vnodes, indexed by inode number.
+ */
+#ifndef SFSINLINE
+#define SFSINLINE INLINE
+#endif
+
+#define sfs_vnode_ino(sv)	((sv)->sv_ino)
+#define sfs_ino_eq(a, b)	((a) == (b))
+
+DECLHASH(sfs_vnodetable, struct sfs_vnode, uint32_t);
+DEFHASH(sfs_vnodetable, struct sfs_vnode, uint32_t, sv_hashlink,
+	sfs_vnode_ino, hash_u32, sfs_ino_eq, SFSINLINE);
+
 struct sfs_fs {
 	struct fs sfs_absfs;            /* abstract filesystem structure */
 	struct sfs_super sfs_super;	/* on-disk superblock */
+	uint32_t sfs_blocksize;         /* block size (from superblock) */
 	bool sfs_superdirty;            /* true if superblock modified */
 	struct device *sfs_device;      /* device mounted on */
-	struct vnodearray *sfs_vnodes;  /* vnodes loaded into memory */
-	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
+	struct sfs_vnodetable sfs_vnodes; /* vnodes loaded into memory */
+	struct bitmap **sfs_freemap;    /* blocks in use are marked 1 */
+	unsigned sfs_freemapchunks;     /* number of bitmaps in sfs_freemap */
 	bool sfs_freemapdirty;          /* true if freemap modified */
 };
 
@@ -75,15 +93,41 @@ int sfs_mount(const char *device);
  * Internal functions
  */
 
+/* Shortcuts for the size macros in kern/sfs.h */
+#define SFS_FS_DBPERIDB(sfs)    SFS_DBPERIDB((sfs)->sfs_blocksize)
+#define SFS_FS_BITMAPSIZE(sfs)  \
+    SFS_BITMAPSIZE((sfs)->sfs_super.sp_nblocks, (sfs)->sfs_blocksize)
+#define SFS_FS_BITBLOCKS(sfs)   \
+    SFS_BITBLOCKS((sfs)->sfs_super.sp_nblocks, (sfs)->sfs_blocksize)
+
+/*
+ * The freemap is held in memory as one bitmap per SFS_BLOCKSIZE
+ * sector of the on-disk map, so that no allocation is bigger than a
+ * sector whatever the block size or the size of the volume.
+ */
+#define SFS_MAPCHUNKBITS        SFS_BLOCKBITS(SFS_BLOCKSIZE)
+#define SFS_MAPCHUNK(sfs, b)    ((sfs)->sfs_freemap[(b) / SFS_MAPCHUNKBITS])
+#define SFS_MAPBIT(b)           ((b) % SFS_MAPCHUNKBITS)
+
 /* Initialize uio structure */
-#define SFSUIO(iov, uio, ptr, block, rw) \
-    uio_kinit(iov, uio, ptr, SFS_BLOCKSIZE, ((off_t)(block))*SFS_BLOCKSIZE, rw)
+#define SFSUIO(sfs, iov, uio, ptr, block, rw) \
+    uio_kinit(iov, uio, ptr, (sfs)->sfs_blocksize, \
+	      ((off_t)(block))*(sfs)->sfs_blocksize, rw)
 
 /* Convenience functions for block I/O */
 int sfs_rwblock(struct sfs_fs *sfs, struct uio *uio);
 int sfs_rblock(struct sfs_fs *sfs, void *data, uint32_t block);
 int sfs_wblock(struct sfs_fs *sfs, void *data, uint32_t block);
 
+/*
+ * Same, but only the first SFS_BLOCKSIZE bytes of the block, which is
+ * where the superblock and inodes live.
+ */
+int sfs_rhead(struct sfs_fs *sfs, void *data, uint32_t block);
+int sfs_whead(struct sfs_fs *sfs, void *data, uint32_t block);
+int sfs_rwsector(struct sfs_fs *sfs, void *data, uint32_t block,
+		 unsigned sector, enum uio_rw rw);
+
 /* Get root vnode */
 struct vnode *sfs_getroot(struct fs *fs);
 
@@ -70,6 +70,11 @@ int sys_execv(userptr_t prog, userptr_t args);
 void sys__exit(int code);
 int sys_waitpid(pid_t pid, userptr_t returncode, int flags, pid_t *retval);
 int sys_getpid(pid_t *retval);
+int sys_getrlimit(int resource, userptr_t rlp);
+int sys_setrlimit(int resource, userptr_t rlp);
+int sys_getwsinfo(userptr_t info);
+int sys_getloadinfo(userptr_t info);
+int sys_madvise(userptr_t addr, size_t len, int advice);
 
 int sys_open(userptr_t filename, int flags, int mode, int *retval);
 int sys_dup2(int oldfd, int newfd, int *retval);
@@ -77,9 +82,21 @@ int sys_close(int fd);
 int sys_read(int fd, userptr_t buf, size_t size, int *retval);
 int sys_write(int fd, userptr_t buf, size_t size, int *retval);
 int sys_lseek(int fd, off_t offset, int code, off_t *retval);
+int sys_ioctl(int fd, int code, userptr_t data);
+int sys_fcntl(int fd, int op, int arg, int *retval);
 
 int sys_chdir(userptr_t path);
 int sys___getcwd(userptr_t buf, size_t buflen, int *retval);
 
+int sys_ioring_setup(userptr_t ring);
+int sys_ioring_enter(unsigned to_submit, unsigned min_complete, int *retval);
+
+int sys_aio_read(userptr_t cb);
+int sys_aio_write(userptr_t cb);
+int sys_aio_error(userptr_t cb, int *retval);
+int sys_aio_return(userptr_t cb, int *retval);
+int sys_aio_suspend(userptr_t list, int nent);
+int sys_aio_waitcomplete(userptr_t cbp, int flags, int *retval);
+
 
 #endif /* _SYSCALL_H_ */
@@ -49,6 +49,7 @@ int waittest(int, char **);
 /* lib tests */
 int arraytest(int, char **);
 int bitmaptest(int, char **);
+int hashtest(int, char **);
 int queuetest(int, char **);
 
 /* thread tests */
@@ -70,6 +71,11 @@ int printfile(int, char **);
 /* other tests */
 int malloctest(int, char **);
 int mallocstress(int, char **);
+int vmalloctest(int, char **);
+int rmaptest(int, char **);
+int pageoptest(int, char **);
+int tlbtest(int, char **);
+int kstattest(int, char **);
 int nettest(int, char **);
 
 /* Routine for running a user-level program. */
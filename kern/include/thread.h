@@ -40,7 +40,9 @@
 #include <threadlist.h>
 
 struct addrspace;
+struct aio_ctx;
 struct cpu;
+struct ioring_ctx;
 struct vnode;
 
 /* get machine-dependent defs */
@@ -114,6 +116,15 @@ struct thread {
 	/* VFS */
 	struct vnode *t_cwd;		/* current working directory */
 	struct filetable *t_filetable;	/* table of open files */
+	struct ioring_ctx *t_ioring;	/* submission ring, if any */
+	struct aio_ctx *t_aio;		/* asynchronous I/O, if any */
+
+	/* Scheduling latency; protected by the runqueue lock */
+	time_t t_readysecs;		/* when last made runnable */
+	uint32_t t_readynsecs;
+	unsigned t_nwaits;		/* times made runnable */
+	unsigned t_waitms;		/* total time spent runnable... */
+	unsigned t_waitus;		/* ...and the leftover microseconds */
 
 	/* add more here as needed */
 };
@@ -169,5 +180,21 @@ void schedule(void);
  */
 void thread_consider_migration(void);
 
+/*
+ * Scheduler load: the number of threads running or runnable, for the
+ * load averages; and the run-queue wait histogram summed over all
+ * CPUs, into an array of LATENCY_NBUCKETS.
+ */
+unsigned thread_nactive(void);
+void thread_getlatency(unsigned *hist);
+
+/*
+ * Number of CPUs in the system, and which others are idle (pageop.c);
+ * look one up by number.
+ */
+unsigned thread_numcpus(void);
+unsigned thread_idlecpus(struct cpu **cpus, unsigned max);
+struct cpu *thread_getcpu(unsigned num);
+
 
 #endif /* _THREAD_H_ */
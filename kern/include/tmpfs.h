@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _TMPFS_H_
+#define _TMPFS_H_
+
+
+/*
+ * Header for tmpfs, the in-memory filesystem.
+ *
+ * Everything lives in RAM: file data in whole pages taken from the
+ * frame table, directories in small per-directory hash tables. Nothing
+ * survives a reboot. Each instance has a cap on the number of data
+ * pages it may hold; writes past it fail with ENOSPC.
+ *
+ * Locking: the namespace (directory contents, link counts, and vnode
+ * reference counts) is protected by the vfs biglock, as elsewhere.
+ * File contents and sizes are protected by a per-file sleep lock, so
+ * reads and writes don't hold the biglock.
+ */
+
+#include <spinlock.h>
+#include <fs.h>
+#include <vnode.h>
+
+/* Object types */
+#define TMPFS_TYPE_FILE     1
+#define TMPFS_TYPE_DIR      2
+#define TMPFS_TYPE_SYMLINK  3
+
+/* Hash buckets per directory */
+#define TMPFS_NHASH         16
+
+/* Default size limit, in pages, for a new instance */
+#define TMPFS_DEFPAGES      256
+
+struct tmpfs_node;
+
+/* One name in a directory */
+struct tmpfs_dirent {
+	char *td_name;			/* name (kmalloc'd) */
+	struct tmpfs_node *td_node;	/* what it refers to */
+	struct tmpfs_dirent *td_next;	/* next in hash chain */
+};
+
+/*
+ * A file, directory, or symlink.
+ *
+ * A node stays in memory as long as it has a name or a vnode
+ * reference. When the last reference goes away but names remain,
+ * tmpfs_reclaim leaves the node in place with vn_refcount at 0; the
+ * next lookup picks it up again with VOP_INCREF.
+ */
+struct tmpfs_node {
+	struct vnode tn_v;		/* abstract vnode structure */
+	int tn_type;			/* TMPFS_TYPE_* */
+	unsigned tn_linkcount;		/* number of names */
+
+	/* regular files */
+	struct lock *tn_lock;		/* protects tn_size and tn_pages */
+	off_t tn_size;			/* size in bytes */
+	struct array *tn_pages;		/* kernel vaddr of each page, or 0 */
+	unsigned tn_npages;		/* number of pages allocated */
+
+	/* symlinks */
+	char *tn_target;		/* contents (kmalloc'd) */
+
+	/* directories */
+	struct tmpfs_node *tn_parent;	/* for ".." */
+	unsigned tn_nentries;		/* number of names in tn_hash */
+	struct tmpfs_dirent *tn_hash[TMPFS_NHASH];
+};
+
+struct tmpfs_fs {
+	struct fs tf_absfs;		/* abstract filesystem structure */
+	char *tf_name;			/* volume name */
+	struct tmpfs_node *tf_root;	/* root directory */
+	struct spinlock tf_lock;	/* protects tf_npages */
+	unsigned tf_npages;		/* data pages in use */
+	unsigned tf_maxpages;		/* limit on tf_npages */
+};
+
+/*
+ * Create a tmpfs instance named NAME holding at most MAXPAGES pages
+ * of file data, and make it accessible as "NAME:" (calls vfs_addfs).
+ */
+int tmpfs_create(const char *name, unsigned maxpages);
+
+
+/*
+ * Internal functions
+ */
+
+/* Create a new object with no names and one vnode reference */
+int tmpfs_makenode(struct tmpfs_fs *tf, int type, struct tmpfs_node **ret);
+
+/* Get root vnode */
+struct vnode *tmpfs_getroot(struct fs *fs);
+
+
+#endif /* _TMPFS_H_ */
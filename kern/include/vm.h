@@ -48,9 +48,24 @@
 
 #define KVADDR_TO_PADDR(vaddr) ((vaddr)-MIPS_KSEG0)
 
+struct addrspace;
+
+/*
+ * Reverse map entry: one place a user frame is mapped.
+ */
+struct rmap {
+	struct addrspace *rm_as;	// address space mapping the frame
+	vaddr_t rm_vaddr;		// user address it is mapped at
+	struct rmap *rm_next;		// next mapping of the same frame
+};
+
 struct frame_table_entry {
 	// address of next free frame
 	size_t          next_freeframe;
+	// address space charged for the frame; NULL for kernel frames
+	struct addrspace *owner;
+	// every mapping of the frame; NULL for kernel frames
+	struct rmap *rmap;
 };
 
 /* Initialization function */
@@ -59,11 +74,67 @@ void vm_bootstrap(void);
 /* Fault handling function called by trap code */
 int vm_fault(int faulttype, vaddr_t faultaddress);
 
+/*
+ * Map in a user page ahead of time, zeroing it as part of PB if given.
+ * The caller holds the address space's as_lock.
+ */
+struct pagebatch;
+int vm_prefault(struct addrspace *as, vaddr_t vaddr, struct pagebatch *pb);
+
 /* Allocate/free kernel heap pages (called by kmalloc/kfree) */
 void frametable_bootstrap(void);
 vaddr_t alloc_kpages(int npages);
 void free_kpages(vaddr_t addr);
 
+/*
+ * Allocate/free user pages, charged to an address space's RSS and
+ * tracked in the frame's reverse map. rmap_add records an extra
+ * mapping of an allocated page; free_upage removes one, and frees the
+ * frame with the last. rmap_walk visits each mapping of a frame.
+ */
+vaddr_t alloc_upage(struct addrspace *as, vaddr_t vaddr);
+void free_upage(struct addrspace *as, vaddr_t addr, vaddr_t vaddr);
+int rmap_add(vaddr_t addr, struct addrspace *as, vaddr_t vaddr);
+void rmap_walk(vaddr_t addr,
+	       void (*func)(struct addrspace *as, vaddr_t vaddr, void *data),
+	       void *data);
+
+/* Frame table figures for load control */
+unsigned long frametable_usable(void);
+bool frametable_low(void);
+unsigned long frametable_nfree(void);
+
+/* Free frames, for hibernation */
+struct bitmap;
+paddr_t frametable_getfree(struct bitmap *freemap);
+
+/*
+ * Working-set window tick, called from hardclock on one CPU; and the
+ * check for a new window, called from hardclock on every CPU.
+ */
+void vm_wstick(void);
+void vm_wscheck(void);
+
+/* Wait here if suspended for memory; called before returning to user mode */
+void vm_wswait(void);
+
+/* Working-set figures for getwsinfo() */
+struct wsinfo;
+int vm_getwsinfo(struct addrspace *as, struct wsinfo *wi);
+
+/* Drop this CPU's TLB entries for a range of pages */
+void vm_tlbinvalidate(vaddr_t vaddr, unsigned npages);
+
+/* Same, on every CPU running AS, waiting until it's done */
+void vm_tlbinvalidate_as(struct addrspace *as, vaddr_t vaddr, unsigned npages);
+
+/*
+ * Point this CPU's fast TLB refill at AS's page table (none if AS is
+ * NULL); stop every CPU using it before AS goes away.
+ */
+void vm_setpagetable(struct addrspace *as);
+void vm_droppagetable(struct addrspace *as);
+
 /* TLB shootdown handling called from interprocessor_interrupt */
 void vm_tlbshootdown_all(void);
 void vm_tlbshootdown(const struct tlbshootdown *);
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _VMALLOC_H_
+#define _VMALLOC_H_
+
+/*
+ * Kernel virtual memory allocator.
+ *
+ * kmalloc can't hand out more than a page at a time once the frame
+ * table is up, because it needs physically contiguous memory.
+ * vmalloc instead maps individual frames at consecutive addresses in
+ * KSEG2, which is TLB-mapped, so large buffers only need free pages,
+ * not free runs of pages. The mappings live in a flat kernel page
+ * table; vm_fault loads them into the TLB on demand via
+ * vmalloc_translate.
+ *
+ * vmalloc may sleep and must not be called from interrupt handlers.
+ * vmalloc'd memory is not zeroed.
+ *
+ * kvmalloc/kvfree use kmalloc for small sizes and vmalloc for large
+ * ones, for callers whose sizes vary. Under dumbvm there is no KSEG2
+ * mapping and they are just kmalloc/kfree.
+ */
+
+#include "opt-dumbvm.h"
+
+#define VMALLOC_BASE	MIPS_KSEG2	/* start of the vmalloc arena */
+#define VMALLOC_NPAGES	4096		/* size of the arena, in pages */
+
+#if OPT_DUMBVM
+
+#define kvmalloc(sz)	kmalloc(sz)
+#define kvfree(ptr)	kfree(ptr)
+
+#else
+
+void vmalloc_bootstrap(void);
+
+void *vmalloc(size_t size);
+void vfree(void *ptr);
+
+/* Look up the frame mapped at VADDR, for the fault handler. */
+int vmalloc_translate(vaddr_t vaddr, paddr_t *paddr);
+
+void *kvmalloc(size_t size);
+void kvfree(void *ptr);
+
+#endif /* OPT_DUMBVM */
+
+#endif /* _VMALLOC_H_ */
@@ -31,6 +31,7 @@
 #define _VNODE_H_
 
 
+struct fs;
 struct uio;
 struct stat;
 
@@ -50,6 +51,12 @@ struct stat;
  * vn_opencount is managed using VOP_INCOPEN and VOP_DECOPEN by
  * vfs_open() and vfs_close(). Code above the VFS layer should not
  * need to worry about it.
+ *
+ * vn_execinfo is the file's parsed executable headers, kept by
+ * load_elf so repeated execs needn't reread them. It's dropped
+ * whenever the file is written or truncated; see vnode_getexec.
+ * The last few files with headers cached stay referenced, so the
+ * vnode isn't reclaimed (and the headers lost) between runs.
  */
 struct vnode {
 	int vn_refcount;                /* Reference count */
@@ -60,6 +67,9 @@ struct vnode {
 	void *vn_data;                  /* Filesystem-specific data */
 
 	const struct vnode_ops *vn_ops; /* Functions on this vnode */
+
+	void *vn_execinfo;              /* Cached by load_elf, or NULL */
+	unsigned vn_modcount;           /* Writes and truncates so far */
 };
 
 /*
@@ -248,14 +258,14 @@ struct vnode_ops {
 #define VOP_READ(vn, uio)               (__VOP(vn, read)(vn, uio))
 #define VOP_READLINK(vn, uio)           (__VOP(vn, readlink)(vn, uio))
 #define VOP_GETDIRENTRY(vn, uio)        (__VOP(vn,getdirentry)(vn, uio))
-#define VOP_WRITE(vn, uio)              (__VOP(vn, write)(vn, uio))
+#define VOP_WRITE(vn, uio)              vnode_write(vn, uio)
 #define VOP_IOCTL(vn, code, buf)        (__VOP(vn, ioctl)(vn,code,buf))
 #define VOP_STAT(vn, ptr) 	        (__VOP(vn, stat)(vn, ptr))
 #define VOP_GETTYPE(vn, result)         (__VOP(vn, gettype)(vn, result))
 #define VOP_TRYSEEK(vn, pos)            (__VOP(vn, tryseek)(vn, pos))
 #define VOP_FSYNC(vn)                   (__VOP(vn, fsync)(vn))
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
-#define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
+#define VOP_TRUNCATE(vn, pos)           vnode_truncate(vn, pos)
 #define VOP_NAMEFILE(vn, uio)           (__VOP(vn, namefile)(vn, uio))
 
 #define VOP_CREAT(vn,nm,excl,mode,res)  (__VOP(vn, creat)(vn,nm,excl,mode,res))
@@ -274,6 +284,32 @@ struct vnode_ops {
  */
 void vnode_check(struct vnode *, const char *op);
 
+/*
+ * Write and truncate, which also drop vn_execinfo (after the
+ * operation, so a load_elf racing with it can't keep stale headers).
+ * Invoked by VOP_WRITE and VOP_TRUNCATE.
+ */
+int vnode_write(struct vnode *, struct uio *);
+int vnode_truncate(struct vnode *, off_t pos);
+
+/*
+ * Cached executable headers.
+ *
+ *    vnode_getexec - copy the cached headers, LEN bytes, into BUF and
+ *                    return 0; or if there are none, return ENOENT
+ *                    with *MODCOUNT set to pass to vnode_setexec.
+ *    vnode_setexec - cache INFO (from kmalloc; this takes it over)
+ *                    unless the file has been modified since MODCOUNT
+ *                    was handed out, in which case INFO is freed.
+ *    vnode_dropexec - release the files on FS (all files, if FS is
+ *                    NULL) that are kept referenced for their cached
+ *                    headers. For unmounting.
+ */
+int vnode_getexec(struct vnode *, void *buf, size_t len,
+		  unsigned *modcount);
+void vnode_setexec(struct vnode *, void *info, unsigned modcount);
+void vnode_dropexec(struct fs *fs);
+
 /*
  * Reference count manipulation (handled above filesystem level)
  */
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _WORKINGSET_H_
+#define _WORKINGSET_H_
+
+/*
+ * Working-set estimation and load control (kern/vm/workingset.c).
+ *
+ *    ws_init    - set up the working-set fields of a new address space.
+ *    ws_fault   - account a page fault by AS, taking a new sample if a
+ *                 window has gone by since the last one.
+ *    ws_current - true if AS has been sampled in the current window.
+ *    ws_admit   - called before giving AS a new page; may suspend the
+ *                 process while memory is overcommitted. Never sleeps;
+ *                 the process waits in vm_wswait (see vm.h).
+ *    ws_destroy - drop AS's working set from the system total.
+ */
+
+struct addrspace;
+
+void ws_init(struct addrspace *as);
+void ws_fault(struct addrspace *as);
+bool ws_current(struct addrspace *as);
+void ws_admit(struct addrspace *as);
+void ws_destroy(struct addrspace *as);
+
+#endif /* _WORKINGSET_H_ */
@@ -34,6 +34,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <vmalloc.h>
 #include <bitmap.h>
 
 /*
@@ -64,7 +65,8 @@ bitmap_create(unsigned nbits)
         if (b == NULL) {
                 return NULL;
         }
-        b->v = kmalloc(words*sizeof(WORD_TYPE));
+        /* big bitmaps (e.g. SFS freemaps) won't fit in one page */
+        b->v = kvmalloc(words*sizeof(WORD_TYPE));
         if (b->v == NULL) {
                 kfree(b);
                 return NULL;
@@ -171,6 +173,6 @@ bitmap_isset(struct bitmap *b, unsigned index)
 void
 bitmap_destroy(struct bitmap *b)
 {
-        kfree(b->v);
+        kvfree(b->v);
         kfree(b);
 }
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Intrusive hash table. See <hash.h> for the interface and the
+ * resizing and locking rules.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <vm.h>
+#include <hash.h>
+
+/* The bucket array must fit in one kmalloc block; see <hash.h>. */
+#define HASH_MAXBUCKETS (PAGE_SIZE / sizeof(struct hashlink *))
+
+/*
+ * With HASH_LOCKED, ht_locks[0..HASH_NLOCKS-1] cover buckets by index
+ * mod HASH_NLOCKS. ht_locks[HASH_NLOCKS] (the "meta" lock) covers
+ * ht_count, ht_migrate and ht_moved. The bucket arrays themselves
+ * (ht_buckets, ht_old and their sizes) only change with every lock
+ * held, so holding any one of them is enough to look at them. Lock
+ * order is by index.
+ */
+#define METALOCK HASH_NLOCKS
+
+static
+void
+hash_lock(struct hashtable *ht, unsigned which)
+{
+	if (ht->ht_locks != NULL) {
+		spinlock_acquire(&ht->ht_locks[which]);
+	}
+}
+
+static
+void
+hash_unlock(struct hashtable *ht, unsigned which)
+{
+	if (ht->ht_locks != NULL) {
+		spinlock_release(&ht->ht_locks[which]);
+	}
+}
+
+static
+void
+hash_lockall(struct hashtable *ht)
+{
+	unsigned i;
+
+	for (i=0; i<=METALOCK; i++) {
+		hash_lock(ht, i);
+	}
+}
+
+static
+void
+hash_unlockall(struct hashtable *ht)
+{
+	unsigned i;
+
+	for (i=METALOCK+1; i-- > 0; ) {
+		hash_unlock(ht, i);
+	}
+}
+
+/* The lock covering hash value (or bucket number) H */
+#define KEYLOCK(h) ((h) % HASH_NLOCKS)
+
+static
+struct hashlink **
+hash_newbuckets(unsigned n)
+{
+	struct hashlink **b;
+	unsigned i;
+
+	b = kmalloc(n * sizeof(*b));
+	if (b == NULL) {
+		return NULL;
+	}
+	for (i=0; i<n; i++) {
+		b[i] = NULL;
+	}
+	return b;
+}
+
+int
+hashtable_init(struct hashtable *ht, unsigned minbuckets, int flags)
+{
+	unsigned n, i;
+
+	if (minbuckets == 0) {
+		minbuckets = HASH_DEFBUCKETS;
+	}
+	if ((flags & HASH_LOCKED) && minbuckets < HASH_NLOCKS) {
+		/* Keeps each key under one lock; see <hash.h> */
+		minbuckets = HASH_NLOCKS;
+	}
+	if (minbuckets > HASH_MAXBUCKETS) {
+		minbuckets = HASH_MAXBUCKETS;
+	}
+	for (n = 1; n < minbuckets; n *= 2) {
+		/* nothing */
+	}
+
+	ht->ht_buckets = hash_newbuckets(n);
+	if (ht->ht_buckets == NULL) {
+		return ENOMEM;
+	}
+	ht->ht_nbuckets = n;
+	ht->ht_old = NULL;
+	ht->ht_nold = 0;
+	ht->ht_migrate = 0;
+	ht->ht_moved = 0;
+	ht->ht_minbuckets = n;
+	ht->ht_count = 0;
+	ht->ht_locks = NULL;
+
+	if (flags & HASH_LOCKED) {
+		ht->ht_locks = kmalloc((METALOCK+1) * sizeof(struct spinlock));
+		if (ht->ht_locks == NULL) {
+			kfree(ht->ht_buckets);
+			return ENOMEM;
+		}
+		for (i=0; i<=METALOCK; i++) {
+			spinlock_init(&ht->ht_locks[i]);
+		}
+	}
+	return 0;
+}
+
+void
+hashtable_cleanup(struct hashtable *ht)
+{
+	unsigned i;
+
+	KASSERT(ht->ht_count == 0);
+
+	kfree(ht->ht_buckets);
+	kfree(ht->ht_old);
+	if (ht->ht_locks != NULL) {
+		for (i=0; i<=METALOCK; i++) {
+			spinlock_cleanup(&ht->ht_locks[i]);
+		}
+		kfree(ht->ht_locks);
+	}
+	ht->ht_buckets = ht->ht_old = NULL;
+	ht->ht_locks = NULL;
+}
+
+unsigned
+hashtable_num(const struct hashtable *ht)
+{
+	return ht->ht_count;
+}
+
+/*
+ * Move up to HASH_MIGRATESTEP buckets from ht_old to ht_buckets, and
+ * free ht_old once it's empty.
+ *
+ * All the keys in old bucket I have the same hash mod ht_nold, so the
+ * same hash mod HASH_NLOCKS, and they land in new buckets covered by
+ * the same lock. So lock I is all we need to move them.
+ */
+static
+void
+hash_migrate(struct hashtable *ht)
+{
+	struct hashlink *hl, *next, **old;
+	unsigned step, i, b;
+	bool done;
+
+	for (step=0; step<HASH_MIGRATESTEP; step++) {
+		hash_lock(ht, METALOCK);
+		if (ht->ht_old == NULL || ht->ht_migrate == ht->ht_nold) {
+			hash_unlock(ht, METALOCK);
+			return;
+		}
+		i = ht->ht_migrate++;
+		hash_unlock(ht, METALOCK);
+
+		hash_lock(ht, KEYLOCK(i));
+		for (hl = ht->ht_old[i]; hl != NULL; hl = next) {
+			next = hl->hl_next;
+			b = hl->hl_hash & (ht->ht_nbuckets - 1);
+			hl->hl_next = ht->ht_buckets[b];
+			ht->ht_buckets[b] = hl;
+		}
+		ht->ht_old[i] = NULL;
+		hash_unlock(ht, KEYLOCK(i));
+
+		hash_lock(ht, METALOCK);
+		done = (++ht->ht_moved == ht->ht_nold);
+		hash_unlock(ht, METALOCK);
+
+		if (done) {
+			hash_lockall(ht);
+			old = ht->ht_old;
+			ht->ht_old = NULL;
+			ht->ht_nold = 0;
+			hash_unlockall(ht);
+			kfree(old);
+			return;
+		}
+	}
+}
+
+/*
+ * Do resizing work: advance a resize in progress, or start one if the
+ * load factor is out of range. If we can't get memory for the new
+ * bucket array, just carry on with the old one.
+ */
+static
+void
+hash_resize(struct hashtable *ht)
+{
+	struct hashlink **nb;
+	unsigned n, newn, count;
+
+	if (ht->ht_old != NULL) {
+		hash_migrate(ht);
+		return;
+	}
+
+	/* Unlocked reads; rechecked below before committing */
+	n = ht->ht_nbuckets;
+	count = ht->ht_count;
+	if (count > n * HASH_MAXLOAD && n < HASH_MAXBUCKETS) {
+		newn = n * 2;
+	}
+	else if (count < n / HASH_MINLOAD && n > ht->ht_minbuckets) {
+		newn = n / 2;
+	}
+	else {
+		return;
+	}
+
+	nb = hash_newbuckets(newn);
+	if (nb == NULL) {
+		return;
+	}
+
+	hash_lockall(ht);
+	if (ht->ht_old != NULL || ht->ht_nbuckets != n) {
+		/* Somebody else already did it */
+		hash_unlockall(ht);
+		kfree(nb);
+		return;
+	}
+	ht->ht_old = ht->ht_buckets;
+	ht->ht_nold = n;
+	ht->ht_buckets = nb;
+	ht->ht_nbuckets = newn;
+	ht->ht_migrate = 0;
+	ht->ht_moved = 0;
+	hash_unlockall(ht);
+
+	hash_migrate(ht);
+}
+
+void
+hashtable_insert(struct hashtable *ht, struct hashlink *hl, uint32_t hash)
+{
+	unsigned b;
+
+	hl->hl_hash = hash;
+
+	hash_lock(ht, KEYLOCK(hash));
+	b = hash & (ht->ht_nbuckets - 1);
+	hl->hl_next = ht->ht_buckets[b];
+	ht->ht_buckets[b] = hl;
+	hash_lock(ht, METALOCK);
+	ht->ht_count++;
+	hash_unlock(ht, METALOCK);
+	hash_unlock(ht, KEYLOCK(hash));
+
+	hash_resize(ht);
+}
+
+/*
+ * Unlink HL from the chain at *PP. Returns true if it was there.
+ */
+static
+bool
+hash_unlink(struct hashlink **pp, struct hashlink *hl)
+{
+	for (; *pp != NULL; pp = &(*pp)->hl_next) {
+		if (*pp == hl) {
+			*pp = hl->hl_next;
+			hl->hl_next = NULL;
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+hashtable_remove(struct hashtable *ht, struct hashlink *hl)
+{
+	uint32_t hash = hl->hl_hash;
+	bool found;
+
+	hash_lock(ht, KEYLOCK(hash));
+	found = hash_unlink(&ht->ht_buckets[hash & (ht->ht_nbuckets - 1)], hl);
+	if (!found && ht->ht_old != NULL) {
+		found = hash_unlink(&ht->ht_old[hash & (ht->ht_nold - 1)], hl);
+	}
+	KASSERT(found);
+	hash_lock(ht, METALOCK);
+	KASSERT(ht->ht_count > 0);
+	ht->ht_count--;
+	hash_unlock(ht, METALOCK);
+	hash_unlock(ht, KEYLOCK(hash));
+}
+
+struct hashlink *
+hashtable_lookup(struct hashtable *ht, uint32_t hash,
+		 bool (*match)(const struct hashlink *, const void *),
+		 const void *key)
+{
+	struct hashlink *hl;
+
+	hash_lock(ht, KEYLOCK(hash));
+	for (hl = ht->ht_buckets[hash & (ht->ht_nbuckets - 1)];
+	     hl != NULL; hl = hl->hl_next) {
+		if (hl->hl_hash == hash && match(hl, key)) {
+			goto out;
+		}
+	}
+	if (ht->ht_old != NULL) {
+		for (hl = ht->ht_old[hash & (ht->ht_nold - 1)];
+		     hl != NULL; hl = hl->hl_next) {
+			if (hl->hl_hash == hash && match(hl, key)) {
+				goto out;
+			}
+		}
+	}
+ out:
+	hash_unlock(ht, KEYLOCK(hash));
+	return hl;
+}
+
+void
+hashtable_iterinit(struct hashtable *ht, struct hashiter *hi)
+{
+	(void)ht;
+	hi->hi_table = 0;
+	hi->hi_bucket = 0;
+	hi->hi_next = NULL;
+}
+
+struct hashlink *
+hashtable_iternext(struct hashtable *ht, struct hashiter *hi)
+{
+	struct hashlink *hl, **table;
+	unsigned n;
+
+	hl = hi->hi_next;
+	while (hl == NULL) {
+		if (hi->hi_table == 0) {
+			table = ht->ht_old;
+			n = ht->ht_nold;
+		}
+		else {
+			table = ht->ht_buckets;
+			n = ht->ht_nbuckets;
+		}
+		if (table == NULL || hi->hi_bucket >= n) {
+			if (hi->hi_table == 0) {
+				hi->hi_table = 1;
+				hi->hi_bucket = 0;
+				continue;
+			}
+			return NULL;
+		}
+		hl = table[hi->hi_bucket++];
+	}
+	hi->hi_next = hl->hl_next;
+	return hl;
+}
+
+////////////////////////////////////////////////////////////
+
+/*
+ * The bucket is picked from the low bits of the hash, so integer keys
+ * need mixing first (pids and inode numbers are mostly sequential
+ * and would otherwise fill buckets in stripes). This is the murmur3
+ * finalizer.
+ */
+uint32_t
+hash_u32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/* FNV-1a */
+uint32_t
+hash_string(const char *str)
+{
+	uint32_t h = 2166136261U;
+
+	while (*str) {
+		h ^= (unsigned char)*str++;
+		h *= 16777619U;
+	}
+	return h;
+}
@@ -35,6 +35,9 @@
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <wchan.h>
+#include <cpu.h>
+#include <dmesg.h>
 #include <mainbus.h>
 #include <vfs.h>          // for vfs_sync()
 
@@ -48,6 +51,29 @@ static struct lock *kprintf_lock;
 /* Lock for polled kprintfs */
 static struct spinlock kprintf_spinlock;
 
+/* All the CPUs' message rings; see dmesg.h */
+static struct dmesg *dmesg_rings;
+
+/* Where the drain thread waits for output */
+static struct wchan *dmesg_wchan;
+
+/* True while kprintf buffers its output */
+static volatile bool dmesg_on;
+
+/*
+ * The CPU reading the rings, if any. Normally everyone who drains
+ * holds kprintf_lock anyway, but dmesg_flush may not be able to take
+ * it, and each ring must only ever have one reader.
+ */
+static struct cpu *dmesg_drainer;
+static struct spinlock dmesg_spinlock;	/* protects dmesg_drainer */
+
+/* Set by dmesg_flush to make the drainer stop and let it take over */
+static volatile bool dmesg_handover;
+
+/* How long dmesg_flush waits for the drainer to stop */
+#define DMESG_HANDOVER_SPINS	1000000
+
 
 /*
  * Warning: all this has to work from interrupt handlers and when
@@ -69,6 +95,7 @@ kprintf_bootstrap(void)
 		panic("Could not create kprintf_lock\n");
 	}
 	spinlock_init(&kprintf_spinlock);
+	spinlock_init(&dmesg_spinlock);
 }
 
 /*
@@ -88,12 +115,246 @@ console_send(void *junk, const char *data, size_t len)
 }
 
 /*
- * Printf to the console.
+ * Set up the message ring for a new CPU. cpu_create calls this at
+ * boot, for one CPU at a time, so the list needs no lock.
+ */
+void
+dmesg_init(struct dmesg *dm)
+{
+	dm->dm_head = 0;
+	dm->dm_tail = 0;
+	dm->dm_lost = 0;
+	dm->dm_lostseen = 0;
+	dm->dm_next = dmesg_rings;
+	dmesg_rings = dm;
+}
+
+/*
+ * Append characters to a CPU's ring. Backend for __printf. Called
+ * on that CPU with interrupts off, so nothing else is writing.
+ */
+static
+void
+dmesg_send(void *vdm, const char *data, size_t len)
+{
+	struct dmesg *dm = vdm;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		if (dm->dm_head - dm->dm_tail == DMESG_SIZE) {
+			dm->dm_lost++;
+			continue;
+		}
+		dm->dm_buf[dm->dm_head % DMESG_SIZE] = data[i];
+		dm->dm_head++;
+	}
+}
+
+/*
+ * Become the one reader of the rings, if nobody else is.
+ */
+static
+bool
+dmesg_claim(void)
+{
+	bool ret;
+
+	spinlock_acquire(&dmesg_spinlock);
+	ret = dmesg_drainer == NULL;
+	if (ret) {
+		dmesg_drainer = curcpu->c_self;
+	}
+	spinlock_release(&dmesg_spinlock);
+	return ret;
+}
+
+static
+void
+dmesg_unclaim(void)
+{
+	spinlock_acquire(&dmesg_spinlock);
+	KASSERT(dmesg_drainer == curcpu->c_self);
+	dmesg_drainer = NULL;
+	spinlock_release(&dmesg_spinlock);
+}
+
+/*
+ * Print everything in the rings, and report anything lost; or stop
+ * early if dmesg_flush wants to take over. Call after dmesg_claim,
+ * with kprintf_lock or kprintf_spinlock held, between putch_prepare
+ * and putch_complete.
+ */
+static
+void
+dmesg_print(void)
+{
+	struct dmesg *dm;
+	unsigned lost;
+	char msg[64];
+
+	for (dm = dmesg_rings; dm != NULL; dm = dm->dm_next) {
+		while (dm->dm_tail != dm->dm_head) {
+			if (dmesg_handover) {
+				return;
+			}
+			putch(dm->dm_buf[dm->dm_tail % DMESG_SIZE]);
+			dm->dm_tail++;
+		}
+		lost = dm->dm_lost;
+		if (lost != dm->dm_lostseen) {
+			snprintf(msg, sizeof(msg),
+				 "[%u characters of kernel messages lost]\n",
+				 lost - dm->dm_lostseen);
+			dm->dm_lostseen = lost;
+			console_send(NULL, msg, strlen(msg));
+		}
+	}
+}
+
+/*
+ * Print what's in the rings, unless dmesg_flush is doing it. Call
+ * with kprintf_lock held, between putch_prepare and putch_complete.
+ */
+static
+void
+dmesg_drain(void)
+{
+	if (dmesg_claim()) {
+		dmesg_print();
+		dmesg_unclaim();
+	}
+}
+
+/*
+ * The drain thread. Sleeps until hardclock sees there's something to
+ * print, then prints it.
+ */
+static
+void
+dmesg_thread(void *junk1, unsigned long junk2)
+{
+	(void)junk1;
+	(void)junk2;
+
+	while (1) {
+		wchan_lock(dmesg_wchan);
+		wchan_sleep(dmesg_wchan);
+
+		lock_acquire(kprintf_lock);
+		putch_prepare();
+		dmesg_drain();
+		putch_complete();
+		lock_release(kprintf_lock);
+	}
+}
+
+/*
+ * Start the drain thread, and start buffering. Call after
+ * kprintf_bootstrap.
+ */
+void
+dmesg_bootstrap(void)
+{
+	int result;
+
+	KASSERT(kprintf_lock != NULL);
+
+	dmesg_wchan = wchan_create("dmesg");
+	if (dmesg_wchan == NULL) {
+		panic("Could not create dmesg wchan\n");
+	}
+	result = thread_fork("dmesg", dmesg_thread, NULL, 0, NULL);
+	if (result) {
+		panic("dmesg: thread_fork: %s\n", strerror(result));
+	}
+	dmesg_on = true;
+}
+
+/*
+ * Called from hardclock, on one CPU. Wake the drain thread if any
+ * ring has something in it.
+ */
+void
+dmesg_tick(void)
+{
+	struct dmesg *dm;
+
+	if (!dmesg_on) {
+		return;
+	}
+	for (dm = dmesg_rings; dm != NULL; dm = dm->dm_next) {
+		if (dm->dm_head != dm->dm_tail ||
+		    dm->dm_lost != dm->dm_lostseen) {
+			wchan_wakeone(dmesg_wchan);
+			return;
+		}
+	}
+}
+
+/*
+ * Print whatever is buffered and stop buffering, so that from now on
+ * kprintf output goes straight to the console. For panic and
+ * shutdown, when the drain thread may never run again.
+ */
+void
+dmesg_flush(void)
+{
+	bool dolock, claimed;
+	unsigned i;
+
+	if (!dmesg_on) {
+		return;
+	}
+	dmesg_on = false;
+
+	dolock = curthread->t_in_interrupt == false
+		&& curthread->t_iplhigh_count == 0;
+
+	if (dolock) {
+		lock_acquire(kprintf_lock);
+	}
+	else {
+		spinlock_acquire(&kprintf_spinlock);
+	}
+
+	/*
+	 * Without kprintf_lock the drain thread may be in the middle of
+	 * the rings. Ask it to stop and wait for it, unless it's this
+	 * CPU we've interrupted, or it doesn't stop because panic has
+	 * halted its CPU; either way, leave the rings to it.
+	 */
+	dmesg_handover = true;
+	for (i=0; !(claimed = dmesg_claim()); i++) {
+		if (dmesg_drainer == curcpu->c_self ||
+		    i == DMESG_HANDOVER_SPINS) {
+			break;
+		}
+	}
+	dmesg_handover = false;
+
+	putch_prepare();
+	if (claimed) {
+		dmesg_print();
+		dmesg_unclaim();
+	}
+	putch_complete();
+	if (dolock) {
+		lock_release(kprintf_lock);
+	}
+	else {
+		spinlock_release(&kprintf_spinlock);
+	}
+}
+
+/*
+ * Printf to the console: to this CPU's ring, once the drain thread
+ * is running, or else directly.
  */
 int
 kprintf(const char *fmt, ...)
 {
-	int chars;
+	struct dmesg *dm;
+	int chars, spl;
 	va_list ap;
 	bool dolock;
 
@@ -101,6 +362,27 @@ kprintf(const char *fmt, ...)
 		&& curthread->t_in_interrupt == false
 		&& curthread->t_iplhigh_count == 0;
 
+	if (dmesg_on) {
+		dm = &curcpu->c_dmesg;
+		if (dolock && dm->dm_head - dm->dm_tail > DMESG_SIZE / 2) {
+			/* getting full; make room rather than lose output */
+			lock_acquire(kprintf_lock);
+			putch_prepare();
+			dmesg_drain();
+			putch_complete();
+			lock_release(kprintf_lock);
+		}
+
+		/* with interrupts off we stay on this CPU */
+		spl = splhigh();
+		va_start(ap, fmt);
+		chars = __vprintf(dmesg_send, &curcpu->c_dmesg, fmt, ap);
+		va_end(ap);
+		splx(spl);
+
+		return chars;
+	}
+
 	if (dolock) {
 		lock_acquire(kprintf_lock);
 	}
@@ -169,7 +451,8 @@ panic(const char *fmt, ...)
 	if (evil == 2) {
 		evil = 3;
 
-		/* Print the message. */
+		/* Print what was buffered, then the message. */
+		dmesg_flush();
 		kprintf("panic: ");
 		putch_prepare();
 		va_start(ap, fmt);
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Kernel statistics counters. See kstat.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+#include <kstat.h>
+
+/* Registered kstats, oldest first; protected by kstat_lock */
+static struct kstat *kstat_head, *kstat_tail;
+static struct spinlock kstat_lock = SPINLOCK_INITIALIZER;
+
+void
+kstat_register(struct kstat *ks)
+{
+	KASSERT(ks->ks_next == NULL);
+
+	spinlock_acquire(&kstat_lock);
+	KASSERT(ks != kstat_tail);
+	if (kstat_tail == NULL) {
+		kstat_head = ks;
+	}
+	else {
+		kstat_tail->ks_next = ks;
+	}
+	kstat_tail = ks;
+	spinlock_release(&kstat_lock);
+}
+
+void
+kstat_add(struct kstat *ks, unsigned long n)
+{
+	int spl;
+
+	/* with interrupts off we stay on this CPU */
+	spl = splhigh();
+	ks->ks_count[curcpu->c_number % KSTAT_MAXCPUS] += n;
+	splx(spl);
+}
+
+void
+kstat_inc(struct kstat *ks)
+{
+	kstat_add(ks, 1);
+}
+
+/*
+ * Add up the per-CPU counts. The total may be a little behind if
+ * other CPUs are counting at the same time.
+ */
+unsigned long
+kstat_value(struct kstat *ks)
+{
+	unsigned long total;
+	unsigned i;
+
+	if (ks->ks_read != NULL) {
+		return ks->ks_read();
+	}
+
+	total = 0;
+	for (i=0; i<KSTAT_MAXCPUS; i++) {
+		total += ks->ks_count[i];
+	}
+	return total;
+}
+
+struct kstat *
+kstat_find(const char *name)
+{
+	struct kstat *ks;
+
+	spinlock_acquire(&kstat_lock);
+	for (ks = kstat_head; ks != NULL; ks = ks->ks_next) {
+		if (!strcmp(ks->ks_name, name)) {
+			break;
+		}
+	}
+	spinlock_release(&kstat_lock);
+	return ks;
+}
+
+struct kstat *
+kstat_get(unsigned index)
+{
+	struct kstat *ks;
+
+	spinlock_acquire(&kstat_lock);
+	for (ks = kstat_head; ks != NULL && index > 0; ks = ks->ks_next) {
+		index--;
+	}
+	spinlock_release(&kstat_lock);
+	return ks;
+}
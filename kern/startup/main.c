@@ -40,6 +40,7 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <cpu.h>
 #include <synch.h>
 #include <vm.h>
 #include <mainbus.h>
@@ -47,6 +48,9 @@
 #include <device.h>
 #include <pid.h>
 #include <syscall.h>
+#include <iowork.h>
+#include <dmesg.h>
+#include <hibernate.h>
 #include <test.h>
 #include <version.h>
 #include "autoconf.h"  // for pseudoconfig
@@ -110,6 +114,7 @@ boot(void)
 	thread_bootstrap();
 	pid_bootstrap();
 	hardclock_bootstrap();
+	trap_bootstrap();
 	vfs_bootstrap();
 
 	/* Probe and initialize devices. Interrupts should come on. */
@@ -121,10 +126,15 @@ boot(void)
 	pseudoconfig();
 	kprintf("\n");
 
+	/* If we hibernated, this picks up where we left off instead. */
+	hibernate_resume();
+
 	/* Late phase of initialization. */
 	vm_bootstrap();
 	kprintf_bootstrap();
+	dmesg_bootstrap();
 	execv_bootstrap();
+	iowork_bootstrap();
 	thread_start_cpus();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
@@ -145,6 +155,8 @@ static
 void
 shutdown(void)
 {
+	/* Get buffered messages out; print directly from now on. */
+	dmesg_flush();
 
 	kprintf("Shutting down.\n");
 	
@@ -174,6 +186,9 @@ sys_reboot(int code)
 	    case RB_HALT:
 	    case RB_POWEROFF:
 		break;
+	    case RB_HIBERNATE:
+		/* Comes back here, with everything as it was, on resume */
+		return hibernate();
 	    default:
 		return EINVAL;
 	}
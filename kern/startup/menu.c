@@ -39,12 +39,17 @@
 #include <thread.h>
 #include <vfs.h>
 #include <sfs.h>
+#include <raid0.h>
+#include <tmpfs.h>
 #include <pid.h>
 #include <syscall.h>
 #include <test.h>
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
 #include "opt-net.h"
+#include "opt-raid0.h"
+#include "opt-tmpfs.h"
+#include "opt-dumbvm.h"
 
 /*
  * In-kernel menu and command dispatcher.
@@ -266,6 +271,19 @@ cmd_panic(int nargs, char **args)
 	return 0;
 }
 
+/*
+ * Command for hibernating. Returns once we've been resumed.
+ */
+static
+int
+cmd_hibernate(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	return sys_reboot(RB_HIBERNATE);
+}
+
 /*
  * Command for shutting down.
  */
@@ -348,6 +366,54 @@ cmd_unmount(int nargs, char **args)
 	return vfs_unmount(device);
 }
 
+#if OPT_TMPFS
+/*
+ * Command for creating an in-memory filesystem.
+ */
+static
+int
+cmd_tmpfs(int nargs, char **args)
+{
+	unsigned maxpages = TMPFS_DEFPAGES;
+
+	if (nargs != 2 && nargs != 3) {
+		kprintf("Usage: tmpfs name [maxpages]\n");
+		return EINVAL;
+	}
+
+	if (nargs == 3) {
+		maxpages = atoi(args[2]);
+	}
+
+	return tmpfs_create(args[1], maxpages);
+}
+#endif
+
+#if OPT_RAID0
+/*
+ * Command for creating a striped device out of several disks.
+ */
+static
+int
+cmd_raid0(int nargs, char **args)
+{
+	unsigned chunk;
+
+	if (nargs < 5) {
+		kprintf("Usage: raid0 name chunksectors disk1raw: "
+			"disk2raw: ...\n");
+		return EINVAL;
+	}
+
+	chunk = atoi(args[2]);
+	if (chunk == 0) {
+		chunk = RAID0_DEFCHUNK;
+	}
+
+	return raid0_create(args[1], chunk, nargs - 3, &args[3]);
+}
+#endif
+
 /*
  * Command to set the "boot fs". 
  *
@@ -423,12 +489,19 @@ static const char *opsmenu[] = {
 	"[p]       Other program             ",
 	"[mount]   Mount a filesystem        ",
 	"[unmount] Unmount a filesystem      ",
+#if OPT_TMPFS
+	"[tmpfs]   Create a memory filesystem",
+#endif
+#if OPT_RAID0
+	"[raid0]   Create a striped device   ",
+#endif
 	"[bootfs]  Set \"boot\" filesystem     ",
 	"[pf]      Print a file              ",
 	"[cd]      Change directory          ",
 	"[pwd]     Print current directory   ",
 	"[sync]    Sync filesystems          ",
 	"[panic]   Intentional panic         ",
+	"[hib]     Hibernate to disk         ",
 	"[q]       Quit and shut down        ",
 	NULL
 };
@@ -447,8 +520,16 @@ cmd_opsmenu(int n, char **a)
 static const char *testmenu[] = {
 	"[at]  Array test                    ",
 	"[bt]  Bitmap test                   ",
+	"[ht]  Hash table test               ",
 	"[km1] Kernel malloc test            ",
 	"[km2] kmalloc stress test           ",
+	"[kst] Kernel statistics test        ",
+#if !OPT_DUMBVM
+	"[vm1] vmalloc test                  ",
+	"[vm2] Frame reverse map test        ",
+	"[vm3] Page copy/zero offload test   ",
+	"[vm4] TLB update test               ",
+#endif
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
@@ -530,12 +611,20 @@ static struct {
 	{ "p",		cmd_prog },
 	{ "mount",	cmd_mount },
 	{ "unmount",	cmd_unmount },
+#if OPT_TMPFS
+	{ "tmpfs",	cmd_tmpfs },
+#endif
+#if OPT_RAID0
+	{ "raid0",	cmd_raid0 },
+#endif
 	{ "bootfs",	cmd_bootfs },
 	{ "pf",		printfile },
 	{ "cd",		cmd_chdir },
 	{ "pwd",	cmd_pwd },
 	{ "sync",	cmd_sync },
 	{ "panic",	cmd_panic },
+	{ "hib",	cmd_hibernate },
+	{ "hibernate",	cmd_hibernate },
 	{ "q",		cmd_quit },
 	{ "exit",	cmd_quit },
 	{ "halt",	cmd_quit },
@@ -555,8 +644,16 @@ static struct {
 	/* base system tests */
 	{ "at",		arraytest },
 	{ "bt",		bitmaptest },
+	{ "ht",		hashtest },
 	{ "km1",	malloctest },
 	{ "km2",	mallocstress },
+	{ "kst",	kstattest },
+#if !OPT_DUMBVM
+	{ "vm1",	vmalloctest },
+	{ "vm2",	rmaptest },
+	{ "vm3",	pageoptest },
+	{ "vm4",	tlbtest },
+#endif
 #if OPT_NET
 	{ "net",	nettest },
 #endif
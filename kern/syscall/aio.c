@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Asynchronous I/O: aio_read, aio_write, and friends.
+ *
+ * Requests are carried out by the I/O worker threads (iowork.c). Each
+ * process has a list of its requests, in submission order, from when
+ * they are queued until their results are collected by aio_return or
+ * aio_waitcomplete; a request is named by the user address of its
+ * control block.
+ *
+ * Processes are single-threaded, so only the owning thread adds or
+ * removes requests; the workers only mark them done. The lock
+ * protects the done flags and counts, and the cv is signaled on each
+ * completion.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/aio.h>
+#include <lib.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <file.h>
+#include <iowork.h>
+#include <aio.h>
+#include <syscall.h>
+
+struct aio_req {
+	struct iowork ar_work;		/* must be first */
+	struct aio_ctx *ar_ctx;		/* owning process */
+	userptr_t ar_cb;		/* user control block (our name) */
+	bool ar_done;			/* result is in */
+	int ar_result;			/* errno, or 0 */
+	int ar_retval;			/* bytes transferred */
+	struct aio_req *ar_next;	/* next in submission order */
+};
+
+struct aio_ctx {
+	struct lock *ac_lock;
+	struct cv *ac_cv;		/* signaled on each completion */
+	struct aio_req *ac_head;	/* requests, oldest first */
+	struct aio_req *ac_tail;
+	unsigned ac_count;		/* requests on the list */
+	unsigned ac_inflight;		/* requests not yet done */
+};
+
+/*
+ * Get the current process's aio state, creating it if needed.
+ */
+static
+int
+aio_getctx(struct aio_ctx **ret)
+{
+	struct aio_ctx *ctx;
+
+	if (curthread->t_aio != NULL) {
+		*ret = curthread->t_aio;
+		return 0;
+	}
+
+	ctx = kmalloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		return ENOMEM;
+	}
+	ctx->ac_lock = lock_create("aio");
+	if (ctx->ac_lock == NULL) {
+		kfree(ctx);
+		return ENOMEM;
+	}
+	ctx->ac_cv = cv_create("aio");
+	if (ctx->ac_cv == NULL) {
+		lock_destroy(ctx->ac_lock);
+		kfree(ctx);
+		return ENOMEM;
+	}
+	ctx->ac_head = ctx->ac_tail = NULL;
+	ctx->ac_count = 0;
+	ctx->ac_inflight = 0;
+
+	curthread->t_aio = ctx;
+	*ret = ctx;
+	return 0;
+}
+
+/*
+ * Find the request for control block CB.
+ */
+static
+struct aio_req *
+aio_find(struct aio_ctx *ctx, userptr_t cb)
+{
+	struct aio_req *req;
+
+	for (req = ctx->ac_head; req != NULL; req = req->ar_next) {
+		if (req->ar_cb == cb) {
+			return req;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take a finished request off the list and free it.
+ */
+static
+void
+aio_reap(struct aio_ctx *ctx, struct aio_req *req)
+{
+	struct aio_req **pp, *prev = NULL;
+
+	KASSERT(lock_do_i_hold(ctx->ac_lock));
+	KASSERT(req->ar_done);
+
+	for (pp = &ctx->ac_head; *pp != req; pp = &(*pp)->ar_next) {
+		KASSERT(*pp != NULL);
+		prev = *pp;
+	}
+	*pp = req->ar_next;
+	if (ctx->ac_tail == req) {
+		ctx->ac_tail = prev;
+	}
+	ctx->ac_count--;
+	kfree(req);
+}
+
+/*
+ * Completion function, called by the worker.
+ */
+static
+void
+aio_complete(struct iowork *iw)
+{
+	struct aio_req *req = (struct aio_req *)iw;
+	struct aio_ctx *ctx = req->ar_ctx;
+
+	lock_acquire(ctx->ac_lock);
+	req->ar_result = iw->iw_result;
+	req->ar_retval = iw->iw_retval;
+	req->ar_done = true;
+	KASSERT(ctx->ac_inflight > 0);
+	ctx->ac_inflight--;
+	cv_broadcast(ctx->ac_cv, ctx->ac_lock);
+	/* the process may be waiting to tear everything down */
+	lock_release(ctx->ac_lock);
+}
+
+/*
+ * Common code for aio_read and aio_write.
+ */
+static
+int
+aio_queue(userptr_t cb, enum uio_rw rw)
+{
+	struct aiocb acb;
+	struct aio_ctx *ctx;
+	struct aio_req *req;
+	int result;
+
+	result = copyin(cb, &acb, sizeof(acb));
+	if (result) {
+		return result;
+	}
+	if (acb.aio_offset < 0) {
+		return EINVAL;
+	}
+
+	result = aio_getctx(&ctx);
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	if (aio_find(ctx, cb) != NULL) {
+		/* control block still in use */
+		lock_release(ctx->ac_lock);
+		return EINVAL;
+	}
+	if (ctx->ac_count >= AIO_MAX) {
+		lock_release(ctx->ac_lock);
+		return EAGAIN;
+	}
+	lock_release(ctx->ac_lock);
+
+	req = kmalloc(sizeof(*req));
+	if (req == NULL) {
+		return ENOMEM;
+	}
+	result = iowork_prepare(&req->ar_work, acb.aio_fildes, acb.aio_buf,
+				acb.aio_nbytes, acb.aio_offset, rw);
+	if (result) {
+		kfree(req);
+		return result;
+	}
+	req->ar_work.iw_complete = aio_complete;
+	req->ar_ctx = ctx;
+	req->ar_cb = cb;
+	req->ar_done = false;
+	req->ar_result = 0;
+	req->ar_retval = 0;
+	req->ar_next = NULL;
+
+	lock_acquire(ctx->ac_lock);
+	if (ctx->ac_tail == NULL) {
+		ctx->ac_head = req;
+	}
+	else {
+		ctx->ac_tail->ar_next = req;
+	}
+	ctx->ac_tail = req;
+	ctx->ac_count++;
+	ctx->ac_inflight++;
+	lock_release(ctx->ac_lock);
+
+	iowork_submit(&req->ar_work);
+	return 0;
+}
+
+/*
+ * sys_aio_read
+ * queue a read described by the control block CB.
+ */
+int
+sys_aio_read(userptr_t cb)
+{
+	return aio_queue(cb, UIO_READ);
+}
+
+/*
+ * sys_aio_write
+ * queue a write described by the control block CB.
+ */
+int
+sys_aio_write(userptr_t cb)
+{
+	return aio_queue(cb, UIO_WRITE);
+}
+
+/*
+ * sys_aio_error
+ * report EINPROGRESS, or the error status of a finished request.
+ */
+int
+sys_aio_error(userptr_t cb, int *retval)
+{
+	struct aio_ctx *ctx = curthread->t_aio;
+	struct aio_req *req;
+
+	if (ctx == NULL) {
+		return EINVAL;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	req = aio_find(ctx, cb);
+	if (req == NULL) {
+		lock_release(ctx->ac_lock);
+		return EINVAL;
+	}
+	*retval = req->ar_done ? req->ar_result : EINPROGRESS;
+	lock_release(ctx->ac_lock);
+	return 0;
+}
+
+/*
+ * sys_aio_return
+ * collect the result of a finished request, as read or write would
+ * have returned it, and forget the request.
+ */
+int
+sys_aio_return(userptr_t cb, int *retval)
+{
+	struct aio_ctx *ctx = curthread->t_aio;
+	struct aio_req *req;
+	int result;
+
+	if (ctx == NULL) {
+		return EINVAL;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	req = aio_find(ctx, cb);
+	if (req == NULL) {
+		lock_release(ctx->ac_lock);
+		return EINVAL;
+	}
+	if (!req->ar_done) {
+		lock_release(ctx->ac_lock);
+		return EINPROGRESS;
+	}
+	result = req->ar_result;
+	*retval = req->ar_retval;
+	aio_reap(ctx, req);
+	lock_release(ctx->ac_lock);
+
+	return result;
+}
+
+/*
+ * sys_aio_suspend
+ * wait until at least one of the NENT requests in the user array LIST
+ * is finished. NULL entries are ignored.
+ */
+int
+sys_aio_suspend(userptr_t list, int nent)
+{
+	struct aio_ctx *ctx = curthread->t_aio;
+	userptr_t cbs[AIO_MAX];
+	struct aio_req *req;
+	bool found, done;
+	int i, result;
+
+	if (nent <= 0 || nent > AIO_MAX) {
+		return EINVAL;
+	}
+	result = copyin(list, cbs, nent * sizeof(cbs[0]));
+	if (result) {
+		return result;
+	}
+	if (ctx == NULL) {
+		return EINVAL;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	while (1) {
+		found = done = false;
+		for (i=0; i<nent; i++) {
+			if (cbs[i] == NULL) {
+				continue;
+			}
+			req = aio_find(ctx, cbs[i]);
+			if (req != NULL) {
+				found = true;
+				done = done || req->ar_done;
+			}
+		}
+		if (done || !found) {
+			break;
+		}
+		cv_wait(ctx->ac_cv, ctx->ac_lock);
+	}
+	lock_release(ctx->ac_lock);
+
+	return found ? 0 : EINVAL;
+}
+
+/*
+ * sys_aio_waitcomplete
+ * collect the oldest finished request, waiting for one if none is
+ * finished yet (unless FLAGS has AIO_NOWAIT). Stores its control block
+ * pointer in *CBP and returns its result as aio_return would.
+ */
+int
+sys_aio_waitcomplete(userptr_t cbp, int flags, int *retval)
+{
+	struct aio_ctx *ctx = curthread->t_aio;
+	struct aio_req *req;
+	int result;
+
+	if ((flags & ~AIO_NOWAIT) != 0) {
+		return EINVAL;
+	}
+	if (ctx == NULL) {
+		return EINVAL;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	while (1) {
+		if (ctx->ac_count == 0) {
+			lock_release(ctx->ac_lock);
+			return EINVAL;
+		}
+		for (req = ctx->ac_head; req != NULL; req = req->ar_next) {
+			if (req->ar_done) {
+				break;
+			}
+		}
+		if (req != NULL) {
+			break;
+		}
+		if (flags & AIO_NOWAIT) {
+			lock_release(ctx->ac_lock);
+			return EAGAIN;
+		}
+		cv_wait(ctx->ac_cv, ctx->ac_lock);
+	}
+	lock_release(ctx->ac_lock);
+
+	/* only we remove requests, so REQ stays valid while unlocked */
+	result = copyout(&req->ar_cb, cbp, sizeof(req->ar_cb));
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	result = req->ar_result;
+	*retval = req->ar_retval;
+	aio_reap(ctx, req);
+	lock_release(ctx->ac_lock);
+
+	return result;
+}
+
+/*
+ * Throw away the current thread's aio state, once nothing is in flight.
+ */
+void
+aio_detach(void)
+{
+	struct aio_ctx *ctx = curthread->t_aio;
+	struct aio_req *req;
+
+	if (ctx == NULL) {
+		return;
+	}
+
+	lock_acquire(ctx->ac_lock);
+	while (ctx->ac_inflight > 0) {
+		cv_wait(ctx->ac_cv, ctx->ac_lock);
+	}
+	while ((req = ctx->ac_head) != NULL) {
+		aio_reap(ctx, req);
+	}
+	lock_release(ctx->ac_lock);
+
+	curthread->t_aio = NULL;
+	cv_destroy(ctx->ac_cv);
+	lock_destroy(ctx->ac_lock);
+	kfree(ctx);
+}
@@ -54,14 +54,15 @@
  * ==================================================
  */
 
-
+static int filetable_own(void);
 
 /*** openfile functions ***/
 
 /*
  * file_open
  * opens a file, places it in the filetable, sets RETFD to the file
- * descriptor. the pointer arguments must be kernel pointers.
+ * descriptor. the pointer arguments must be kernel pointers.  O_CLOEXEC
+ * is handled here and not passed on to vfs.
  * NOTE -- the passed in filename must be a mutable string.
  */
 int
@@ -71,7 +72,7 @@ file_open(char *filename, int flags, int mode, int *retfd)
 	struct openfile *file;
 	int result;
 	
-	result = vfs_open(filename, flags, mode, &vn);
+	result = vfs_open(filename, flags & ~O_CLOEXEC, mode, &vn);
 	if (result) {
 		return result;
 	}
@@ -108,6 +109,10 @@ file_open(char *filename, int flags, int mode, int *retfd)
 		return result;
 	}
 
+	if (flags & O_CLOEXEC) {
+		curthread->t_filetable->ft_cloexec[*retfd] = true;
+	}
+
 	return 0;
 }
 
@@ -153,18 +158,154 @@ file_close(int fd)
 		return result;
 	}
 
+	/* the file stays open in the table we stop sharing */
+	result = filetable_own();
+	if (result) {
+		return result;
+	}
+
 	result = file_doclose(file);
 	if (result) {
 		/* leave file open for possible retry */
 		return result;
 	}
 	curthread->t_filetable->ft_openfiles[fd] = NULL;
+	curthread->t_filetable->ft_cloexec[fd] = false;
 
 	return 0;
 }
 
+/*
+ * file_incref
+ * takes an extra reference to an openfile, for holders outside the
+ * filetable (e.g. queued asynchronous I/O).
+ */
+void
+file_incref(struct openfile *file)
+{
+	lock_acquire(file->of_lock);
+	file->of_refcount++;
+	lock_release(file->of_lock);
+}
+
+/*
+ * file_decref
+ * drops a reference taken with file_incref.
+ */
+void
+file_decref(struct openfile *file)
+{
+	int result;
+
+	result = file_doclose(file);
+	KASSERT(result == 0);
+}
+
 /*** filetable functions ***/
 
+/*
+ * filetable_create
+ * allocates an empty table with a single user.
+ */
+static
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	int fd;
+
+	ft = kmalloc(sizeof(struct filetable));
+	if (ft == NULL) {
+		return NULL;
+	}
+
+	/* NULL-out the table */
+	for (fd = 0; fd < OPEN_MAX; fd++) {
+		ft->ft_openfiles[fd] = NULL;
+		ft->ft_cloexec[fd] = false;
+	}
+	ft->ft_refcount = 1;
+	spinlock_init(&ft->ft_lock);
+
+	return ft;
+}
+
+/*
+ * filetable_release
+ * drops one user of FT.  the last one closes the files and frees the table.
+ */
+static
+void
+filetable_release(struct filetable *ft)
+{
+	bool last;
+	int fd, result;
+
+	spinlock_acquire(&ft->ft_lock);
+	KASSERT(ft->ft_refcount > 0);
+	ft->ft_refcount--;
+	last = (ft->ft_refcount == 0);
+	spinlock_release(&ft->ft_lock);
+
+	if (!last) {
+		return;
+	}
+
+	for (fd = 0; fd < OPEN_MAX; fd++) {
+		if (ft->ft_openfiles[fd]) {
+			result = file_doclose(ft->ft_openfiles[fd]);
+			KASSERT(result == 0);
+		}
+	}
+
+	spinlock_cleanup(&ft->ft_lock);
+	kfree(ft);
+}
+
+/*
+ * filetable_own
+ * makes sure the curthread's filetable isn't shared with another process,
+ * copying it if it is.  must be called before changing the table.
+ *
+ * only the owning process can add users to its table (by forking), so if
+ * the count is 1 it can't go up behind our back.  two sharers can unshare
+ * at the same time, though, so whoever drops the count to 0 frees the old
+ * table.
+ */
+static
+int
+filetable_own(void)
+{
+	struct filetable *ft = curthread->t_filetable;
+	struct filetable *copy;
+	int fd;
+
+	KASSERT(ft != NULL);
+
+	if (ft->ft_refcount == 1) {
+		return 0;
+	}
+
+	copy = filetable_create();
+	if (copy == NULL) {
+		return ENOMEM;
+	}
+
+	/* the copy shares the openfiles, as after fork in Unix */
+	for (fd = 0; fd < OPEN_MAX; fd++) {
+		if (ft->ft_openfiles[fd] != NULL) {
+			file_incref(ft->ft_openfiles[fd]);
+			copy->ft_openfiles[fd] = ft->ft_openfiles[fd];
+			copy->ft_cloexec[fd] = ft->ft_cloexec[fd];
+		}
+	}
+
+	curthread->t_filetable = copy;
+	filetable_release(ft);
+
+	return 0;
+}
+
 /* 
  * filetable_init
  * pretty straightforward -- allocate the space, initialize to NULL.
@@ -190,15 +331,10 @@ filetable_init(const char *inpath, const char *outpath, const char *errpath)
 	/* catch memory leaks, repeated calls */
 	KASSERT(curthread->t_filetable == NULL);
 
-	curthread->t_filetable = kmalloc(sizeof(struct filetable));
+	curthread->t_filetable = filetable_create();
 	if (curthread->t_filetable == NULL) {
 		return ENOMEM;
 	}
-	
-	/* NULL-out the table */
-	for (fd = 0; fd < OPEN_MAX; fd++) {
-		curthread->t_filetable->ft_openfiles[fd] = NULL;
-	}
 
 	/*
 	 * open the std fds.  note that the names must be copied into
@@ -227,65 +363,42 @@ filetable_init(const char *inpath, const char *outpath, const char *errpath)
 
 /*
  * filetable_copy
- * again, pretty straightforward.  the subtle business here is that instead of
- * copying the openfile structure, we just increment the refcount.  this means
- * that openfile structs will, in fact, be shared between processes, as in
- * Unix.
+ * doesn't actually copy anything: the child shares the curthread's table
+ * until one of them changes it (see filetable_own).  the openfiles are
+ * thus shared between processes, as in Unix, and fork doesn't pay for
+ * duplicating descriptors that exec is about to close anyway.
  */
 int
 filetable_copy(struct filetable **copy)
 {
 	struct filetable *ft = curthread->t_filetable;
-	int fd;
 
 	/* waste of a call, really */
 	if (ft == NULL) {
 		*copy = NULL;
 		return 0;
 	}
-	
-	*copy = kmalloc(sizeof(struct filetable));
-	
-	if (*copy == NULL) {
-		return ENOMEM;
-	}
 
-	/* copy over the entries */
-	for (fd = 0; fd < OPEN_MAX; fd++) {
-		if (ft->ft_openfiles[fd] != NULL) {
-			lock_acquire(ft->ft_openfiles[fd]->of_lock);
-			ft->ft_openfiles[fd]->of_refcount++;
-			lock_release(ft->ft_openfiles[fd]->of_lock);
-			(*copy)->ft_openfiles[fd] = ft->ft_openfiles[fd];
-		} 
-		else {
-			(*copy)->ft_openfiles[fd] = NULL;
-		}
-	}
+	spinlock_acquire(&ft->ft_lock);
+	ft->ft_refcount++;
+	spinlock_release(&ft->ft_lock);
 
+	*copy = ft;
 	return 0;
 }
 
 /*
  * filetable_destroy
- * closes the files in the file table, frees the table.
+ * drops the process's use of the file table; the last user closes the
+ * files and frees it.
  */
 void
 filetable_destroy(struct filetable *ft)
 {
-	int fd, result;
-
 	KASSERT(ft != NULL);
 
-	for (fd = 0; fd < OPEN_MAX; fd++) {
-		if (ft->ft_openfiles[fd]) {
-			result = file_doclose(ft->ft_openfiles[fd]);
-			KASSERT(result == 0);
-		}
-	}
-	
-	kfree(ft);
-}	
+	filetable_release(ft);
+}
 
 /* 
  * filetable_placefile
@@ -295,12 +408,19 @@ filetable_destroy(struct filetable *ft)
 int
 filetable_placefile(struct openfile *file, int *fd)
 {
-	struct filetable *ft = curthread->t_filetable;
-	int i;
+	struct filetable *ft;
+	int i, result;
+
+	result = filetable_own();
+	if (result) {
+		return result;
+	}
+	ft = curthread->t_filetable;
 	
 	for (i = 0; i < OPEN_MAX; i++) {
 		if (ft->ft_openfiles[i] == NULL) {
 			ft->ft_openfiles[i] = file;
+			ft->ft_cloexec[i] = false;
 			*fd = i;
 			return 0;
 		}
@@ -358,6 +478,12 @@ filetable_dup2file(int oldfd, int newfd)
 		return 0;
 	}
 
+	result = filetable_own();
+	if (result) {
+		return result;
+	}
+	ft = curthread->t_filetable;
+
 	/* closes the newfd if it's open */
 	if (ft->ft_openfiles[newfd] != NULL) {
 		result = file_close(newfd);
@@ -373,6 +499,100 @@ filetable_dup2file(int oldfd, int newfd)
 
 	/* doesn't need to be synchronized because it's just changing the ft */
 	ft->ft_openfiles[newfd] = file;
+	ft->ft_cloexec[newfd] = false;
+
+	return 0;
+}
+
+/*
+ * filetable_getcloexec
+ * reports whether FD is closed on exec.
+ */
+int
+filetable_getcloexec(int fd, bool *cloexec)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_findfile(fd, &file);
+	if (result) {
+		return result;
+	}
+
+	*cloexec = curthread->t_filetable->ft_cloexec[fd];
+	return 0;
+}
+
+/*
+ * filetable_setcloexec
+ * sets or clears FD's close-on-exec flag.  setting it to what it already
+ * is doesn't unshare the table.
+ */
+int
+filetable_setcloexec(int fd, bool cloexec)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_findfile(fd, &file);
+	if (result) {
+		return result;
+	}
+
+	if (curthread->t_filetable->ft_cloexec[fd] == cloexec) {
+		return 0;
+	}
+
+	result = filetable_own();
+	if (result) {
+		return result;
+	}
+
+	curthread->t_filetable->ft_cloexec[fd] = cloexec;
+	return 0;
+}
+
+/*
+ * filetable_execclose
+ * closes the files marked close-on-exec.  the only way this can fail is
+ * running out of memory unsharing the table, which happens before anything
+ * is closed, so execv can still back out.  if nothing is marked, a table
+ * shared with the parent stays shared.
+ */
+int
+filetable_execclose(void)
+{
+	struct filetable *ft = curthread->t_filetable;
+	int fd, result;
+
+	if (ft == NULL) {
+		return 0;
+	}
+
+	for (fd = 0; fd < OPEN_MAX; fd++) {
+		if (ft->ft_cloexec[fd]) {
+			break;
+		}
+	}
+	if (fd == OPEN_MAX) {
+		return 0;
+	}
+
+	result = filetable_own();
+	if (result) {
+		return result;
+	}
+	ft = curthread->t_filetable;
+
+	for (; fd < OPEN_MAX; fd++) {
+		if (ft->ft_cloexec[fd]) {
+			KASSERT(ft->ft_openfiles[fd] != NULL);
+			result = file_doclose(ft->ft_openfiles[fd]);
+			KASSERT(result == 0);
+			ft->ft_openfiles[fd] = NULL;
+			ft->ft_cloexec[fd] = false;
+		}
+	}
 
 	return 0;
 }
@@ -425,48 +645,54 @@ sys_open(userptr_t filename, int flags, int mode, int *retval)
 }
 
 /*
- * sys_read
- * translates the fd into its openfile, then calls VOP_READ.
+ * file_doio
+ * shared code for sys_read and sys_write and asynchronous I/O: checks the
+ * access mode, then calls VOP_READ or VOP_WRITE on the user buffer BUF
+ * in the current address space. if OFFSET is FILE_CUROFF the file's seek
+ * position is used and updated; otherwise the transfer is done at OFFSET
+ * and the seek position is left alone.
  */
 int
-sys_read(int fd, userptr_t buf, size_t size, int *retval)
+file_doio(struct openfile *file, userptr_t buf, size_t size, off_t offset,
+	  enum uio_rw rw, int *retval)
 {
 	struct iovec iov;
 	struct uio useruio;
-	struct openfile *file;
 	int result;
 
-	/* better be a valid file descriptor */
-	result = filetable_findfile(fd, &file);
-	if (result) {
-		return result;
-	}
-
 	lock_acquire(file->of_lock);
 
-	if (file->of_accmode == O_WRONLY) {
+	if (file->of_accmode == (rw == UIO_READ ? O_WRONLY : O_RDONLY)) {
 		lock_release(file->of_lock);
 		return EBADF;
 	}
 
-	/* set up a uio with the buffer, its size, and the current offset */
-	mk_useruio(&iov, &useruio, buf, size, file->of_offset, UIO_READ);
+	/* set up a uio with the buffer, its size, and the offset */
+	mk_useruio(&iov, &useruio, buf, size,
+		   offset == FILE_CUROFF ? file->of_offset : offset, rw);
 
-	/* does the read */
-	result = VOP_READ(file->of_vnode, &useruio);
+	/* does the transfer */
+	if (rw == UIO_READ) {
+		result = VOP_READ(file->of_vnode, &useruio);
+	}
+	else {
+		result = VOP_WRITE(file->of_vnode, &useruio);
+	}
 	if (result) {
 		lock_release(file->of_lock);
 		return result;
 	}
 
 	/* set the offset to the updated offset in the uio */
-	file->of_offset = useruio.uio_offset;
+	if (offset == FILE_CUROFF) {
+		file->of_offset = useruio.uio_offset;
+	}
 
 	lock_release(file->of_lock);
-	
+
 	/*
-	 * The amount read is the size of the buffer originally, minus
-	 * how much is left in it.
+	 * The amount transferred is the size of the buffer originally,
+	 * minus how much is left in it.
 	 */
 	*retval = size - useruio.uio_resid;
 
@@ -474,51 +700,40 @@ sys_read(int fd, userptr_t buf, size_t size, int *retval)
 }
 
 /*
- * sys_write
- * translates the fd into its openfile, then calls VOP_WRITE.
+ * sys_read
+ * translates the fd into its openfile, then calls file_doio.
  */
 int
-sys_write(int fd, userptr_t buf, size_t size, int *retval)
+sys_read(int fd, userptr_t buf, size_t size, int *retval)
 {
-	struct iovec iov;
-	struct uio useruio;
 	struct openfile *file;
 	int result;
 
+	/* better be a valid file descriptor */
 	result = filetable_findfile(fd, &file);
 	if (result) {
 		return result;
 	}
 
-	lock_acquire(file->of_lock);
-
-	if (file->of_accmode == O_RDONLY) {
-		lock_release(file->of_lock);
-		return EBADF;
-	}
+	return file_doio(file, buf, size, FILE_CUROFF, UIO_READ, retval);
+}
 
-	/* set up a uio with the buffer, its size, and the current offset */
-	mk_useruio(&iov, &useruio, buf, size, file->of_offset, UIO_WRITE);
+/*
+ * sys_write
+ * translates the fd into its openfile, then calls file_doio.
+ */
+int
+sys_write(int fd, userptr_t buf, size_t size, int *retval)
+{
+	struct openfile *file;
+	int result;
 
-	/* does the write */
-	result = VOP_WRITE(file->of_vnode, &useruio);
+	result = filetable_findfile(fd, &file);
 	if (result) {
-		lock_release(file->of_lock);
 		return result;
 	}
 
-	/* set the offset to the updated offset in the uio */
-	file->of_offset = useruio.uio_offset;
-
-	lock_release(file->of_lock);
-
-	/*
-	 * the amount written is the size of the buffer originally,
-	 * minus how much is left in it.
-	 */
-	*retval = size - useruio.uio_resid;
-
-	return 0;
+	return file_doio(file, buf, size, FILE_CUROFF, UIO_WRITE, retval);
 }
 
 /* 
@@ -587,6 +802,25 @@ sys_lseek(int fd, off_t offset, int whence, off_t *retval)
 	return 0;
 }
 
+/*
+ * sys_ioctl
+ * translates the fd into its openfile and passes the operation on to
+ * the vnode.
+ */
+int
+sys_ioctl(int fd, int code, userptr_t data)
+{
+	struct openfile *file;
+	int result;
+
+	result = filetable_findfile(fd, &file);
+	if (result) {
+		return result;
+	}
+
+	return VOP_IOCTL(file->of_vnode, code, data);
+}
+
 /* 
  * sys_dup2
  * just pass the work off to the filetable
@@ -605,6 +839,46 @@ sys_dup2(int oldfd, int newfd, int *retval)
 	return 0;
 }
 
+/*
+ * sys_fcntl
+ * only the descriptor flags (that is, FD_CLOEXEC) and the access mode are
+ * supported.
+ */
+int
+sys_fcntl(int fd, int op, int arg, int *retval)
+{
+	struct openfile *file;
+	bool cloexec;
+	int result;
+
+	switch (op) {
+	    case F_GETFD:
+		result = filetable_getcloexec(fd, &cloexec);
+		if (result) {
+			return result;
+		}
+		*retval = cloexec ? FD_CLOEXEC : 0;
+		return 0;
+	    case F_SETFD:
+		result = filetable_setcloexec(fd, (arg & FD_CLOEXEC) != 0);
+		if (result) {
+			return result;
+		}
+		*retval = 0;
+		return 0;
+	    case F_GETFL:
+		result = filetable_findfile(fd, &file);
+		if (result) {
+			return result;
+		}
+		/* fixed at open, so no need for the lock */
+		*retval = file->of_accmode;
+		return 0;
+	}
+
+	return EINVAL;
+}
+
 /* really not "file" calls, per se, but might as well put it here */
 
 /*
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Batched system call submission: the kernel side of <kern/ioring.h>.
+ *
+ * The ring lives in a page of the process's memory. At setup we fault
+ * it in and find its kernel (KSEG0) address, and from then on access
+ * it directly; no copyin/copyout is needed to take submissions or post
+ * completions. The page is pinned (as_pin) so MADV_DONTNEED can't free
+ * the frame; otherwise it stays put until the address space is
+ * destroyed, and ioring_detach is called before that happens.
+ *
+ * The process can scribble on the ring at any time, so the kernel
+ * keeps its own copies of the indexes it owns (ic_sqhead, ic_cqtail)
+ * and copies each SQE out of the ring before looking at it.
+ *
+ * Flow control: every SQE taken reserves a CQ slot (ic_inflight) until
+ * its completion is posted, and we stop taking SQEs while the
+ * reserved plus unreaped completions would fill the CQ. So posting a
+ * completion never has to wait.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/ioring.h>
+#include <kern/limits.h>
+#include <lib.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <vm.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <file.h>
+#include <iowork.h>
+#include <ioring.h>
+#include <syscall.h>
+
+#define IORING_MASK	(IORING_ENTRIES - 1)
+
+struct ioring_ctx {
+	struct ioring *ic_ring;		/* kernel mapping of the user ring */
+	struct addrspace *ic_as;	/* address space the ring is in */
+	struct as_pin ic_pin;		/* keeps the ring's frame in place */
+	struct lock *ic_lock;		/* protects the fields below */
+	struct cv *ic_cv;		/* signaled on each completion */
+	unsigned ic_sqhead;		/* our copy of ir_sqhead */
+	unsigned ic_cqtail;		/* our copy of ir_cqtail */
+	unsigned ic_inflight;		/* CQ slots reserved */
+};
+
+/* A read or write handed to the I/O workers */
+struct ioring_req {
+	struct iowork irq_work;		/* must be first */
+	struct ioring_ctx *irq_ctx;
+	unsigned irq_user;
+};
+
+/*
+ * Number of completions posted but not yet reaped. If the process has
+ * set ir_cqhead to something nonsensical, call the queue full.
+ */
+static
+unsigned
+ioring_cqpending(struct ioring_ctx *ctx)
+{
+	unsigned pending;
+
+	pending = ctx->ic_cqtail - ctx->ic_ring->ir_cqhead;
+	if (pending > IORING_ENTRIES) {
+		pending = IORING_ENTRIES;
+	}
+	return pending;
+}
+
+/*
+ * Post a completion into the slot reserved for it.
+ */
+static
+void
+ioring_post(struct ioring_ctx *ctx, unsigned user, int result, int retval)
+{
+	struct ioring_cqe *cqe;
+
+	lock_acquire(ctx->ic_lock);
+	KASSERT(ctx->ic_inflight > 0);
+
+	cqe = &ctx->ic_ring->ir_cq[ctx->ic_cqtail & IORING_MASK];
+	cqe->cqe_user = user;
+	if (result) {
+		cqe->cqe_result = -1;
+		cqe->cqe_error = result;
+	}
+	else {
+		cqe->cqe_result = retval;
+		cqe->cqe_error = 0;
+	}
+	ctx->ic_cqtail++;
+	ctx->ic_ring->ir_cqtail = ctx->ic_cqtail;
+	ctx->ic_inflight--;
+
+	cv_broadcast(ctx->ic_cv, ctx->ic_lock);
+	/* the ring may be detached as soon as we let go */
+	lock_release(ctx->ic_lock);
+}
+
+/*
+ * Completion function for reads and writes run by the workers.
+ */
+static
+void
+ioring_complete(struct iowork *iw)
+{
+	struct ioring_req *req = (struct ioring_req *)iw;
+	struct ioring_ctx *ctx;
+	unsigned user;
+	int result, retval;
+
+	ctx = req->irq_ctx;
+	user = req->irq_user;
+	result = iw->iw_result;
+	retval = iw->iw_retval;
+	kfree(req);
+
+	ioring_post(ctx, user, result, retval);
+}
+
+/*
+ * Queue a read or write for the workers.
+ */
+static
+int
+ioring_queue_io(struct ioring_ctx *ctx, const struct ioring_sqe *sqe)
+{
+	struct ioring_req *req;
+	int result;
+
+	req = kmalloc(sizeof(*req));
+	if (req == NULL) {
+		return ENOMEM;
+	}
+
+	result = iowork_prepare(&req->irq_work, sqe->sqe_fd, sqe->sqe_buf,
+		sqe->sqe_len,
+		sqe->sqe_offset == IORING_CUROFF ? FILE_CUROFF : sqe->sqe_offset,
+		sqe->sqe_op == IORING_OP_READ ? UIO_READ : UIO_WRITE);
+	if (result) {
+		kfree(req);
+		return result;
+	}
+	req->irq_work.iw_complete = ioring_complete;
+	req->irq_ctx = ctx;
+	req->irq_user = sqe->sqe_user;
+
+	iowork_submit(&req->irq_work);
+	return 0;
+}
+
+/*
+ * Start one request. Its CQ slot has already been reserved.
+ */
+static
+void
+ioring_start(struct ioring_ctx *ctx, const struct ioring_sqe *sqe)
+{
+	char path[PATH_MAX];
+	int result, retval = 0;
+
+	switch (sqe->sqe_op) {
+	    case IORING_OP_NOP:
+		result = 0;
+		break;
+	    case IORING_OP_READ:
+	    case IORING_OP_WRITE:
+		result = ioring_queue_io(ctx, sqe);
+		if (result == 0) {
+			/* the worker posts the completion */
+			return;
+		}
+		break;
+	    case IORING_OP_OPEN:
+		result = copyinstr(sqe->sqe_buf, path, sizeof(path), NULL);
+		if (result == 0) {
+			result = file_open(path, sqe->sqe_flags, 0, &retval);
+		}
+		break;
+	    case IORING_OP_CLOSE:
+		result = file_close(sqe->sqe_fd);
+		break;
+	    default:
+		result = EINVAL;
+		break;
+	}
+
+	ioring_post(ctx, sqe->sqe_user, result, retval);
+}
+
+/*
+ * sys_ioring_setup
+ * register the ring at RING for the current process.
+ */
+int
+sys_ioring_setup(userptr_t ring)
+{
+	struct ioring_ctx *ctx;
+	unsigned indexes[4];
+	vaddr_t uva, kva;
+	int result;
+
+	if (curthread->t_ioring != NULL) {
+		return EBUSY;
+	}
+
+	uva = (vaddr_t)ring;
+	if (uva % sizeof(__off_t) != 0 ||
+	    (uva & PAGE_FRAME) !=
+	    ((uva + sizeof(struct ioring) - 1) & PAGE_FRAME)) {
+		return EINVAL;
+	}
+
+	/*
+	 * Zero the indexes with copyout; this also faults the page in
+	 * (and checks it is writable) so it can be translated.
+	 */
+	bzero(indexes, sizeof(indexes));
+	result = copyout(indexes, ring, sizeof(indexes));
+	if (result) {
+		return result;
+	}
+	result = as_translate(curthread->t_addrspace, uva, &kva);
+	if (result) {
+		return result;
+	}
+
+	ctx = kmalloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		return ENOMEM;
+	}
+	ctx->ic_lock = lock_create("ioring");
+	if (ctx->ic_lock == NULL) {
+		kfree(ctx);
+		return ENOMEM;
+	}
+	ctx->ic_cv = cv_create("ioring");
+	if (ctx->ic_cv == NULL) {
+		lock_destroy(ctx->ic_lock);
+		kfree(ctx);
+		return ENOMEM;
+	}
+	ctx->ic_ring = (struct ioring *)kva;
+	ctx->ic_as = curthread->t_addrspace;
+	ctx->ic_sqhead = 0;
+	ctx->ic_cqtail = 0;
+	ctx->ic_inflight = 0;
+	as_pin(ctx->ic_as, &ctx->ic_pin, uva, sizeof(struct ioring));
+
+	curthread->t_ioring = ctx;
+	return 0;
+}
+
+/*
+ * sys_ioring_enter
+ * take up to TO_SUBMIT requests from the submission queue and start
+ * them, then wait until at least MIN_COMPLETE completions are waiting
+ * to be reaped (or nothing is left in flight). Returns the number of
+ * requests taken.
+ */
+int
+sys_ioring_enter(unsigned to_submit, unsigned min_complete, int *retval)
+{
+	struct ioring_ctx *ctx = curthread->t_ioring;
+	struct ioring_sqe sqe;
+	unsigned taken, queued;
+	int result = 0;
+
+	if (ctx == NULL) {
+		return EINVAL;
+	}
+
+	for (taken = 0; taken < to_submit; taken++) {
+		lock_acquire(ctx->ic_lock);
+		queued = ctx->ic_ring->ir_sqtail - ctx->ic_sqhead;
+		if (queued == 0 ||
+		    ctx->ic_inflight + ioring_cqpending(ctx) >= IORING_ENTRIES) {
+			lock_release(ctx->ic_lock);
+			break;
+		}
+		if (queued > IORING_ENTRIES) {
+			lock_release(ctx->ic_lock);
+			result = EINVAL;
+			break;
+		}
+		sqe = ctx->ic_ring->ir_sq[ctx->ic_sqhead & IORING_MASK];
+		ctx->ic_sqhead++;
+		ctx->ic_ring->ir_sqhead = ctx->ic_sqhead;
+		ctx->ic_inflight++;
+		lock_release(ctx->ic_lock);
+
+		ioring_start(ctx, &sqe);
+	}
+
+	if (taken == 0 && result) {
+		return result;
+	}
+
+	lock_acquire(ctx->ic_lock);
+	while (ioring_cqpending(ctx) < min_complete && ctx->ic_inflight > 0) {
+		cv_wait(ctx->ic_cv, ctx->ic_lock);
+	}
+	lock_release(ctx->ic_lock);
+
+	*retval = taken;
+	return 0;
+}
+
+/*
+ * Drop the current thread's ring, once everything in flight is done.
+ */
+void
+ioring_detach(void)
+{
+	struct ioring_ctx *ctx = curthread->t_ioring;
+
+	if (ctx == NULL) {
+		return;
+	}
+
+	lock_acquire(ctx->ic_lock);
+	while (ctx->ic_inflight > 0) {
+		cv_wait(ctx->ic_cv, ctx->ic_lock);
+	}
+	lock_release(ctx->ic_lock);
+
+	curthread->t_ioring = NULL;
+	as_unpin(ctx->ic_as, &ctx->ic_pin);
+	cv_destroy(ctx->ic_cv);
+	lock_destroy(ctx->ic_lock);
+	kfree(ctx);
+}
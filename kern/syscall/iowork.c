@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * I/O worker threads. See iowork.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <vm.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <file.h>
+#include <iowork.h>
+
+/* Number of worker threads */
+#define IOWORK_NTHREADS	4
+
+static struct lock *iowork_lock;	/* protects the queue */
+static struct cv *iowork_cv;		/* signaled when work is queued */
+static struct iowork *iowork_head;	/* queue of pending work */
+static struct iowork *iowork_tail;
+
+/*
+ * Take the next piece of work off the queue, waiting if there is none.
+ */
+static
+struct iowork *
+iowork_get(void)
+{
+	struct iowork *iw;
+
+	lock_acquire(iowork_lock);
+	while (iowork_head == NULL) {
+		cv_wait(iowork_cv, iowork_lock);
+	}
+	iw = iowork_head;
+	iowork_head = iw->iw_next;
+	if (iowork_head == NULL) {
+		iowork_tail = NULL;
+	}
+	lock_release(iowork_lock);
+
+	iw->iw_next = NULL;
+	return iw;
+}
+
+/*
+ * Worker thread main loop.
+ */
+static
+void
+iowork_thread(void *junk1, unsigned long num)
+{
+	struct iowork *iw;
+
+	(void)junk1;
+	(void)num;
+
+	while (1) {
+		iw = iowork_get();
+
+		/* borrow the submitter's address space for the transfer */
+		KASSERT(curthread->t_addrspace == NULL);
+		curthread->t_addrspace = iw->iw_as;
+		as_activate(iw->iw_as);
+
+		iw->iw_retval = 0;
+		iw->iw_result = file_doio(iw->iw_file, iw->iw_buf, iw->iw_len,
+					  iw->iw_offset, iw->iw_rw,
+					  &iw->iw_retval);
+
+		curthread->t_addrspace = NULL;
+		as_activate(NULL);
+		as_unpin(iw->iw_as, &iw->iw_pin);
+
+		file_decref(iw->iw_file);
+		iw->iw_file = NULL;
+
+		iw->iw_complete(iw);
+	}
+}
+
+/*
+ * Touch every page of BUF so it is mapped before a worker uses it.
+ */
+static
+int
+iowork_prefault(userptr_t buf, size_t len)
+{
+	vaddr_t va, end;
+	char ch;
+	int result;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	va = (vaddr_t)buf;
+	end = va + len;
+	if (end < va) {
+		return EFAULT;
+	}
+
+	while (va < end) {
+		result = copyin((const_userptr_t)va, &ch, 1);
+		if (result) {
+			return result;
+		}
+		va = (va & PAGE_FRAME) + PAGE_SIZE;
+	}
+	return 0;
+}
+
+/*
+ * Set up IW for a transfer on file handle FD.
+ */
+int
+iowork_prepare(struct iowork *iw, int fd, userptr_t buf, size_t len,
+	       off_t offset, enum uio_rw rw)
+{
+	struct openfile *file;
+	int result;
+
+	if (offset < 0 && offset != FILE_CUROFF) {
+		return EINVAL;
+	}
+
+	result = filetable_findfile(fd, &file);
+	if (result) {
+		return result;
+	}
+	result = iowork_prefault(buf, len);
+	if (result) {
+		return result;
+	}
+
+	file_incref(file);
+	iw->iw_file = file;
+	iw->iw_as = curthread->t_addrspace;
+	as_pin(iw->iw_as, &iw->iw_pin, (vaddr_t)buf, len);
+	iw->iw_buf = buf;
+	iw->iw_len = len;
+	iw->iw_offset = offset;
+	iw->iw_rw = rw;
+	iw->iw_result = 0;
+	iw->iw_retval = 0;
+	iw->iw_complete = NULL;
+	iw->iw_next = NULL;
+	return 0;
+}
+
+/*
+ * Queue IW for a worker.
+ */
+void
+iowork_submit(struct iowork *iw)
+{
+	KASSERT(iw->iw_file != NULL);
+	KASSERT(iw->iw_as != NULL);
+	KASSERT(iw->iw_complete != NULL);
+
+	iw->iw_next = NULL;
+
+	lock_acquire(iowork_lock);
+	if (iowork_tail == NULL) {
+		iowork_head = iw;
+	}
+	else {
+		iowork_tail->iw_next = iw;
+	}
+	iowork_tail = iw;
+	cv_signal(iowork_cv, iowork_lock);
+	lock_release(iowork_lock);
+}
+
+/*
+ * Set up the queue and start the workers.
+ */
+void
+iowork_bootstrap(void)
+{
+	unsigned i;
+	int result;
+
+	iowork_lock = lock_create("iowork");
+	if (iowork_lock == NULL) {
+		panic("iowork: Out of memory creating lock\n");
+	}
+	iowork_cv = cv_create("iowork");
+	if (iowork_cv == NULL) {
+		panic("iowork: Out of memory creating cv\n");
+	}
+	iowork_head = iowork_tail = NULL;
+
+	for (i=0; i<IOWORK_NTHREADS; i++) {
+		result = thread_fork("iowork", iowork_thread, NULL, i, NULL);
+		if (result) {
+			panic("iowork: thread_fork: %s\n", strerror(result));
+		}
+	}
+}
@@ -48,6 +48,13 @@
  * To support dynamically linked executables with shared libraries
  * you'd need to change this to load the "ELF interpreter" (dynamic
  * linker). And you'd have to write a dynamic linker...
+ *
+ * The headers are parsed once per executable file and the result is
+ * kept on the vnode (vn_execinfo), so running the same program again
+ * only reads the segments themselves. Writing or truncating the file
+ * throws the parsed copy away. The last few programs run are kept
+ * referenced (see vnode.c), since sfs and emufs would otherwise
+ * reclaim the vnode, and the copy with it, when a program exits.
  */
 
 #include <types.h>
@@ -59,6 +66,45 @@
 #include <addrspace.h>
 #include <vnode.h>
 #include <elf.h>
+#include <kstat.h>
+
+/*
+ * Most loadable segments whose headers are kept; real programs have
+ * two or three. Programs with more are still run, but their program
+ * headers are read again each time.
+ */
+#define ELF_MAXSEGS	8
+
+/* A loadable segment */
+struct elfseg {
+	off_t es_offset;		/* where it is in the file */
+	vaddr_t es_vaddr;		/* where it goes in memory */
+	size_t es_memsize;		/* size in memory */
+	size_t es_filesize;		/* size in the file */
+	uint32_t es_flags;		/* PF_R, PF_W, PF_X */
+};
+
+/*
+ * The parts of an executable's headers load_elf uses.
+ */
+struct elfinfo {
+	vaddr_t ei_entry;		/* entry point */
+	off_t ei_phoff;			/* where the program headers are */
+	unsigned ei_phentsize;		/* size of each */
+	unsigned ei_phnum;		/* how many */
+	unsigned ei_nsegs;		/* PT_LOAD segments, in file order */
+	struct elfseg ei_segs[ELF_MAXSEGS];	/* if no more than this */
+};
+
+static KSTAT_COUNTER(elf_cachehits, "exec.elfcache.hits");
+static KSTAT_COUNTER(elf_cachemisses, "exec.elfcache.misses");
+
+void
+load_elf_bootstrap(void)
+{
+	kstat_register(&elf_cachehits);
+	kstat_register(&elf_cachemisses);
+}
 
 /*
  * Load a segment at virtual address VADDR. The segment in memory
@@ -145,16 +191,58 @@ load_segment(struct vnode *v, off_t offset, vaddr_t vaddr,
 }
 
 /*
- * Load an ELF executable user program into the current address space.
+ * Read program header I of V into PH.
  *
- * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ * Note that the expression phoff + i*phentsize is mandated by the ELF
+ * standard - we use sizeof(ph) to load, because that's the structure
+ * we know, but the file on disk might have a larger structure, so we
+ * must use phentsize to find where the phdr starts.
  */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+load_elf_phdr(struct vnode *v, const struct elfinfo *ei, unsigned i,
+	      Elf_Phdr *ph)
+{
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, ph, sizeof(*ph),
+		  ei->ei_phoff + i * ei->ei_phentsize, UIO_READ);
+	result = VOP_READ(v, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid != 0) {
+		/* short read; problem with executable? */
+		kprintf("ELF: short read on phdr - file truncated?\n");
+		return ENOEXEC;
+	}
+	return 0;
+}
+
+static
+void
+load_elf_seg(const Elf_Phdr *ph, struct elfseg *seg)
+{
+	seg->es_offset = ph->p_offset;
+	seg->es_vaddr = ph->p_vaddr;
+	seg->es_memsize = ph->p_memsz;
+	seg->es_filesize = ph->p_filesz;
+	seg->es_flags = ph->p_flags;
+}
+
+/*
+ * Read and check the headers of the executable V, and fill in EI.
+ */
+static
+int
+load_elf_headers(struct vnode *v, struct elfinfo *ei)
 {
 	Elf_Ehdr eh;   /* Executable header */
 	Elf_Phdr ph;   /* "Program header" = segment header */
-	int result, i;
+	int result;
+	unsigned i;
 	struct iovec iov;
 	struct uio ku;
 
@@ -198,36 +286,27 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		return ENOEXEC;
 	}
 
+	ei->ei_entry = eh.e_entry;
+	ei->ei_phoff = eh.e_phoff;
+	ei->ei_phentsize = eh.e_phentsize;
+	ei->ei_phnum = eh.e_phnum;
+	ei->ei_nsegs = 0;
+
 	/*
-	 * Go through the list of segments and set up the address space.
+	 * Go through the list of segments and note the loadable ones.
 	 *
 	 * Ordinarily there will be one code segment, one read-only
 	 * data segment, and one data/bss segment, but there might
-	 * conceivably be more. You don't need to support such files
-	 * if it's unduly awkward to do so.
-	 *
-	 * Note that the expression eh.e_phoff + i*eh.e_phentsize is 
-	 * mandated by the ELF standard - we use sizeof(ph) to load,
-	 * because that's the structure we know, but the file on disk
-	 * might have a larger structure, so we must use e_phentsize
-	 * to find where the phdr starts.
+	 * conceivably be more. We record up to ELF_MAXSEGS and only
+	 * count the rest.
 	 */
 
-	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
-
-		result = VOP_READ(v, &ku);
+	for (i=0; i<ei->ei_phnum; i++) {
+		result = load_elf_phdr(v, ei, i, &ph);
 		if (result) {
 			return result;
 		}
 
-		if (ku.uio_resid != 0) {
-			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
-		}
-
 		switch (ph.p_type) {
 		    case PT_NULL: /* skip */ continue;
 		    case PT_PHDR: /* skip */ continue;
@@ -239,57 +318,137 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 			return ENOEXEC;
 		}
 
-		result = as_define_region(curthread->t_addrspace,
-					  ph.p_vaddr, ph.p_memsz,
-					  ph.p_flags & PF_R,
-					  ph.p_flags & PF_W,
-					  ph.p_flags & PF_X);
+		if (ei->ei_nsegs < ELF_MAXSEGS) {
+			load_elf_seg(&ph, &ei->ei_segs[ei->ei_nsegs]);
+		}
+		ei->ei_nsegs++;
+	}
+
+	return 0;
+}
+
+/*
+ * Go through the loadable segments of V, defining a region for each,
+ * or if LOAD is set, loading each. They come from EI if it has them
+ * all, or else straight from the program headers.
+ */
+static
+int
+load_elf_segs(struct vnode *v, const struct elfinfo *ei, bool load)
+{
+	struct elfseg seg;
+	Elf_Phdr ph;
+	unsigned i, n;
+	int result;
+
+	i = 0;
+	for (n=0; n<ei->ei_nsegs; n++) {
+		if (ei->ei_nsegs <= ELF_MAXSEGS) {
+			seg = ei->ei_segs[n];
+		}
+		else {
+			/* find the next PT_LOAD */
+			do {
+				if (i == ei->ei_phnum) {
+					/* the file changed under us */
+					return ENOEXEC;
+				}
+				result = load_elf_phdr(v, ei, i++, &ph);
+				if (result) {
+					return result;
+				}
+			} while (ph.p_type != PT_LOAD);
+			load_elf_seg(&ph, &seg);
+		}
+
+		if (load) {
+			result = load_segment(v, seg.es_offset, seg.es_vaddr,
+					      seg.es_memsize, seg.es_filesize,
+					      seg.es_flags & PF_X);
+		}
+		else {
+			result = as_define_region(curthread->t_addrspace,
+						  seg.es_vaddr, seg.es_memsize,
+						  seg.es_flags & PF_R,
+						  seg.es_flags & PF_W,
+						  seg.es_flags & PF_X);
+		}
 		if (result) {
 			return result;
 		}
 	}
+	return 0;
+}
 
-	result = as_prepare_load(curthread->t_addrspace);
+/*
+ * Get the headers of V, from the vnode's cached copy if it has one;
+ * otherwise read them and leave a copy there for next time.
+ */
+static
+int
+load_elf_info(struct vnode *v, struct elfinfo *ei)
+{
+	struct elfinfo *copy;
+	unsigned modcount;
+	int result;
+
+	if (vnode_getexec(v, ei, sizeof(*ei), &modcount) == 0) {
+		kstat_inc(&elf_cachehits);
+		return 0;
+	}
+	kstat_inc(&elf_cachemisses);
+
+	result = load_elf_headers(v, ei);
+	if (result) {
+		return result;
+	}
+
+	/* Caching is only an optimization; do without if out of memory */
+	copy = kmalloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *ei;
+		vnode_setexec(v, copy, modcount);
+	}
+	return 0;
+}
+
+/*
+ * Load an ELF executable user program into the current address space.
+ *
+ * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ */
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+	struct elfinfo ei;
+	int result;
+
+	result = load_elf_info(v, &ei);
 	if (result) {
 		return result;
 	}
 
 	/*
-	 * Now actually load each segment.
+	 * Set up the address space.
 	 */
 
-	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
-
-		result = VOP_READ(v, &ku);
-		if (result) {
-			return result;
-		}
+	result = load_elf_segs(v, &ei, false);
+	if (result) {
+		return result;
+	}
 
-		if (ku.uio_resid != 0) {
-			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
-		}
+	result = as_prepare_load(curthread->t_addrspace);
+	if (result) {
+		return result;
+	}
 
-		switch (ph.p_type) {
-		    case PT_NULL: /* skip */ continue;
-		    case PT_PHDR: /* skip */ continue;
-		    case PT_MIPS_REGINFO: /* skip */ continue;
-		    case PT_LOAD: break;
-		    default:
-			kprintf("loadelf: unknown segment type %d\n", 
-				ph.p_type);
-			return ENOEXEC;
-		}
+	/*
+	 * Now actually load each segment.
+	 */
 
-		result = load_segment(v, ph.p_offset, ph.p_vaddr, 
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
-		if (result) {
-			return result;
-		}
+	result = load_elf_segs(v, &ei, true);
+	if (result) {
+		return result;
 	}
 
 	result = as_complete_load(curthread->t_addrspace);
@@ -297,7 +456,7 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		return result;
 	}
 
-	*entrypoint = eh.e_entry;
+	*entrypoint = ei.ei_entry;
 
 	return 0;
 }
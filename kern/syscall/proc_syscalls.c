@@ -33,6 +33,8 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
 #include <kern/wait.h>
 #include <lib.h>
 #include <machine/trapframe.h>
@@ -41,6 +43,7 @@
 #include <current.h>
 #include <copyinout.h>
 #include <pid.h>
+#include <addrspace.h>
 #include <syscall.h>
 
 /* note that sys_execv is defined in runprogram.c for convenience */
@@ -138,3 +141,105 @@ sys_waitpid(pid_t pid, userptr_t retstatus, int flags, pid_t *retval)
 	
 	return copyout(&status, retstatus, sizeof(int));
 }
+
+/*
+ * sys_getrlimit
+ * Only RLIMIT_RSS is supported; it lives in the address space so that
+ * the VM system can get at it without going through the thread.
+ */
+int
+sys_getrlimit(int resource, userptr_t rlp)
+{
+	struct addrspace *as = curthread->t_addrspace;
+
+	if (resource != RLIMIT_RSS) {
+		return EINVAL;
+	}
+	KASSERT(as != NULL);
+	return copyout(&as->as_rsslimit, rlp, sizeof(struct rlimit));
+}
+
+/*
+ * sys_setrlimit
+ * The soft limit can be anything up to the hard limit. The hard limit
+ * can be lowered but, as there is no superuser, never raised again.
+ * Lowering a limit below the current resident set doesn't reclaim
+ * anything; it just stops the process from growing further.
+ */
+int
+sys_setrlimit(int resource, userptr_t rlp)
+{
+	struct addrspace *as = curthread->t_addrspace;
+	struct rlimit rl;
+	int result;
+
+	if (resource != RLIMIT_RSS) {
+		return EINVAL;
+	}
+
+	result = copyin(rlp, &rl, sizeof(rl));
+	if (result) {
+		return result;
+	}
+	if (rl.rlim_cur > rl.rlim_max) {
+		return EINVAL;
+	}
+
+	KASSERT(as != NULL);
+	if (rl.rlim_max > as->as_rsslimit.rlim_max) {
+		return EPERM;
+	}
+	as->as_rsslimit = rl;
+	return 0;
+}
+
+/*
+ * sys_getwsinfo
+ * Report the working-set estimates kept by the VM system.
+ */
+int
+sys_getwsinfo(userptr_t info)
+{
+	struct wsinfo wi;
+	int result;
+
+	KASSERT(curthread->t_addrspace != NULL);
+	result = vm_getwsinfo(curthread->t_addrspace, &wi);
+	if (result) {
+		return result;
+	}
+	return copyout(&wi, info, sizeof(wi));
+}
+
+/*
+ * sys_getloadinfo
+ * Report the load averages and run-queue waits, system-wide and for
+ * the calling thread.
+ */
+int
+sys_getloadinfo(userptr_t info)
+{
+	struct loadinfo li;
+
+	bzero(&li, sizeof(li));
+	li.li_fscale = clock_getload(li.li_load);
+	li.li_nactive = thread_nactive();
+	thread_getlatency(li.li_latency);
+
+	/* our own figures only change as we're switched in, so no lock */
+	li.li_mywaits = curthread->t_nwaits;
+	li.li_mywaitms = curthread->t_waitms;
+
+	return copyout(&li, info, sizeof(li));
+}
+
+/*
+ * sys_madvise
+ * Just hand the advice to the address space.
+ */
+int
+sys_madvise(userptr_t addr, size_t len, int advice)
+{
+	KASSERT(curthread->t_addrspace != NULL);
+	return as_advise(curthread->t_addrspace, (vaddr_t)addr, len, advice);
+}
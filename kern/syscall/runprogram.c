@@ -43,8 +43,12 @@
 #include <copyinout.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <vmalloc.h>
+#include <execprof.h>
 #include <vfs.h>
 #include <file.h>
+#include <ioring.h>
+#include <aio.h>
 #include <syscall.h>
 #include <test.h>
 
@@ -60,8 +64,9 @@
  * things into a structure to make it relatively easy to move to having
  * e.g. two argv buffers instead of one.
  *
- * A better way to do this is to allocate the argv buffer in pageable
- * virtual memory. However, we don't have a VM system for that yet.
+ * The buffer and offsets are bigger than a page, so they come from
+ * kvmalloc; physically contiguous memory is scarce once the system
+ * has been up for a while.
  */
 struct argvdata {
 	char *buffer;
@@ -80,6 +85,7 @@ execv_bootstrap(void)
 	if (argdata.lock == NULL) {
 		panic("Cannot create argv data lock\n");
 	}
+	load_elf_bootstrap();
 }
 
 
@@ -246,6 +252,10 @@ loadexec(char *path, vaddr_t *entrypoint, vaddr_t *stackptr)
 
 	/* replace address spaces, and activate the new one */
 	oldvm = curthread->t_addrspace;
+	if (oldvm) {
+		/* resource limits survive exec */
+		newvm->as_rsslimit = oldvm->as_rsslimit;
+	}
 	curthread->t_addrspace = newvm;
 	as_activate(curthread->t_addrspace);
 
@@ -263,11 +273,10 @@ loadexec(char *path, vaddr_t *entrypoint, vaddr_t *stackptr)
 		return result;
 	}
 
-	vfs_close(v);
-
 	/* Define the user stack in the address space */
 	result = as_define_stack(curthread->t_addrspace, stackptr);
 	if (result) {
+		vfs_close(v);
 		curthread->t_addrspace = oldvm;
 		as_activate(curthread->t_addrspace);
 		as_destroy(newvm);
@@ -275,6 +284,24 @@ loadexec(char *path, vaddr_t *entrypoint, vaddr_t *stackptr)
 		return result;
         }
 
+	/*
+	 * Close the files marked close-on-exec. This is the last step
+	 * that can fail; it closes nothing unless it succeeds.
+	 */
+	result = filetable_execclose();
+	if (result) {
+		vfs_close(v);
+		curthread->t_addrspace = oldvm;
+		as_activate(curthread->t_addrspace);
+		as_destroy(newvm);
+		kfree(newname);
+		return result;
+	}
+
+	/* Prefetch the pages earlier runs started with, or record them */
+	execprof_start(newvm, v);
+	vfs_close(v);
+
 	/*
 	 * Wipe out old address space.
 	 *
@@ -282,6 +309,9 @@ loadexec(char *path, vaddr_t *entrypoint, vaddr_t *stackptr)
 	 * nothing left for it to return an error to.
 	 */
 	if (oldvm) {
+		/* async I/O buffers are in the old address space */
+		ioring_detach();
+		aio_detach();
 		as_destroy(oldvm);
 	}
 
@@ -422,15 +452,15 @@ sys_execv(userptr_t prog, userptr_t argv)
 	lock_acquire(argdata.lock);
 
 	/* allocate space */
-	argdata.buffer = kmalloc(ARG_MAX);
+	argdata.buffer = kvmalloc(ARG_MAX);
 	if (argdata.buffer == NULL) {
 		lock_release(argdata.lock);
 		kfree(path);
 		return ENOMEM;
 	}
-	argdata.offsets = kmalloc(NARG_MAX * sizeof(size_t));
+	argdata.offsets = kvmalloc(NARG_MAX * sizeof(size_t));
 	if (argdata.offsets == NULL) {
-		kfree(argdata.buffer);
+		kvfree(argdata.buffer);
 		lock_release(argdata.lock);
 		kfree(path);
 		return ENOMEM;
@@ -440,8 +470,8 @@ sys_execv(userptr_t prog, userptr_t argv)
 	result = copyin_args(argv, &argdata);
 	if (result) {
 		kfree(path);
-		kfree(argdata.buffer);
-		kfree(argdata.offsets);
+		kvfree(argdata.buffer);
+		kvfree(argdata.offsets);
 		lock_release(argdata.lock);
 		return result;
 	}
@@ -450,8 +480,8 @@ sys_execv(userptr_t prog, userptr_t argv)
 	result = loadexec(path, &entrypoint, &stackptr);
 	if (result) {
 		kfree(path);
-		kfree(argdata.buffer);
-		kfree(argdata.offsets);
+		kvfree(argdata.buffer);
+		kvfree(argdata.offsets);
 		lock_release(argdata.lock);
 		return result;
 	}
@@ -470,8 +500,8 @@ sys_execv(userptr_t prog, userptr_t argv)
 	argc = argdata.nargs;
 
 	/* free the argdata space */    
-	kfree(argdata.buffer);
-	kfree(argdata.offsets);
+	kvfree(argdata.buffer);
+	kvfree(argdata.offsets);
 
 	lock_release(argdata.lock);
 
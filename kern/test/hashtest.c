@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <hash.h>
+#include <test.h>
+
+#define TESTSIZE 1500
+
+struct hashitem {
+	uint32_t hi_key;
+	char hi_name[16];
+	bool hi_intable;
+	struct hashlink hi_link;
+	struct hashlink hi_namelink;
+};
+
+#define item_key(it) ((it)->hi_key)
+#define item_name(it) ((const char *)(it)->hi_name)
+#define key_eq(a, b) ((a) == (b))
+#define name_eq(a, b) (strcmp((a), (b)) == 0)
+
+DECLHASH(itemtable, struct hashitem, uint32_t);
+DEFHASH(itemtable, struct hashitem, uint32_t, hi_link,
+	item_key, hash_u32, key_eq, /*no inline*/);
+
+DECLHASH(nametable, struct hashitem, const char *);
+DEFHASH(nametable, struct hashitem, const char *, hi_namelink,
+	item_name, hash_string, name_eq, /*no inline*/);
+
+static struct hashitem items[TESTSIZE];
+
+/* Check that exactly the items marked hi_intable are in the table */
+static
+void
+checktable(struct itemtable *t)
+{
+	struct hashiter iter;
+	struct hashitem *it;
+	unsigned i, n, seen;
+
+	n = 0;
+	for (i=0; i<TESTSIZE; i++) {
+		it = itemtable_lookup(t, items[i].hi_key);
+		if (items[i].hi_intable) {
+			KASSERT(it == &items[i]);
+			n++;
+		}
+		else {
+			KASSERT(it == NULL);
+		}
+	}
+	KASSERT(itemtable_num(t) == n);
+
+	seen = 0;
+	itemtable_iterinit(t, &iter);
+	while ((it = itemtable_iternext(t, &iter)) != NULL) {
+		KASSERT(it->hi_intable);
+		seen++;
+	}
+	KASSERT(seen == n);
+}
+
+static
+void
+testtable(int flags)
+{
+	struct itemtable t;
+	struct hashiter iter;
+	struct hashitem *it;
+	unsigned i;
+	int result;
+
+	result = itemtable_init(&t, 0, flags);
+	KASSERT(result == 0);
+
+	for (i=0; i<TESTSIZE; i++) {
+		/* Sparse, clustered keys, like pids after a while */
+		items[i].hi_key = i * 37 + (i % 3);
+		items[i].hi_intable = false;
+	}
+	checktable(&t);
+
+	/* Insert everything; this grows the table several times */
+	for (i=0; i<TESTSIZE; i++) {
+		itemtable_insert(&t, &items[i]);
+		items[i].hi_intable = true;
+		if (i % 97 == 0) {
+			checktable(&t);
+		}
+	}
+	checktable(&t);
+
+	/* Remove a random subset, without any inserts in between */
+	for (i=0; i<TESTSIZE; i++) {
+		if (random() % 4 != 0) {
+			itemtable_remove(&t, &items[i]);
+			items[i].hi_intable = false;
+		}
+	}
+	checktable(&t);
+
+	/* Put them back in the other order; the first inserts shrink */
+	for (i=TESTSIZE; i-- > 0; ) {
+		if (!items[i].hi_intable) {
+			itemtable_insert(&t, &items[i]);
+			items[i].hi_intable = true;
+		}
+	}
+	checktable(&t);
+
+	/* Empty it by iterating, removing as we go */
+	itemtable_iterinit(&t, &iter);
+	while ((it = itemtable_iternext(&t, &iter)) != NULL) {
+		itemtable_remove(&t, it);
+		it->hi_intable = false;
+	}
+	checktable(&t);
+	KASSERT(itemtable_num(&t) == 0);
+
+	itemtable_cleanup(&t);
+}
+
+static
+void
+testnames(void)
+{
+	struct nametable t;
+	unsigned i;
+	int result;
+
+	result = nametable_init(&t, 4, 0);
+	KASSERT(result == 0);
+
+	for (i=0; i<TESTSIZE; i++) {
+		snprintf(items[i].hi_name, sizeof(items[i].hi_name),
+			 "file%u", i);
+		nametable_insert(&t, &items[i]);
+	}
+	for (i=0; i<TESTSIZE; i++) {
+		char buf[16];
+
+		snprintf(buf, sizeof(buf), "file%u", i);
+		KASSERT(nametable_lookup(&t, buf) == &items[i]);
+	}
+	KASSERT(nametable_lookup(&t, "nosuchfile") == NULL);
+
+	for (i=0; i<TESTSIZE; i++) {
+		nametable_remove(&t, &items[i]);
+	}
+	KASSERT(nametable_num(&t) == 0);
+	nametable_cleanup(&t);
+}
+
+int
+hashtest(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	kprintf("Beginning hash table test...\n");
+	testtable(0);
+	testtable(HASH_LOCKED);
+	testnames();
+	kprintf("Hash table test complete\n");
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmarks for kernel data structures. These print ns/op so
+ * changes to the structures can be compared quickly; they check only
+ * enough to make sure the work isn't optimized away.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <array.h>
+#include <bitmap.h>
+#include <thread.h>
+#include <threadlist.h>
+#include <vm.h>
+#include "khtest.h"
+
+#define BITMAPBITS  32768
+#define ARRAYSIZE   4096
+#define NLISTED     64
+#define KMROUNDS    200000
+#define REPS        200
+
+/*
+ * Allocate every bit, then repeatedly free a random bit and allocate
+ * one again. bitmap_alloc scans from the start, so this measures the
+ * worst case of a nearly full map, as in a full disk's freemap.
+ */
+int
+bitmapbench(int nargs, char **args)
+{
+	struct bitmap *b;
+	unsigned i, idx, got;
+	uint64_t start;
+	unsigned long ops;
+
+	(void)nargs;
+	(void)args;
+
+	b = bitmap_create(BITMAPBITS);
+	KASSERT(b != NULL);
+
+	start = khtest_nsecs();
+	for (i=0; i<BITMAPBITS; i++) {
+		KASSERT(bitmap_alloc(b, &got) == 0);
+	}
+	khtest_report("bitmap_alloc (filling)", BITMAPBITS,
+		      khtest_nsecs() - start);
+
+	ops = 0;
+	start = khtest_nsecs();
+	for (i=0; i<BITMAPBITS; i++) {
+		idx = random() % BITMAPBITS;
+		bitmap_unmark(b, idx);
+		KASSERT(bitmap_alloc(b, &got) == 0);
+		KASSERT(got == idx);
+		ops++;
+	}
+	khtest_report("bitmap unmark+alloc (full map)", ops,
+		      khtest_nsecs() - start);
+
+	ops = 0;
+	start = khtest_nsecs();
+	for (i=0; i<BITMAPBITS*REPS/16; i++) {
+		idx = i % BITMAPBITS;
+		ops += bitmap_isset(b, idx) != 0;
+	}
+	KASSERT(ops == BITMAPBITS*REPS/16);
+	khtest_report("bitmap_isset", ops, khtest_nsecs() - start);
+
+	bitmap_destroy(b);
+	return 0;
+}
+
+/*
+ * Grow an array one element at a time, then empty it from the front
+ * (each remove shifts the rest down) and from the back.
+ */
+int
+arraybench(int nargs, char **args)
+{
+	struct array *a;
+	unsigned i, r;
+	uint64_t start, addtime, fronttime, backtime;
+	static int vals[ARRAYSIZE];
+
+	(void)nargs;
+	(void)args;
+
+	a = array_create();
+	KASSERT(a != NULL);
+
+	addtime = fronttime = backtime = 0;
+	for (r=0; r<REPS; r++) {
+		start = khtest_nsecs();
+		for (i=0; i<ARRAYSIZE; i++) {
+			KASSERT(array_add(a, &vals[i], NULL) == 0);
+		}
+		addtime += khtest_nsecs() - start;
+
+		start = khtest_nsecs();
+		for (i=0; i<ARRAYSIZE/2; i++) {
+			KASSERT(array_get(a, 0) == &vals[i]);
+			array_remove(a, 0);
+		}
+		fronttime += khtest_nsecs() - start;
+
+		start = khtest_nsecs();
+		while (array_num(a) > 0) {
+			KASSERT(array_setsize(a, array_num(a) - 1) == 0);
+		}
+		backtime += khtest_nsecs() - start;
+	}
+	khtest_report("array_add", (unsigned long)ARRAYSIZE*REPS, addtime);
+	khtest_report("array_remove (front)", (unsigned long)ARRAYSIZE/2*REPS,
+		      fronttime);
+	khtest_report("array_setsize (shrink by 1)",
+		      (unsigned long)ARRAYSIZE/2*REPS, backtime);
+
+	array_destroy(a);
+	return 0;
+}
+
+/*
+ * Rotate a run-queue-sized list: remove from the head, add at the
+ * tail, the way the scheduler does.
+ */
+int
+threadlistbench(int nargs, char **args)
+{
+	static struct thread fakethreads[NLISTED];
+	struct threadlist tl;
+	struct thread *t;
+	unsigned long i, ops;
+	uint64_t start;
+
+	(void)nargs;
+	(void)args;
+
+	threadlist_init(&tl);
+	for (i=0; i<NLISTED; i++) {
+		threadlistnode_init(&fakethreads[i].t_listnode,
+				    &fakethreads[i]);
+		threadlist_addtail(&tl, &fakethreads[i]);
+	}
+
+	ops = (unsigned long)NLISTED * REPS * 100;
+	start = khtest_nsecs();
+	for (i=0; i<ops; i++) {
+		t = threadlist_remhead(&tl);
+		threadlist_addtail(&tl, t);
+	}
+	khtest_report("threadlist remhead+addtail", ops,
+		      khtest_nsecs() - start);
+
+	while (threadlist_remhead(&tl) != NULL) {
+		/* nothing */
+	}
+	threadlist_cleanup(&tl);
+	return 0;
+}
+
+/*
+ * kmalloc/kfree pairs of a single size, with a few blocks kept live so
+ * the page isn't released each time.
+ */
+int
+kmallocbench(int nargs, char **args)
+{
+	static const size_t sizes[] = { 16, 64, 512, 2000, 3*PAGE_SIZE };
+	void *keep[4], *p;
+	unsigned s, i;
+	uint64_t start;
+	char what[64];
+
+	(void)nargs;
+	(void)args;
+
+	for (s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+		for (i=0; i<4; i++) {
+			keep[i] = kmalloc(sizes[s]);
+			KASSERT(keep[i] != NULL);
+		}
+
+		start = khtest_nsecs();
+		for (i=0; i<KMROUNDS; i++) {
+			p = kmalloc(sizes[s]);
+			KASSERT(p != NULL);
+			kfree(p);
+		}
+		snprintf(what, sizeof(what), "kmalloc+kfree %lu bytes",
+			 (unsigned long)sizes[s]);
+		khtest_report(what, KMROUNDS, khtest_nsecs() - start);
+
+		for (i=0; i<4; i++) {
+			kfree(keep[i]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _LIB_H_
+#define _LIB_H_
+
+/*
+ * Host shim for the kernel's <lib.h>.
+ *
+ * The string functions and snprintf come from the host C library. Everything else
+ * the harnessed code expects from the kernel (kprintf, panic,
+ * assertions, random numbers) is provided by shim.c. Assertions are
+ * always on.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+void badassert(const char *expr, const char *file, int line,
+	       const char *func);
+
+#define KASSERT(expr) \
+	((expr) ? (void)0 : badassert(#expr, __FILE__, __LINE__, __func__))
+#define DEBUGASSERT(expr) KASSERT(expr)
+
+#define DB_KMALLOC     0x800
+extern uint32_t dbflags;
+#define DEBUG(d, ...) ((dbflags & (d)) ? kprintf(__VA_ARGS__) : 0)
+
+/*
+ * The kernel's random() returns uint32_t, which clashes with the host
+ * libc's; rename it.
+ */
+#define random khtest_random
+#define randmax khtest_randmax
+#define RANDOM_MAX (randmax())
+uint32_t randmax(void);
+uint32_t random(void);
+
+void *kmalloc(size_t size);
+void kfree(void *ptr);
+void kheap_printstats(void);
+char *kstrdup(const char *str);
+
+int kprintf(const char *format, ...) __PF(1,2);
+void panic(const char *format, ...) __PF(1,2);
+
+#define DIVROUNDUP(a,b) (((a)+(b)-1)/(b))
+#define ROUNDUP(a,b)    (DIVROUNDUP(a,b)*b)
+
+#endif /* _LIB_H_ */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _SPINLOCK_H_
+#define _SPINLOCK_H_
+
+/*
+ * Host shim for <spinlock.h>. khtest is single-threaded, so spinlocks
+ * only track whether they're held, to keep the kernel's
+ * spinlock_do_i_hold assertions meaningful.
+ */
+
+struct spinlock {
+	volatile int splk_held;
+};
+
+#define SPINLOCK_INITIALIZER	{ 0 }
+
+static inline void
+spinlock_init(struct spinlock *lk)
+{
+	lk->splk_held = 0;
+}
+
+static inline void
+spinlock_cleanup(struct spinlock *lk)
+{
+	KASSERT(lk->splk_held == 0);
+}
+
+static inline void
+spinlock_acquire(struct spinlock *lk)
+{
+	KASSERT(lk->splk_held == 0);
+	lk->splk_held = 1;
+}
+
+static inline void
+spinlock_release(struct spinlock *lk)
+{
+	KASSERT(lk->splk_held == 1);
+	lk->splk_held = 0;
+}
+
+static inline bool
+spinlock_do_i_hold(struct spinlock *lk)
+{
+	return lk->splk_held != 0;
+}
+
+#endif /* _SPINLOCK_H_ */
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KHTEST_H_
+#define _KHTEST_H_
+
+/*
+ * Declarations for khtest, the host-side kernel data structure harness.
+ *
+ * Tests and benchmarks use the same signature as the kernel menu
+ * tests so that the tests in kern/test can be linked in unchanged.
+ * A test signals failure by tripping a KASSERT (which aborts) or by
+ * returning nonzero.
+ */
+
+/* Tests (besides arraytest and bitmaptest from <test.h>) */
+int kmalloctest_host(int nargs, char **args);
+int threadlisttest(int nargs, char **args);
+int sfsformattest(int nargs, char **args);
+
+/* Benchmarks */
+int bitmapbench(int nargs, char **args);
+int arraybench(int nargs, char **args);
+int threadlistbench(int nargs, char **args);
+int kmallocbench(int nargs, char **args);
+
+/* Timing support, from shim.c: a monotonic clock in nanoseconds */
+uint64_t khtest_nsecs(void);
+
+/* Print one benchmark result line */
+void khtest_report(const char *what, unsigned long ops, uint64_t nsecs);
+
+#endif /* _KHTEST_H_ */
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * khtest: run kernel data structure tests and benchmarks on the host.
+ *
+ * Usage: khtest [-b] [name...]
+ *
+ * With no names, runs every test; with -b, runs every benchmark as
+ * well. Otherwise runs just the named tests and benchmarks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <types.h>
+#include <lib.h>
+#include <test.h>
+#include "khtest.h"
+
+static const struct {
+	const char *name;
+	int (*func)(int, char **);
+	bool isbench;
+} tests[] = {
+	{ "array",	arraytest,		false },
+	{ "bitmap",	bitmaptest,		false },
+	{ "hash",	hashtest,		false },
+	{ "threadlist",	threadlisttest,		false },
+	{ "kmalloc",	kmalloctest_host,	false },
+	{ "sfs",	sfsformattest,		false },
+
+	{ "bitmapbench",	bitmapbench,		true },
+	{ "arraybench",		arraybench,		true },
+	{ "threadlistbench",	threadlistbench,	true },
+	{ "kmallocbench",	kmallocbench,		true },
+};
+static const unsigned ntests = sizeof(tests) / sizeof(tests[0]);
+
+static
+int
+runone(unsigned i)
+{
+	char *args[2];
+	int result;
+
+	args[0] = (char *)tests[i].name;
+	args[1] = NULL;
+
+	printf("=== %s\n", tests[i].name);
+	result = tests[i].func(1, args);
+	if (result) {
+		printf("=== %s: FAILED (%d)\n", tests[i].name, result);
+	}
+	return result;
+}
+
+int
+main(int argc, char **argv)
+{
+	bool dobench = false;
+	unsigned i, nfail = 0;
+	int j;
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		dobench = true;
+		argc--;
+		argv++;
+	}
+
+	if (argc == 1) {
+		for (i=0; i<ntests; i++) {
+			if (!tests[i].isbench || dobench) {
+				nfail += runone(i) != 0;
+			}
+		}
+	}
+	else {
+		for (j=1; j<argc; j++) {
+			for (i=0; i<ntests; i++) {
+				if (!strcmp(argv[j], tests[i].name)) {
+					break;
+				}
+			}
+			if (i == ntests) {
+				fprintf(stderr, "khtest: no test %s\n", argv[j]);
+				exit(2);
+			}
+			nfail += runone(i) != 0;
+		}
+	}
+
+	if (nfail > 0) {
+		printf("khtest: %u failed\n", nfail);
+		return 1;
+	}
+	printf("khtest: all passed\n");
+	return 0;
+}
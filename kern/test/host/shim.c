@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Host implementations of the kernel services the harnessed code
+ * needs: console output, panic and assertions, random numbers, and
+ * page allocation.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Grab the host random() before <lib.h> renames it. */
+static
+long
+hostrandom(void)
+{
+	return random();
+}
+
+#include <types.h>
+#include <lib.h>
+#include <vm.h>
+#include "khtest.h"
+
+uint32_t dbflags = 0;
+unsigned khtest_kallocs;
+
+int
+kprintf(const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = vprintf(fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+void
+panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fflush(stdout);
+	fprintf(stderr, "panic: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+void
+badassert(const char *expr, const char *file, int line, const char *func)
+{
+	panic("Assertion failed: %s, at %s:%d (%s)\n", expr, file, line, func);
+}
+
+uint32_t
+randmax(void)
+{
+	return 0x7fffffff;
+}
+
+uint32_t
+random(void)
+{
+	return hostrandom();
+}
+
+char *
+kstrdup(const char *s)
+{
+	char *z;
+
+	z = kmalloc(strlen(s)+1);
+	if (z == NULL) {
+		return NULL;
+	}
+	strcpy(z, s);
+	return z;
+}
+
+vaddr_t
+alloc_kpages(int npages)
+{
+	void *p;
+
+	p = aligned_alloc(PAGE_SIZE, (size_t)npages * PAGE_SIZE);
+	if (p == NULL) {
+		return 0;
+	}
+	khtest_kallocs++;
+	return (vaddr_t)p;
+}
+
+void
+free_kpages(vaddr_t addr)
+{
+	KASSERT(addr % PAGE_SIZE == 0);
+	KASSERT(khtest_kallocs > 0);
+	khtest_kallocs--;
+	free((void *)addr);
+}
+
+uint64_t
+khtest_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+khtest_report(const char *what, unsigned long ops, uint64_t nsecs)
+{
+	printf("  %-32s %10lu ops %10.1f ns/op\n", what, ops,
+	       ops ? (double)nsecs / ops : 0.0);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Host test for the kmalloc subpage allocator (kern/vm/kmalloc.c).
+ *
+ * Allocates blocks of assorted sizes, fills each with a pattern
+ * derived from its index, frees them in a scrambled order, and checks
+ * that no block was overwritten and that every page went back.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <vm.h>
+#include "khtest.h"
+
+#define NBLOCKS   512
+#define NROUNDS   8
+
+static const size_t sizes[] = {
+	1, 7, 16, 31, 32, 64, 100, 128, 255, 256, 511, 512,
+	1000, 1024, 2047, 2048, 4096, 5000, 3*PAGE_SIZE,
+};
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static
+void
+fill(unsigned char *p, size_t len, unsigned tag)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		p[i] = (unsigned char)(tag + i);
+	}
+}
+
+static
+void
+verify(const unsigned char *p, size_t len, unsigned tag)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		KASSERT(p[i] == (unsigned char)(tag + i));
+	}
+}
+
+int
+kmalloctest_host(int nargs, char **args)
+{
+	static unsigned char *ptrs[NBLOCKS];
+	static size_t lens[NBLOCKS];
+	unsigned baseline, round, i, j, tmp;
+	static unsigned order[NBLOCKS];
+
+	(void)nargs;
+	(void)args;
+
+	baseline = khtest_kallocs;
+
+	for (round=0; round<NROUNDS; round++) {
+		for (i=0; i<NBLOCKS; i++) {
+			lens[i] = sizes[random() % NSIZES];
+			ptrs[i] = kmalloc(lens[i]);
+			KASSERT(ptrs[i] != NULL);
+			fill(ptrs[i], lens[i], i);
+			order[i] = i;
+		}
+
+		/* Shuffle the free order */
+		for (i=NBLOCKS-1; i>0; i--) {
+			j = random() % (i+1);
+			tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+
+		/* Free half, check the rest are intact, then free those */
+		for (i=0; i<NBLOCKS/2; i++) {
+			j = order[i];
+			verify(ptrs[j], lens[j], j);
+			kfree(ptrs[j]);
+			ptrs[j] = NULL;
+		}
+		for (i=NBLOCKS/2; i<NBLOCKS; i++) {
+			j = order[i];
+			verify(ptrs[j], lens[j], j);
+			kfree(ptrs[j]);
+		}
+
+		/* Every page should have been given back */
+		KASSERT(khtest_kallocs == baseline);
+	}
+
+	kfree(NULL);
+
+	kprintf("kmalloc test: %u rounds of %u blocks\n", NROUNDS, NBLOCKS);
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Host test for the SFS on-disk definitions in <kern/sfs.h>: structure
+ * sizes, and the block-size-dependent layout macros for every legal
+ * block size.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <kern/sfs.h>
+#include "khtest.h"
+
+int
+sfsformattest(int nargs, char **args)
+{
+	static const uint32_t nblockss[] = { 1, 4095, 4096, 4097, 100000 };
+	uint32_t bs, nblocks;
+	unsigned i, nok;
+
+	(void)nargs;
+	(void)args;
+
+	KASSERT(sizeof(struct sfs_super) == SFS_BLOCKSIZE);
+	KASSERT(sizeof(struct sfs_inode) == SFS_BLOCKSIZE);
+	KASSERT(SFS_BLOCKSIZE % sizeof(struct sfs_dir) == 0);
+	KASSERT(sizeof(struct sfs_dir) == 64);
+
+	nok = 0;
+	for (bs = 1; bs <= 2*SFS_MAXBLOCKSIZE; bs++) {
+		if (!SFS_BLOCKSIZE_OK(bs)) {
+			continue;
+		}
+		nok++;
+
+		KASSERT(bs >= SFS_BLOCKSIZE && bs <= SFS_MAXBLOCKSIZE);
+		KASSERT((bs & (bs-1)) == 0);
+		KASSERT(bs % sizeof(struct sfs_dir) == 0);
+		KASSERT(SFS_DBPERIDB(bs) * sizeof(uint32_t) == bs);
+		KASSERT(SFS_BLOCKBITS(bs) == bs * CHAR_BIT);
+
+		for (i=0; i<sizeof(nblockss)/sizeof(nblockss[0]); i++) {
+			nblocks = nblockss[i];
+			KASSERT(SFS_BITMAPSIZE(nblocks, bs) >= nblocks);
+			KASSERT(SFS_BITMAPSIZE(nblocks, bs) % 
+				SFS_BLOCKBITS(bs) == 0);
+			KASSERT(SFS_BITBLOCKS(nblocks, bs) ==
+				DIVROUNDUP(nblocks, SFS_BLOCKBITS(bs)));
+		}
+	}
+
+	/* 512, 1024, 2048, 4096, 8192 */
+	KASSERT(nok == 5);
+
+	kprintf("sfs format test done\n");
+	return 0;
+}
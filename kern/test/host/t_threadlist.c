@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Host test for the thread list code (kern/thread/threadlist.c).
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <thread.h>
+#include <threadlist.h>
+#include "khtest.h"
+
+#define NTHREADS 17
+
+static struct thread fakethreads[NTHREADS];
+
+/* Check that TL holds exactly the threads in EXPECT, in order */
+static
+void
+checklist(struct threadlist *tl, const int *expect, unsigned n)
+{
+	struct threadlistnode *tln;
+	unsigned i;
+
+	KASSERT(tl->tl_count == n);
+	KASSERT(threadlist_isempty(tl) == (n == 0));
+
+	tln = tl->tl_head.tln_next;
+	for (i=0; i<n; i++) {
+		KASSERT(tln->tln_self == &fakethreads[expect[i]]);
+		KASSERT(tln->tln_next->tln_prev == tln);
+		tln = tln->tln_next;
+	}
+	KASSERT(tln == &tl->tl_tail);
+}
+
+int
+threadlisttest(int nargs, char **args)
+{
+	struct threadlist tl;
+	struct thread *t;
+	unsigned i;
+
+	(void)nargs;
+	(void)args;
+
+	for (i=0; i<NTHREADS; i++) {
+		fakethreads[i].t_name = "fake";
+		threadlistnode_init(&fakethreads[i].t_listnode,
+				    &fakethreads[i]);
+	}
+
+	threadlist_init(&tl);
+	checklist(&tl, NULL, 0);
+	KASSERT(threadlist_remhead(&tl) == NULL);
+	KASSERT(threadlist_remtail(&tl) == NULL);
+
+	threadlist_addtail(&tl, &fakethreads[1]);
+	threadlist_addhead(&tl, &fakethreads[0]);
+	threadlist_addtail(&tl, &fakethreads[3]);
+	{
+		static const int e[] = { 0, 1, 3 };
+		checklist(&tl, e, 3);
+	}
+
+	threadlist_insertafter(&tl, &fakethreads[1], &fakethreads[2]);
+	threadlist_insertbefore(&tl, &fakethreads[4], &fakethreads[0]);
+	{
+		static const int e[] = { 4, 0, 1, 2, 3 };
+		checklist(&tl, e, 5);
+	}
+
+	threadlist_remove(&tl, &fakethreads[1]);
+	{
+		static const int e[] = { 4, 0, 2, 3 };
+		checklist(&tl, e, 4);
+	}
+
+	t = threadlist_remhead(&tl);
+	KASSERT(t == &fakethreads[4]);
+	t = threadlist_remtail(&tl);
+	KASSERT(t == &fakethreads[3]);
+	{
+		static const int e[] = { 0, 2 };
+		checklist(&tl, e, 2);
+	}
+
+	/* Drain, then fill with everything and drain from the back */
+	while (threadlist_remhead(&tl) != NULL) {
+		/* nothing */
+	}
+	checklist(&tl, NULL, 0);
+
+	for (i=0; i<NTHREADS; i++) {
+		threadlist_addtail(&tl, &fakethreads[i]);
+	}
+	KASSERT(tl.tl_count == NTHREADS);
+	for (i=NTHREADS; i-- > 0; ) {
+		t = threadlist_remtail(&tl);
+		KASSERT(t == &fakethreads[i]);
+	}
+	checklist(&tl, NULL, 0);
+
+	threadlist_cleanup(&tl);
+	for (i=0; i<NTHREADS; i++) {
+		threadlistnode_cleanup(&fakethreads[i].t_listnode);
+	}
+
+	kprintf("threadlist test done\n");
+	return 0;
+}
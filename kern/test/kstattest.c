@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Test code for kernel statistics and the kstat: filesystem.
+ */
+#include <types.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <thread.h>
+#include <synch.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <kstat.h>
+#include <test.h>
+
+/*
+ * Bump a counter from several threads at once (which, given more
+ * than one CPU, lands in several per-CPU slots), then check that the
+ * total comes back right both from kstat_value and by reading the
+ * file in kstat:.
+ */
+
+#define NTHREADS	8
+#define NINCS		1000
+
+static KSTAT_COUNTER(kstattest_count, "test.count");
+static bool kstattest_registered;
+
+static struct semaphore *kstattest_done;
+
+static
+void
+kstattest_thread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<NINCS; i++) {
+		kstat_inc(&kstattest_count);
+		if (i % 100 == 0) {
+			thread_yield();
+		}
+	}
+	V(kstattest_done);
+}
+
+/*
+ * Read kstat:NAME into BUF as a string.
+ */
+static
+void
+kstattest_readfile(const char *name, char *buf, size_t len)
+{
+	char path[64];
+	struct vnode *v;
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	snprintf(path, sizeof(path), "kstat:%s", name);
+	result = vfs_open(path, O_RDONLY, 0, &v);
+	if (result) {
+		panic("kstattest: %s: %s\n", path, strerror(result));
+	}
+	uio_kinit(&iov, &ku, buf, len - 1, 0, UIO_READ);
+	result = VOP_READ(v, &ku);
+	if (result) {
+		panic("kstattest: read %s: %s\n", path, strerror(result));
+	}
+	buf[len - 1 - ku.uio_resid] = 0;
+	vfs_close(v);
+}
+
+int
+kstattest(int nargs, char **args)
+{
+	unsigned long start, expect;
+	char buf[32], want[32];
+	unsigned i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting kstat test...\n");
+
+	if (!kstattest_registered) {
+		kstat_register(&kstattest_count);
+		kstattest_registered = true;
+	}
+	if (kstat_find("test.count") != &kstattest_count) {
+		panic("kstattest: kstat_find failed\n");
+	}
+
+	kstattest_done = sem_create("kstattest", 0);
+	if (kstattest_done == NULL) {
+		panic("kstattest: sem_create failed\n");
+	}
+
+	start = kstat_value(&kstattest_count);
+	for (i=0; i<NTHREADS; i++) {
+		result = thread_fork("kstattest", kstattest_thread,
+				     NULL, i, NULL);
+		if (result) {
+			panic("kstattest: thread_fork: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NTHREADS; i++) {
+		P(kstattest_done);
+	}
+	sem_destroy(kstattest_done);
+
+	expect = start + NTHREADS * NINCS;
+	if (kstat_value(&kstattest_count) != expect) {
+		panic("kstattest: count is %lu, expected %lu\n",
+		      kstat_value(&kstattest_count), expect);
+	}
+
+	kstattest_readfile("test.count", buf, sizeof(buf));
+	snprintf(want, sizeof(want), "%lu\n", expect);
+	if (strcmp(buf, want)) {
+		panic("kstattest: kstat:test.count says %s", buf);
+	}
+
+	kstattest_readfile("sched.switches", buf, sizeof(buf));
+	kprintf("sched.switches: %s", buf);
+
+	kprintf("kstat test done\n");
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Test code for the page operation engine.
+ */
+#include <types.h>
+#include <lib.h>
+#include <vm.h>
+#include <pageop.h>
+#include <test.h>
+
+/*
+ * Copy half the pages and zero the others, in a batch big enough to
+ * run more than once, and check every byte came out right. Other
+ * CPUs help if they're idle, which they generally are when the menu
+ * is running a test.
+ */
+
+#define NPAGES		(PAGEBATCH_MAX + PAGEBATCH_MAX / 2)
+#define NROUNDS		8
+
+static vaddr_t srcpages[NPAGES];
+static vaddr_t dstpages[NPAGES];
+
+static
+unsigned char
+pageoptest_byte(unsigned page, unsigned offset, unsigned round)
+{
+	return (page * 7 + offset * 3 + round) & 0xff;
+}
+
+int
+pageoptest(int nargs, char **args)
+{
+	struct pagebatch pb;
+	unsigned char *p, *q;
+	unsigned round, i, j;
+	unsigned char want;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting pageop test...\n");
+
+	for (i=0; i<NPAGES; i++) {
+		srcpages[i] = alloc_kpages(1);
+		dstpages[i] = alloc_kpages(1);
+		if (srcpages[i] == 0 || dstpages[i] == 0) {
+			panic("pageoptest: Out of memory\n");
+		}
+	}
+
+	for (round=0; round<NROUNDS; round++) {
+		for (i=0; i<NPAGES; i++) {
+			p = (unsigned char *)srcpages[i];
+			q = (unsigned char *)dstpages[i];
+			for (j=0; j<PAGE_SIZE; j++) {
+				p[j] = pageoptest_byte(i, j, round);
+				q[j] = 0xa5;
+			}
+		}
+
+		pagebatch_init(&pb);
+		for (i=0; i<NPAGES; i++) {
+			if (i % 2 == 0) {
+				pagebatch_copy(&pb, dstpages[i], srcpages[i]);
+			}
+			else {
+				pagebatch_zero(&pb, dstpages[i]);
+			}
+		}
+		pagebatch_cleanup(&pb);
+
+		for (i=0; i<NPAGES; i++) {
+			p = (unsigned char *)dstpages[i];
+			for (j=0; j<PAGE_SIZE; j++) {
+				want = (i % 2 == 0) ?
+					pageoptest_byte(i, j, round) : 0;
+				if (p[j] != want) {
+					panic("pageoptest: round %u page %u "
+					      "byte %u: got %u, expected %u\n",
+					      round, i, j, p[j], want);
+				}
+			}
+		}
+		kprintf(".");
+	}
+	kprintf("\n");
+
+	for (i=0; i<NPAGES; i++) {
+		free_kpages(srcpages[i]);
+		free_kpages(dstpages[i]);
+	}
+
+	kprintf("pageop test done\n");
+	return 0;
+}
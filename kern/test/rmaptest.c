@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Test code for the frame reverse map.
+ */
+#include <types.h>
+#include <lib.h>
+#include <synch.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <elf.h>
+#include <test.h>
+
+/*
+ * Build an address space with a few pages in it, check that each
+ * frame's reverse map names exactly that address space and page;
+ * copy it and check that the copy's frames name the copy; add a
+ * second mapping of one frame by hand and check that both show up
+ * and that the frame survives dropping one of them.
+ */
+
+#define BASE    0x400000
+#define NPAGES  8
+
+struct rmapcount {
+	struct addrspace *rc_as;
+	vaddr_t rc_vaddr;
+	unsigned rc_count;		/* mappings seen */
+	unsigned rc_matches;		/* of which (rc_as, rc_vaddr) */
+};
+
+static
+void
+rmaptest_visit(struct addrspace *as, vaddr_t vaddr, void *data)
+{
+	struct rmapcount *rc = data;
+
+	rc->rc_count++;
+	if (as == rc->rc_as && vaddr == rc->rc_vaddr) {
+		rc->rc_matches++;
+	}
+}
+
+static
+void
+rmaptest_check(struct addrspace *as, vaddr_t vaddr, unsigned count)
+{
+	struct rmapcount rc;
+	vaddr_t kva;
+
+	if (as_translate(as, vaddr, &kva)) {
+		panic("rmaptest: 0x%x not mapped\n", vaddr);
+	}
+	rc.rc_as = as;
+	rc.rc_vaddr = vaddr;
+	rc.rc_count = rc.rc_matches = 0;
+	rmap_walk(kva & PAGE_FRAME, rmaptest_visit, &rc);
+	if (rc.rc_count != count || rc.rc_matches != 1) {
+		panic("rmaptest: 0x%x: %u mappings, %u matching; "
+		      "expected %u and 1\n", vaddr, rc.rc_count,
+		      rc.rc_matches, count);
+	}
+}
+
+int
+rmaptest(int nargs, char **args)
+{
+	struct addrspace *as, *copy;
+	vaddr_t va, kva;
+	unsigned i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting rmap test...\n");
+
+	as = as_create();
+	if (as == NULL) {
+		panic("rmaptest: as_create failed\n");
+	}
+	result = as_define_region(as, BASE, NPAGES * PAGE_SIZE, PF_R, PF_W, 0);
+	if (result) {
+		panic("rmaptest: as_define_region: %s\n", strerror(result));
+	}
+	for (i=0; i<NPAGES; i++) {
+		lock_acquire(as->as_lock);
+		result = vm_prefault(as, BASE + i * PAGE_SIZE, NULL);
+		lock_release(as->as_lock);
+		if (result) {
+			panic("rmaptest: vm_prefault: %s\n", strerror(result));
+		}
+		rmaptest_check(as, BASE + i * PAGE_SIZE, 1);
+	}
+
+	result = as_copy(as, &copy);
+	if (result) {
+		panic("rmaptest: as_copy: %s\n", strerror(result));
+	}
+	for (i=0; i<NPAGES; i++) {
+		rmaptest_check(copy, BASE + i * PAGE_SIZE, 1);
+	}
+	as_destroy(copy);
+
+	/*
+	 * Record a second mapping of the first frame (one page up; the
+	 * page table isn't touched) and take it away again.
+	 */
+	va = BASE + PAGE_SIZE;
+	as_translate(as, BASE, &kva);
+	result = rmap_add(kva, as, va);
+	if (result) {
+		panic("rmaptest: rmap_add: %s\n", strerror(result));
+	}
+	rmaptest_check(as, BASE, 2);
+	free_upage(as, kva, va);
+	rmaptest_check(as, BASE, 1);
+
+	as_destroy(as);
+
+	kprintf("rmap test done\n");
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Test code for the TLB update layer.
+ */
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <vm.h>
+#include <vmalloc.h>
+#include <machine/tlb.h>
+#include <test.h>
+
+/*
+ * Touch every page of a vmalloc buffer so it gets loaded, and check
+ * nothing is in the TLB twice; then invalidate a short range (which
+ * probes) and the whole buffer (which is long enough to scan), check
+ * the pages are gone each time, and check the data survives being
+ * faulted back in.
+ */
+
+#define NPAGES		(VM_TLBSCAN * 2)
+
+static
+void
+tlbtest_touch(unsigned char *buf, unsigned round)
+{
+	unsigned i;
+
+	for (i=0; i<NPAGES; i++) {
+		buf[i * PAGE_SIZE + i] = (unsigned char)(i + round);
+	}
+}
+
+static
+void
+tlbtest_check(unsigned char *buf, unsigned round)
+{
+	unsigned i;
+
+	for (i=0; i<NPAGES; i++) {
+		if (buf[i * PAGE_SIZE + i] != (unsigned char)(i + round)) {
+			panic("tlbtest: page %u lost its contents\n", i);
+		}
+	}
+}
+
+/*
+ * Check no two valid TLB entries are for the same page.
+ */
+static
+void
+tlbtest_nodups(void)
+{
+	uint32_t ehi[NUM_TLB], elo;
+	bool valid[NUM_TLB];
+	int i, j, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_read(&ehi[i], &elo, i);
+		valid[i] = (elo & TLBLO_VALID) != 0;
+	}
+	splx(spl);
+
+	for (i=0; i<NUM_TLB; i++) {
+		for (j=i+1; j<NUM_TLB; j++) {
+			if (valid[i] && valid[j] &&
+			    (ehi[i] & TLBHI_VPAGE) == (ehi[j] & TLBHI_VPAGE)) {
+				panic("tlbtest: 0x%x is in the TLB twice\n",
+				      ehi[i] & TLBHI_VPAGE);
+			}
+		}
+	}
+}
+
+/*
+ * Invalidate NPG pages from page FIRST of BUF and check they're gone.
+ */
+static
+void
+tlbtest_invalidate(unsigned char *buf, unsigned first, unsigned npg)
+{
+	vaddr_t va;
+	unsigned i;
+	int spl;
+
+	spl = splhigh();
+	va = (vaddr_t)buf + first * PAGE_SIZE;
+	vm_tlbinvalidate(va, npg);
+	for (i=0; i<npg; i++) {
+		if (tlb_probe(va + i * PAGE_SIZE, 0) >= 0) {
+			panic("tlbtest: 0x%x still in the TLB\n",
+			      va + i * PAGE_SIZE);
+		}
+	}
+	splx(spl);
+}
+
+int
+tlbtest(int nargs, char **args)
+{
+	unsigned char *buf;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting TLB test...\n");
+
+	buf = vmalloc(NPAGES * PAGE_SIZE);
+	if (buf == NULL) {
+		panic("tlbtest: vmalloc failed\n");
+	}
+
+	tlbtest_touch(buf, 0);
+	tlbtest_touch(buf, 1);
+	tlbtest_nodups();
+
+	tlbtest_invalidate(buf, 1, 2);
+	tlbtest_check(buf, 1);
+	tlbtest_nodups();
+
+	tlbtest_invalidate(buf, 0, NPAGES);
+	tlbtest_check(buf, 1);
+	tlbtest_touch(buf, 2);
+	tlbtest_nodups();
+
+	vfree(buf);
+
+	kprintf("TLB test done\n");
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Test code for vmalloc.
+ */
+#include <types.h>
+#include <lib.h>
+#include <vm.h>
+#include <vmalloc.h>
+#include <test.h>
+
+/*
+ * Allocate NBUFS buffers of increasing size, each several pages, fill
+ * each with a pattern, and check the patterns after all of them are
+ * allocated; then free every other one and allocate again so that
+ * freed address space gets reused.
+ */
+
+#define NBUFS     8
+#define BASESIZE  (3 * PAGE_SIZE + 17)
+
+static
+void
+vmalloc_fill(unsigned char *p, size_t len, unsigned seed)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		p[i] = (unsigned char)(i * 7 + seed);
+	}
+}
+
+static
+void
+vmalloc_check(unsigned char *p, size_t len, unsigned seed)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		if (p[i] != (unsigned char)(i * 7 + seed)) {
+			panic("vmalloctest: buffer %u offset %u corrupted\n",
+			      seed, (unsigned)i);
+		}
+	}
+}
+
+int
+vmalloctest(int nargs, char **args)
+{
+	unsigned char *bufs[NBUFS];
+	size_t sizes[NBUFS];
+	unsigned i, pass;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting vmalloc test...\n");
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i=pass; i<NBUFS; i += pass + 1) {
+			sizes[i] = BASESIZE * (i + 1);
+			bufs[i] = vmalloc(sizes[i]);
+			if (bufs[i] == NULL) {
+				panic("vmalloctest: vmalloc of %u bytes failed\n",
+				      (unsigned)sizes[i]);
+			}
+			KASSERT((vaddr_t)bufs[i] >= VMALLOC_BASE);
+			vmalloc_fill(bufs[i], sizes[i], i);
+		}
+		for (i=0; i<NBUFS; i++) {
+			vmalloc_check(bufs[i], sizes[i], i);
+		}
+		for (i=1; i<NBUFS; i += 2) {
+			vfree(bufs[i]);
+		}
+	}
+	for (i=0; i<NBUFS; i += 2) {
+		vfree(bufs[i]);
+	}
+
+	/* kvmalloc should take both paths */
+	bufs[0] = kvmalloc(16);
+	bufs[1] = kvmalloc(BASESIZE);
+	if (bufs[0] == NULL || bufs[1] == NULL) {
+		panic("vmalloctest: kvmalloc failed\n");
+	}
+	KASSERT((vaddr_t)bufs[0] < VMALLOC_BASE);
+	KASSERT((vaddr_t)bufs[1] >= VMALLOC_BASE);
+	kvfree(bufs[0]);
+	kvfree(bufs[1]);
+
+	kprintf("vmalloc test done\n");
+	return 0;
+}
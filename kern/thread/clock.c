@@ -34,6 +34,8 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <vm.h>
+#include <dmesg.h>
 
 /*
  * Time handling.
@@ -52,12 +54,26 @@
  */
 #define SCHEDULE_HARDCLOCKS	4	/* Reschedule every 4 hardclocks. */
 #define MIGRATE_HARDCLOCKS	16	/* Migrate every 16 hardclocks. */
+#define WORKINGSET_HARDCLOCKS	25	/* Working-set window length. */
 
 /*
  * Once a second, everything waiting on lbolt is awakened by CPU 0.
  */
 static struct wchan *lbolt;
 
+/*
+ * Load averages over 1, 5 and 15 seconds, in fixed point with
+ * LOAD_FSCALE as 1.0. Each second they move toward the number of
+ * active threads by 1 - exp(-1/period) of the difference, so
+ * loadexp[] holds exp(-1/1), exp(-1/5), exp(-1/15) in fixed point.
+ * Updated only by timerclock; read without locking.
+ */
+#define LOAD_FSHIFT	11
+#define LOAD_FSCALE	(1U << LOAD_FSHIFT)
+
+static volatile unsigned loadavg[3];
+static const unsigned loadexp[3] = { 753, 1677, 1916 };
+
 /*
  * Setup.
  */
@@ -77,10 +93,32 @@ hardclock_bootstrap(void)
 void
 timerclock(void)
 {
-	/* Just broadcast on lbolt */
+	unsigned n, i;
+
+	n = thread_nactive();
+	for (i=0; i<3; i++) {
+		loadavg[i] = (loadavg[i] * loadexp[i] +
+			      (n << LOAD_FSHIFT) * (LOAD_FSCALE - loadexp[i]))
+			>> LOAD_FSHIFT;
+	}
+
 	wchan_wakeall(lbolt);
 }
 
+/*
+ * Fetch the load averages. Returns the fixed-point scale.
+ */
+unsigned
+clock_getload(unsigned *load)
+{
+	unsigned i;
+
+	for (i=0; i<3; i++) {
+		load[i] = loadavg[i];
+	}
+	return LOAD_FSCALE;
+}
+
 /*
  * This is called HZ times a second (on each processor) by the timer
  * code.
@@ -99,6 +137,15 @@ hardclock(void)
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
+	if (curcpu->c_number == 0 &&
+	    (curcpu->c_hardclocks % WORKINGSET_HARDCLOCKS) == 0) {
+		vm_wstick();
+	}
+	vm_wscheck();
+	if (curcpu->c_number == 0 &&
+	    (curcpu->c_hardclocks % DMESG_HARDCLOCKS) == 0) {
+		dmesg_tick();
+	}
 	thread_yield();
 }
 
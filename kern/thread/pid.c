@@ -37,6 +37,7 @@
 #include <limits.h>
 #include <lib.h>
 #include <array.h>
+#include <hash.h>
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
@@ -56,19 +57,26 @@ struct pidinfo {
 	volatile bool pi_exited;	// true if thread has exited
 	int pi_exitstatus;		// status (only valid if exited)
 	struct cv *pi_cv;		// use to wait for thread exit
+	struct hashlink pi_hashlink;	// link in pidtable
 };
 
+#define pidinfo_pid(pi)	((pi)->pi_pid)
+#define pid_eq(a, b)	((a) == (b))
+#define pid_hash(pid)	hash_u32((uint32_t)(pid))
+
+DECLHASH(pidtable, struct pidinfo, pid_t);
+DEFHASH(pidtable, struct pidinfo, pid_t, pi_hashlink,
+	pidinfo_pid, pid_hash, pid_eq, /*no inline*/);
+
 
 /*
  * Global pid and exit data.
  *
- * The process table is an el-cheapo hash table. It's indexed by
- * (pid % PROCS_MAX), and only allows one process per slot. If a
- * new pid allocation would cause a hash collision, we just don't
- * use that pid.
+ * The process table is a hash table keyed by pid, so any pid not
+ * currently in use can be handed out. It's protected by pidlock.
  */
 static struct lock *pidlock;		// lock for global exit data
-static struct pidinfo *pidinfo[PROCS_MAX]; // actual pid info
+static struct pidtable pidtable;	// actual pid info
 static pid_t nextpid;			// next candidate pid
 static int nprocs;			// number of allocated pids
 
@@ -125,22 +133,22 @@ pidinfo_destroy(struct pidinfo *pi)
 void
 pid_bootstrap(void)
 {
-	int i;
+	struct pidinfo *pi;
 
 	pidlock = lock_create("pidlock");
 	if (pidlock == NULL) {
 		panic("Out of memory creating pid lock\n");
 	}
 
-	/* not really necessary - should start zeroed */
-	for (i=0; i<PROCS_MAX; i++) {
-		pidinfo[i] = NULL;
+	if (pidtable_init(&pidtable, 0, 0)) {
+		panic("Out of memory creating pid table\n");
 	}
 
-	pidinfo[BOOTUP_PID] = pidinfo_create(BOOTUP_PID, INVALID_PID);
-	if (pidinfo[BOOTUP_PID]==NULL) {
+	pi = pidinfo_create(BOOTUP_PID, INVALID_PID);
+	if (pi==NULL) {
 		panic("Out of memory creating bootup pid data\n");
 	}
+	pidtable_insert(&pidtable, pi);
 
 	nextpid = PID_MIN;
 	nprocs = 1;
@@ -153,25 +161,16 @@ static
 struct pidinfo *
 pi_get(pid_t pid)
 {
-	struct pidinfo *pi;
-
 	KASSERT(pid>=0);
 	KASSERT(pid != INVALID_PID);
 	KASSERT(lock_do_i_hold(pidlock));
 
-	pi = pidinfo[pid % PROCS_MAX];
-	if (pi==NULL) {
-		return NULL;
-	}
-	if (pi->pi_pid != pid) {
-		return NULL;
-	}
-	return pi;
+	return pidtable_lookup(&pidtable, pid);
 }
 
 /*
- * pi_put: insert a new pidinfo in the process table. The right slot
- * must be empty.
+ * pi_put: insert a new pidinfo in the process table. The pid must not
+ * already be in use.
  */
 static
 void
@@ -180,9 +179,10 @@ pi_put(pid_t pid, struct pidinfo *pi)
 	KASSERT(lock_do_i_hold(pidlock));
 
 	KASSERT(pid != INVALID_PID);
+	KASSERT(pi->pi_pid == pid);
 
-	KASSERT(pidinfo[pid % PROCS_MAX] == NULL);
-	pidinfo[pid % PROCS_MAX] = pi;
+	KASSERT(pi_get(pid) == NULL);
+	pidtable_insert(&pidtable, pi);
 	nprocs++;
 }
 
@@ -199,12 +199,11 @@ pi_drop(pid_t pid)
 
 	KASSERT(lock_do_i_hold(pidlock));
 
-	pi = pidinfo[pid % PROCS_MAX];
+	pi = pi_get(pid);
 	KASSERT(pi != NULL);
-	KASSERT(pi->pi_pid == pid);
 
+	pidtable_remove(&pidtable, pi);
 	pidinfo_destroy(pi);
-	pidinfo[pid % PROCS_MAX] = NULL;
 	nprocs--;
 }
 
@@ -251,7 +250,7 @@ pid_alloc(pid_t *retval)
 	 * forever.
 	 */
 	count = 0;
-	while (pidinfo[nextpid % PROCS_MAX] != NULL) {
+	while (pi_get(nextpid) != NULL) {
 
 		/* avoid various boundary cases by allowing extra loops */
 		KASSERT(count < PROCS_MAX*2+5);
@@ -339,22 +338,20 @@ pid_disown(pid_t theirpid)
 void
 pid_setexitstatus(int status)
 {
-	struct pidinfo *us;
-	int i;
+	struct pidinfo *us, *pi;
+	struct hashiter iter;
 
 	KASSERT(curthread->t_pid != INVALID_PID);
 
 	lock_acquire(pidlock);
 
-	/* First, disown all children */
-	for (i=0; i<PROCS_MAX; i++) {
-		if (pidinfo[i]==NULL) {
-			continue;
-		}
-		if (pidinfo[i]->pi_ppid == curthread->t_pid) {
-			pidinfo[i]->pi_ppid = INVALID_PID;
-			if (pidinfo[i]->pi_exited) {
-				pi_drop(pidinfo[i]->pi_pid);
+	/* First, disown all children (dropping one mid-iteration is ok) */
+	pidtable_iterinit(&pidtable, &iter);
+	while ((pi = pidtable_iternext(&pidtable, &iter)) != NULL) {
+		if (pi->pi_ppid == curthread->t_pid) {
+			pi->pi_ppid = INVALID_PID;
+			if (pi->pi_exited) {
+				pi_drop(pi->pi_pid);
 			}
 		}
 	}
@@ -51,6 +51,11 @@
 #include <vnode.h>
 #include <pid.h>
 #include <file.h>
+#include <ioring.h>
+#include <aio.h>
+#include <kstat.h>
+#include <clock.h>
+#include <pageop.h>
 
 #include "opt-synchprobs.h"
 
@@ -70,6 +75,17 @@ DECLARRAY(cpu);
 DEFARRAY(cpu, /*no inline*/ );
 static struct cpuarray allcpus;
 
+/* Scheduler statistics. */
+static unsigned long thread_nrunnable(void);
+static KSTAT_COUNTER(sched_switches, "sched.switches");
+static KSTAT_GAUGE(sched_runnable, "sched.runnable", thread_nrunnable);
+
+/*
+ * Set once the clock is attached; until then runnable threads aren't
+ * timestamped and the latency histogram isn't kept.
+ */
+static bool thread_timing;
+
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
@@ -158,6 +174,15 @@ thread_create(const char *name)
 	/* VFS fields */
 	thread->t_cwd = NULL;
 	thread->t_filetable = NULL;
+	thread->t_ioring = NULL;
+	thread->t_aio = NULL;
+
+	/* Scheduling latency */
+	thread->t_readysecs = 0;
+	thread->t_readynsecs = 0;
+	thread->t_nwaits = 0;
+	thread->t_waitms = 0;
+	thread->t_waitus = 0;
 
 	/* If you add to struct thread, be sure to initialize here */
 
@@ -190,15 +215,22 @@ cpu_create(unsigned hardware_number)
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
+	c->c_wsepoch = 0;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
 	spinlock_init(&c->c_runqueue_lock);
+	bzero(c->c_latency, sizeof(c->c_latency));
 
 	c->c_ipi_pending = 0;
 	c->c_numshootdown = 0;
 	spinlock_init(&c->c_ipi_lock);
 
+	c->c_pageops = NULL;
+	spinlock_init(&c->c_pageop_lock);
+
+	dmesg_init(&c->c_dmesg);
+
 	result = cpuarray_add(&allcpus, c, &c->c_number);
 	if (result != 0) {
 		panic("cpu_create: array_add: %s\n", strerror(result));
@@ -264,6 +296,8 @@ thread_destroy(struct thread *thread)
 	/* VFS fields, cleaned up in thread_exit */
 	KASSERT(thread->t_cwd == NULL);
 	KASSERT(thread->t_filetable == NULL);
+	KASSERT(thread->t_ioring == NULL);
+	KASSERT(thread->t_aio == NULL);
 
 	/* VM fields, cleaned up in thread_exit */
 	KASSERT(thread->t_addrspace == NULL);
@@ -360,6 +394,113 @@ thread_shutdown(void)
 	ipi_broadcast(IPI_OFFLINE);
 }
 
+/*
+ * Total number of threads waiting on run queues, for the
+ * sched.runnable kstat.
+ */
+static
+unsigned long
+thread_nrunnable(void)
+{
+	unsigned long total;
+	unsigned i, numcpus;
+	struct cpu *c;
+
+	total = 0;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		spinlock_acquire(&c->c_runqueue_lock);
+		total += c->c_runqueue.tl_count;
+		spinlock_release(&c->c_runqueue_lock);
+	}
+	return total;
+}
+
+/*
+ * Fill in CPUS with up to MAX cpus other than this one that are idle
+ * right now, and return how many. Only a hint: they may well not be
+ * idle by the time anyone acts on it.
+ */
+unsigned
+thread_idlecpus(struct cpu **cpus, unsigned max)
+{
+	unsigned i, n, numcpus;
+	struct cpu *c;
+
+	n = 0;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus && n<max; i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self && c->c_isidle) {
+			cpus[n++] = c;
+		}
+	}
+	return n;
+}
+
+/*
+ * CPU number NUM, for NUM less than thread_numcpus().
+ */
+struct cpu *
+thread_getcpu(unsigned num)
+{
+	return cpuarray_get(&allcpus, num);
+}
+
+/*
+ * Number of CPUs.
+ */
+unsigned
+thread_numcpus(void)
+{
+	return cpuarray_num(&allcpus);
+}
+
+/*
+ * Number of threads running or waiting to run, for the load average.
+ */
+unsigned
+thread_nactive(void)
+{
+	unsigned total, i, numcpus;
+	struct cpu *c;
+
+	total = 0;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		spinlock_acquire(&c->c_runqueue_lock);
+		total += c->c_runqueue.tl_count;
+		if (!c->c_isidle) {
+			total++;
+		}
+		spinlock_release(&c->c_runqueue_lock);
+	}
+	return total;
+}
+
+/*
+ * Sum the run-queue wait histograms of all cpus into HIST.
+ */
+void
+thread_getlatency(unsigned *hist)
+{
+	unsigned i, j, numcpus;
+	struct cpu *c;
+
+	bzero(hist, LATENCY_NBUCKETS * sizeof(hist[0]));
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		spinlock_acquire(&c->c_runqueue_lock);
+		for (j=0; j<LATENCY_NBUCKETS; j++) {
+			hist[j] += c->c_latency[j];
+		}
+		spinlock_release(&c->c_runqueue_lock);
+	}
+}
+
 /*
  * Thread system initialization.
  */
@@ -397,6 +538,9 @@ thread_bootstrap(void)
 	curthread->t_cpu = curcpu;
 	curcpu->c_curthread = curthread;
 
+	kstat_register(&sched_switches);
+	kstat_register(&sched_runnable);
+
 	/* Done */
 }
 
@@ -433,6 +577,9 @@ thread_start_cpus(void)
 
 	kprintf("cpu0: %s\n", cpu_identify());
 
+	/* Devices are attached, so gettime works now. */
+	thread_timing = true;
+
 	cpu_startup_sem = sem_create("cpu_hatch", 0);
 	mainbus_start_cpus();
 	
@@ -466,6 +613,10 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 		spinlock_acquire(&targetcpu->c_runqueue_lock);
 	}
 
+	if (thread_timing) {
+		gettime(&target->t_readysecs, &target->t_readynsecs);
+	}
+
 	isidle = targetcpu->c_isidle;
 	threadlist_addtail(&targetcpu->c_runqueue, target);
 	if (isidle) {
@@ -481,6 +632,45 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 	}
 }
 
+/*
+ * Account for the time thread T spent on a run queue, now that the
+ * current cpu has picked it to run. Called with the runqueue locked.
+ */
+static
+void
+thread_waited(struct thread *t)
+{
+	time_t secs, dsecs;
+	uint32_t nsecs, dnsecs, usecs, limit;
+	unsigned b;
+
+	KASSERT(spinlock_do_i_hold(&curcpu->c_runqueue_lock));
+
+	gettime(&secs, &nsecs);
+	getinterval(t->t_readysecs, t->t_readynsecs, secs, nsecs,
+		    &dsecs, &dnsecs);
+	t->t_readysecs = 0;
+	t->t_readynsecs = 0;
+
+	t->t_nwaits++;
+	t->t_waitms += dsecs * 1000 + dnsecs / 1000000;
+	t->t_waitus += (dnsecs / 1000) % 1000;
+	if (t->t_waitus >= 1000) {
+		t->t_waitms++;
+		t->t_waitus -= 1000;
+	}
+
+	/* Anything over a few seconds goes in the last bucket anyway */
+	usecs = dsecs > 4 ? 0xffffffff : dsecs * 1000000 + dnsecs / 1000;
+	b = 0;
+	limit = LATENCY_MIN_USEC;
+	while (usecs >= limit && b < LATENCY_NBUCKETS - 1) {
+		b++;
+		limit <<= 1;
+	}
+	curcpu->c_latency[b]++;
+}
+
 /*
  * Create a new thread based on an existing one.
  *
@@ -684,12 +874,22 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
-			cpu_idle();
+			/* Help with page copying if anyone wants it */
+			if (!pageop_idle()) {
+				cpu_idle();
+			}
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
 
+	if (next->t_readysecs != 0) {
+		thread_waited(next);
+	}
+	if (next != cur) {
+		kstat_inc(&sched_switches);
+	}
+
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
 	 * curthread and it may not be, depending on how curthread and
@@ -837,6 +1037,10 @@ thread_exit(int status)
 
 	cur = curthread;
 
+	/* Wait for outstanding async I/O, which uses the files and VM */
+	ioring_detach();
+	aio_detach();
+
 	/* VFS fields */
 	if (cur->t_cwd) {
 		VOP_DECREF(cur->t_cwd);
@@ -1213,7 +1417,10 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_acquire(&target->c_ipi_lock);
 
 	n = target->c_numshootdown;
-	if (n == TLBSHOOTDOWN_MAX) {
+	if (n == TLBSHOOTDOWN_ALL) {
+		/* already flushing everything */
+	}
+	else if (n == TLBSHOOTDOWN_MAX) {
 		target->c_numshootdown = TLBSHOOTDOWN_ALL;
 	}
 	else {
@@ -1227,6 +1434,43 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_release(&target->c_ipi_lock);
 }
 
+void
+ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self) {
+			ipi_tlbshootdown(c, mapping);
+		}
+	}
+}
+
+/*
+ * Wait until TARGET has done every shootdown sent to it so far. Once
+ * its queue has been seen empty, anything that was on it is done,
+ * whatever has been sent since.
+ */
+void
+ipi_tlbshootdown_wait(struct cpu *target)
+{
+	bool done;
+
+	KASSERT(target != curcpu->c_self);
+
+	while (1) {
+		spinlock_acquire(&target->c_ipi_lock);
+		done = target->c_numshootdown == 0;
+		spinlock_release(&target->c_ipi_lock);
+		if (done) {
+			break;
+		}
+		thread_yield();
+	}
+}
+
 void
 interprocessor_interrupt(void)
 {
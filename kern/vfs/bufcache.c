@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Block cache for block devices. See bufcache.h.
+ *
+ * Everything is protected by bufcache_lock, which is held across
+ * device I/O. That serializes cached I/O, but sfs is serialized by
+ * the big lock anyway, and raw-device tools run one at a time.
+ *
+ * The lock is not held while copying to or from the caller, which
+ * may be user memory and fault. The buffer is marked busy instead,
+ * and nobody else uses, flushes, or replaces it until that's done.
+ * No more than BUFCACHE_NBUFS - BUFCACHE_MAXRUN buffers are busy at
+ * once, so bufcache_getbuf always has one to give out.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <device.h>
+#include <kstat.h>
+#include <bufcache.h>
+
+struct buf {
+	struct device *b_dev;		/* NULL if not in use */
+	uint32_t b_block;		/* block number on b_dev */
+	bool b_dirty;			/* needs writing out */
+	bool b_busy;			/* being copied without the lock */
+	unsigned b_lastuse;		/* for LRU replacement */
+	char *b_data;
+};
+
+static struct lock *bufcache_lock;
+static struct cv *bufcache_cv;		/* signaled when a buffer isn't busy */
+static unsigned bufcache_nbusy;		/* buffers with b_busy set */
+static struct buf bufcache[BUFCACHE_NBUFS];
+static unsigned bufcache_clock;		/* source of b_lastuse values */
+static char *bufcache_rdbuf;		/* staging for merged reads */
+static char *bufcache_wrbuf;		/* staging for merged writes */
+
+/* Where the last read on bufcache_seqdev ended, to spot sequential reads */
+static struct device *bufcache_seqdev;
+static uint32_t bufcache_seqnext;
+
+static KSTAT_COUNTER(bufcache_hits, "bufcache.hits");
+static KSTAT_COUNTER(bufcache_misses, "bufcache.misses");
+static KSTAT_COUNTER(bufcache_reads, "bufcache.diskreads");
+static KSTAT_COUNTER(bufcache_writes, "bufcache.diskwrites");
+
+void
+bufcache_bootstrap(void)
+{
+	unsigned i;
+
+	bufcache_lock = lock_create("bufcache");
+	if (bufcache_lock == NULL) {
+		panic("bufcache: Out of memory creating lock\n");
+	}
+	bufcache_cv = cv_create("bufcache");
+	if (bufcache_cv == NULL) {
+		panic("bufcache: Out of memory creating cv\n");
+	}
+	for (i=0; i<BUFCACHE_NBUFS; i++) {
+		bufcache[i].b_dev = NULL;
+		bufcache[i].b_dirty = false;
+		bufcache[i].b_busy = false;
+		bufcache[i].b_data = kmalloc(BUFCACHE_BLOCKSIZE);
+		if (bufcache[i].b_data == NULL) {
+			panic("bufcache: Out of memory allocating buffers\n");
+		}
+	}
+	bufcache_rdbuf = kmalloc(BUFCACHE_MAXRUN * BUFCACHE_BLOCKSIZE);
+	bufcache_wrbuf = kmalloc(BUFCACHE_MAXRUN * BUFCACHE_BLOCKSIZE);
+	if (bufcache_rdbuf == NULL || bufcache_wrbuf == NULL) {
+		panic("bufcache: Out of memory allocating buffers\n");
+	}
+
+	kstat_register(&bufcache_hits);
+	kstat_register(&bufcache_misses);
+	kstat_register(&bufcache_reads);
+	kstat_register(&bufcache_writes);
+}
+
+bool
+bufcache_cancache(struct device *d)
+{
+	return d->d_blocks > 0 && d->d_blocksize <= BUFCACHE_BLOCKSIZE;
+}
+
+/*
+ * Transfer NBLOCKS blocks from BLOCK between D and DATA.
+ */
+static
+int
+bufcache_devio(struct device *d, uint32_t block, uint32_t nblocks,
+	       void *data, enum uio_rw rw)
+{
+	struct iovec iov;
+	struct uio ku;
+
+	uio_kinit(&iov, &ku, data, nblocks * d->d_blocksize,
+		  (off_t)block * d->d_blocksize, rw);
+	kstat_inc(rw == UIO_READ ? &bufcache_reads : &bufcache_writes);
+	return d->d_io(d, &ku);
+}
+
+static
+struct buf *
+bufcache_find(struct device *d, uint32_t block)
+{
+	unsigned i;
+
+	for (i=0; i<BUFCACHE_NBUFS; i++) {
+		if (bufcache[i].b_dev == d && bufcache[i].b_block == block) {
+			return &bufcache[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * True if B has data that needs writing out and can be read now.
+ */
+static
+bool
+bufcache_flushable(struct buf *b)
+{
+	return b != NULL && b->b_dirty && !b->b_busy;
+}
+
+/*
+ * Write out dirty blocks of D (or of every device, if D is NULL),
+ * each run of consecutive ones with a single d_io call. Busy blocks
+ * are being written to; they are left for next time.
+ */
+static
+int
+bufcache_flushlocked(struct device *d)
+{
+	struct buf *b, *next;
+	struct device *bd;
+	uint32_t first, n, i;
+	unsigned j;
+	int result;
+
+	KASSERT(lock_do_i_hold(bufcache_lock));
+
+	for (j=0; j<BUFCACHE_NBUFS; j++) {
+		b = &bufcache[j];
+		if (b->b_dev == NULL || !bufcache_flushable(b) ||
+		    (d != NULL && b->b_dev != d)) {
+			continue;
+		}
+		bd = b->b_dev;
+
+		/* Back up to the start of this run... */
+		first = b->b_block;
+		while (first > 0) {
+			next = bufcache_find(bd, first - 1);
+			if (!bufcache_flushable(next)) {
+				break;
+			}
+			first--;
+		}
+
+		/* ...and collect as much of it as fits. */
+		for (n=0; n<BUFCACHE_MAXRUN; n++) {
+			next = bufcache_find(bd, first + n);
+			if (!bufcache_flushable(next)) {
+				break;
+			}
+			memcpy(bufcache_wrbuf + n * bd->d_blocksize,
+			       next->b_data, bd->d_blocksize);
+		}
+		KASSERT(n > 0);
+
+		result = bufcache_devio(bd, first, n, bufcache_wrbuf,
+					UIO_WRITE);
+		if (result) {
+			return result;
+		}
+		for (i=0; i<n; i++) {
+			bufcache_find(bd, first + i)->b_dirty = false;
+		}
+
+		/* This one may not have been in the run; look again. */
+		j--;
+	}
+	return 0;
+}
+
+/*
+ * Get a buffer to put a new block in: a free one, or else the least
+ * recently used that isn't busy. Evicting a dirty block writes out
+ * the rest of its device's dirty blocks too, while we're at it.
+ */
+static
+int
+bufcache_getbuf(struct buf **ret)
+{
+	struct buf *b, *victim;
+	unsigned i;
+	int result;
+
+	victim = NULL;
+	for (i=0; i<BUFCACHE_NBUFS; i++) {
+		b = &bufcache[i];
+		if (b->b_busy) {
+			continue;
+		}
+		if (b->b_dev == NULL) {
+			victim = b;
+			break;
+		}
+		if (victim == NULL || b->b_lastuse < victim->b_lastuse) {
+			victim = b;
+		}
+	}
+	KASSERT(victim != NULL);
+
+	if (victim->b_dev != NULL && victim->b_dirty) {
+		result = bufcache_flushlocked(victim->b_dev);
+		if (result) {
+			return result;
+		}
+	}
+	victim->b_dev = NULL;
+	victim->b_dirty = false;
+	*ret = victim;
+	return 0;
+}
+
+/*
+ * Read block BLOCK of D into the cache, along with as many of the
+ * blocks after it as are below LIMIT, not already cached, and fit in
+ * one run. Hand back the buffer for BLOCK.
+ */
+static
+int
+bufcache_fill(struct device *d, uint32_t block, uint32_t limit,
+	      struct buf **ret)
+{
+	struct buf *b;
+	uint32_t n, i;
+	int result;
+
+	n = 1;
+	while (n < BUFCACHE_MAXRUN && block + n < limit &&
+	       bufcache_find(d, block + n) == NULL) {
+		n++;
+	}
+
+	result = bufcache_devio(d, block, n, bufcache_rdbuf, UIO_READ);
+	if (result) {
+		return result;
+	}
+
+	/* Install them last to first, so BLOCK is the most recent. */
+	for (i=n; i-- > 0; ) {
+		result = bufcache_getbuf(&b);
+		if (result) {
+			return result;
+		}
+		memcpy(b->b_data, bufcache_rdbuf + i * d->d_blocksize,
+		       d->d_blocksize);
+		b->b_dev = d;
+		b->b_block = block + i;
+		b->b_lastuse = ++bufcache_clock;
+	}
+	*ret = b;
+	return 0;
+}
+
+/*
+ * Wait until none of D's buffers are busy.
+ */
+static
+void
+bufcache_waitidle(struct device *d)
+{
+	unsigned i;
+
+	KASSERT(lock_do_i_hold(bufcache_lock));
+
+	i = 0;
+	while (i < BUFCACHE_NBUFS) {
+		if (bufcache[i].b_dev == d && bufcache[i].b_busy) {
+			cv_wait(bufcache_cv, bufcache_lock);
+			i = 0;
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+/*
+ * Mark B busy, or not; the caller holds bufcache_lock.
+ */
+static
+void
+bufcache_setbusy(struct buf *b, bool busy)
+{
+	KASSERT(b->b_busy != busy);
+
+	b->b_busy = busy;
+	if (busy) {
+		bufcache_nbusy++;
+	}
+	else {
+		bufcache_nbusy--;
+		cv_broadcast(bufcache_cv, bufcache_lock);
+	}
+}
+
+/*
+ * Block-aligned I/O on D through the cache.
+ */
+int
+bufcache_io(struct device *d, struct uio *uio, bool writebehind)
+{
+	struct uio saveduio;
+	struct iovec savediov;
+	struct buf *b;
+	uint32_t block, nblocks, limit, i;
+	int result;
+
+	KASSERT(bufcache_cancache(d));
+	KASSERT(uio->uio_iovcnt == 1);
+
+	if (uio->uio_offset % d->d_blocksize != 0 ||
+	    uio->uio_resid % d->d_blocksize != 0 || uio->uio_offset < 0) {
+		return EINVAL;
+	}
+	block = uio->uio_offset / d->d_blocksize;
+	nblocks = uio->uio_resid / d->d_blocksize;
+	if (block + nblocks > d->d_blocks) {
+		return EINVAL;
+	}
+
+	saveduio = *uio;
+	savediov = *uio->uio_iov;
+
+	lock_acquire(bufcache_lock);
+
+	/* Read ahead if this read carries on from the last one. */
+	limit = block + nblocks;
+	if (uio->uio_rw == UIO_READ && d == bufcache_seqdev &&
+	    block == bufcache_seqnext) {
+		limit = d->d_blocks;
+	}
+
+	result = 0;
+	for (i=0; i<nblocks && result == 0; i++) {
+		/*
+		 * Wait for anyone else using this block, and for enough
+		 * buffers that aren't busy for bufcache_fill.
+		 */
+		while (1) {
+			b = bufcache_find(d, block + i);
+			if ((b == NULL || !b->b_busy) && bufcache_nbusy <
+			    BUFCACHE_NBUFS - BUFCACHE_MAXRUN) {
+				break;
+			}
+			cv_wait(bufcache_cv, bufcache_lock);
+		}
+
+		if (uio->uio_rw == UIO_READ) {
+			if (b != NULL) {
+				kstat_inc(&bufcache_hits);
+			}
+			else {
+				kstat_inc(&bufcache_misses);
+				result = bufcache_fill(d, block + i, limit, &b);
+				if (result) {
+					break;
+				}
+			}
+			bufcache_setbusy(b, true);
+			lock_release(bufcache_lock);
+			result = uiomove(b->b_data, d->d_blocksize, uio);
+			lock_acquire(bufcache_lock);
+			bufcache_setbusy(b, false);
+		}
+		else {
+			if (b == NULL) {
+				result = bufcache_getbuf(&b);
+				if (result) {
+					break;
+				}
+				b->b_dev = d;
+				b->b_block = block + i;
+			}
+			bufcache_setbusy(b, true);
+			lock_release(bufcache_lock);
+			result = uiomove(b->b_data, d->d_blocksize, uio);
+			lock_acquire(bufcache_lock);
+			bufcache_setbusy(b, false);
+			if (result == 0 && writebehind) {
+				b->b_dirty = true;
+			}
+			else if (result == 0) {
+				result = bufcache_devio(d, block + i, 1,
+							b->b_data, UIO_WRITE);
+				b->b_dirty = false;
+			}
+			if (result) {
+				/* we don't know what's in it any more */
+				b->b_dev = NULL;
+				b->b_dirty = false;
+				break;
+			}
+		}
+		b->b_lastuse = ++bufcache_clock;
+	}
+
+	if (uio->uio_rw == UIO_READ) {
+		bufcache_seqdev = d;
+		bufcache_seqnext = block + nblocks;
+	}
+
+	lock_release(bufcache_lock);
+
+	if (result) {
+		*saveduio.uio_iov = savediov;
+		*uio = saveduio;
+	}
+	return result;
+}
+
+int
+bufcache_flush(struct device *d)
+{
+	int result;
+
+	lock_acquire(bufcache_lock);
+	result = bufcache_flushlocked(d);
+	lock_release(bufcache_lock);
+	return result;
+}
+
+void
+bufcache_forget(struct device *d, uint32_t block, uint32_t nblocks)
+{
+	struct buf *b;
+	unsigned i;
+
+	lock_acquire(bufcache_lock);
+	bufcache_waitidle(d);
+	for (i=0; i<BUFCACHE_NBUFS; i++) {
+		b = &bufcache[i];
+		if (b->b_dev == d && b->b_block >= block &&
+		    b->b_block - block < nblocks) {
+			b->b_dev = NULL;
+			b->b_dirty = false;
+		}
+	}
+	lock_release(bufcache_lock);
+}
+
+int
+bufcache_invalidate(struct device *d)
+{
+	unsigned i;
+	int result;
+
+	lock_acquire(bufcache_lock);
+	bufcache_waitidle(d);
+	result = bufcache_flushlocked(d);
+	if (result == 0) {
+		for (i=0; i<BUFCACHE_NBUFS; i++) {
+			if (bufcache[i].b_dev == d) {
+				bufcache[i].b_dev = NULL;
+			}
+		}
+	}
+	lock_release(bufcache_lock);
+	return result;
+}
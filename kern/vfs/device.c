@@ -36,12 +36,15 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/ioctl.h>
 #include <stat.h>
 #include <lib.h>
 #include <uio.h>
+#include <copyinout.h>
 #include <synch.h>
 #include <vnode.h>
 #include <device.h>
+#include <bufcache.h>
 
 /*
  * Called for each open().
@@ -63,13 +66,22 @@ dev_open(struct vnode *v, int flags)
 
 /*
  * Called on the last close().
- * Just pass through.
+ * Write out anything left behind in the block cache, then pass
+ * through.
  */
 static
 int
 dev_close(struct vnode *v)
 {
 	struct device *d = v->vn_data;
+	int result;
+
+	if (d->d_buffered) {
+		result = bufcache_flush(d);
+		if (result) {
+			return result;
+		}
+	}
 	return d->d_close(d);
 }
 
@@ -87,14 +99,28 @@ dev_reclaim(struct vnode *v)
 }
 
 /*
- * Called for read. Hand off to d_io.
+ * Called for read. Hand off to d_io, or to the block cache if the
+ * device is in buffered mode. Unbuffered reads of a block device
+ * first write out anything the cache is holding for it, so they
+ * don't see stale data.
  */
 static
 int
 dev_read(struct vnode *v, struct uio *uio)
 {
 	struct device *d = v->vn_data;
+	int result;
+
 	KASSERT(uio->uio_rw == UIO_READ);
+	if (bufcache_cancache(d)) {
+		if (d->d_buffered) {
+			return bufcache_io(d, uio, true);
+		}
+		result = bufcache_flush(d);
+		if (result) {
+			return result;
+		}
+	}
 	return d->d_io(d, uio);
 }
 
@@ -112,25 +138,78 @@ null_io(struct vnode *v, struct uio *uio)
 }
 
 /*
- * Called for write. Hand off to d_io.
+ * Called for write. Hand off to d_io, or in buffered mode to the
+ * block cache, where it's written behind. An unbuffered write to a
+ * block device goes around the cache, so flush first (to keep the
+ * order of writes) and drop the cached copies of what it covered
+ * afterwards.
  */
 static
 int
 dev_write(struct vnode *v, struct uio *uio)
 {
 	struct device *d = v->vn_data;
+	uint32_t block, nblocks;
+	int result;
+
 	KASSERT(uio->uio_rw == UIO_WRITE);
-	return d->d_io(d, uio);
+	if (!bufcache_cancache(d)) {
+		return d->d_io(d, uio);
+	}
+	if (d->d_buffered) {
+		return bufcache_io(d, uio, true);
+	}
+
+	result = bufcache_flush(d);
+	if (result) {
+		return result;
+	}
+	block = uio->uio_offset / d->d_blocksize;
+	nblocks = (uio->uio_resid + d->d_blocksize - 1) / d->d_blocksize;
+	result = d->d_io(d, uio);
+	bufcache_forget(d, block, nblocks);
+	return result;
 }
 
 /*
- * Called for ioctl(). Just pass through.
+ * Called for ioctl(). The buffered-mode ioctls are handled here for
+ * any block device the cache can take; everything else passes
+ * through.
  */
 static
 int
 dev_ioctl(struct vnode *v, int op, userptr_t data)
 {
 	struct device *d = v->vn_data;
+	int val, result;
+
+	switch (op) {
+	    case DIOCGBUFFER:
+		if (!bufcache_cancache(d)) {
+			return EIOCTL;
+		}
+		val = d->d_buffered ? 1 : 0;
+		return copyout(&val, data, sizeof(val));
+	    case DIOCSBUFFER:
+		if (!bufcache_cancache(d)) {
+			return EIOCTL;
+		}
+		result = copyin(data, &val, sizeof(val));
+		if (result) {
+			return result;
+		}
+		if (val) {
+			d->d_buffered = true;
+			return 0;
+		}
+		/* Leaving buffered mode; nothing may stay behind. */
+		result = bufcache_flush(d);
+		if (result) {
+			return result;
+		}
+		d->d_buffered = false;
+		return 0;
+	}
 	return d->d_ioctl(d, op, data);
 }
 
@@ -230,14 +309,19 @@ dev_tryseek(struct vnode *v, off_t pos)
 }
 
 /*
- * For fsync() - meaningless, do nothing.
+ * For fsync(). Only block devices can have anything written behind
+ * in the cache; for everything else this does nothing.
  */
 static
 int
-null_fsync(struct vnode *v)
+dev_fsync(struct vnode *v)
 {
-	(void)v;
-	return 0;
+	struct device *d = v->vn_data;
+
+	if (!bufcache_cancache(d)) {
+		return 0;
+	}
+	return bufcache_flush(d);
 }
 
 /*
@@ -426,7 +510,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	dev_stat,
 	dev_gettype,
 	dev_tryseek,
-	null_fsync,
+	dev_fsync,
 	dev_mmap,
 	dev_truncate,
 	dev_namefile,
@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * kstatfs: the kernel statistics filesystem, "kstat:".
+ *
+ * A single read-only directory with one file per registered kstat
+ * (see kstat.h). Reading a file gives the kstat's current value as a
+ * line of decimal text, so `cat kstat:vm.faults` works. Nothing is
+ * stored: the value is worked out on each read, which is cheap enough
+ * to poll.
+ *
+ * The root vnode is static and holds a reference to itself, so it is
+ * never reclaimed. A file vnode is made on each lookup and freed when
+ * the last reference goes away; kstats never go away, so there is
+ * nothing to keep track of.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <vfs.h>
+#include <fs.h>
+#include <vnode.h>
+#include <kstat.h>
+
+static const struct vnode_ops kstatfs_fileops;
+static const struct vnode_ops kstatfs_dirops;
+
+static struct fs kstatfs_fs;
+static struct vnode kstatfs_root;
+
+/*
+ * Format KS's value into BUF. Returns the length.
+ */
+static
+size_t
+kstatfs_format(struct kstat *ks, char *buf, size_t len)
+{
+	snprintf(buf, len, "%lu\n", kstat_value(ks));
+	return strlen(buf);
+}
+
+////////////////////////////////////////////////////////////
+// Vnode operations.
+
+/*
+ * This is called on *each* open(). Everything is read-only.
+ */
+static
+int
+kstatfs_open(struct vnode *v, int openflags)
+{
+	(void)v;
+
+	if ((openflags & O_ACCMODE) != O_RDONLY) {
+		return EROFS;
+	}
+	return 0;
+}
+
+/*
+ * Called on the *last* close(). Nothing to do.
+ */
+static
+int
+kstatfs_close(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called when the vnode refcount hits zero. Nobody else can find a
+ * file vnode, so it can just go.
+ */
+static
+int
+kstatfs_reclaim(struct vnode *v)
+{
+	if (v == &kstatfs_root) {
+		panic("kstatfs: root vnode reclaimed\n");
+	}
+	VOP_CLEANUP(v);
+	kfree(v);
+	return 0;
+}
+
+/*
+ * Called for read(). Format the value and hand back the part at the
+ * requested offset.
+ */
+static
+int
+kstatfs_read(struct vnode *v, struct uio *uio)
+{
+	char buf[32];
+	size_t len;
+
+	KASSERT(uio->uio_rw==UIO_READ);
+
+	len = kstatfs_format(v->vn_data, buf, sizeof(buf));
+	if (uio->uio_offset >= (off_t)len) {
+		/* EOF */
+		return 0;
+	}
+	return uiomove(buf + uio->uio_offset, len - uio->uio_offset, uio);
+}
+
+/*
+ * Called for getdirentry(). The offset is the index of the kstat in
+ * registration order; since kstats are only ever added, it's stable.
+ */
+static
+int
+kstatfs_getdirentry(struct vnode *v, struct uio *uio)
+{
+	struct kstat *ks;
+	int result;
+
+	(void)v;
+	KASSERT(uio->uio_rw==UIO_READ);
+
+	ks = kstat_get(uio->uio_offset);
+	if (ks == NULL) {
+		/* EOF */
+		return 0;
+	}
+
+	result = uiomove((char *)ks->ks_name, strlen(ks->ks_name), uio);
+	if (result == 0) {
+		uio->uio_offset++;
+	}
+	return result;
+}
+
+/*
+ * Called for ioctl(). No ioctls.
+ */
+static
+int
+kstatfs_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EINVAL;
+}
+
+/*
+ * Called for stat/fstat/lstat.
+ */
+static
+int
+kstatfs_stat(struct vnode *v, struct stat *statbuf)
+{
+	char buf[32];
+	unsigned n;
+	int result;
+
+	bzero(statbuf, sizeof(struct stat));
+
+	result = VOP_GETTYPE(v, &statbuf->st_mode);
+	if (result) {
+		return result;
+	}
+
+	if (v == &kstatfs_root) {
+		for (n = 0; kstat_get(n) != NULL; n++) {
+			/* count them */
+		}
+		statbuf->st_size = n;
+	}
+	else {
+		statbuf->st_size = kstatfs_format(v->vn_data, buf,
+						  sizeof(buf));
+	}
+	statbuf->st_nlink = 1;
+
+	return 0;
+}
+
+/*
+ * Return the type of the file (types as per kern/stat.h)
+ */
+static
+int
+kstatfs_gettype(struct vnode *v, uint32_t *ret)
+{
+	*ret = (v == &kstatfs_root) ? S_IFDIR : S_IFREG;
+	return 0;
+}
+
+/*
+ * Check for legal seeks.
+ */
+static
+int
+kstatfs_tryseek(struct vnode *v, off_t pos)
+{
+	(void)v;
+
+	if (pos<0) {
+		return EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Called for fsync(). Nothing to do.
+ */
+static
+int
+kstatfs_fsync(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called for mmap().
+ */
+static
+int
+kstatfs_mmap(struct vnode *v)
+{
+	(void)v;
+	return EUNIMP;
+}
+
+/*
+ * Name of the root directory relative to itself: the empty string.
+ */
+static
+int
+kstatfs_namefile(struct vnode *v, struct uio *uio)
+{
+	(void)v;
+	(void)uio;
+	return 0;
+}
+
+/*
+ * Lookup gets a vnode for a pathname. There's only the one
+ * directory, so the path is a kstat name or "." (or nothing).
+ */
+static
+int
+kstatfs_lookup(struct vnode *v, char *path, struct vnode **ret)
+{
+	struct kstat *ks;
+	struct vnode *newv;
+	int result;
+
+	KASSERT(v == &kstatfs_root);
+
+	if (path[0] == 0 || !strcmp(path, ".") || !strcmp(path, "..")) {
+		VOP_INCREF(v);
+		*ret = v;
+		return 0;
+	}
+
+	ks = kstat_find(path);
+	if (ks == NULL) {
+		return strchr(path, '/') != NULL ? ENOTDIR : ENOENT;
+	}
+
+	newv = kmalloc(sizeof(struct vnode));
+	if (newv == NULL) {
+		return ENOMEM;
+	}
+	result = VOP_INIT(newv, &kstatfs_fileops, &kstatfs_fs, ks);
+	if (result) {
+		kfree(newv);
+		return result;
+	}
+
+	*ret = newv;
+	return 0;
+}
+
+/*
+ * lookparent returns the last path component as a string and the
+ * directory it's in as a vnode. Only used for operations that would
+ * change something, which all fail anyway, but get the errors right.
+ */
+static
+int
+kstatfs_lookparent(struct vnode *v, char *path, struct vnode **ret,
+		   char *buf, size_t buflen)
+{
+	KASSERT(v == &kstatfs_root);
+
+	if (strchr(path, '/') != NULL) {
+		return kstat_find(path) != NULL ? ENOTDIR : ENOENT;
+	}
+	if (strlen(path)+1 > buflen) {
+		return ENAMETOOLONG;
+	}
+	strcpy(buf, path);
+
+	VOP_INCREF(v);
+	*ret = v;
+	return 0;
+}
+
+//////////////////////////////////////////////////
+
+static
+int
+kstatfs_notdir(void)
+{
+	return ENOTDIR;
+}
+
+static
+int
+kstatfs_isdir(void)
+{
+	return EISDIR;
+}
+
+static
+int
+kstatfs_rofs(void)
+{
+	return EROFS;
+}
+
+/*
+ * Casting through void * prevents warnings.
+ * All of the vnode ops return int, and it's ok to cast functions that
+ * take args to functions that take no args.
+ */
+
+#define ISDIR ((void *)kstatfs_isdir)
+#define NOTDIR ((void *)kstatfs_notdir)
+#define ROFS ((void *)kstatfs_rofs)
+
+/*
+ * Function table for kstat files.
+ */
+static const struct vnode_ops kstatfs_fileops = {
+	VOP_MAGIC,	/* mark this a valid vnode ops table */
+
+	kstatfs_open,
+	kstatfs_close,
+	kstatfs_reclaim,
+
+	kstatfs_read,
+	NOTDIR,  /* readlink */
+	NOTDIR,  /* getdirentry */
+	ROFS,    /* write */
+	kstatfs_ioctl,
+	kstatfs_stat,
+	kstatfs_gettype,
+	kstatfs_tryseek,
+	kstatfs_fsync,
+	kstatfs_mmap,
+	ROFS,    /* truncate */
+	NOTDIR,  /* namefile */
+
+	NOTDIR,  /* creat */
+	NOTDIR,  /* symlink */
+	NOTDIR,  /* mkdir */
+	NOTDIR,  /* link */
+	NOTDIR,  /* remove */
+	NOTDIR,  /* rmdir */
+	NOTDIR,  /* rename */
+
+	NOTDIR,  /* lookup */
+	NOTDIR,  /* lookparent */
+};
+
+/*
+ * Function table for the root directory.
+ */
+static const struct vnode_ops kstatfs_dirops = {
+	VOP_MAGIC,	/* mark this a valid vnode ops table */
+
+	kstatfs_open,
+	kstatfs_close,
+	kstatfs_reclaim,
+
+	ISDIR,   /* read */
+	ISDIR,   /* readlink */
+	kstatfs_getdirentry,
+	ISDIR,   /* write */
+	kstatfs_ioctl,
+	kstatfs_stat,
+	kstatfs_gettype,
+	kstatfs_tryseek,
+	kstatfs_fsync,
+	ISDIR,   /* mmap */
+	ISDIR,   /* truncate */
+	kstatfs_namefile,
+
+	ROFS,    /* creat */
+	ROFS,    /* symlink */
+	ROFS,    /* mkdir */
+	ROFS,    /* link */
+	ROFS,    /* remove */
+	ROFS,    /* rmdir */
+	ROFS,    /* rename */
+
+	kstatfs_lookup,
+	kstatfs_lookparent,
+};
+
+////////////////////////////////////////////////////////////
+// Filesystem operations.
+
+static
+int
+kstatfs_sync(struct fs *fs)
+{
+	(void)fs;
+	return 0;
+}
+
+static
+const char *
+kstatfs_getvolname(struct fs *fs)
+{
+	(void)fs;
+	return "kstat";
+}
+
+static
+struct vnode *
+kstatfs_getroot(struct fs *fs)
+{
+	(void)fs;
+	VOP_INCREF(&kstatfs_root);
+	return &kstatfs_root;
+}
+
+/*
+ * Attached with vfs_addfs, so it's permanent.
+ */
+static
+int
+kstatfs_unmount(struct fs *fs)
+{
+	(void)fs;
+	return EBUSY;
+}
+
+/*
+ * Create and attach kstat:
+ */
+void
+kstatfs_create(void)
+{
+	int result;
+
+	kstatfs_fs.fs_sync = kstatfs_sync;
+	kstatfs_fs.fs_getvolname = kstatfs_getvolname;
+	kstatfs_fs.fs_getroot = kstatfs_getroot;
+	kstatfs_fs.fs_unmount = kstatfs_unmount;
+	kstatfs_fs.fs_data = NULL;
+
+	result = VOP_INIT(&kstatfs_root, &kstatfs_dirops, &kstatfs_fs, NULL);
+	if (result) {
+		panic("kstatfs: VOP_INIT: %s\n", strerror(result));
+	}
+
+	result = vfs_addfs("kstat", &kstatfs_fs);
+	if (result) {
+		panic("Could not add kstat filesystem: %s\n",
+		      strerror(result));
+	}
+}
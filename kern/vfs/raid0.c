@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * RAID-0 (striped) virtual block device. See raid0.h.
+ *
+ * Sector S of the stripe set lives in chunk S/CHUNK; chunk C lives on
+ * member C%NDISKS, as that member's chunk C/NDISKS. A "row" is one
+ * chunk from each member, and a request is carried out one row (or
+ * part of a row) at a time: each member's piece of the row is staged
+ * through that member's one-chunk bounce buffer and handed to its
+ * worker thread, and we wait for all the workers to finish before
+ * moving on. The bounce buffers are needed because the workers run
+ * in their own threads and cannot see the caller's address space.
+ *
+ * Since kmalloc can't give us more than a page of contiguous memory,
+ * a chunk is limited to one page.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <thread.h>
+#include <vnode.h>
+#include <device.h>
+#include <vfs.h>
+#include <vm.h>
+#include <raid0.h>
+
+struct raid0;
+
+/*
+ * One member disk, plus the sub-request slot its worker thread
+ * picks work up from.
+ */
+struct raid0_member {
+	struct raid0 *rm_raid;		/* stripe set we belong to */
+	struct vnode *rm_vn;		/* raw device vnode of the disk */
+	struct device *rm_dev;		/* the disk itself */
+	struct semaphore *rm_go;	/* posted when rm_* below are set */
+	void *rm_buf;			/* bounce buffer, one chunk */
+
+	/* current sub-request */
+	off_t rm_pos;			/* byte offset on the member */
+	size_t rm_len;			/* length in bytes */
+	enum uio_rw rm_rw;		/* direction */
+	int rm_result;			/* error code from the worker */
+};
+
+struct raid0 {
+	struct device r_dev;		/* abstract device (d_data = us) */
+	struct lock *r_lock;		/* one request at a time */
+	struct semaphore *r_done;	/* posted by each finished worker */
+	uint32_t r_sectsize;		/* sector size (same on all members) */
+	unsigned r_chunk;		/* chunk size in sectors */
+	unsigned r_ndisks;		/* number of members */
+	struct raid0_member r_disks[RAID0_MAXDISKS];
+};
+
+/*
+ * Worker thread for one member: wait for a sub-request, run it, and
+ * report back. Devices are never destroyed, so neither are these.
+ */
+static
+void
+raid0_worker(void *vrm, unsigned long junk)
+{
+	struct raid0_member *rm = vrm;
+	struct iovec iov;
+	struct uio ku;
+
+	(void)junk;
+
+	while (1) {
+		P(rm->rm_go);
+
+		/*
+		 * Call the driver directly rather than going through
+		 * VOP_READ/VOP_WRITE: those take the vfs biglock, which
+		 * the thread waiting on us may well be holding.
+		 */
+		uio_kinit(&iov, &ku, rm->rm_buf, rm->rm_len, rm->rm_pos,
+			  rm->rm_rw);
+		rm->rm_result = rm->rm_dev->d_io(rm->rm_dev, &ku);
+		if (rm->rm_result == 0 && ku.uio_resid != 0) {
+			/* short transfer off the end of the member */
+			rm->rm_result = EIO;
+		}
+
+		V(rm->rm_raid->r_done);
+	}
+}
+
+/*
+ * Fill in member RM's sub-request for the piece of the stripe set
+ * starting at byte offset POS, of length LEN, and start it.
+ */
+static
+void
+raid0_post(struct raid0 *r, struct raid0_member *rm, off_t pos, size_t len,
+	   enum uio_rw rw)
+{
+	uint32_t chunkbytes, row, within;
+
+	chunkbytes = r->r_chunk * r->r_sectsize;
+	row = pos / (chunkbytes * r->r_ndisks);
+	within = pos % chunkbytes;
+
+	rm->rm_pos = (off_t)row * chunkbytes + within;
+	rm->rm_len = len;
+	rm->rm_rw = rw;
+	rm->rm_result = 0;
+	V(rm->rm_go);
+}
+
+/*
+ * Do the part of UIO that lies in the row it currently points into,
+ * up to LEN bytes. Each member involved gets one piece of at most a
+ * chunk, and the members run in parallel.
+ */
+static
+int
+raid0_dorow(struct raid0 *r, struct uio *uio, size_t len)
+{
+	struct raid0_member *rm;
+	uint32_t chunkbytes;
+	off_t pos;
+	size_t amt, done;
+	unsigned i, first, nposted;
+	int result = 0;
+
+	chunkbytes = r->r_chunk * r->r_sectsize;
+	pos = uio->uio_offset;
+	first = (pos / chunkbytes) % r->r_ndisks;
+
+	/*
+	 * Piece I goes to member FIRST+I; the first piece may start
+	 * partway into its chunk, and the last may end partway.
+	 */
+	done = 0;
+	nposted = 0;
+	while (done < len) {
+		amt = chunkbytes - (pos + done) % chunkbytes;
+		if (amt > len - done) {
+			amt = len - done;
+		}
+		rm = &r->r_disks[first + nposted];
+
+		if (uio->uio_rw == UIO_WRITE) {
+			result = uiomove(rm->rm_buf, amt, uio);
+			if (result) {
+				break;
+			}
+		}
+		raid0_post(r, rm, pos + done, amt, uio->uio_rw);
+		nposted++;
+		done += amt;
+	}
+
+	/* Wait for everyone before looking at any result. */
+	for (i=0; i<nposted; i++) {
+		P(r->r_done);
+	}
+	if (done < len) {
+		/* uiomove failed */
+		return result;
+	}
+
+	result = 0;
+	for (i=first; i<first+nposted; i++) {
+		if (r->r_disks[i].rm_result != 0 && result == 0) {
+			result = r->r_disks[i].rm_result;
+		}
+	}
+	if (result || uio->uio_rw == UIO_WRITE) {
+		return result;
+	}
+
+	/* Reads: hand the data back in order. */
+	for (i=first; i<first+nposted; i++) {
+		result = uiomove(r->r_disks[i].rm_buf,
+				 r->r_disks[i].rm_len, uio);
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * I/O function (for both reads and writes)
+ */
+static
+int
+raid0_io(struct device *d, struct uio *uio)
+{
+	struct raid0 *r = d->d_data;
+	uint32_t rowbytes;
+	size_t len;
+	int result = 0;
+
+	/* Don't allow I/O that isn't sector-aligned. */
+	if (uio->uio_offset % r->r_sectsize != 0 ||
+	    uio->uio_resid % r->r_sectsize != 0) {
+		return EINVAL;
+	}
+
+	/* Don't allow I/O before the start or past the end of the device. */
+	if (uio->uio_offset < 0) {
+		return EINVAL;
+	}
+	if ((uint64_t)uio->uio_offset / r->r_sectsize
+	    + (uint64_t)uio->uio_resid / r->r_sectsize
+	    > (uint64_t)d->d_blocks) {
+		return EINVAL;
+	}
+
+	rowbytes = r->r_chunk * r->r_sectsize * r->r_ndisks;
+
+	lock_acquire(r->r_lock);
+	while (uio->uio_resid > 0) {
+		/* Go up to the end of the current row. */
+		len = rowbytes - uio->uio_offset % rowbytes;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		result = raid0_dorow(r, uio, len);
+		if (result) {
+			break;
+		}
+	}
+	lock_release(r->r_lock);
+
+	return result;
+}
+
+/*
+ * Function called when we are open()'d.
+ */
+static
+int
+raid0_open(struct device *d, int openflags)
+{
+	(void)d;
+	(void)openflags;
+	return 0;
+}
+
+/*
+ * Function called when we are close()'d.
+ */
+static
+int
+raid0_close(struct device *d)
+{
+	(void)d;
+	return 0;
+}
+
+/*
+ * Function for handling ioctls.
+ */
+static
+int
+raid0_ioctl(struct device *d, int op, userptr_t data)
+{
+	(void)d;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+/*
+ * Open one member disk and check that it's a block device with the
+ * same sector size as the others. Hands back the size in sectors.
+ */
+static
+int
+raid0_openmember(struct raid0 *r, const char *name, struct vnode **ret,
+		 uint32_t *nsectsret)
+{
+	struct stat st;
+	struct vnode *vn;
+	char *path;
+	int result;
+
+	/* vfs_open destroys the string it's passed */
+	path = kstrdup(name);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = vfs_open(path, O_RDWR, 0, &vn);
+	kfree(path);
+	if (result) {
+		return result;
+	}
+
+	result = VOP_STAT(vn, &st);
+	if (result) {
+		vfs_close(vn);
+		return result;
+	}
+	/* Only device vnodes are S_IFBLK, so vn_data is a struct device. */
+	if ((st.st_mode & S_IFMT) != S_IFBLK || st.st_blksize == 0) {
+		vfs_close(vn);
+		return EFTYPE;
+	}
+	if (r->r_sectsize == 0) {
+		r->r_sectsize = st.st_blksize;
+	}
+	else if (r->r_sectsize != (uint32_t)st.st_blksize) {
+		vfs_close(vn);
+		return EINVAL;
+	}
+
+	*ret = vn;
+	*nsectsret = st.st_blocks;
+	return 0;
+}
+
+/*
+ * Create and register a stripe set.
+ */
+int
+raid0_create(const char *name, unsigned chunk, unsigned ndisks, char **disks)
+{
+	struct raid0 *r;
+	struct raid0_member *rm;
+	uint32_t nsects, minsects;
+	char tname[32];
+	unsigned i, nopen;
+	int result;
+
+	if (chunk == 0 || ndisks < 2 || ndisks > RAID0_MAXDISKS) {
+		return EINVAL;
+	}
+
+	r = kmalloc(sizeof(struct raid0));
+	if (r == NULL) {
+		return ENOMEM;
+	}
+	bzero(r, sizeof(struct raid0));
+	r->r_chunk = chunk;
+	r->r_ndisks = ndisks;
+
+	/* Open the members and find the smallest. */
+	minsects = 0;
+	for (nopen=0; nopen<ndisks; nopen++) {
+		rm = &r->r_disks[nopen];
+		result = raid0_openmember(r, disks[nopen], &rm->rm_vn, &nsects);
+		if (result) {
+			goto fail;
+		}
+		rm->rm_raid = r;
+		rm->rm_dev = rm->rm_vn->vn_data;
+		if (nopen == 0 || nsects < minsects) {
+			minsects = nsects;
+		}
+	}
+
+	/* Only whole rows are usable. */
+	if (minsects / chunk == 0) {
+		result = EINVAL;
+		goto fail;
+	}
+
+	if (chunk * r->r_sectsize > PAGE_SIZE) {
+		result = EINVAL;
+		goto fail;
+	}
+
+	r->r_lock = lock_create("raid0");
+	if (r->r_lock == NULL) {
+		result = ENOMEM;
+		goto fail;
+	}
+	r->r_done = sem_create("raid0-done", 0);
+	if (r->r_done == NULL) {
+		result = ENOMEM;
+		goto fail;
+	}
+	for (i=0; i<ndisks; i++) {
+		r->r_disks[i].rm_go = sem_create("raid0-go", 0);
+		if (r->r_disks[i].rm_go == NULL) {
+			result = ENOMEM;
+			goto fail;
+		}
+		r->r_disks[i].rm_buf = kmalloc(chunk * r->r_sectsize);
+		if (r->r_disks[i].rm_buf == NULL) {
+			result = ENOMEM;
+			goto fail;
+		}
+	}
+
+	/*
+	 * Start the workers. Past this point we can't back out, since
+	 * there's no way to stop them again.
+	 */
+	for (i=0; i<ndisks; i++) {
+		snprintf(tname, sizeof(tname), "%s-%u", name, i);
+		result = thread_fork(tname, raid0_worker, &r->r_disks[i], 0,
+				     NULL);
+		if (result) {
+			panic("raid0: thread_fork: %s\n", strerror(result));
+		}
+	}
+
+	r->r_dev.d_open = raid0_open;
+	r->r_dev.d_close = raid0_close;
+	r->r_dev.d_io = raid0_io;
+	r->r_dev.d_ioctl = raid0_ioctl;
+	r->r_dev.d_blocks = (minsects / chunk) * chunk * ndisks;
+	r->r_dev.d_blocksize = r->r_sectsize;
+	r->r_dev.d_data = r;
+
+	result = vfs_adddev(name, &r->r_dev, 1);
+	if (result) {
+		/* The workers hold pointers into R; leak it. */
+		kprintf("raid0: %s: vfs_adddev: %s\n", name, strerror(result));
+		return result;
+	}
+
+	kprintf("%s: %u disks, %u-sector chunks, %lu sectors\n", name,
+		ndisks, chunk, (unsigned long)r->r_dev.d_blocks);
+	return 0;
+
+ fail:
+	for (i=0; i<ndisks; i++) {
+		if (r->r_disks[i].rm_go != NULL) {
+			sem_destroy(r->r_disks[i].rm_go);
+		}
+		kfree(r->r_disks[i].rm_buf);
+	}
+	for (i=0; i<nopen; i++) {
+		vfs_close(r->r_disks[i].rm_vn);
+	}
+	if (r->r_done != NULL) {
+		sem_destroy(r->r_done);
+	}
+	if (r->r_lock != NULL) {
+		lock_destroy(r->r_lock);
+	}
+	kfree(r);
+	return result;
+}
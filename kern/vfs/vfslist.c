@@ -43,6 +43,8 @@
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <kstat.h>
+#include <bufcache.h>
 
 /*
  * Structure for a single named device.
@@ -109,7 +111,9 @@ vfs_bootstrap(void)
 	}
 	vfs_biglock_depth = 0;
 
+	bufcache_bootstrap();
 	devnull_create();
+	kstatfs_create();
 }
 
 /*
@@ -153,20 +157,42 @@ vfs_sync(void)
 {
 	struct knowndev *dev;
 	unsigned i, num;
+	int result, ret;
 
 	vfs_biglock_acquire();
 
+	/* Keep going after an error; report the first one. */
+	ret = 0;
+
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
 		dev = knowndevarray_get(knowndevs, i);
 		if (dev->kd_fs != NULL) {
-			/*result =*/ FSOP_SYNC(dev->kd_fs);
+			result = FSOP_SYNC(dev->kd_fs);
+			if (result) {
+				kprintf("vfs: Warning: sync failed for %s: "
+					"%s\n", dev->kd_name,
+					strerror(result));
+				if (ret == 0) {
+					ret = result;
+				}
+			}
+		}
+	}
+
+	/* and anything written behind the cache on raw devices */
+	result = bufcache_flush(NULL);
+	if (result) {
+		kprintf("vfs: Warning: writing out raw devices failed: %s\n",
+			strerror(result));
+		if (ret == 0) {
+			ret = result;
 		}
 	}
 
 	vfs_biglock_release();
 
-	return 0;
+	return ret;
 }
 
 /*
@@ -421,6 +447,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 	if (result == 0 && dev != NULL) {
 		/* use index+1 as the device number, so 0 is reserved */
 		dev->d_devnumber = index+1;
+		dev->d_buffered = false;
 	}
 
 	vfs_biglock_release();
@@ -571,6 +598,9 @@ vfs_unmount(const char *devname)
 	KASSERT(kd->kd_rawname != NULL);
 	KASSERT(kd->kd_device != NULL);
 
+	/* the exec header cache holds on to some files */
+	vnode_dropexec(kd->kd_fs);
+
 	result = FSOP_SYNC(kd->kd_fs);
 	if (result) {
 		goto fail;
@@ -605,6 +635,9 @@ vfs_unmountall(void)
 
 	vfs_biglock_acquire();
 
+	/* the exec header cache holds on to some files */
+	vnode_dropexec(NULL);
+
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
 		dev = knowndevarray_get(knowndevs, i);
@@ -650,6 +683,12 @@ vfs_unmountall(void)
 		dev->kd_fs = NULL;
 	}
 
+	result = bufcache_flush(NULL);
+	if (result) {
+		kprintf("vfs: Warning: writing out raw devices failed: %s\n",
+			strerror(result));
+	}
+
 	vfs_biglock_release();
 
 	return 0;
@@ -33,10 +33,23 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <spinlock.h>
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
 
+/* Protects vn_execinfo and vn_modcount of every vnode */
+static struct spinlock vnode_execlock = SPINLOCK_INITIALIZER;
+
+/*
+ * Files with cached headers, most recently used first. Each holds a
+ * reference, so the headers outlive the program's last close: sfs and
+ * emufs reclaim a vnode, vn_execinfo and all, as soon as nobody has
+ * it. Protected by the big lock.
+ */
+#define VNODE_EXECFILES	8
+static struct vnode *vnode_execfiles[VNODE_EXECFILES];
+
 /*
  * Initialize an abstract vnode.
  * Invoked by VOP_INIT.
@@ -53,6 +66,8 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	vn->vn_opencount = 0;
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
+	vn->vn_execinfo = NULL;
+	vn->vn_modcount = 0;
 	return 0;
 }
 
@@ -66,6 +81,12 @@ vnode_cleanup(struct vnode *vn)
 	KASSERT(vn->vn_refcount==1);
 	KASSERT(vn->vn_opencount==0);
 
+	/* Nobody else can be looking at it now */
+	if (vn->vn_execinfo != NULL) {
+		kfree(vn->vn_execinfo);
+		vn->vn_execinfo = NULL;
+	}
+
 	vn->vn_ops = NULL;
 	vn->vn_refcount = 0;
 	vn->vn_opencount = 0;
@@ -225,3 +246,154 @@ vnode_check(struct vnode *v, const char *opstr)
 
 	vfs_biglock_release();
 }
+
+/*
+ * Put VN at the front of vnode_execfiles, taking a reference if it
+ * isn't there already and dropping the last one if that's full.
+ */
+static
+void
+vnode_execkeep(struct vnode *vn)
+{
+	struct vnode *old;
+	unsigned i;
+
+	vfs_biglock_acquire();
+	for (i=0; i<VNODE_EXECFILES-1; i++) {
+		if (vnode_execfiles[i] == vn || vnode_execfiles[i] == NULL) {
+			break;
+		}
+	}
+	old = vnode_execfiles[i];
+	if (old != vn) {
+		VOP_INCREF(vn);
+	}
+	memmove(&vnode_execfiles[1], &vnode_execfiles[0],
+		i * sizeof(vnode_execfiles[0]));
+	vnode_execfiles[0] = vn;
+	if (old != NULL && old != vn) {
+		VOP_DECREF(old);
+	}
+	vfs_biglock_release();
+}
+
+/*
+ * Take out of vnode_execfiles, and release, VN if it's there (any
+ * vnode, if VN is NULL) that is on FS (any filesystem, if FS is NULL).
+ */
+static
+void
+vnode_execrelease(struct fs *fs, struct vnode *vn)
+{
+	struct vnode *v;
+	unsigned i, j;
+
+	vfs_biglock_acquire();
+	for (i=j=0; i<VNODE_EXECFILES; i++) {
+		v = vnode_execfiles[i];
+		if (v != NULL && (vn == NULL || v == vn) &&
+		    (fs == NULL || v->vn_fs == fs)) {
+			VOP_DECREF(v);
+		}
+		else {
+			vnode_execfiles[j++] = v;
+		}
+	}
+	while (j < VNODE_EXECFILES) {
+		vnode_execfiles[j++] = NULL;
+	}
+	vfs_biglock_release();
+}
+
+/*
+ * Note that VN's contents have changed: drop the cached headers.
+ */
+static
+void
+vnode_modified(struct vnode *vn)
+{
+	void *info;
+
+	spinlock_acquire(&vnode_execlock);
+	vn->vn_modcount++;
+	info = vn->vn_execinfo;
+	vn->vn_execinfo = NULL;
+	spinlock_release(&vnode_execlock);
+
+	if (info != NULL) {
+		kfree(info);
+		vnode_execrelease(NULL, vn);
+	}
+}
+
+/*
+ * Write. Called by VOP_WRITE.
+ */
+int
+vnode_write(struct vnode *vn, struct uio *uio)
+{
+	int result;
+
+	result = __VOP(vn, write)(vn, uio);
+	vnode_modified(vn);
+	return result;
+}
+
+/*
+ * Truncate. Called by VOP_TRUNCATE.
+ */
+int
+vnode_truncate(struct vnode *vn, off_t pos)
+{
+	int result;
+
+	result = __VOP(vn, truncate)(vn, pos);
+	vnode_modified(vn);
+	return result;
+}
+
+int
+vnode_getexec(struct vnode *vn, void *buf, size_t len, unsigned *modcount)
+{
+	int result;
+
+	spinlock_acquire(&vnode_execlock);
+	if (vn->vn_execinfo != NULL) {
+		memcpy(buf, vn->vn_execinfo, len);
+		result = 0;
+	}
+	else {
+		*modcount = vn->vn_modcount;
+		result = ENOENT;
+	}
+	spinlock_release(&vnode_execlock);
+
+	if (result == 0) {
+		vnode_execkeep(vn);
+	}
+	return result;
+}
+
+void
+vnode_setexec(struct vnode *vn, void *info, unsigned modcount)
+{
+	spinlock_acquire(&vnode_execlock);
+	if (vn->vn_execinfo == NULL && vn->vn_modcount == modcount) {
+		vn->vn_execinfo = info;
+		info = NULL;
+	}
+	spinlock_release(&vnode_execlock);
+
+	if (info != NULL) {
+		kfree(info);
+	}
+	else {
+		vnode_execkeep(vn);
+	}
+}
+
+void
+vnode_dropexec(struct fs *fs)
+{
+	vnode_execrelease(fs, NULL);
+}
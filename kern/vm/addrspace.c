@@ -29,15 +29,20 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/mman.h>
 #include <lib.h>
 #include <thread.h>
 #include <current.h>
+#include <synch.h>
 #include <addrspace.h>
 #include <vm.h>
 #include <machine/tlb.h>
 #include <spl.h>
 #include <spinlock.h>
 #include <elf.h>
+#include <workingset.h>
+#include <execprof.h>
+#include <pageop.h>
 
 /*
  * Note! If OPT_DUMBVM is set, as is the case until you start the VM
@@ -59,15 +64,29 @@ as_create(void)
 		return NULL;
 	}
 
+	as->as_lock = lock_create("addrspace");
+	if (as->as_lock == NULL) {
+		kfree(as);
+		return NULL;
+	}
+
 	// create first level page table
 	as->as_pagetable = alloc_kpages(1);
 	if (as->as_pagetable == 0) {
 		kprintf("Can't create page table. \n");
+		lock_destroy(as->as_lock);
+		kfree(as);
 		return NULL;
 	}
 	
 	as_zero_region(as->as_pagetable, 1);
+	as->as_pins = NULL;
 	as->as_regions_start = 0;
+	as->as_rss = 0;
+	as->as_rsslimit.rlim_cur = RLIM_INFINITY;
+	as->as_rsslimit.rlim_max = RLIM_INFINITY;
+	ws_init(as);
+	as->as_exectrace = NULL;
 	return as;
 }
 
@@ -83,12 +102,14 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	struct addrspace *new;
 	struct as_region *s, *news, *olds;
 	vaddr_t *ovaddr1, *ovaddr2, *nvaddr1, *nvaddr2, vaddr;
+	struct pagebatch pb;
 
 	// initialise the new addrspace
 	new = as_create();
 	if (new==NULL) {
 		return ENOMEM;
 	}
+	new->as_rsslimit = old->as_rsslimit;
 
 	// copy the information(vbase, npages and permission) of
 	// the regions of the old addrspace into the new one
@@ -103,6 +124,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	news->as_vbase = s->as_vbase;
 	news->as_npages = s->as_npages;
 	news->as_permissions = s->as_permissions;
+	news->as_advice = s->as_advice;
 	news->as_next_region = 0;
 	new->as_regions_start = news;
 	s = s->as_next_region;
@@ -115,13 +137,18 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		news->as_vbase = s->as_vbase;
 		news->as_npages = s->as_npages;
 		news->as_permissions = s->as_permissions;
+		news->as_advice = s->as_advice;
 		news->as_next_region = 0;
 		olds->as_next_region = news;
 		s = s->as_next_region;
 	}
 	
 	// copy the contents of the old two-level page table
-	// to the new one
+	// to the new one; the page contents are copied in batches
+	// so idle CPUs can share the work. I/O workers may be
+	// faulting pages into the old one meanwhile.
+	lock_acquire(old->as_lock);
+	pagebatch_init(&pb);
 	ovaddr1 = (vaddr_t *) old->as_pagetable;
 	nvaddr1 = (vaddr_t *) new->as_pagetable;
 	for (int i = 0; i < PTE_NUM; ++i) {
@@ -137,12 +164,16 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 				// copy old page table content 
 				// if it actually contains the volid address of the physical frame
 				if (*ovaddr2 & PTE_VALID) {
-					vaddr = alloc_kpages(1);
-					KASSERT(vaddr != 0);
+					vaddr = alloc_upage(new, PT_VADDR(i, j));
+					if (vaddr == 0) {
+						pagebatch_cleanup(&pb);
+						lock_release(old->as_lock);
+						as_destroy(new);
+						return ENOMEM;
+					}
 					// copy all the contents of the old frame to the new frame
-					memmove((void *)vaddr,
-							 (const void *)(*ovaddr2 & PAGE_FRAME),
-							PAGE_SIZE);
+					pagebatch_copy(&pb, vaddr,
+						       *ovaddr2 & PAGE_FRAME);
 					// update the PTE of the new addrspace's page table
 					*nvaddr2 = (vaddr | PTE_VALID);
 				}
@@ -153,6 +184,8 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		ovaddr1 += 1;
 		nvaddr1	+= 1;
 	}
+	pagebatch_cleanup(&pb);
+	lock_release(old->as_lock);
 	
 	*ret = new;
 	return 0;
@@ -170,7 +203,11 @@ as_destroy(struct addrspace *as)
 	vaddr_t *vaddr1, *vaddr2, vaddr;
 	
 	KASSERT(as != NULL);
+	KASSERT(as->as_pins == NULL);
 	
+	vm_droppagetable(as);
+	ws_destroy(as);
+	execprof_finish(as);
 	vaddr1 = (vaddr_t *) as->as_pagetable;
 	
 	for (int i = 0; i < PTE_NUM; ++i) {
@@ -179,7 +216,7 @@ as_destroy(struct addrspace *as)
 			for (int j = 0; j < PTE_NUM; ++j) {
 				if (*vaddr2 & PTE_VALID) {
 					vaddr = *vaddr2 & PAGE_FRAME;
-					free_kpages(vaddr);
+					free_upage(as, vaddr, PT_VADDR(i, j));
 				}
 				vaddr2 += 1;
 			}
@@ -188,9 +225,11 @@ as_destroy(struct addrspace *as)
 		vaddr1 += 1;
 	}
 	free_kpages(as->as_pagetable);
+	KASSERT(as->as_rss == 0);
 	
 	KASSERT(as->as_regions_start != 0);
 	as_destroy_regions(as->as_regions_start);
+	lock_destroy(as->as_lock);
 	kfree(as);
 }
 
@@ -212,11 +251,11 @@ as_destroy_regions(struct as_region *ar)
 void
 as_activate(struct addrspace *as)
 {
-	(void)as;
 	int spl = splhigh();
 	for (int i = 0; i < NUM_TLB; i++) {
 		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
 	}
+	vm_setpagetable(as);
 	splx(spl);
 }
 
@@ -254,6 +293,7 @@ as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 		as->as_regions_start->as_vbase = vaddr;
 		as->as_regions_start->as_npages = npages;
 		as->as_regions_start->as_permissions = readable | writeable | executable;
+		as->as_regions_start->as_advice = MADV_NORMAL;
 		as->as_regions_start->as_next_region = 0;
 	}
 	else {
@@ -265,6 +305,7 @@ as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 		ar->as_next_region->as_vbase = vaddr;
 		ar->as_next_region->as_npages = npages;
 		ar->as_next_region->as_permissions = readable | writeable | executable;
+		ar->as_next_region->as_advice = MADV_NORMAL;
 		ar->as_next_region->as_next_region = 0;
 	}
 	
@@ -315,7 +356,32 @@ as_prepare_load(struct addrspace *as)
 }
 
 /*
- * Restore the original region permission flag back
+ * Clear PTE_WRITABLE on the pages of region S, so the fast TLB
+ * refill won't load them writable.
+ */
+static
+void
+as_revokewrite(struct addrspace *as, struct as_region *s)
+{
+	vaddr_t *vaddr1, *vaddr2, va;
+	size_t i;
+
+	for (i = 0; i < s->as_npages; i++) {
+		va = s->as_vbase + i * PAGE_SIZE;
+		vaddr1 = (vaddr_t *)(as->as_pagetable + ((va & TOP_TEN) >> 22) * 4);
+		if (*vaddr1 == 0) {
+			continue;
+		}
+		vaddr2 = (vaddr_t *)(*vaddr1 + ((va & MID_TEN) >> 12) * 4);
+		*vaddr2 &= ~(vaddr_t)PTE_WRITABLE;
+	}
+}
+
+/*
+ * Restore the original region permission flag back.
+ * Pages loaded into the TLB while the regions were writable keep
+ * their write permission there, so drop them from regions that
+ * aren't writable any more.
  */
 int
 as_complete_load(struct addrspace *as)
@@ -327,6 +393,12 @@ as_complete_load(struct addrspace *as)
 	s = as->as_regions_start;
 	while (s != 0) {
 		s->as_permissions >>= 8;
+		if ((s->as_permissions & PF_W) == 0) {
+			as_revokewrite(as, s);
+			if (as == curthread->t_addrspace) {
+				vm_tlbinvalidate(s->as_vbase, s->as_npages);
+			}
+		}
 		s = s->as_next_region;
 	}
 	return 0;
@@ -363,6 +435,291 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * Find the region containing VADDR, or NULL.
+ */
+static
+struct as_region *
+as_findregion(struct addrspace *as, vaddr_t vaddr)
+{
+	struct as_region *s;
+
+	for (s = as->as_regions_start; s != 0; s = s->as_next_region) {
+		if (vaddr >= s->as_vbase &&
+		    vaddr < s->as_vbase + s->as_npages * PAGE_SIZE) {
+			return s;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Make sure a region starts at VADDR, splitting the region containing
+ * it in two if necessary.
+ */
+static
+int
+as_splitregion(struct addrspace *as, vaddr_t vaddr)
+{
+	struct as_region *s, *news;
+	size_t npages;
+
+	s = as_findregion(as, vaddr);
+	if (s == NULL || s->as_vbase == vaddr) {
+		return 0;
+	}
+
+	news = kmalloc(sizeof(struct as_region));
+	if (news == NULL) {
+		return ENOMEM;
+	}
+	npages = (vaddr - s->as_vbase) / PAGE_SIZE;
+	news->as_vbase = vaddr;
+	news->as_npages = s->as_npages - npages;
+	news->as_permissions = s->as_permissions;
+	news->as_advice = s->as_advice;
+	news->as_next_region = s->as_next_region;
+	s->as_npages = npages;
+	s->as_next_region = news;
+	return 0;
+}
+
+/*
+ * Find the PTE for VADDR, or NULL if the page isn't mapped. The
+ * caller holds as_lock.
+ */
+static
+vaddr_t *
+as_findpte(struct addrspace *as, vaddr_t vaddr)
+{
+	vaddr_t *vaddr1, *vaddr2;
+
+	vaddr1 = (vaddr_t *)(as->as_pagetable + ((vaddr & TOP_TEN) >> 22) * 4);
+	if (*vaddr1 == 0) {
+		return NULL;
+	}
+	vaddr2 = (vaddr_t *)(*vaddr1 + ((vaddr & MID_TEN) >> 12) * 4);
+	if ((*vaddr2 & PTE_VALID) == 0) {
+		return NULL;
+	}
+	return vaddr2;
+}
+
+/*
+ * Unmap the page at VADDR, if it is mapped, and free its frame. It
+ * will come back zero-filled if touched again. The caller must hold
+ * as_lock and have taken the page out of every TLB already.
+ */
+static
+void
+as_droppage(struct addrspace *as, vaddr_t vaddr)
+{
+	vaddr_t *pte;
+
+	pte = as_findpte(as, vaddr);
+	if (pte == NULL) {
+		return;
+	}
+	free_upage(as, *pte & PAGE_FRAME, vaddr);
+	*pte = 0;
+}
+
+/*
+ * Check if any of VADDR..END is pinned. The caller holds as_lock.
+ */
+static
+bool
+as_ispinned(struct addrspace *as, vaddr_t vaddr, vaddr_t end)
+{
+	struct as_pin *pin;
+
+	for (pin = as->as_pins; pin != NULL; pin = pin->ap_next) {
+		if (pin->ap_start < end && vaddr < pin->ap_end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Pin VADDR..VADDR+LEN using the storage in PIN, which stays in use
+ * until as_unpin. Pinning doesn't fault anything in; callers do that
+ * first.
+ */
+void
+as_pin(struct addrspace *as, struct as_pin *pin, vaddr_t vaddr, size_t len)
+{
+	pin->ap_start = vaddr;
+	pin->ap_end = vaddr + len;
+
+	lock_acquire(as->as_lock);
+	pin->ap_next = as->as_pins;
+	as->as_pins = pin;
+	lock_release(as->as_lock);
+}
+
+void
+as_unpin(struct addrspace *as, struct as_pin *pin)
+{
+	struct as_pin **pp;
+
+	lock_acquire(as->as_lock);
+	for (pp = &as->as_pins; *pp != pin; pp = &(*pp)->ap_next) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = pin->ap_next;
+	lock_release(as->as_lock);
+	pin->ap_next = NULL;
+}
+
+/*
+ * Bring in the pages from VADDR to END, zeroing new ones as a batch
+ * so idle CPUs can help. Only a hint; stop when memory runs short.
+ * The caller holds as_lock.
+ */
+static
+void
+as_prefault(struct addrspace *as, vaddr_t vaddr, vaddr_t end)
+{
+	struct pagebatch pb;
+	vaddr_t va;
+
+	pagebatch_init(&pb);
+	for (va = vaddr; va < end; va += PAGE_SIZE) {
+		if (vm_prefault(as, va, &pb)) {
+			break;
+		}
+	}
+	pagebatch_cleanup(&pb);
+}
+
+/*
+ * Apply madvise() advice to the range VADDR..VADDR+LEN of AS. The
+ * access-pattern hints are recorded on the regions, splitting them
+ * where the range begins and ends.
+ */
+int
+as_advise(struct addrspace *as, vaddr_t vaddr, size_t len, int advice)
+{
+	struct as_region *s;
+	vaddr_t va, end, *pte;
+	int result;
+
+	switch (advice) {
+	    case MADV_NORMAL:
+	    case MADV_RANDOM:
+	    case MADV_SEQUENTIAL:
+	    case MADV_WILLNEED:
+	    case MADV_DONTNEED:
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	if ((vaddr & PAGE_FRAME) != vaddr || len == 0) {
+		return EINVAL;
+	}
+	len = ROUNDUP(len, PAGE_SIZE);
+	end = vaddr + len;
+	if (end < vaddr || end > USERSPACETOP) {
+		return EINVAL;
+	}
+
+	// I/O workers may be faulting on this address space
+	lock_acquire(as->as_lock);
+
+	// The whole range must be in regions
+	for (va = vaddr; va < end; va = s->as_vbase + s->as_npages * PAGE_SIZE) {
+		s = as_findregion(as, va);
+		if (s == NULL) {
+			lock_release(as->as_lock);
+			return ENOMEM;
+		}
+		if (advice == MADV_DONTNEED && (s->as_permissions & PF_W) == 0) {
+			// Can't get the contents back for read-only pages
+			lock_release(as->as_lock);
+			return EINVAL;
+		}
+	}
+
+	switch (advice) {
+	    case MADV_WILLNEED:
+		as_prefault(as, vaddr, end);
+		lock_release(as->as_lock);
+		return 0;
+
+	    case MADV_DONTNEED:
+		// Not while the kernel is using any of it
+		if (as_ispinned(as, vaddr, end)) {
+			lock_release(as->as_lock);
+			return EBUSY;
+		}
+		// Keep the fast refill path from loading the pages again,
+		// then take them out of every TLB before freeing them. An
+		// I/O worker may be running this address space elsewhere;
+		// if it touches the range now it faults and waits for us.
+		for (va = vaddr; va < end; va += PAGE_SIZE) {
+			pte = as_findpte(as, va);
+			if (pte != NULL) {
+				*pte &= ~PTE_REFERENCED;
+			}
+		}
+		vm_tlbinvalidate_as(as, vaddr, len / PAGE_SIZE);
+		for (va = vaddr; va < end; va += PAGE_SIZE) {
+			as_droppage(as, va);
+		}
+		lock_release(as->as_lock);
+		return 0;
+	}
+
+	result = as_splitregion(as, vaddr);
+	if (result == 0) {
+		result = as_splitregion(as, end);
+	}
+	if (result) {
+		lock_release(as->as_lock);
+		return result;
+	}
+	for (va = vaddr; va < end; va = s->as_vbase + s->as_npages * PAGE_SIZE) {
+		s = as_findregion(as, va);
+		KASSERT(s != NULL);
+		s->as_advice = advice;
+	}
+	lock_release(as->as_lock);
+	return 0;
+}
+
+/*
+ * Look up the frame mapped at VADDR in the page table and return its
+ * kernel address (plus the offset within the page).
+ */
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, vaddr_t *kvaddr)
+{
+	int index1, index2;
+	vaddr_t *vaddr1, *vaddr2;
+
+	KASSERT(as != NULL);
+
+	if (vaddr >= USERSPACETOP) {
+		return EFAULT;
+	}
+
+	index1 = (vaddr & TOP_TEN) >> 22;
+	vaddr1 = (vaddr_t *)(as->as_pagetable + index1 * 4);
+	if (*vaddr1 == 0) {
+		return EFAULT;
+	}
+	index2 = (vaddr & MID_TEN) >> 12;
+	vaddr2 = (vaddr_t *)(*vaddr1 + index2 * 4);
+	if ((*vaddr2 & PTE_VALID) == 0) {
+		return EFAULT;
+	}
+
+	*kvaddr = (*vaddr2 & PAGE_FRAME) | (vaddr & ~(vaddr_t)PAGE_FRAME);
+	return 0;
+}
+
 /*
  * Zero out a page within the provide address
  */
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Exec prefetch profiles.
+ *
+ * Programs tend to touch the same pages in the same order every time
+ * they start: the stack, the start of the BSS, the libc buffers. Each
+ * of these costs a fault, a frame allocation, and a TLB load before
+ * the program has done anything useful. So the first time an
+ * executable is run, exec attaches a trace to the new address space,
+ * and vm_getpte notes in it each page the program is given until
+ * EXECPROF_MSEC have gone by or the trace is full. The trace is then
+ * sorted and saved against the executable, identified by filesystem,
+ * inode number and size. The next exec of the same executable
+ * prefaults the saved pages in one pass, in address order, before the
+ * program starts running.
+ *
+ * load_elf reads each segment in whole at exec time, so the pages a
+ * profile brings in are the ones exec doesn't: the BSS beyond the
+ * file-backed part, and the stack.
+ *
+ * Profiles are only a hint. Pages no longer inside the address space
+ * (the executable was rebuilt) are skipped, and prefetching stops if
+ * free memory runs low. The table only lives in memory, so profiles
+ * are relearned after each reboot; the least recently used one is
+ * thrown out when the table is full.
+ */
+
+#include <types.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <vnode.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <execprof.h>
+#include <pageop.h>
+
+struct execprof_key {
+	struct fs *ek_fs;
+	ino_t ek_ino;
+	off_t ek_size;
+};
+
+struct execprof {
+	struct execprof_key ep_key;
+	unsigned ep_lastuse;		/* for replacement; 0 if unused */
+	unsigned ep_npages;
+	vaddr_t ep_pages[EXECPROF_MAXPAGES];	/* sorted */
+};
+
+/*
+ * The profile being recorded for one address space. Also used to
+ * hold a copy of a profile while it is prefetched.
+ */
+struct execprof_trace {
+	struct execprof_key et_key;
+	time_t et_secs;			/* when the program started */
+	uint32_t et_nsecs;
+	unsigned et_npages;
+	vaddr_t et_pages[EXECPROF_MAXPAGES];
+};
+
+static struct lock *execprof_lock;
+static struct execprof execprof_table[EXECPROF_NPROFILES];
+static unsigned execprof_clock;		/* bumped on each use */
+
+void
+execprof_bootstrap(void)
+{
+	execprof_lock = lock_create("execprof");
+	if (execprof_lock == NULL) {
+		panic("execprof_bootstrap: Out of memory\n");
+	}
+}
+
+/*
+ * Find the profile for KEY, or NULL. Call with execprof_lock held.
+ */
+static
+struct execprof *
+execprof_find(const struct execprof_key *key)
+{
+	struct execprof *ep;
+	unsigned i;
+
+	for (i = 0; i < EXECPROF_NPROFILES; i++) {
+		ep = &execprof_table[i];
+		if (ep->ep_lastuse != 0 &&
+		    ep->ep_key.ek_fs == key->ek_fs &&
+		    ep->ep_key.ek_ino == key->ek_ino &&
+		    ep->ep_key.ek_size == key->ek_size) {
+			return ep;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Choose a slot for a new profile: an unused one, or else the least
+ * recently used. Call with execprof_lock held.
+ */
+static
+struct execprof *
+execprof_victim(void)
+{
+	struct execprof *ep, *victim;
+	unsigned i;
+
+	victim = &execprof_table[0];
+	for (i = 1; i < EXECPROF_NPROFILES; i++) {
+		ep = &execprof_table[i];
+		if (ep->ep_lastuse < victim->ep_lastuse) {
+			victim = ep;
+		}
+	}
+	return victim;
+}
+
+/*
+ * Check that VADDR is still somewhere AS could fault it in.
+ */
+static
+bool
+execprof_valid(struct addrspace *as, vaddr_t vaddr)
+{
+	struct as_region *s;
+
+	if (vaddr >= USERSTACK - VM_STACKPAGES * PAGE_SIZE &&
+	    vaddr < USERSTACK) {
+		return true;
+	}
+	for (s = as->as_regions_start; s != 0; s = s->as_next_region) {
+		if (vaddr >= s->as_vbase &&
+		    vaddr < s->as_vbase + s->as_npages * PAGE_SIZE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Set up the new image AS, just loaded from V: prefault the pages
+ * V's earlier runs started with, or record them if there are none.
+ * Failures here only cost the program some faults.
+ */
+void
+execprof_start(struct addrspace *as, struct vnode *v)
+{
+	struct execprof_trace *et;
+	struct execprof *ep;
+	struct stat st;
+	struct pagebatch pb;
+	bool found;
+	unsigned i;
+
+	KASSERT(as->as_exectrace == NULL);
+
+	if (VOP_STAT(v, &st) || st.st_ino == 0) {
+		/* can't tell this file from others */
+		return;
+	}
+
+	et = kmalloc(sizeof(*et));
+	if (et == NULL) {
+		return;
+	}
+	et->et_key.ek_fs = v->vn_fs;
+	et->et_key.ek_ino = st.st_ino;
+	et->et_key.ek_size = st.st_size;
+	et->et_npages = 0;
+
+	lock_acquire(execprof_lock);
+	ep = execprof_find(&et->et_key);
+	found = (ep != NULL);
+	if (found) {
+		ep->ep_lastuse = ++execprof_clock;
+		et->et_npages = ep->ep_npages;
+		memcpy(et->et_pages, ep->ep_pages,
+		       ep->ep_npages * sizeof(vaddr_t));
+	}
+	lock_release(execprof_lock);
+
+	if (!found) {
+		gettime(&et->et_secs, &et->et_nsecs);
+		as->as_exectrace = et;
+		return;
+	}
+
+	lock_acquire(as->as_lock);
+	pagebatch_init(&pb);
+	for (i = 0; i < et->et_npages; i++) {
+		if (frametable_low()) {
+			break;
+		}
+		if (!execprof_valid(as, et->et_pages[i])) {
+			continue;
+		}
+		if (vm_prefault(as, et->et_pages[i], &pb)) {
+			break;
+		}
+	}
+	pagebatch_cleanup(&pb);
+	lock_release(as->as_lock);
+	kfree(et);
+}
+
+/*
+ * AS, which is recording, has been given the page at VADDR. Stop
+ * recording once the trace is full or the program has been running
+ * long enough.
+ */
+void
+execprof_record(struct addrspace *as, vaddr_t vaddr)
+{
+	struct execprof_trace *et = as->as_exectrace;
+	time_t secs;
+	uint32_t nsecs;
+
+	KASSERT(et != NULL);
+
+	gettime(&secs, &nsecs);
+	getinterval(et->et_secs, et->et_nsecs, secs, nsecs, &secs, &nsecs);
+	if (secs * 1000 + nsecs / 1000000 >= EXECPROF_MSEC) {
+		execprof_finish(as);
+		return;
+	}
+
+	et->et_pages[et->et_npages++] = vaddr & PAGE_FRAME;
+	if (et->et_npages == EXECPROF_MAXPAGES) {
+		execprof_finish(as);
+	}
+}
+
+/*
+ * Stop recording AS, if it is, and save the trace as the profile for
+ * its executable. Called when the window closes, and from as_destroy
+ * for programs that exit (or exec) before then.
+ */
+void
+execprof_finish(struct addrspace *as)
+{
+	struct execprof_trace *et = as->as_exectrace;
+	struct execprof *ep;
+	unsigned i, j, n;
+	vaddr_t page;
+
+	if (et == NULL) {
+		return;
+	}
+	as->as_exectrace = NULL;
+
+	/*
+	 * Insertion sort, dropping duplicates (from pages released
+	 * with madvise and faulted in again). The trace is short.
+	 */
+	n = 0;
+	for (i = 0; i < et->et_npages; i++) {
+		page = et->et_pages[i];
+		for (j = n; j > 0 && et->et_pages[j-1] > page; j--) {
+			/* nothing */
+		}
+		if (j > 0 && et->et_pages[j-1] == page) {
+			continue;
+		}
+		memmove(&et->et_pages[j+1], &et->et_pages[j],
+			(n - j) * sizeof(vaddr_t));
+		et->et_pages[j] = page;
+		n++;
+	}
+
+	lock_acquire(execprof_lock);
+	ep = execprof_find(&et->et_key);
+	if (ep == NULL) {
+		ep = execprof_victim();
+		ep->ep_key = et->et_key;
+	}
+	ep->ep_lastuse = ++execprof_clock;
+	ep->ep_npages = n;
+	memcpy(ep->ep_pages, et->et_pages, n * sizeof(vaddr_t));
+	lock_release(execprof_lock);
+
+	kfree(et);
+}
@@ -1,6 +1,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <bitmap.h>
 #include <thread.h>
 #include <addrspace.h>
 #include <vm.h>
@@ -26,6 +27,15 @@ static struct spinlock frametable_lock = SPINLOCK_INITIALIZER;
  */
 static struct frame_table_entry *frame_table;
 static paddr_t frametop, freeframe;
+static unsigned long nfreeframes;
+static unsigned long nuserframes;	/* frames from alloc_upage */
+
+/*
+ * Processes over their soft RSS limit can't take frames once fewer
+ * than this many are left; the rest are kept for processes within
+ * their limits.
+ */
+static unsigned long rss_reserve;
 
 /*
  * initialise frame table
@@ -67,6 +77,8 @@ frametable_bootstrap(void)
 	// If the next frame address of this entry equals zero, means this current frame is allocated
 	p = frame_table;
 	for (i = 0; i < framenum-1; i++) {
+		p->owner = NULL;
+		p->rmap = NULL;
 		if (i < entry_num) {
 			p->next_freeframe = 0;
 			p += 1;
@@ -76,6 +88,45 @@ frametable_bootstrap(void)
 		p->next_freeframe = paddr;
 		p += 1;
 	}
+	p->next_freeframe = 0;
+	p->owner = NULL;
+	p->rmap = NULL;
+
+	nfreeframes = framenum - entry_num;
+	rss_reserve = nfreeframes / 8;
+}
+
+/*
+ * Take a frame off the free list. Returns 0 if there are none.
+ */
+static
+paddr_t
+frame_take(void)
+{
+	struct frame_table_entry *p;
+	paddr_t paddr;
+	int i;
+
+	KASSERT(spinlock_do_i_hold(&frametable_lock));
+
+	// Freeframe equals zero means all the frames have been allocated
+	// and there is no frame to use.
+	if (freeframe == 0) {
+		return 0;
+	}
+
+	// Get the current free frame's entry id 
+	// and retrieve the next free frame 
+	paddr = freeframe;
+	i = (freeframe - frametop) / PAGE_SIZE;
+	p = frame_table + i;
+
+	freeframe = p->next_freeframe;
+	p->next_freeframe = 0;
+	p->owner = NULL;
+	p->rmap = NULL;
+	nfreeframes--;
+	return paddr;
 }
 
 /*
@@ -87,35 +138,14 @@ paddr_t
 getppages(int npages)
 {
 	paddr_t paddr;
-	struct frame_table_entry *p;
-	int i;
 	
 	spinlock_acquire(&frametable_lock);
 	if (frame_table == 0)
 		paddr = ram_stealmem(npages);
+	else if (npages > 1)
+		paddr = 0;
 	else
-	{
-		if (npages > 1){
-			spinlock_release(&frametable_lock);
-			return 0;
-		}
-		
-		// Freeframe equals zero means all the frames have been allocated
-		// and there is no frame to use.
-		if (freeframe == 0){
-			spinlock_release(&frametable_lock);
-			return 0;
-		}
-		
-		// Get the current free frame's entry id 
-		// and retrieve the next free frame 
-		paddr = freeframe;
-		i = (freeframe - frametop) / PAGE_SIZE;
-		p = frame_table + i;
-		
-		freeframe = p->next_freeframe;
-		p->next_freeframe = 0;
-	}
+		paddr = frame_take();
 	spinlock_release(&frametable_lock);
 	
 	return paddr;
@@ -150,8 +180,16 @@ freeppages(paddr_t paddr)
 	spinlock_acquire(&frametable_lock);
 	i = (paddr - frametop) / PAGE_SIZE;
 	p = frame_table + i;
+	KASSERT(p->rmap == NULL);
+	if (p->owner != NULL) {
+		KASSERT(p->owner->as_rss > 0);
+		p->owner->as_rss--;
+		p->owner = NULL;
+		nuserframes--;
+	}
 	p->next_freeframe = freeframe;
 	freeframe = paddr;
+	nfreeframes++;
 	spinlock_release(&frametable_lock);
 }
 
@@ -172,3 +210,234 @@ free_kpages(vaddr_t addr)
 	}
 }
 
+
+/*
+ * Frame table entry for the frame at kernel address KVADDR.
+ */
+static
+struct frame_table_entry *
+frame_entry(vaddr_t kvaddr)
+{
+	paddr_t paddr = KVADDR_TO_PADDR(kvaddr);
+
+	KASSERT(frame_table != 0);
+	KASSERT(paddr >= frametop);
+	return frame_table + (paddr - frametop) / PAGE_SIZE;
+}
+
+/*
+ * Allocate a page of user memory to be mapped at VADDR in AS,
+ * charging it to AS's resident set. The hard RSS limit (rlim_max) is
+ * always enforced; the soft limit (rlim_cur) only when free memory is
+ * down to the reserve, so a process that has grown past its soft limit
+ * is the one that runs out first rather than everyone else.
+ *
+ * There is no backing store to page out to, so a process that hits
+ * its limit gets 0 back here rather than having one of its own pages
+ * replaced.
+ */
+vaddr_t
+alloc_upage(struct addrspace *as, vaddr_t vaddr)
+{
+	struct frame_table_entry *p;
+	struct rmap *rm;
+	paddr_t paddr;
+	rlim_t rss;
+
+	KASSERT(as != NULL);
+
+	rm = kmalloc(sizeof(*rm));
+	if (rm == NULL) {
+		return 0;
+	}
+	rm->rm_as = as;
+	rm->rm_vaddr = vaddr;
+
+	spinlock_acquire(&frametable_lock);
+	KASSERT(frame_table != 0);
+
+	rss = (rlim_t)(as->as_rss + 1) * PAGE_SIZE;
+	if (rss > as->as_rsslimit.rlim_max ||
+	    (rss > as->as_rsslimit.rlim_cur && nfreeframes <= rss_reserve)) {
+		spinlock_release(&frametable_lock);
+		kfree(rm);
+		return 0;
+	}
+
+	paddr = frame_take();
+	if (paddr != 0) {
+		p = frame_table + (paddr - frametop) / PAGE_SIZE;
+		p->owner = as;
+		rm->rm_next = NULL;
+		p->rmap = rm;
+		as->as_rss++;
+		nuserframes++;
+	}
+	spinlock_release(&frametable_lock);
+
+	if (paddr == 0) {
+		kfree(rm);
+		return 0;
+	}
+	return PADDR_TO_KVADDR(paddr);
+}
+
+/*
+ * Take the mapping of VADDR in AS off the reverse map of frame P.
+ */
+static
+struct rmap *
+rmap_unlink(struct frame_table_entry *p, struct addrspace *as, vaddr_t vaddr)
+{
+	struct rmap *rm, **rmp;
+
+	KASSERT(spinlock_do_i_hold(&frametable_lock));
+
+	for (rmp = &p->rmap; *rmp != NULL; rmp = &(*rmp)->rm_next) {
+		rm = *rmp;
+		if (rm->rm_as == as && rm->rm_vaddr == vaddr) {
+			*rmp = rm->rm_next;
+			return rm;
+		}
+	}
+	panic("rmap: frame not mapped at 0x%x\n", vaddr);
+	return NULL;
+}
+
+/*
+ * Unmap the user page at kernel address ADDR from VADDR in AS. The
+ * frame is freed when its last mapping goes; until then, if AS was
+ * paying for it, the charge moves to one of the remaining mappers.
+ */
+void
+free_upage(struct addrspace *as, vaddr_t addr, vaddr_t vaddr)
+{
+	struct frame_table_entry *p;
+	struct rmap *rm;
+	bool last;
+
+	spinlock_acquire(&frametable_lock);
+	p = frame_entry(addr);
+	rm = rmap_unlink(p, as, vaddr);
+	last = (p->rmap == NULL);
+	if (!last && p->owner == as) {
+		KASSERT(as->as_rss > 0);
+		as->as_rss--;
+		p->owner = p->rmap->rm_as;
+		p->owner->as_rss++;
+	}
+	spinlock_release(&frametable_lock);
+
+	kfree(rm);
+	if (last) {
+		KASSERT(p->owner == as);
+		free_kpages(addr);
+	}
+}
+
+/*
+ * Record that the user page at kernel address ADDR is also mapped at
+ * VADDR in AS. For sharing a frame between mappings.
+ */
+int
+rmap_add(vaddr_t addr, struct addrspace *as, vaddr_t vaddr)
+{
+	struct frame_table_entry *p;
+	struct rmap *rm;
+
+	rm = kmalloc(sizeof(*rm));
+	if (rm == NULL) {
+		return ENOMEM;
+	}
+	rm->rm_as = as;
+	rm->rm_vaddr = vaddr;
+
+	spinlock_acquire(&frametable_lock);
+	p = frame_entry(addr);
+	KASSERT(p->rmap != NULL);
+	rm->rm_next = p->rmap;
+	p->rmap = rm;
+	spinlock_release(&frametable_lock);
+
+	return 0;
+}
+
+/*
+ * Call FUNC for each (address space, user address) mapping the user
+ * page at kernel address ADDR. FUNC is called with the frame table
+ * locked, so it must not sleep, allocate memory, or map or unmap
+ * pages itself.
+ */
+void
+rmap_walk(vaddr_t addr,
+	  void (*func)(struct addrspace *as, vaddr_t vaddr, void *data),
+	  void *data)
+{
+	struct frame_table_entry *p;
+	struct rmap *rm;
+
+	spinlock_acquire(&frametable_lock);
+	p = frame_entry(addr);
+	for (rm = p->rmap; rm != NULL; rm = rm->rm_next) {
+		func(rm->rm_as, rm->rm_vaddr, data);
+	}
+	spinlock_release(&frametable_lock);
+}
+
+/*
+ * Number of frames user memory could have: those free plus those
+ * already in use by processes.
+ */
+unsigned long
+frametable_usable(void)
+{
+	unsigned long n;
+
+	spinlock_acquire(&frametable_lock);
+	n = nfreeframes + nuserframes;
+	spinlock_release(&frametable_lock);
+	return n;
+}
+
+/*
+ * Number of free frames, for the vm.freepages kstat.
+ */
+unsigned long
+frametable_nfree(void)
+{
+	/* racy, but it's only for display */
+	return nfreeframes;
+}
+
+/*
+ * Mark every free frame in FREEMAP (indexed by physical page number)
+ * and return the highest free frame, or 0 if there are none. For
+ * hibernation, which calls this at splhigh so the answer stays true.
+ */
+paddr_t
+frametable_getfree(struct bitmap *freemap)
+{
+	struct frame_table_entry *p;
+	paddr_t paddr, top = 0;
+
+	spinlock_acquire(&frametable_lock);
+	for (paddr = freeframe; paddr != 0; paddr = p->next_freeframe) {
+		bitmap_mark(freemap, paddr / PAGE_SIZE);
+		if (paddr > top) {
+			top = paddr;
+		}
+		p = frame_table + (paddr - frametop) / PAGE_SIZE;
+	}
+	spinlock_release(&frametable_lock);
+	return top;
+}
+
+/*
+ * True if free memory is down to the reserve.
+ */
+bool
+frametable_low(void)
+{
+	/* a racy read is fine; this is only a hint */
+	return nfreeframes <= rss_reserve;
+}
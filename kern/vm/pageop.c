@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Bulk page copying and zeroing, shared with idle CPUs. See pageop.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <kstat.h>
+#include <pageop.h>
+
+/* Initiators waiting for handed-off chunks; shared by all batches */
+static struct wchan *pageop_wchan;
+
+static KSTAT_COUNTER(pageop_pages, "pageop.pages");
+static KSTAT_COUNTER(pageop_offloaded, "pageop.offloaded");
+
+void
+pageop_bootstrap(void)
+{
+	pageop_wchan = wchan_create("pageop");
+	if (pageop_wchan == NULL) {
+		panic("pageop: Out of memory creating wchan\n");
+	}
+	kstat_register(&pageop_pages);
+	kstat_register(&pageop_offloaded);
+}
+
+/*
+ * Do ops START through END-1 of PB.
+ */
+static
+void
+pageop_do(struct pagebatch *pb, unsigned start, unsigned end)
+{
+	unsigned i;
+
+	for (i=start; i<end; i++) {
+		if (pb->pb_src[i] == 0) {
+			bzero((void *)pb->pb_dst[i], PAGE_SIZE);
+		}
+		else {
+			memcpy((void *)pb->pb_dst[i],
+			       (const void *)pb->pb_src[i], PAGE_SIZE);
+		}
+	}
+}
+
+/*
+ * A handed-off chunk is finished. Once the lock is released the
+ * batch may be gone.
+ */
+static
+void
+pageop_chunkdone(struct pagebatch *pb)
+{
+	spinlock_acquire(&pb->pb_lock);
+	KASSERT(pb->pb_pending > 0);
+	pb->pb_pending--;
+	if (pb->pb_pending == 0) {
+		wchan_wakeall(pageop_wchan);
+	}
+	spinlock_release(&pb->pb_lock);
+}
+
+/*
+ * Called by an idle CPU: do the first chunk on our queue, if any.
+ */
+bool
+pageop_idle(void)
+{
+	struct pageop_chunk *pc;
+
+	spinlock_acquire(&curcpu->c_pageop_lock);
+	pc = curcpu->c_pageops;
+	if (pc != NULL) {
+		curcpu->c_pageops = pc->pc_next;
+		pc->pc_next = NULL;
+	}
+	spinlock_release(&curcpu->c_pageop_lock);
+
+	if (pc == NULL) {
+		return false;
+	}
+
+	pageop_do(pc->pc_batch, pc->pc_start, pc->pc_end);
+	kstat_add(&pageop_offloaded, pc->pc_end - pc->pc_start);
+	pageop_chunkdone(pc->pc_batch);
+	return true;
+}
+
+/*
+ * Take PC off C's queue if no one has started it yet.
+ */
+static
+bool
+pageop_reclaim(struct cpu *c, struct pageop_chunk *pc)
+{
+	struct pageop_chunk **pp;
+	bool found = false;
+
+	spinlock_acquire(&c->c_pageop_lock);
+	for (pp = &c->c_pageops; *pp != NULL; pp = &(*pp)->pc_next) {
+		if (*pp == pc) {
+			*pp = pc->pc_next;
+			pc->pc_next = NULL;
+			found = true;
+			break;
+		}
+	}
+	spinlock_release(&c->c_pageop_lock);
+	return found;
+}
+
+void
+pagebatch_init(struct pagebatch *pb)
+{
+	pb->pb_n = 0;
+	spinlock_init(&pb->pb_lock);
+	pb->pb_pending = 0;
+}
+
+void
+pagebatch_cleanup(struct pagebatch *pb)
+{
+	pagebatch_run(pb);
+	spinlock_cleanup(&pb->pb_lock);
+}
+
+void
+pagebatch_copy(struct pagebatch *pb, vaddr_t dst, vaddr_t src)
+{
+	KASSERT(src != 0);
+
+	if (pb->pb_n == PAGEBATCH_MAX) {
+		pagebatch_run(pb);
+	}
+	pb->pb_dst[pb->pb_n] = dst;
+	pb->pb_src[pb->pb_n] = src;
+	pb->pb_n++;
+}
+
+void
+pagebatch_zero(struct pagebatch *pb, vaddr_t dst)
+{
+	if (pb->pb_n == PAGEBATCH_MAX) {
+		pagebatch_run(pb);
+	}
+	pb->pb_dst[pb->pb_n] = dst;
+	pb->pb_src[pb->pb_n] = 0;
+	pb->pb_n++;
+}
+
+/*
+ * Run the batch: split it between us and whichever CPUs are idle,
+ * and return when it's all done.
+ */
+void
+pagebatch_run(struct pagebatch *pb)
+{
+	struct cpu *helpers[PAGEOP_MAXHELPERS];
+	struct pageop_chunk *pc;
+	unsigned nhelpers, per, i;
+
+	if (pb->pb_n == 0) {
+		return;
+	}
+	kstat_add(&pageop_pages, pb->pb_n);
+
+	/* Everyone, including us, gets at least PAGEOP_MINCHUNK. */
+	nhelpers = 0;
+	if (pb->pb_n >= 2 * PAGEOP_MINCHUNK) {
+		nhelpers = thread_idlecpus(helpers,
+					   pb->pb_n / PAGEOP_MINCHUNK - 1);
+	}
+	if (nhelpers == 0) {
+		pageop_do(pb, 0, pb->pb_n);
+		pb->pb_n = 0;
+		return;
+	}
+
+	/*
+	 * We keep the first share, plus whatever's left from the
+	 * division; each helper gets one share of PER ops.
+	 */
+	per = pb->pb_n / (nhelpers + 1);
+	pb->pb_pending = nhelpers;
+	for (i=0; i<nhelpers; i++) {
+		pc = &pb->pb_chunks[i];
+		pc->pc_batch = pb;
+		pc->pc_end = pb->pb_n - i * per;
+		pc->pc_start = pc->pc_end - per;
+
+		spinlock_acquire(&helpers[i]->c_pageop_lock);
+		pc->pc_next = helpers[i]->c_pageops;
+		helpers[i]->c_pageops = pc;
+		spinlock_release(&helpers[i]->c_pageop_lock);
+
+		ipi_send(helpers[i], IPI_UNIDLE);
+	}
+
+	pageop_do(pb, 0, pb->pb_n - nhelpers * per);
+
+	/* Do the ones nobody has got to yet ourselves. */
+	for (i=0; i<nhelpers; i++) {
+		pc = &pb->pb_chunks[i];
+		if (pageop_reclaim(helpers[i], pc)) {
+			pageop_do(pb, pc->pc_start, pc->pc_end);
+			pageop_chunkdone(pb);
+		}
+	}
+
+	/* And wait for the rest. */
+	spinlock_acquire(&pb->pb_lock);
+	while (pb->pb_pending > 0) {
+		wchan_lock(pageop_wchan);
+		spinlock_release(&pb->pb_lock);
+		wchan_sleep(pageop_wchan);
+		spinlock_acquire(&pb->pb_lock);
+	}
+	spinlock_release(&pb->pb_lock);
+
+	pb->pb_n = 0;
+}
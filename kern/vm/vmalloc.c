@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Kernel virtual memory allocator. See vmalloc.h.
+ *
+ * The arena is VMALLOC_NPAGES pages of KSEG2 starting at VMALLOC_BASE.
+ * vmalloc_pt has one entry per arena page: the physical address of
+ * the frame mapped there, or 0. Allocated ranges are kept in a list
+ * sorted by address, and each is followed by an unmapped guard page
+ * so that running off the end of a buffer faults.
+ *
+ * Free space is searched next-fit from where the last allocation
+ * ended, so a freed range isn't handed out again until the allocator
+ * has gone round the whole arena. vfree shoots down the mappings on
+ * other CPUs, but doesn't wait for that to happen; the slow reuse
+ * covers the gap.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <vm.h>
+#include <vmalloc.h>
+
+/* Allocations bigger than this go to vmalloc in kvmalloc */
+#define KVMALLOC_THRESHOLD	(PAGE_SIZE / 2)
+
+struct vmarea {
+	unsigned va_start;		/* first page (arena index) */
+	unsigned va_npages;		/* pages mapped, excluding guard */
+	struct vmarea *va_next;		/* next area by address */
+};
+
+static struct spinlock vmalloc_lock = SPINLOCK_INITIALIZER;
+static paddr_t *vmalloc_pt;		/* kernel page table */
+static struct vmarea *vmalloc_areas;	/* allocated ranges */
+static unsigned vmalloc_cursor;		/* where the next search starts */
+
+#define VMALLOC_VADDR(pg)	(VMALLOC_BASE + (vaddr_t)(pg) * PAGE_SIZE)
+#define VMALLOC_PAGE(va)	(((va) - VMALLOC_BASE) / PAGE_SIZE)
+
+/*
+ * Set up the kernel page table. Called before the frame table exists,
+ * so the table comes out of stolen (contiguous) memory.
+ */
+void
+vmalloc_bootstrap(void)
+{
+	size_t ptsize;
+	paddr_t pa;
+
+	ptsize = VMALLOC_NPAGES * sizeof(paddr_t);
+	pa = ram_stealmem(DIVROUNDUP(ptsize, PAGE_SIZE));
+	if (pa == 0) {
+		panic("vmalloc: Out of memory for page table\n");
+	}
+	vmalloc_pt = (paddr_t *)PADDR_TO_KVADDR(pa);
+	bzero(vmalloc_pt, ptsize);
+	vmalloc_areas = NULL;
+	vmalloc_cursor = 0;
+}
+
+/*
+ * Try to fit NPAGES (plus a guard page) in the gap from page START up
+ * to page END. Returns the page to use, or END on failure.
+ */
+static
+unsigned
+vmalloc_fit(unsigned start, unsigned end, unsigned npages)
+{
+	if (start < vmalloc_cursor) {
+		start = vmalloc_cursor < end ? vmalloc_cursor : end;
+	}
+	if (end - start < npages + 1) {
+		return end;
+	}
+	return start;
+}
+
+/*
+ * Reserve address space for AREA (va_npages already set) and link it
+ * into the list. Searches from the cursor to the end of the arena,
+ * then wraps around to the beginning.
+ */
+static
+int
+vmalloc_reserve(struct vmarea *area)
+{
+	struct vmarea **pp, *next;
+	unsigned start, end, pass, pg;
+
+	KASSERT(spinlock_do_i_hold(&vmalloc_lock));
+
+	for (pass = 0; pass < 2; pass++) {
+		start = 0;
+		pp = &vmalloc_areas;
+		while (1) {
+			next = *pp;
+			end = next ? next->va_start : VMALLOC_NPAGES;
+			pg = vmalloc_fit(start, end, area->va_npages);
+			if (pg < end) {
+				area->va_start = pg;
+				area->va_next = next;
+				*pp = area;
+				vmalloc_cursor = pg + area->va_npages + 1;
+				return 0;
+			}
+			if (next == NULL) {
+				break;
+			}
+			start = next->va_start + next->va_npages + 1;
+			pp = &next->va_next;
+		}
+		/* wrap around and search the whole arena */
+		vmalloc_cursor = 0;
+	}
+	return ENOMEM;
+}
+
+/*
+ * Take AREA off the list.
+ */
+static
+void
+vmalloc_unlink(struct vmarea *area)
+{
+	struct vmarea **pp;
+
+	KASSERT(spinlock_do_i_hold(&vmalloc_lock));
+
+	for (pp = &vmalloc_areas; *pp != area; pp = &(*pp)->va_next) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = area->va_next;
+}
+
+/*
+ * Find the area starting at page PG.
+ */
+static
+struct vmarea *
+vmalloc_find(unsigned pg)
+{
+	struct vmarea *area;
+
+	KASSERT(spinlock_do_i_hold(&vmalloc_lock));
+
+	for (area = vmalloc_areas; area != NULL; area = area->va_next) {
+		if (area->va_start == pg) {
+			return area;
+		}
+		if (area->va_start > pg) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Drop the TLB mapping for arena page PG on this CPU.
+ */
+static
+void
+vmalloc_tlbinval(unsigned pg)
+{
+	vm_tlbinvalidate(VMALLOC_VADDR(pg), 1);
+}
+
+/*
+ * Unmap and free the pages of AREA. AREA must still be on the list,
+ * so that its range can't be reserved again and filled in by someone
+ * else while we are clearing it; take it off afterwards.
+ */
+static
+void
+vmalloc_unmap(struct vmarea *area)
+{
+	struct tlbshootdown ts;
+	unsigned i, pg;
+	paddr_t pa;
+
+	for (i=0; i<area->va_npages; i++) {
+		pg = area->va_start + i;
+		pa = vmalloc_pt[pg];
+		if (pa == 0) {
+			/* partially set up by a failed vmalloc */
+			continue;
+		}
+		vmalloc_pt[pg] = 0;
+		vmalloc_tlbinval(pg);
+		ts.ts_addrspace = NULL;
+		ts.ts_vaddr = VMALLOC_VADDR(pg);
+		ipi_tlbshootdown_broadcast(&ts);
+		free_kpages(PADDR_TO_KVADDR(pa));
+	}
+}
+
+/*
+ * Allocate SIZE bytes of virtually contiguous kernel memory.
+ */
+void *
+vmalloc(size_t size)
+{
+	struct vmarea *area;
+	unsigned i;
+	vaddr_t kva;
+
+	KASSERT(curthread->t_in_interrupt == false);
+
+	if (size == 0 || size > (VMALLOC_NPAGES - 1) * PAGE_SIZE) {
+		return NULL;
+	}
+
+	area = kmalloc(sizeof(*area));
+	if (area == NULL) {
+		return NULL;
+	}
+	area->va_npages = DIVROUNDUP(size, PAGE_SIZE);
+
+	spinlock_acquire(&vmalloc_lock);
+	if (vmalloc_reserve(area)) {
+		spinlock_release(&vmalloc_lock);
+		kfree(area);
+		return NULL;
+	}
+	spinlock_release(&vmalloc_lock);
+
+	/*
+	 * The range is ours now, so fill it in without the lock. Nobody
+	 * else looks at these page table entries until we return.
+	 */
+	for (i=0; i<area->va_npages; i++) {
+		kva = alloc_kpages(1);
+		if (kva == 0) {
+			vmalloc_unmap(area);
+			spinlock_acquire(&vmalloc_lock);
+			vmalloc_unlink(area);
+			spinlock_release(&vmalloc_lock);
+			kfree(area);
+			return NULL;
+		}
+		vmalloc_pt[area->va_start + i] = KVADDR_TO_PADDR(kva);
+	}
+
+	return (void *)VMALLOC_VADDR(area->va_start);
+}
+
+/*
+ * Free memory from vmalloc.
+ */
+void
+vfree(void *ptr)
+{
+	struct vmarea *area;
+	vaddr_t va;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	va = (vaddr_t)ptr;
+	KASSERT((va & PAGE_FRAME) == va);
+	KASSERT(va >= VMALLOC_BASE);
+	KASSERT(VMALLOC_PAGE(va) < VMALLOC_NPAGES);
+
+	spinlock_acquire(&vmalloc_lock);
+	area = vmalloc_find(VMALLOC_PAGE(va));
+	if (area == NULL) {
+		panic("vfree: Bad pointer %p\n", ptr);
+	}
+	spinlock_release(&vmalloc_lock);
+
+	/* keep the range reserved until it has been cleared */
+	vmalloc_unmap(area);
+
+	spinlock_acquire(&vmalloc_lock);
+	vmalloc_unlink(area);
+	spinlock_release(&vmalloc_lock);
+	kfree(area);
+}
+
+/*
+ * Called from vm_fault for addresses in KSEG2. This doesn't take the
+ * lock: the entry is one word, and a page that's being set up or torn
+ * down isn't legitimately being touched by anyone.
+ */
+int
+vmalloc_translate(vaddr_t vaddr, paddr_t *paddr)
+{
+	unsigned pg;
+
+	if (vaddr < VMALLOC_BASE) {
+		return EFAULT;
+	}
+	pg = VMALLOC_PAGE(vaddr);
+	if (pg >= VMALLOC_NPAGES || vmalloc_pt == NULL ||
+	    vmalloc_pt[pg] == 0) {
+		return EFAULT;
+	}
+	*paddr = vmalloc_pt[pg];
+	return 0;
+}
+
+/*
+ * kmalloc for small sizes, vmalloc for large ones.
+ */
+void *
+kvmalloc(size_t size)
+{
+	if (size > KVMALLOC_THRESHOLD) {
+		return vmalloc(size);
+	}
+	return kmalloc(size);
+}
+
+void
+kvfree(void *ptr)
+{
+	if ((vaddr_t)ptr >= VMALLOC_BASE) {
+		vfree(ptr);
+	}
+	else {
+		kfree(ptr);
+	}
+}
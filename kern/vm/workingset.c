@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Working-set estimation and load control.
+ *
+ * Time is divided into windows of WORKINGSET_HARDCLOCKS clock ticks,
+ * counted by ws_epoch. A process's working set is the number of its
+ * pages it touched during a window. Since the TLB is software-loaded,
+ * vm_fault sets PTE_REFERENCED on each page it loads; the first fault
+ * a process takes in a new window counts and clears those bits and
+ * flushes the TLB so that the next window's references are seen
+ * again. Fault counts per window (the page fault frequency) are kept
+ * alongside.
+ *
+ * The fast TLB refill path loads referenced pages without going
+ * through vm_fault, so a process could run through a whole window
+ * without faulting there. To make sure it does, each CPU empties its
+ * TLB and turns the fast path off when it sees a new window start
+ * (vm_wscheck), and the fast path is only turned on for a process
+ * that has been sampled in the current window (ws_current).
+ *
+ * ws_total is the sum of the working sets of the processes that are
+ * not suspended. When it is more than the memory available and free
+ * memory is down to the reserve, a process that asks for a new page
+ * is suspended rather than allowed to push the system into running
+ * out. It stops counting towards ws_total at once, but the page fault
+ * that decided this may come from copyin or uiomove with filesystem
+ * locks held, so the fault itself carries on. The process waits the
+ * next time it is about to return to user mode, when it holds nothing
+ * (vm_wswait), checking once a second whether things have improved.
+ * A process is never suspended if no other process is active, and
+ * never for more than WS_SUSPEND_MAX seconds at a time, so the system
+ * can't deadlock with everyone suspended.
+ *
+ * There is no swap, so a suspended process keeps its memory; it just
+ * stops growing until the others have finished and released theirs.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <current.h>
+#include <cpu.h>
+#include <thread.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <workingset.h>
+
+/* Longest a process stays suspended before it tries its luck (seconds) */
+#define WS_SUSPEND_MAX	10
+
+static struct spinlock ws_lock = SPINLOCK_INITIALIZER;
+static volatile unsigned ws_epoch;	/* current window */
+static unsigned ws_total;		/* sum of as_ws, unsuspended */
+static unsigned ws_nactive;		/* unsuspended with as_ws > 0 */
+static unsigned ws_nsuspended;		/* suspended right now */
+
+/*
+ * Start a new window. Called by hardclock on one CPU.
+ */
+void
+vm_wstick(void)
+{
+	ws_epoch++;
+}
+
+/*
+ * Called by hardclock on every CPU. When a new window has started,
+ * send the process running here through vm_fault on its next TLB
+ * miss, so ws_fault samples it.
+ */
+void
+vm_wscheck(void)
+{
+	unsigned epoch = ws_epoch;
+
+	if (curcpu->c_wsepoch == epoch) {
+		return;
+	}
+	curcpu->c_wsepoch = epoch;
+	vm_tlbshootdown_all();
+	vm_setpagetable(NULL);
+}
+
+/*
+ * Whether AS has been sampled in the current window.
+ */
+bool
+ws_current(struct addrspace *as)
+{
+	return as->as_wsepoch == ws_epoch;
+}
+
+/*
+ * Add AS's working set to the system totals, or take it off again.
+ */
+static
+void
+ws_charge(struct addrspace *as)
+{
+	KASSERT(spinlock_do_i_hold(&ws_lock));
+	if (!as->as_suspended) {
+		ws_total += as->as_ws;
+		if (as->as_ws > 0) {
+			ws_nactive++;
+		}
+	}
+}
+
+static
+void
+ws_uncharge(struct addrspace *as)
+{
+	KASSERT(spinlock_do_i_hold(&ws_lock));
+	if (!as->as_suspended) {
+		KASSERT(ws_total >= as->as_ws);
+		ws_total -= as->as_ws;
+		if (as->as_ws > 0) {
+			KASSERT(ws_nactive > 0);
+			ws_nactive--;
+		}
+	}
+}
+
+void
+ws_init(struct addrspace *as)
+{
+	as->as_wsepoch = ws_epoch;
+	as->as_faults = 0;
+	as->as_pff = 0;
+	as->as_ws = 0;
+	as->as_suspended = false;
+	as->as_nsuspend = 0;
+}
+
+/*
+ * Count and clear the referenced bits in AS's page table.
+ */
+static
+unsigned
+ws_sample(struct addrspace *as)
+{
+	vaddr_t *vaddr1, *vaddr2;
+	unsigned n = 0;
+	int i, j;
+
+	vaddr1 = (vaddr_t *) as->as_pagetable;
+	for (i = 0; i < PTE_NUM; i++) {
+		if (vaddr1[i] == 0) {
+			continue;
+		}
+		vaddr2 = (vaddr_t *) vaddr1[i];
+		for (j = 0; j < PTE_NUM; j++) {
+			if (vaddr2[j] & PTE_REFERENCED) {
+				vaddr2[j] &= ~(vaddr_t)PTE_REFERENCED;
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+/*
+ * Called by vm_fault for user faults of the current process.
+ */
+void
+ws_fault(struct addrspace *as)
+{
+	unsigned epoch, windows, ws;
+
+	as->as_faults++;
+
+	epoch = ws_epoch;
+	if (epoch == as->as_wsepoch) {
+		/* vm_wscheck may have turned the fast path off */
+		vm_setpagetable(as);
+		return;
+	}
+	windows = epoch - as->as_wsepoch;
+
+	ws = ws_sample(as);
+
+	spinlock_acquire(&ws_lock);
+	ws_uncharge(as);
+	as->as_ws = ws;
+	ws_charge(as);
+	spinlock_release(&ws_lock);
+
+	as->as_pff = as->as_faults / windows;
+	as->as_faults = 0;
+	as->as_wsepoch = epoch;
+
+	/* make the next window's references fault in again */
+	as_activate(as);
+	KASSERT(ws_current(as));
+}
+
+/*
+ * Whether AS should wait for memory: memory is overcommitted and
+ * someone else can make progress. USABLE and LOW are from the frame
+ * table, which is looked at before taking ws_lock.
+ */
+static
+bool
+ws_mustwait(struct addrspace *as, unsigned long usable, bool low)
+{
+	unsigned others;
+
+	KASSERT(spinlock_do_i_hold(&ws_lock));
+
+	others = ws_nactive;
+	if (!as->as_suspended && as->as_ws > 0) {
+		others--;
+	}
+	return low && ws_total > usable && others > 0;
+}
+
+/*
+ * Called before AS is given a new page. If memory is overcommitted,
+ * suspend the process; it gets the page anyway, since this may be a
+ * fault in the kernel with locks held, and waits in vm_wswait.
+ */
+void
+ws_admit(struct addrspace *as)
+{
+	unsigned long usable;
+	bool low;
+
+	usable = frametable_usable();
+	low = frametable_low();
+
+	spinlock_acquire(&ws_lock);
+	if (!as->as_suspended && ws_mustwait(as, usable, low)) {
+		ws_uncharge(as);
+		as->as_suspended = true;
+		as->as_nsuspend++;
+		ws_nsuspended++;
+	}
+	spinlock_release(&ws_lock);
+}
+
+/*
+ * Called on the way back to user mode, with nothing held. If the
+ * current process was suspended, wait until memory is no longer
+ * overcommitted, or WS_SUSPEND_MAX seconds have gone by.
+ */
+void
+vm_wswait(void)
+{
+	struct addrspace *as = curthread->t_addrspace;
+	unsigned long usable;
+	bool low;
+	int waited;
+
+	/*
+	 * Unlocked peek. I/O workers can set the flag behind our back,
+	 * but only we clear it (here or in ws_destroy), so if it is set
+	 * now it stays set.
+	 */
+	if (as == NULL || !as->as_suspended) {
+		return;
+	}
+
+	for (waited = 0; ; waited++) {
+		usable = frametable_usable();
+		low = frametable_low();
+
+		spinlock_acquire(&ws_lock);
+		if (waited == WS_SUSPEND_MAX ||
+		    !ws_mustwait(as, usable, low)) {
+			break;
+		}
+		spinlock_release(&ws_lock);
+
+		clocksleep(1);
+	}
+
+	KASSERT(as->as_suspended);
+	as->as_suspended = false;
+	ws_nsuspended--;
+	ws_charge(as);
+	spinlock_release(&ws_lock);
+}
+
+void
+ws_destroy(struct addrspace *as)
+{
+	spinlock_acquire(&ws_lock);
+	if (as->as_suspended) {
+		/* exited or exec'd before getting back to user mode */
+		as->as_suspended = false;
+		ws_nsuspended--;
+	}
+	else {
+		ws_uncharge(as);
+	}
+	spinlock_release(&ws_lock);
+}
+
+/*
+ * Fill in WI for getwsinfo().
+ */
+int
+vm_getwsinfo(struct addrspace *as, struct wsinfo *wi)
+{
+	KASSERT(as != NULL);
+
+	wi->wi_ws = as->as_ws;
+	wi->wi_faults = as->as_pff;
+	wi->wi_rss = as->as_rss;
+	wi->wi_nsuspend = as->as_nsuspend;
+	wi->wi_ram = frametable_usable();
+
+	spinlock_acquire(&ws_lock);
+	wi->wi_totalws = ws_total;
+	wi->wi_nsuspended = ws_nsuspended;
+	spinlock_release(&ws_lock);
+
+	return 0;
+}
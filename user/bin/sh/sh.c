@@ -406,46 +406,28 @@ docommand(char *buf)
 
 /*
  * getcmd
- * pulls valid characters off the console, filling the buffer.  
- * backspace deletes a character, simply by moving the position back.
- * a newline or carriage return breaks the loop, which terminates
- * the string and returns.
- *
- * if there's an invalid character or a backspace when there's nothing 
- * in the buffer, putchars an alert (bell).
+ * reads a line from the console into the buffer. the console echoes
+ * and does the line editing (backspace and so on), so this only has
+ * to collect characters up to the newline. characters that aren't
+ * printable or don't fit are dropped.
  */
 static
 void
 getcmd(char *buf, size_t len)
 {
 	size_t pos = 0;
-	int done=0, ch;
+	int ch;
 
 	/*
 	 * In the absence of a <ctype.h>, assume input is 7-bit ASCII.
 	 */
 
-	while (!done) {
-		ch = getchar();
-		if ((ch == '\b' || ch == 127) && pos > 0) {
-			putchar('\b');
-			putchar(' ');
-			putchar('\b');
-			pos--;
-		}
-		else if (ch == '\r' || ch == '\n') {
-			putchar('\r');
-			putchar('\n');
-			done = 1;
-		}
-		else if (ch >= 32 && ch < 127 && pos < len-1) {
+	ch = getchar();
+	while (ch != EOF && ch != '\n' && ch != '\r') {
+		if (ch >= 32 && ch < 127 && pos < len-1) {
 			buf[pos++] = ch;
-			putchar(ch);
-		}
-		else {
-			/* alert (bell) character */
-			putchar('\a');
 		}
+		ch = getchar();
 	}
 	buf[pos] = 0;
 }	
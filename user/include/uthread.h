@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _UTHREAD_H_
+#define _UTHREAD_H_
+
+#include <sys/null.h>
+
+/*
+ * User-level threads.
+ *
+ * These are green threads: all of them run inside the one process,
+ * on its one kernel thread, and a thread runs until it yields, blocks
+ * on a mutex or condition variable, or exits. Switching between them
+ * saves a few registers and doesn't enter the kernel. Because nothing
+ * is preemptive, code between those calls needs no locking; but a
+ * system call that blocks stops every thread in the process.
+ *
+ * The thread that runs main() is a uthread too. The process exits
+ * when main returns, as usual, or when the last thread calls
+ * uthread_exit.
+ *
+ *    uthread_create    - start FUNC(ARG) in a new thread with a stack
+ *                        of UTHREAD_STACKSIZE bytes. If RET is not
+ *                        NULL the thread is joinable and is handed
+ *                        back there; otherwise it is cleaned up as soon
+ *                        as it exits. Returns 0 or ENOMEM.
+ *    uthread_exit      - end the current thread.
+ *    uthread_join      - wait for T to exit and release it. Each
+ *                        joinable thread must be joined exactly once.
+ *    uthread_yield     - let the other runnable threads run.
+ *    uthread_self      - the current thread.
+ *
+ * Mutexes and condition variables work the usual way. Waiters are
+ * woken in FIFO order. They can be set up statically with the
+ * initializers or with the init functions; destroying one that has
+ * waiters (or an owner) is an error.
+ */
+
+#define UTHREAD_STACKSIZE	16384
+
+struct uthread;
+
+struct uthread_queue {
+	struct uthread *q_head;
+	struct uthread *q_tail;
+};
+
+struct uthread_mutex {
+	struct uthread *m_owner;
+	struct uthread_queue m_waiters;
+};
+
+struct uthread_cond {
+	struct uthread_queue c_waiters;
+};
+
+#define UTHREAD_MUTEX_INITIALIZER	{ NULL, { NULL, NULL } }
+#define UTHREAD_COND_INITIALIZER	{ { NULL, NULL } }
+
+int uthread_create(struct uthread **ret, void (*func)(void *), void *arg);
+void uthread_exit(void);
+void uthread_join(struct uthread *t);
+void uthread_yield(void);
+struct uthread *uthread_self(void);
+
+void uthread_mutex_init(struct uthread_mutex *m);
+void uthread_mutex_destroy(struct uthread_mutex *m);
+void uthread_mutex_lock(struct uthread_mutex *m);
+int uthread_mutex_trylock(struct uthread_mutex *m);
+void uthread_mutex_unlock(struct uthread_mutex *m);
+
+void uthread_cond_init(struct uthread_cond *c);
+void uthread_cond_destroy(struct uthread_cond *c);
+void uthread_cond_wait(struct uthread_cond *c, struct uthread_mutex *m);
+void uthread_cond_signal(struct uthread_cond *c);
+void uthread_cond_broadcast(struct uthread_cond *c);
+
+#endif /* _UTHREAD_H_ */
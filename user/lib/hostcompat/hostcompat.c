@@ -85,27 +85,17 @@ hostcompat_ttysetup(void)
 
 	hostcompat_savetios = tios;
 
-	/* Turn off canonical ("cooked") input. */
-	tios.c_lflag &= ~ICANON;
-
 	/*
-	 * With canonical input off, this says how many characters must be
-	 * typed before read() will return.
+	 * Leave canonical ("cooked") input and echoing on; the OS/161
+	 * console does the same by default. Input CR is mapped to LF,
+	 * as the console does.
 	 */
-	tios.c_cc[VMIN] = 1;
-
-	/* This can be used to set up read timeouts, but we don't need that. */
-	tios.c_cc[VTIME] = 0;
-
-	/* Turn off echoing of keypresses. */
-	tios.c_lflag &= ~(ECHO|ECHONL|ECHOCTL);
+	tios.c_lflag |= ICANON|ECHO;
+	tios.c_iflag |= ICRNL;
 
 	/* Do not support XON/XOFF flow control. */
 	tios.c_iflag &= ~(IXON|IXOFF);
 
-	/* On input, we want no CR/LF translation. */
-	tios.c_iflag &= ~(INLCR|IGNCR|ICRNL);
-
 	/* However, on output we want LF ('\n') mapped to CRLF. */
 #ifdef OCRNL	/* missing on OS X */
 	tios.c_oflag &= ~(OCRNL);
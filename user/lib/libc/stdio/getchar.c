@@ -30,6 +30,14 @@
 #include <stdio.h>
 #include <unistd.h>
 
+/*
+ * Input is read a buffer at a time. The console in canonical mode
+ * returns a line per read, so reading a line with getchar costs one
+ * system call instead of one per character.
+ */
+static char getchar_buf[128];
+static int getchar_pos, getchar_len;
+
 /*
  * C standard I/O function - read character from stdin
  * and return it or the symbolic constant EOF (-1).
@@ -41,11 +49,16 @@ getchar(void)
 	char ch;
 	int len;
 
-	len = read(STDIN_FILENO, &ch, 1);
-	if (len<=0) {
-		/* end of file or error */
-		return EOF;
+	if (getchar_pos == getchar_len) {
+		len = read(STDIN_FILENO, getchar_buf, sizeof(getchar_buf));
+		if (len<=0) {
+			/* end of file or error */
+			return EOF;
+		}
+		getchar_pos = 0;
+		getchar_len = len;
 	}
+	ch = getchar_buf[getchar_pos++];
 
 	/*
 	 * Cast through unsigned char, to prevent sign extension. This
@@ -38,11 +38,20 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <err.h>
 #include <stdint.h>  // for uintptr_t on non-OS/161 platforms
 
 #undef MALLOCDEBUG
 
+/*
+ * Free blocks at least this big have their whole pages handed back
+ * to the kernel with madvise(MADV_DONTNEED). MPAGESIZE must match the
+ * kernel's page size.
+ */
+#define MPAGESIZE	4096
+#define MRELEASEMIN	(4 * MPAGESIZE)
+
 #if defined(__mips__) || defined(__i386__)
 #define MALLOC32
 #elif defined(__alpha__)
@@ -475,6 +484,28 @@ __malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
 	__malloc_deadbeef(mhnext, sizeof(struct mheader));
 }
 
+/*
+ * Return the whole pages inside a large free block to the kernel.
+ * They read back as zeros if the block is used again.
+ */
+static
+void
+__malloc_release(struct mheader *mh)
+{
+	uintptr_t start, end;
+
+	if (M_SIZE(mh) < MRELEASEMIN) {
+		return;
+	}
+	start = (uintptr_t)M_DATA(mh) + MPAGESIZE - 1;
+	start &= ~(uintptr_t)(MPAGESIZE - 1);
+	end = (uintptr_t)M_NEXT(mh) & ~(uintptr_t)(MPAGESIZE - 1);
+	if (start < end) {
+		/* only advice; nothing to do if it fails */
+		(void)madvise((void *)start, end - start, MADV_DONTNEED);
+	}
+}
+
 /*
  * The actual free() implementation.
  */
@@ -530,8 +561,14 @@ free(void *x)
 	if (mh != (struct mheader *)__heapbase) {
 		mhprev = M_PREV(mh);
 		__malloc_trymerge(mhprev, mh);
+		if (!mhprev->mh_inuse) {
+			/* merged; mh is gone */
+			mh = mhprev;
+		}
 	}
 
+	__malloc_release(mh);
+
 #ifdef MALLOCDEBUG
 	warnx("free: freed %p", x);
 	__malloc_dump();
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * User-level threads. See <uthread.h>.
+ *
+ * There is one run queue, in FIFO order; the running thread is not on
+ * it. A thread blocked on a mutex or condition variable is on that
+ * object's queue instead. Nothing here runs concurrently with
+ * anything else, so none of it needs locking.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <err.h>
+#include <uthread.h>
+
+typedef enum {
+	UT_RUN,
+	UT_READY,
+	UT_BLOCKED,
+	UT_ZOMBIE,
+} utstate_t;
+
+struct uthread {
+	void *ut_sp;			/* saved stack pointer */
+	void *ut_stack;			/* malloc'd stack; NULL for main */
+	void (*ut_func)(void *);	/* start function */
+	void *ut_arg;			/* and its argument */
+	utstate_t ut_state;
+	int ut_joinable;		/* someone will call uthread_join */
+	struct uthread *ut_joiner;	/* thread waiting in uthread_join */
+	int ut_errno;			/* errno while switched out */
+	struct uthread *ut_next;	/* run queue or wait queue link */
+};
+
+/*
+ * Registers saved across a switch, on the stack, by
+ * __uthread_switch. The order must match uthread-switch.S.
+ * gp is the same in every thread and isn't saved.
+ */
+struct uthread_switchframe {
+	uint32_t sf_s0;
+	uint32_t sf_s1;
+	uint32_t sf_s2;
+	uint32_t sf_s3;
+	uint32_t sf_s4;
+	uint32_t sf_s5;
+	uint32_t sf_s6;
+	uint32_t sf_s7;
+	uint32_t sf_s8;
+	uint32_t sf_ra;
+};
+
+/* Save registers and SP into *OLDSP, and resume the thread at NEWSP. */
+void __uthread_switch(void **oldsp, void **newsp);
+
+/* The thread running main(), and the current thread. */
+static struct uthread uthread_main = { .ut_state = UT_RUN };
+static struct uthread *uthread_cur = &uthread_main;
+
+/* Threads ready to run. */
+static struct uthread_queue uthread_runq;
+
+/* Threads that haven't exited yet. */
+static unsigned uthread_nlive = 1;
+
+/* A detached thread that exited, to be freed off its own stack. */
+static struct uthread *uthread_dead;
+
+////////////////////////////////////////////////////////////
+// Queues
+
+static
+void
+uthread_enqueue(struct uthread_queue *q, struct uthread *t)
+{
+	t->ut_next = NULL;
+	if (q->q_tail == NULL) {
+		q->q_head = t;
+	}
+	else {
+		q->q_tail->ut_next = t;
+	}
+	q->q_tail = t;
+}
+
+static
+struct uthread *
+uthread_dequeue(struct uthread_queue *q)
+{
+	struct uthread *t;
+
+	t = q->q_head;
+	if (t != NULL) {
+		q->q_head = t->ut_next;
+		if (q->q_head == NULL) {
+			q->q_tail = NULL;
+		}
+		t->ut_next = NULL;
+	}
+	return t;
+}
+
+static
+void
+uthread_makeready(struct uthread *t)
+{
+	t->ut_state = UT_READY;
+	uthread_enqueue(&uthread_runq, t);
+}
+
+////////////////////////////////////////////////////////////
+// Switching
+
+static
+void
+uthread_free(struct uthread *t)
+{
+	assert(t != &uthread_main);
+	free(t->ut_stack);
+	free(t);
+}
+
+/*
+ * Give up the processor to the next ready thread. The caller has
+ * already set curthread's state and put it on whatever queue it
+ * belongs on. If nothing is ready, every remaining thread is waiting
+ * for another one, and none of them can ever run again.
+ */
+static
+void
+uthread_switch(void)
+{
+	struct uthread *cur, *next;
+
+	cur = uthread_cur;
+	next = uthread_dequeue(&uthread_runq);
+	if (next == NULL) {
+		errx(1, "uthread: deadlock: all threads are blocked");
+	}
+	next->ut_state = UT_RUN;
+	if (next == cur) {
+		return;
+	}
+
+	cur->ut_errno = errno;
+	uthread_cur = next;
+	__uthread_switch(&cur->ut_sp, &next->ut_sp);
+
+	/* Back in cur, possibly much later. */
+	errno = cur->ut_errno;
+	if (uthread_dead != NULL) {
+		uthread_free(uthread_dead);
+		uthread_dead = NULL;
+	}
+}
+
+/*
+ * Where a new thread starts: __uthread_switch "returns" here.
+ */
+static
+void
+uthread_start(void)
+{
+	if (uthread_dead != NULL) {
+		uthread_free(uthread_dead);
+		uthread_dead = NULL;
+	}
+	errno = 0;
+	uthread_cur->ut_func(uthread_cur->ut_arg);
+	uthread_exit();
+}
+
+////////////////////////////////////////////////////////////
+// Threads
+
+int
+uthread_create(struct uthread **ret, void (*func)(void *), void *arg)
+{
+	struct uthread *t;
+	struct uthread_switchframe *sf;
+	char *top;
+
+	t = malloc(sizeof(*t));
+	if (t == NULL) {
+		return ENOMEM;
+	}
+	t->ut_stack = malloc(UTHREAD_STACKSIZE);
+	if (t->ut_stack == NULL) {
+		free(t);
+		return ENOMEM;
+	}
+	t->ut_func = func;
+	t->ut_arg = arg;
+	t->ut_joinable = (ret != NULL);
+	t->ut_joiner = NULL;
+	t->ut_errno = 0;
+
+	/*
+	 * Make the stack look as if the thread had called
+	 * __uthread_switch from the top of uthread_start, leaving the
+	 * 16 bytes of argument space the calling convention requires
+	 * above it.
+	 */
+	top = (char *)t->ut_stack + UTHREAD_STACKSIZE;
+	top = (char *)((uintptr_t)top & ~(uintptr_t)7);
+	sf = (struct uthread_switchframe *)(top - 16) - 1;
+	bzero(sf, sizeof(*sf));
+	sf->sf_ra = (uint32_t)(uintptr_t)uthread_start;
+	t->ut_sp = sf;
+
+	uthread_nlive++;
+	uthread_makeready(t);
+	if (ret != NULL) {
+		*ret = t;
+	}
+	return 0;
+}
+
+void
+uthread_exit(void)
+{
+	struct uthread *cur = uthread_cur;
+
+	uthread_nlive--;
+	if (uthread_nlive == 0) {
+		exit(0);
+	}
+
+	cur->ut_state = UT_ZOMBIE;
+	if (cur->ut_joiner != NULL) {
+		uthread_makeready(cur->ut_joiner);
+	}
+	if (!cur->ut_joinable && cur != &uthread_main) {
+		/* can't free our own stack; the next thread does it */
+		assert(uthread_dead == NULL);
+		uthread_dead = cur;
+	}
+	uthread_switch();
+	errx(1, "uthread: zombie thread ran");
+}
+
+void
+uthread_join(struct uthread *t)
+{
+	assert(t != uthread_cur);
+	assert(t->ut_joinable);
+	assert(t->ut_joiner == NULL);
+
+	if (t->ut_state != UT_ZOMBIE) {
+		t->ut_joiner = uthread_cur;
+		uthread_cur->ut_state = UT_BLOCKED;
+		uthread_switch();
+		assert(t->ut_state == UT_ZOMBIE);
+	}
+	uthread_free(t);
+}
+
+void
+uthread_yield(void)
+{
+	uthread_makeready(uthread_cur);
+	uthread_switch();
+}
+
+struct uthread *
+uthread_self(void)
+{
+	return uthread_cur;
+}
+
+////////////////////////////////////////////////////////////
+// Mutexes
+
+void
+uthread_mutex_init(struct uthread_mutex *m)
+{
+	m->m_owner = NULL;
+	m->m_waiters.q_head = m->m_waiters.q_tail = NULL;
+}
+
+void
+uthread_mutex_destroy(struct uthread_mutex *m)
+{
+	assert(m->m_owner == NULL);
+	assert(m->m_waiters.q_head == NULL);
+}
+
+void
+uthread_mutex_lock(struct uthread_mutex *m)
+{
+	assert(m->m_owner != uthread_cur);
+
+	if (m->m_owner == NULL) {
+		m->m_owner = uthread_cur;
+		return;
+	}
+	/* unlock hands the mutex straight to us */
+	uthread_cur->ut_state = UT_BLOCKED;
+	uthread_enqueue(&m->m_waiters, uthread_cur);
+	uthread_switch();
+	assert(m->m_owner == uthread_cur);
+}
+
+int
+uthread_mutex_trylock(struct uthread_mutex *m)
+{
+	if (m->m_owner != NULL) {
+		return EBUSY;
+	}
+	m->m_owner = uthread_cur;
+	return 0;
+}
+
+void
+uthread_mutex_unlock(struct uthread_mutex *m)
+{
+	struct uthread *t;
+
+	assert(m->m_owner == uthread_cur);
+
+	t = uthread_dequeue(&m->m_waiters);
+	m->m_owner = t;
+	if (t != NULL) {
+		uthread_makeready(t);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Condition variables
+
+void
+uthread_cond_init(struct uthread_cond *c)
+{
+	c->c_waiters.q_head = c->c_waiters.q_tail = NULL;
+}
+
+void
+uthread_cond_destroy(struct uthread_cond *c)
+{
+	assert(c->c_waiters.q_head == NULL);
+}
+
+void
+uthread_cond_wait(struct uthread_cond *c, struct uthread_mutex *m)
+{
+	uthread_cur->ut_state = UT_BLOCKED;
+	uthread_enqueue(&c->c_waiters, uthread_cur);
+	uthread_mutex_unlock(m);
+	uthread_switch();
+	uthread_mutex_lock(m);
+}
+
+void
+uthread_cond_signal(struct uthread_cond *c)
+{
+	struct uthread *t;
+
+	t = uthread_dequeue(&c->c_waiters);
+	if (t != NULL) {
+		uthread_makeready(t);
+	}
+}
+
+void
+uthread_cond_broadcast(struct uthread_cond *c)
+{
+	struct uthread *t;
+
+	while ((t = uthread_dequeue(&c->c_waiters)) != NULL) {
+		uthread_makeready(t);
+	}
+}
@@ -56,18 +56,28 @@
 
 #include "disk.h"
 
+static uint32_t blocksize = SFS_BLOCKSIZE;
+
 static
 uint32_t
 dumpsb(void)
 {
 	struct sfs_super sp;
-	diskread(&sp, SFS_SB_LOCATION);
+	diskreadhead(&sp, SFS_SB_LOCATION);
 	if (SWAPL(sp.sp_magic) != SFS_MAGIC) {
 		errx(1, "Not an sfs filesystem");
 	}
+	if (SWAPL(sp.sp_blocksize) != 0) {
+		blocksize = SWAPL(sp.sp_blocksize);
+	}
+	if (!SFS_BLOCKSIZE_OK(blocksize)) {
+		errx(1, "Invalid block size %u", blocksize);
+	}
+	disksetblocksize(blocksize);
+
 	sp.sp_volname[sizeof(sp.sp_volname)-1] = 0;
-	printf("Volume name: %-40s  %u blocks\n", sp.sp_volname, 
-	       SWAPL(sp.sp_nblocks));
+	printf("Volume name: %-40s  %u blocks of %u bytes\n", sp.sp_volname, 
+	       SWAPL(sp.sp_nblocks), blocksize);
 
 	return SWAPL(sp.sp_nblocks);
 }
@@ -76,8 +86,8 @@ static
 void
 dodirblock(uint32_t block)
 {
-	struct sfs_dir sds[SFS_BLOCKSIZE/sizeof(struct sfs_dir)];
-	int nsds = SFS_BLOCKSIZE/sizeof(struct sfs_dir);
+	struct sfs_dir sds[SFS_MAXBLOCKSIZE/sizeof(struct sfs_dir)];
+	int nsds = blocksize/sizeof(struct sfs_dir);
 	int i;
 
 	diskread(&sds, block);
@@ -100,11 +110,11 @@ void
 dumpdir(uint32_t ino)
 {
 	struct sfs_inode sfi;
-	uint32_t ib[SFS_DBPERIDB];
+	uint32_t ib[SFS_DBPERIDB(SFS_MAXBLOCKSIZE)];
 	int nentries, i;
 	uint32_t block, nblocks=0;
 
-	diskread(&sfi, ino);
+	diskreadhead(&sfi, ino);
 
 	nentries = SWAPL(sfi.sfi_size) / sizeof(struct sfs_dir);
 	if (SWAPL(sfi.sfi_size) % sizeof(struct sfs_dir) != 0) {
@@ -121,7 +131,7 @@ dumpdir(uint32_t ino)
 	}
 	if (SWAPL(sfi.sfi_indirect)) {
 		diskread(&ib, SWAPL(sfi.sfi_indirect));
-		for (i=0; i<SFS_DBPERIDB; i++) {
+		for (i=0; i<(int)SFS_DBPERIDB(blocksize); i++) {
 			block = SWAPL(ib[i]);
 			if (block) {
 				dodirblock(block);
@@ -136,15 +146,17 @@ static
 void
 dumpbits(uint32_t fsblocks)
 {
-	uint32_t nblocks = SFS_BITBLOCKS(fsblocks);
+	uint32_t nblocks = SFS_BITBLOCKS(fsblocks, blocksize);
 	uint32_t i, j;
-	char data[SFS_BLOCKSIZE];
+	char data[SFS_MAXBLOCKSIZE];
 
-	printf("Freemap: %u blocks (%u %u %u)\n", nblocks, SFS_BITMAPSIZE(fsblocks), fsblocks, SFS_BLOCKBITS);
+	printf("Freemap: %u blocks (%u %u %u)\n", nblocks,
+	       SFS_BITMAPSIZE(fsblocks, blocksize), fsblocks,
+	       SFS_BLOCKBITS(blocksize));
 
 	for (i=0; i<nblocks; i++) {
 		diskread(data, SFS_MAP_LOCATION+i);
-		for (j=0; j<SFS_BLOCKSIZE; j++) {
+		for (j=0; j<blocksize; j++) {
 			printf("%02x", (unsigned char)data[j]);
 			if (j%32==31) {
 				printf("\n");
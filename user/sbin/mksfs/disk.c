@@ -36,6 +36,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <err.h>
+#ifndef HOST
+#include <sys/ioctl.h>
+#endif
 
 #include "support.h"
 #include "disk.h"
@@ -48,7 +51,11 @@
 #endif
 
 static int fd=-1;
-static uint32_t nblocks;
+static uint32_t nsectors;
+static uint32_t blocksize = BLOCKSIZE;
+#ifndef HOST
+static int buffered;	/* device put in buffered mode by opendisk */
+#endif
 
 void
 opendisk(const char *path)
@@ -64,10 +71,10 @@ opendisk(const char *path)
 		err(1, "%s: fstat", path);
 	}
 
-	nblocks = statbuf.st_size / BLOCKSIZE;
+	nsectors = statbuf.st_size / BLOCKSIZE;
 
 #ifdef HOST
-	nblocks--;
+	nsectors--;
 
 	{
 		char buf[64];
@@ -87,9 +94,25 @@ opendisk(const char *path)
 			errx(1, "%s: Not a System/161 disk image", path);
 		}
 	}
+#else
+	/*
+	 * Go through the kernel's block cache, so the many small
+	 * reads and writes we do get merged and read ahead. If the
+	 * device doesn't support it, just do without.
+	 */
+	{
+		int on = 1;
+
+		if (ioctl(fd, DIOCSBUFFER, &on) == 0) {
+			buffered = 1;
+		}
+	}
 #endif
 }
 
+/*
+ * The device sector size. Filesystem blocks are a multiple of this.
+ */
 uint32_t
 diskblocksize(void)
 {
@@ -97,15 +120,38 @@ diskblocksize(void)
 	return BLOCKSIZE;
 }
 
+/*
+ * Set the size of the blocks diskread/diskwrite/diskblocks deal in.
+ */
+void
+disksetblocksize(uint32_t bs)
+{
+	assert(bs >= BLOCKSIZE && bs % BLOCKSIZE == 0);
+	blocksize = bs;
+}
+
 uint32_t
 diskblocks(void)
 {
 	assert(fd>=0);
-	return nblocks;
+	return nsectors / (blocksize / BLOCKSIZE);
 }
 
+static
+off_t
+diskoffset(uint32_t block)
+{
+	off_t pos = (off_t)block * blocksize;
+#ifdef HOST
+	// skip over disk file header
+	pos += BLOCKSIZE;
+#endif
+	return pos;
+}
+
+static
 void
-diskwrite(const void *data, uint32_t block)
+dowrite(const void *data, uint32_t block, uint32_t amt)
 {
 	const char *cdata = data;
 	uint32_t tot=0;
@@ -113,17 +159,12 @@ diskwrite(const void *data, uint32_t block)
 
 	assert(fd>=0);
 
-#ifdef HOST
-	// skip over disk file header
-	block++;
-#endif
-
-	if (lseek(fd, block*BLOCKSIZE, SEEK_SET)<0) {
+	if (lseek(fd, diskoffset(block), SEEK_SET)<0) {
 		err(1, "lseek");
 	}
 
-	while (tot < BLOCKSIZE) {
-		len = write(fd, cdata + tot, BLOCKSIZE - tot);
+	while (tot < amt) {
+		len = write(fd, cdata + tot, amt - tot);
 		if (len < 0) {
 			if (errno==EINTR || errno==EAGAIN) {
 				continue;
@@ -137,8 +178,9 @@ diskwrite(const void *data, uint32_t block)
 	}
 }
 
+static
 void
-diskread(void *data, uint32_t block)
+doread(void *data, uint32_t block, uint32_t amt)
 {
 	char *cdata = data;
 	uint32_t tot=0;
@@ -146,17 +188,12 @@ diskread(void *data, uint32_t block)
 
 	assert(fd>=0);
 
-#ifdef HOST
-	// skip over disk file header
-	block++;
-#endif
-
-	if (lseek(fd, block*BLOCKSIZE, SEEK_SET)<0) {
+	if (lseek(fd, diskoffset(block), SEEK_SET)<0) {
 		err(1, "lseek");
 	}
 
-	while (tot < BLOCKSIZE) {
-		len = read(fd, cdata + tot, BLOCKSIZE - tot);
+	while (tot < amt) {
+		len = read(fd, cdata + tot, amt - tot);
 		if (len < 0) {
 			if (errno==EINTR || errno==EAGAIN) {
 				continue;
@@ -170,10 +207,49 @@ diskread(void *data, uint32_t block)
 	}
 }
 
+void
+diskwrite(const void *data, uint32_t block)
+{
+	dowrite(data, block, blocksize);
+}
+
+void
+diskread(void *data, uint32_t block)
+{
+	doread(data, block, blocksize);
+}
+
+/*
+ * Read/write only the first sector of a block. The superblock and
+ * inodes are one sector long no matter what the block size is.
+ */
+void
+diskwritehead(const void *data, uint32_t block)
+{
+	dowrite(data, block, BLOCKSIZE);
+}
+
+void
+diskreadhead(void *data, uint32_t block)
+{
+	doread(data, block, BLOCKSIZE);
+}
+
 void
 closedisk(void)
 {
 	assert(fd>=0);
+#ifndef HOST
+	if (buffered) {
+		int off = 0;
+
+		/* This writes out everything still in the cache. */
+		if (ioctl(fd, DIOCSBUFFER, &off)) {
+			err(1, "ioctl DIOCSBUFFER");
+		}
+		buffered = 0;
+	}
+#endif
 	if (close(fd)) {
 		err(1, "close");
 	}
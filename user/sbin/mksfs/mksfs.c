@@ -29,6 +29,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
@@ -55,7 +56,9 @@
 
 #include "disk.h"
 
-#define MAXBITBLOCKS 32
+#define MAXBITBYTES (32*SFS_BLOCKSIZE)
+
+static uint32_t blocksize = SFS_BLOCKSIZE;
 
 static
 void
@@ -81,8 +84,9 @@ writesuper(const char *volname, uint32_t nblocks)
 	sp.sp_magic = SWAPL(SFS_MAGIC);
 	sp.sp_nblocks = SWAPL(nblocks);
 	strcpy(sp.sp_volname, volname);
+	sp.sp_blocksize = SWAPL(blocksize);
 
-	diskwrite(&sp, SFS_SB_LOCATION);
+	diskwritehead(&sp, SFS_SB_LOCATION);
 }
 
 static
@@ -97,10 +101,10 @@ writerootdir(void)
 	sfi.sfi_type = SWAPS(SFS_TYPE_DIR);
 	sfi.sfi_linkcount = SWAPS(1);
 
-	diskwrite(&sfi, SFS_ROOT_LOCATION);
+	diskwritehead(&sfi, SFS_ROOT_LOCATION);
 }
 
-static char bitbuf[MAXBITBLOCKS*SFS_BLOCKSIZE];
+static char bitbuf[MAXBITBYTES];
 
 static
 void
@@ -118,14 +122,14 @@ void
 writebitmap(uint32_t fsblocks)
 {
 
-	uint32_t nbits = SFS_BITMAPSIZE(fsblocks);
-	uint32_t nblocks = SFS_BITBLOCKS(fsblocks);
+	uint32_t nbits = SFS_BITMAPSIZE(fsblocks, blocksize);
+	uint32_t nblocks = SFS_BITBLOCKS(fsblocks, blocksize);
 	char *ptr;
 	uint32_t i;
 
-	if (nblocks > MAXBITBLOCKS) {
+	if (nbits / CHAR_BIT > MAXBITBYTES) {
 		errx(1, "Filesystem too large "
-		     "- increase MAXBITBLOCKS and recompile");
+		     "- increase MAXBITBYTES and recompile");
 	}
 
 	doallocbit(SFS_SB_LOCATION);
@@ -138,7 +142,7 @@ writebitmap(uint32_t fsblocks)
 	}
 
 	for (i=0; i<nblocks; i++) {
-		ptr = bitbuf + i*SFS_BLOCKSIZE;
+		ptr = bitbuf + i*blocksize;
 		diskwrite(ptr, SFS_MAP_LOCATION+i);
 	}
 }
@@ -146,15 +150,27 @@ writebitmap(uint32_t fsblocks)
 int
 main(int argc, char **argv)
 {
-	uint32_t size, blocksize;
+	uint32_t size, sectorsize;
 	char *volname, *s;
 
 #ifdef HOST
 	hostcompat_init(argc, argv);
 #endif
 
+	if (argc==5 && !strcmp(argv[1], "-b")) {
+		blocksize = atoi(argv[2]);
+		if (!SFS_BLOCKSIZE_OK(blocksize)) {
+			errx(1, "Invalid block size %s (must be a power of 2 "
+			     "from %u to %u)", argv[2],
+			     SFS_BLOCKSIZE, SFS_MAXBLOCKSIZE);
+		}
+		argc -= 2;
+		argv += 2;
+	}
+
 	if (argc!=3) {
-		errx(1, "Usage: mksfs device/diskfile volume-name");
+		errx(1, "Usage: mksfs [-b blocksize] device/diskfile "
+		     "volume-name");
 	}
 
 	check();
@@ -177,12 +193,13 @@ main(int argc, char **argv)
 	}
 
 	opendisk(argv[1]);
-	blocksize = diskblocksize();
+	sectorsize = diskblocksize();
 
-	if (blocksize!=SFS_BLOCKSIZE) {
+	if (sectorsize!=SFS_BLOCKSIZE) {
 		errx(1, "Device has wrong blocksize %u (should be %u)\n",
-		     blocksize, SFS_BLOCKSIZE);
+		     sectorsize, SFS_BLOCKSIZE);
 	}
+	disksetblocksize(blocksize);
 	size = diskblocks();
 
 	writesuper(volname, size);
@@ -66,6 +66,13 @@
 
 static int badness=0;
 
+/* Filesystem block size; set from the superblock */
+static uint32_t blocksize = SFS_BLOCKSIZE;
+
+#define DBPERIDB	SFS_DBPERIDB(blocksize)
+#define MAXDBPERIDB	SFS_DBPERIDB(SFS_MAXBLOCKSIZE)
+#define BLOCKBITS	SFS_BLOCKBITS(blocksize)
+
 static
 void
 setbadness(int code)
@@ -83,6 +90,7 @@ swapsb(struct sfs_super *sp)
 {
 	sp->sp_magic = SWAPL(sp->sp_magic);
 	sp->sp_nblocks = SWAPL(sp->sp_nblocks);
+	sp->sp_blocksize = SWAPL(sp->sp_blocksize);
 }
 
 static
@@ -139,8 +147,8 @@ static
 void
 swapindir(uint32_t *entries)
 {
-	int i;
-	for (i=0; i<SFS_DBPERIDB; i++) {
+	uint32_t i;
+	for (i=0; i<DBPERIDB; i++) {
 		entries[i] = SWAPL(entries[i]);
 	}
 }
@@ -194,7 +202,7 @@ static
 void
 bitmap_init(uint32_t bitblocks)
 {
-	size_t i, mapsize = bitblocks * SFS_BLOCKSIZE;
+	size_t i, mapsize = bitblocks * blocksize;
 	bitmapdata = domalloc(mapsize * sizeof(uint8_t));
 	tofreedata = domalloc(mapsize * sizeof(uint8_t));
 	for (i=0; i<mapsize; i++) {
@@ -292,7 +300,7 @@ reportbits(uint32_t bitblock, uint32_t byte, uint8_t val, const char *what)
 
 	for (x=1, y=0; x; x<<=1, y++) {
 		if (val & x) {
-			blocknum = bitblock*SFS_BLOCKBITS + byte*CHAR_BIT + y;
+			blocknum = bitblock*BLOCKBITS + byte*CHAR_BIT + y;
 			warnx("Block %lu erroneously shown %s in bitmap",
 			      (unsigned long) blocknum, what);
 		}
@@ -303,18 +311,18 @@ static
 void
 check_bitmap(void)
 {
-	uint8_t bits[SFS_BLOCKSIZE], *found, *tofree, tmp;
+	uint8_t bits[SFS_MAXBLOCKSIZE], *found, *tofree, tmp;
 	uint32_t alloccount=0, freecount=0, i, j;
 	int bchanged;
 
 	for (i=0; i<bitblocks; i++) {
 		diskread(bits, SFS_MAP_LOCATION+i);
 		swapbits(bits);
-		found = bitmapdata + i*SFS_BLOCKSIZE;
-		tofree = tofreedata + i*SFS_BLOCKSIZE;
+		found = bitmapdata + i*blocksize;
+		tofree = tofreedata + i*blocksize;
 		bchanged = 0;
 
-		for (j=0; j<SFS_BLOCKSIZE; j++) {
+		for (j=0; j<blocksize; j++) {
 			/* we shouldn't have blocks marked both ways */
 			assert((found[j] & tofree[j])==0);
 
@@ -457,7 +465,7 @@ adjust_filelinks(void)
 			/* directory */
 			continue;
 		}
-		diskread(&sfi, inodes[i].ino);
+		diskreadhead(&sfi, inodes[i].ino);
 		swapinode(&sfi);
 		assert(sfi.sfi_type == SFS_TYPE_FILE);
 		if (sfi.sfi_linkcount != inodes[i].linkcount) {
@@ -468,7 +476,7 @@ adjust_filelinks(void)
 			sfi.sfi_linkcount = inodes[i].linkcount;
 			setbadness(EXIT_RECOV);
 			swapinode(&sfi);
-			diskwrite(&sfi, inodes[i].ino);
+			diskwritehead(&sfi, inodes[i].ino);
 		}
 		count_files++;
 	}
@@ -516,21 +524,30 @@ check_sb(void)
 	uint32_t i;
 	int schanged=0;
 
-	diskread(&sp, SFS_SB_LOCATION);
+	diskreadhead(&sp, SFS_SB_LOCATION);
 	swapsb(&sp);
 	if (sp.sp_magic != SFS_MAGIC) {
 		errx(EXIT_UNRECOV, "Not an sfs filesystem");
 	}
 
+	if (sp.sp_blocksize != 0) {
+		blocksize = sp.sp_blocksize;
+	}
+	if (!SFS_BLOCKSIZE_OK(blocksize)) {
+		errx(EXIT_UNRECOV, "Invalid block size %lu in superblock",
+		     (unsigned long) blocksize);
+	}
+	disksetblocksize(blocksize);
+
 	assert(nblocks==0);
 	assert(bitblocks==0);
 	nblocks = sp.sp_nblocks;
-	bitblocks = SFS_BITBLOCKS(nblocks);
+	bitblocks = SFS_BITBLOCKS(nblocks, blocksize);
 	assert(nblocks>0);
 	assert(bitblocks>0);
 
 	bitmap_init(bitblocks);
-	for (i=nblocks; i<bitblocks*SFS_BLOCKBITS; i++) {
+	for (i=nblocks; i<bitblocks*BLOCKBITS; i++) {
 		bitmap_mark(i, B_PASTEND, 0);
 	}
 
@@ -547,7 +564,7 @@ check_sb(void)
 
 	if (schanged) {
 		swapsb(&sp);
-		diskwrite(&sp, SFS_SB_LOCATION);
+		diskwritehead(&sp, SFS_SB_LOCATION);
 	}
 
 	bitmap_mark(SFS_SB_LOCATION, B_SUPERBLOCK, 0);
@@ -564,7 +581,7 @@ check_indirect_block(uint32_t ino, uint32_t *ientry, uint32_t *blockp,
 		     uint32_t nblocks, uint32_t *badcountp, 
 		     int isdir, int indirection)
 {
-	uint32_t entries[SFS_DBPERIDB];
+	uint32_t entries[MAXDBPERIDB];
 	uint32_t i, ct;
 
 	if (*ientry !=0) {
@@ -573,13 +590,13 @@ check_indirect_block(uint32_t ino, uint32_t *ientry, uint32_t *blockp,
 		bitmap_mark(*ientry, B_IBLOCK, ino);
 	}
 	else {
-		for (i=0; i<SFS_DBPERIDB; i++) {
+		for (i=0; i<DBPERIDB; i++) {
 			entries[i] = 0;
 		}
 	}
 
 	if (indirection > 1) {
-		for (i=0; i<SFS_DBPERIDB; i++) {
+		for (i=0; i<DBPERIDB; i++) {
 			check_indirect_block(ino, &entries[i], 
 					     blockp, nblocks, 
 					     badcountp,
@@ -590,7 +607,7 @@ check_indirect_block(uint32_t ino, uint32_t *ientry, uint32_t *blockp,
 	else {
 		assert(indirection==1);
 
-		for (i=0; i<SFS_DBPERIDB; i++) {
+		for (i=0; i<DBPERIDB; i++) {
 			if (*blockp < nblocks) {
 				if (entries[i] != 0) {
 					bitmap_mark(entries[i],
@@ -612,7 +629,7 @@ check_indirect_block(uint32_t ino, uint32_t *ientry, uint32_t *blockp,
 	}
 
 	ct=0;
-	for (i=ct=0; i<SFS_DBPERIDB; i++) {
+	for (i=ct=0; i<DBPERIDB; i++) {
 		if (entries[i]!=0) ct++;
 	}
 	if (ct==0) {
@@ -640,8 +657,8 @@ check_inode_blocks(uint32_t ino, struct sfs_inode *sfi, int isdir)
 
 	badcount = 0;
 
-	size = SFS_ROUNDUP(sfi->sfi_size, SFS_BLOCKSIZE);
-	nblocks = size/SFS_BLOCKSIZE;
+	size = SFS_ROUNDUP(sfi->sfi_size, blocksize);
+	nblocks = size/blocksize;
 
 	for (block=0; block<SFS_NDIRECT; block++) {
 		if (block < nblocks) {
@@ -709,7 +726,7 @@ static
 uint32_t
 ibmap(uint32_t iblock, uint32_t offset, uint32_t entrysize)
 {
-	uint32_t entries[SFS_DBPERIDB];
+	uint32_t entries[MAXDBPERIDB];
 
 	if (iblock == 0) {
 		return 0;
@@ -721,10 +738,10 @@ ibmap(uint32_t iblock, uint32_t offset, uint32_t entrysize)
 	if (entrysize > 1) {
 		uint32_t index = offset / entrysize;
 		offset %= entrysize;
-		return ibmap(entries[index], offset, entrysize/SFS_DBPERIDB);
+		return ibmap(entries[index], offset, entrysize/DBPERIDB);
 	}
 	else {
-		assert(offset < SFS_DBPERIDB);
+		assert(offset < DBPERIDB);
 		return entries[offset];
 	}
 }
@@ -767,14 +784,14 @@ ibmap(uint32_t iblock, uint32_t offset, uint32_t entrysize)
 #endif
 
 #define BMAP_DMAX   BMAP_ND
-#define BMAP_IMAX   (BMAP_DMAX+SFS_DBPERIDB*BMAP_NI)
-#define BMAP_IIMAX  (BMAP_IMAX+SFS_DBPERIDB*BMAP_NII)
-#define BMAP_IIIMAX (BMAP_IIMAX+SFS_DBPERIDB*BMAP_NIII)
+#define BMAP_IMAX   (BMAP_DMAX+DBPERIDB*BMAP_NI)
+#define BMAP_IIMAX  (BMAP_IMAX+DBPERIDB*BMAP_NII)
+#define BMAP_IIIMAX (BMAP_IIMAX+DBPERIDB*BMAP_NIII)
 
 #define BMAP_DSIZE	1
-#define BMAP_ISIZE	(BMAP_DSIZE*SFS_DBPERIDB)
-#define BMAP_IISIZE	(BMAP_ISIZE*SFS_DBPERIDB)
-#define BMAP_IIISIZE	(BMAP_IISIZE*SFS_DBPERIDB)
+#define BMAP_ISIZE	(BMAP_DSIZE*DBPERIDB)
+#define BMAP_IISIZE	(BMAP_ISIZE*DBPERIDB)
+#define BMAP_IIISIZE	(BMAP_IISIZE*DBPERIDB)
 
 static
 uint32_t
@@ -807,7 +824,7 @@ static
 void
 dirread(struct sfs_inode *sfi, struct sfs_dir *d, unsigned nd)
 {
-	const unsigned atonce = SFS_BLOCKSIZE/sizeof(struct sfs_dir);
+	const unsigned atonce = blocksize/sizeof(struct sfs_dir);
 	unsigned nblocks = SFS_ROUNDUP(nd, atonce) / atonce;
 	unsigned i, j;
 
@@ -821,7 +838,7 @@ dirread(struct sfs_inode *sfi, struct sfs_dir *d, unsigned nd)
 		}
 		else {
 			warnx("Warning: sparse directory found");
-			bzero(d + i*atonce, SFS_BLOCKSIZE);
+			bzero(d + i*atonce, blocksize);
 		}
 	}
 }
@@ -830,7 +847,7 @@ static
 void
 dirwrite(const struct sfs_inode *sfi, struct sfs_dir *d, int nd)
 {
-	const unsigned atonce = SFS_BLOCKSIZE/sizeof(struct sfs_dir);
+	const unsigned atonce = blocksize/sizeof(struct sfs_dir);
 	unsigned nblocks = SFS_ROUNDUP(nd, atonce) / atonce;
 	unsigned i, j, bad;
 
@@ -976,7 +993,7 @@ check_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 	uint32_t dirsize, ndirentries, maxdirentries, subdircount, i;
 	int ichanged=0, dchanged=0, dotseen=0, dotdotseen=0;
 
-	diskread(&sfi, ino);
+	diskreadhead(&sfi, ino);
 	swapinode(&sfi);
 
 	if (remember_dir(ino, pathsofar)) {
@@ -1002,7 +1019,7 @@ check_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 
 	ndirentries = sfi.sfi_size/sizeof(struct sfs_dir);
 	maxdirentries = SFS_ROUNDUP(ndirentries, 
-				    SFS_BLOCKSIZE/sizeof(struct sfs_dir));
+				    blocksize/sizeof(struct sfs_dir));
 	dirsize = maxdirentries * sizeof(struct sfs_dir);
 	direntries = domalloc(dirsize);
 	sortvector = domalloc(ndirentries * sizeof(int));
@@ -1142,7 +1159,7 @@ check_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 			char path[strlen(pathsofar)+SFS_NAMELEN+1];
 			struct sfs_inode subsfi;
 
-			diskread(&subsfi, direntries[i].sfd_ino);
+			diskreadhead(&subsfi, direntries[i].sfd_ino);
 			swapinode(&subsfi);
 			snprintf(path, sizeof(path), "%s/%s", 
 				 pathsofar, direntries[i].sfd_name);
@@ -1152,7 +1169,7 @@ check_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 				if (check_inode_blocks(direntries[i].sfd_ino,
 						       &subsfi, 0)) {
 					swapinode(&subsfi);
-					diskwrite(&subsfi, 
+					diskwritehead(&subsfi, 
 						  direntries[i].sfd_ino);
 				}
 				observe_filelink(direntries[i].sfd_ino);
@@ -1200,7 +1217,7 @@ check_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 
 	if (ichanged) {
 		swapinode(&sfi);
-		diskwrite(&sfi, ino);
+		diskwritehead(&sfi, ino);
 	}
 
 	free(direntries);
@@ -1215,7 +1232,7 @@ void
 check_root_dir(void)
 {
 	struct sfs_inode sfi;
-	diskread(&sfi, SFS_ROOT_LOCATION);
+	diskreadhead(&sfi, SFS_ROOT_LOCATION);
 	swapinode(&sfi);
 
 	switch (sfi.sfi_type) {
@@ -1231,7 +1248,7 @@ check_root_dir(void)
 		setbadness(EXIT_RECOV);
 		sfi.sfi_type = SFS_TYPE_DIR;
 		swapinode(&sfi);
-		diskwrite(&sfi, SFS_ROOT_LOCATION);
+		diskwritehead(&sfi, SFS_ROOT_LOCATION);
 		break;
 	}
 
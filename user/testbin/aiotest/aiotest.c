@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * aiotest.c
+ *
+ * 	Tests asynchronous I/O: writes a file with a batch of aio_write
+ * 	requests collected by aio_waitcomplete, then reads it back with
+ * 	aio_read, aio_suspend, aio_error, and aio_return, and checks the
+ * 	data.
+ *
+ * Needs a filesystem that supports remove() to clean up after itself.
+ */
+
+#include <aio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#define NREQS     16
+#define BLOCKSIZE 512
+
+static struct aiocb cbs[NREQS];
+static char wbuf[NREQS][BLOCKSIZE];
+static char rbuf[NREQS][BLOCKSIZE];
+
+static
+void
+setup(int fd, int i, char *buf)
+{
+	cbs[i].aio_fildes = fd;
+	cbs[i].aio_offset = (off_t)i * BLOCKSIZE;
+	cbs[i].aio_buf = buf;
+	cbs[i].aio_nbytes = BLOCKSIZE;
+}
+
+static
+void
+writeall(int fd)
+{
+	struct aiocb *cb;
+	ssize_t r;
+	int i;
+
+	for (i=0; i<NREQS; i++) {
+		setup(fd, i, wbuf[i]);
+		if (aio_write(&cbs[i]) < 0) {
+			err(1, "aio_write %d", i);
+		}
+	}
+
+	for (i=0; i<NREQS; i++) {
+		r = aio_waitcomplete(&cb, 0);
+		if (r < 0) {
+			err(1, "aio_waitcomplete");
+		}
+		if (cb < cbs || cb >= cbs + NREQS) {
+			errx(1, "aio_waitcomplete: bogus control block %p",
+			     cb);
+		}
+		if (r != BLOCKSIZE) {
+			errx(1, "Write %d: short write (%d)", (int)(cb - cbs),
+			     (int)r);
+		}
+	}
+
+	/* nothing left */
+	if (aio_waitcomplete(&cb, AIO_NOWAIT) >= 0 || errno != EINVAL) {
+		errx(1, "aio_waitcomplete with nothing queued didn't fail");
+	}
+}
+
+static
+void
+readall(int fd)
+{
+	const struct aiocb *list[NREQS];
+	volatile unsigned spins = 0;
+	int i, left, e;
+
+	for (i=0; i<NREQS; i++) {
+		setup(fd, i, rbuf[i]);
+		if (aio_read(&cbs[i]) < 0) {
+			err(1, "aio_read %d", i);
+		}
+		list[i] = &cbs[i];
+	}
+
+	/* do some "work" while the reads are in progress */
+	while (aio_error(&cbs[NREQS-1]) == EINPROGRESS && spins < 100000) {
+		spins++;
+	}
+
+	left = NREQS;
+	while (left > 0) {
+		if (aio_suspend(list, NREQS) < 0) {
+			err(1, "aio_suspend");
+		}
+		for (i=0; i<NREQS; i++) {
+			if (list[i] == NULL) {
+				continue;
+			}
+			e = aio_error(&cbs[i]);
+			if (e == EINPROGRESS) {
+				continue;
+			}
+			if (e != 0) {
+				errx(1, "Read %d: %s", i, strerror(e));
+			}
+			if (aio_return(&cbs[i]) != BLOCKSIZE) {
+				errx(1, "Read %d: short read", i);
+			}
+			list[i] = NULL;
+			left--;
+		}
+	}
+
+	/* collected requests are forgotten */
+	if (aio_error(&cbs[0]) >= 0 || errno != EINVAL) {
+		errx(1, "aio_error on a collected request didn't fail");
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *name = "aiotest.dat";
+	int fd, i, j;
+
+	if (argc > 2) {
+		errx(1, "Usage: aiotest [filename]");
+	}
+	if (argc == 2) {
+		name = argv[1];
+	}
+
+	for (i=0; i<NREQS; i++) {
+		for (j=0; j<BLOCKSIZE; j++) {
+			wbuf[i][j] = 'A' + (i*3 + j) % 26;
+		}
+	}
+
+	fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd<0) {
+		err(1, "%s: open", name);
+	}
+
+	writeall(fd);
+	readall(fd);
+
+	if (close(fd) < 0) {
+		err(1, "%s: close", name);
+	}
+	if (memcmp(rbuf, wbuf, sizeof(wbuf))) {
+		errx(1, "Data mismatch!");
+	}
+	if (remove(name) < 0) {
+		err(1, "%s: remove", name);
+	}
+	printf("Passed aiotest.\n");
+	return 0;
+}
@@ -308,7 +308,13 @@ main(int argc, char **argv)
 			if (op==EOF) {
 				break;
 			}
-			printf("%c\n", op);
+			/* the console has echoed the line */
+			while (op=='\n') {
+				op = getchar();
+			}
+			if (op==EOF) {
+				break;
+			}
 			runit(op);
 		}
 	}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * cloexec.c
+ *
+ * 	Checks close-on-exec and the file table sharing behind fork:
+ * 	the flag follows open, fcntl and dup2; closes and dup2s in a
+ * 	forked child don't show up in the parent; and exec closes the
+ * 	marked handles and only those.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#define PROG      "/testbin/cloexec"
+#define TESTFILE  "cloexec.tmp"
+
+static
+int
+getfd(int fd)
+{
+	int flags;
+
+	flags = fcntl(fd, F_GETFD, 0);
+	if (flags < 0) {
+		err(1, "fcntl F_GETFD on %d", fd);
+	}
+	return flags & FD_CLOEXEC;
+}
+
+static
+void
+waitchild(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+}
+
+/*
+ * Run in the exec'd image: KEPT must still be open, CLOSED must not.
+ */
+static
+void
+afterexec(int kept, int closed)
+{
+	if (fcntl(closed, F_GETFD, 0) >= 0 || errno != EBADF) {
+		errx(1, "close-on-exec handle %d survived exec", closed);
+	}
+	if (getfd(kept) != 0) {
+		errx(1, "handle %d lost across exec", kept);
+	}
+	exit(0);
+}
+
+static
+void
+flagtest(int fd)
+{
+	int fd2 = fd + 1;
+
+	if (getfd(fd) != FD_CLOEXEC) {
+		errx(1, "O_CLOEXEC not set on open");
+	}
+	if (fcntl(fd, F_SETFD, 0) < 0) {
+		err(1, "fcntl F_SETFD");
+	}
+	if (getfd(fd) != 0) {
+		errx(1, "F_SETFD did not clear the flag");
+	}
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		err(1, "fcntl F_SETFD");
+	}
+	if (dup2(fd, fd2) < 0) {
+		err(1, "dup2");
+	}
+	if (getfd(fd2) != 0) {
+		errx(1, "dup2 copied the close-on-exec flag");
+	}
+	close(fd2);
+	printf("cloexec: flags ok\n");
+}
+
+static
+void
+forktest(int fd)
+{
+	int other = fd + 1;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		if (close(fd) < 0) {
+			err(1, "close in child");
+		}
+		if (dup2(STDOUT_FILENO, other) < 0) {
+			err(1, "dup2 in child");
+		}
+		if (getfd(other) != 0) {
+			errx(1, "dup2 in child");
+		}
+		_exit(0);
+	}
+	waitchild(pid);
+
+	if (getfd(fd) != FD_CLOEXEC) {
+		errx(1, "child's close affected the parent");
+	}
+	if (fcntl(other, F_GETFD, 0) >= 0) {
+		errx(1, "child's dup2 affected the parent");
+	}
+	printf("cloexec: fork ok\n");
+}
+
+static
+void
+exectest(int fd)
+{
+	char a1[16], a2[16];
+	char *args[4];
+	int kept;
+	pid_t pid;
+
+	kept = open(TESTFILE, O_RDONLY);
+	if (kept < 0) {
+		err(1, "%s", TESTFILE);
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		snprintf(a1, sizeof(a1), "%d", kept);
+		snprintf(a2, sizeof(a2), "%d", fd);
+		args[0] = (char *)PROG;
+		args[1] = a1;
+		args[2] = a2;
+		args[3] = NULL;
+		execv(PROG, args);
+		err(1, "%s", PROG);
+	}
+	waitchild(pid);
+
+	if (getfd(fd) != FD_CLOEXEC) {
+		errx(1, "child's exec affected the parent");
+	}
+	close(kept);
+	printf("cloexec: exec ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	int fd;
+
+	if (argc == 3) {
+		afterexec(atoi(argv[1]), atoi(argv[2]));
+	}
+
+	fd = open(TESTFILE, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0664);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+
+	flagtest(fd);
+	forktest(fd);
+	exectest(fd);
+
+	close(fd);
+	remove(TESTFILE);
+	printf("cloexec: passed\n");
+	return 0;
+}
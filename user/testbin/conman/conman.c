@@ -32,6 +32,9 @@
  *
  * Echoes characters until a 'q' is read.
  * This should work once the basic system calls are implemented.
+ *
+ * The console is switched out of canonical mode and echo for the
+ * duration, so each character comes through as it is typed.
  */
 
 #include <unistd.h>
@@ -40,7 +43,16 @@
 int
 main() {
 	char ch=0;
-	int len;
+	int len, mode, oldmode;
+	int havemode;
+
+	havemode = (ioctl(STDIN_FILENO, TIOCGETMODE, &oldmode) == 0);
+	if (havemode) {
+		mode = 0;
+		if (ioctl(STDIN_FILENO, TIOCSETMODE, &mode) < 0) {
+			err(1, "stdin: ioctl");
+		}
+	}
 
 	while (ch!='q') {
 		len = read(STDIN_FILENO, &ch, 1);
@@ -53,5 +65,9 @@ main() {
 		}
 		write(STDOUT_FILENO, &ch, 1);
 	}
+
+	if (havemode) {
+		ioctl(STDIN_FILENO, TIOCSETMODE, &oldmode);
+	}
 	return 0;
 }
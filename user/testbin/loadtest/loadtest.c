@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * loadtest.c
+ *
+ * 	Checks the scheduler load figures: starts a few processes that
+ * 	spin for several seconds, spins alongside them, and checks that
+ * 	getloadinfo reports a 1-second load average of about that many
+ * 	and a wait histogram that has counted something.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <err.h>
+
+#define NSPIN     4
+#define SPINSECS  8
+#define SAMPLESECS 5
+
+/*
+ * Burn cpu until SECS seconds after START.
+ */
+static
+void
+spin(time_t start, time_t secs)
+{
+	volatile unsigned x = 0;
+
+	while (time(NULL) - start < secs) {
+		x++;
+	}
+}
+
+static
+void
+printinfo(const struct loadinfo *li)
+{
+	unsigned i;
+
+	printf("loadtest: load %u.%02u %u.%02u %u.%02u, %u active\n",
+	       li->li_load[0] / li->li_fscale,
+	       li->li_load[0] % li->li_fscale * 100 / li->li_fscale,
+	       li->li_load[1] / li->li_fscale,
+	       li->li_load[1] % li->li_fscale * 100 / li->li_fscale,
+	       li->li_load[2] / li->li_fscale,
+	       li->li_load[2] % li->li_fscale * 100 / li->li_fscale,
+	       li->li_nactive);
+	printf("loadtest: waits (from %u usec, doubling):", LATENCY_MIN_USEC);
+	for (i=0; i<LATENCY_NBUCKETS; i++) {
+		printf(" %u", li->li_latency[i]);
+	}
+	printf("\n");
+	printf("loadtest: this process waited %u times, %u ms in all\n",
+	       li->li_mywaits, li->li_mywaitms);
+}
+
+int
+main(void)
+{
+	struct loadinfo li;
+	pid_t pids[NSPIN];
+	time_t start;
+	unsigned i, total;
+	int status;
+
+	start = time(NULL);
+	for (i=0; i<NSPIN; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			spin(start, SPINSECS);
+			_exit(0);
+		}
+	}
+
+	spin(start, SAMPLESECS);
+	if (getloadinfo(&li) < 0) {
+		err(1, "getloadinfo");
+	}
+	printinfo(&li);
+
+	for (i=0; i<NSPIN; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+	}
+
+	/* NSPIN children and us, but allow for startup and rounding */
+	if (li.li_load[0] < li.li_fscale * NSPIN / 2) {
+		errx(1, "1-second load average is too low");
+	}
+	total = 0;
+	for (i=0; i<LATENCY_NBUCKETS; i++) {
+		total += li.li_latency[i];
+	}
+	if (total == 0 || li.li_mywaits == 0) {
+		errx(1, "no run-queue waits were counted");
+	}
+
+	printf("loadtest: passed\n");
+	return 0;
+}
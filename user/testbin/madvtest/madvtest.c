@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * madvtest.c
+ *
+ * 	Tests madvise: MADV_DONTNEED should give back pages so that they
+ * 	read as zero and the resident set shrinks; MADV_WILLNEED should
+ * 	bring pages in; the access-pattern hints should be accepted;
+ * 	and bad arguments should be rejected.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+
+#define PAGE    4096
+#define NPAGES  32
+
+/* the page-aligned part of this is used */
+static char buf[(NPAGES + 1) * PAGE];
+
+static
+unsigned
+rss(void)
+{
+	struct wsinfo wi;
+
+	if (getwsinfo(&wi) < 0) {
+		/* not every VM system keeps these */
+		return 0;
+	}
+	return wi.wi_rss;
+}
+
+int
+main(void)
+{
+	char *p;
+	unsigned i, before, after;
+
+	p = (char *)(((uintptr_t)buf + PAGE - 1) & ~(uintptr_t)(PAGE - 1));
+
+	for (i=0; i<NPAGES; i++) {
+		p[i * PAGE] = 'x';
+	}
+
+	before = rss();
+	if (madvise(p, NPAGES * PAGE, MADV_DONTNEED) < 0) {
+		err(1, "madvise MADV_DONTNEED");
+	}
+	after = rss();
+	if (before != 0 && after + NPAGES > before) {
+		errx(1, "rss went from %u to %u, expected it to drop by %u",
+		     before, after, NPAGES);
+	}
+	for (i=0; i<NPAGES; i++) {
+		if (p[i * PAGE] != 0) {
+			errx(1, "page %u not zero after MADV_DONTNEED", i);
+		}
+	}
+
+	if (madvise(p, NPAGES * PAGE, MADV_DONTNEED) < 0) {
+		err(1, "madvise MADV_DONTNEED");
+	}
+	before = rss();
+	if (madvise(p, NPAGES * PAGE, MADV_WILLNEED) < 0) {
+		err(1, "madvise MADV_WILLNEED");
+	}
+	after = rss();
+	if (before != 0 && after < before + NPAGES) {
+		errx(1, "rss went from %u to %u, expected it to grow by %u",
+		     before, after, NPAGES);
+	}
+
+	if (madvise(p + PAGE, 4 * PAGE, MADV_SEQUENTIAL) < 0) {
+		err(1, "madvise MADV_SEQUENTIAL");
+	}
+	if (madvise(p + 8 * PAGE, PAGE, MADV_RANDOM) < 0) {
+		err(1, "madvise MADV_RANDOM");
+	}
+	if (madvise(p, NPAGES * PAGE, MADV_NORMAL) < 0) {
+		err(1, "madvise MADV_NORMAL");
+	}
+
+	if (madvise(p + 1, PAGE, MADV_NORMAL) == 0 || errno != EINVAL) {
+		errx(1, "unaligned address: expected EINVAL");
+	}
+	if (madvise(p, PAGE, 99) == 0 || errno != EINVAL) {
+		errx(1, "bad advice: expected EINVAL");
+	}
+	if (madvise(NULL, PAGE, MADV_NORMAL) == 0 || errno != ENOMEM) {
+		errx(1, "unmapped range: expected ENOMEM");
+	}
+
+	printf("madvtest: passed\n");
+	return 0;
+}
@@ -66,24 +66,15 @@ geti(void)
 	int ch, digits=0;
 
 	while (1) {
+		/* the console echoes and handles backspace */
 		ch = getchar();
-		if (ch=='\n' || ch=='\r') {
-			putchar('\n');
+		if (ch=='\n' || ch=='\r' || ch==EOF) {
 			break;
 		}
-		else if ((ch=='\b' || ch==127) && digits>0) {
-			printf("\b \b");
-			val = val/10;
-			digits--;
-		}
 		else if (ch>='0' && ch<='9') {
-			putchar(ch);
 			val = val*10 + (ch-'0');
 			digits++;
 		}
-		else {
-			putchar('\a');
-		}
 	}
 
 	if (digits==0) {
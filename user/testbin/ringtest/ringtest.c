@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * ringtest.c
+ *
+ * 	Tests the submission ring: opens a file, writes it in blocks at
+ * 	explicit offsets, and reads it back, all through ioring_enter,
+ * 	then checks the data with plain read().
+ *
+ * Needs a filesystem that supports remove() to clean up after itself.
+ */
+
+#include <sys/ioring.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define NBLOCKS   32
+#define BLOCKSIZE 512
+
+static struct ioring ring __attribute__((__aligned__(4096)));
+static char wbuf[NBLOCKS][BLOCKSIZE];
+static char rbuf[NBLOCKS][BLOCKSIZE];
+
+/*
+ * Queue one request.
+ */
+static
+void
+push(int op, int fd, void *buf, size_t len, off_t offset, int flags,
+     unsigned user)
+{
+	struct ioring_sqe *sqe;
+
+	if (ring.ir_sqtail - ring.ir_sqhead >= IORING_ENTRIES) {
+		errx(1, "Submission queue full");
+	}
+	sqe = &ring.ir_sq[ring.ir_sqtail % IORING_ENTRIES];
+	sqe->sqe_op = op;
+	sqe->sqe_fd = fd;
+	sqe->sqe_buf = buf;
+	sqe->sqe_len = len;
+	sqe->sqe_offset = offset;
+	sqe->sqe_flags = flags;
+	sqe->sqe_user = user;
+	ring.ir_sqtail++;
+}
+
+/*
+ * Submit everything queued and reap N completions, checking that each
+ * one succeeded. Returns the result of the last.
+ */
+static
+int
+run(unsigned n, unsigned expect)
+{
+	struct ioring_cqe *cqe;
+	unsigned pending, got = 0;
+	int result = 0;
+
+	pending = ring.ir_sqtail - ring.ir_sqhead;
+	while (got < n) {
+		if (ioring_enter(pending, n - got) < 0) {
+			err(1, "ioring_enter");
+		}
+		pending = ring.ir_sqtail - ring.ir_sqhead;
+		while (ring.ir_cqhead != ring.ir_cqtail) {
+			cqe = &ring.ir_cq[ring.ir_cqhead % IORING_ENTRIES];
+			if (cqe->cqe_result < 0) {
+				errx(1, "Request %u: %s", cqe->cqe_user,
+				     strerror(cqe->cqe_error));
+			}
+			if (expect && (unsigned)cqe->cqe_result != expect) {
+				errx(1, "Request %u: short transfer (%d)",
+				     cqe->cqe_user, cqe->cqe_result);
+			}
+			result = cqe->cqe_result;
+			ring.ir_cqhead++;
+			got++;
+		}
+	}
+	return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *name = "ringtest.dat";
+	int fd, i, j;
+
+	if (argc > 2) {
+		errx(1, "Usage: ringtest [filename]");
+	}
+	if (argc == 2) {
+		name = argv[1];
+	}
+
+	for (i=0; i<NBLOCKS; i++) {
+		for (j=0; j<BLOCKSIZE; j++) {
+			wbuf[i][j] = 'a' + (i*7 + j) % 26;
+		}
+	}
+
+	if (ioring_setup(&ring) < 0) {
+		err(1, "ioring_setup");
+	}
+
+	/* open */
+	push(IORING_OP_OPEN, 0, (void *)name, 0, 0,
+	     O_RDWR|O_CREAT|O_TRUNC, 0);
+	fd = run(1, 0);
+
+	/* write every block, in reverse order, in one go */
+	for (i=NBLOCKS-1; i>=0; i--) {
+		push(IORING_OP_WRITE, fd, wbuf[i], BLOCKSIZE,
+		     (off_t)i * BLOCKSIZE, 0, i);
+	}
+	run(NBLOCKS, BLOCKSIZE);
+
+	/* read them back */
+	for (i=0; i<NBLOCKS; i++) {
+		push(IORING_OP_READ, fd, rbuf[i], BLOCKSIZE,
+		     (off_t)i * BLOCKSIZE, 0, i);
+	}
+	run(NBLOCKS, BLOCKSIZE);
+
+	push(IORING_OP_CLOSE, fd, NULL, 0, 0, 0, 0);
+	run(1, 0);
+
+	if (memcmp(rbuf, wbuf, sizeof(wbuf))) {
+		errx(1, "Ring read data mismatch!");
+	}
+
+	/* check the file with ordinary reads too */
+	fd = open(name, O_RDONLY);
+	if (fd<0) {
+		err(1, "%s: open", name);
+	}
+	memset(rbuf, 0, sizeof(rbuf));
+	for (i=0; i<NBLOCKS; i++) {
+		if (read(fd, rbuf[i], BLOCKSIZE) != BLOCKSIZE) {
+			err(1, "%s: read", name);
+		}
+	}
+	close(fd);
+	if (memcmp(rbuf, wbuf, sizeof(wbuf))) {
+		errx(1, "File data mismatch!");
+	}
+
+	if (remove(name) < 0) {
+		err(1, "%s: remove", name);
+	}
+	printf("Passed ringtest.\n");
+	return 0;
+}
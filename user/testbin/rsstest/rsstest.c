@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * rsstest.c
+ *
+ * 	Tests resident-set limits: checks the getrlimit/setrlimit rules,
+ * 	then forks a child that sets a small hard RSS limit and touches
+ * 	more memory than that. The child should be killed by a fault,
+ * 	and one that stays within its limit should not.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#define PAGE      4096
+#define LIMIT     64			/* child's limit, in pages */
+#define NPAGES    (LIMIT * 2)		/* memory the child touches */
+
+static char buf[NPAGES * PAGE];
+
+static
+void
+checkrules(void)
+{
+	struct rlimit rl, orig;
+
+	if (getrlimit(RLIMIT_RSS, &orig) < 0) {
+		err(1, "getrlimit");
+	}
+
+	rl.rlim_cur = 2;
+	rl.rlim_max = 1;
+	if (setrlimit(RLIMIT_RSS, &rl) == 0 || errno != EINVAL) {
+		errx(1, "setrlimit with soft > hard: expected EINVAL");
+	}
+
+	if (getrlimit(RLIMIT_NPROC, &rl) == 0 || errno != EINVAL) {
+		errx(1, "getrlimit RLIMIT_NPROC: expected EINVAL");
+	}
+
+	if (orig.rlim_max != RLIM_INFINITY) {
+		printf("rsstest: hard limit already set; skipping EPERM check\n");
+		return;
+	}
+
+	/* lower the hard limit, then try to raise it again */
+	rl.rlim_cur = rl.rlim_max = (rlim_t)1024 * 1024 * 1024;
+	if (setrlimit(RLIMIT_RSS, &rl) < 0) {
+		err(1, "setrlimit");
+	}
+	rl.rlim_max = RLIM_INFINITY;
+	if (setrlimit(RLIMIT_RSS, &rl) == 0 || errno != EPERM) {
+		errx(1, "raising the hard limit: expected EPERM");
+	}
+}
+
+/*
+ * Set the limit and touch NTOUCH pages of buf. Runs in a child.
+ */
+static
+void
+toucher(unsigned ntouch)
+{
+	struct rlimit rl;
+	unsigned i;
+
+	rl.rlim_cur = rl.rlim_max = (rlim_t)LIMIT * PAGE;
+	if (setrlimit(RLIMIT_RSS, &rl) < 0) {
+		err(1, "setrlimit");
+	}
+	for (i=0; i<ntouch; i++) {
+		buf[i * PAGE] = 1;
+	}
+	_exit(0);
+}
+
+static
+int
+runchild(unsigned ntouch)
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		toucher(ntouch);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	return status;
+}
+
+int
+main(void)
+{
+	pid_t pid;
+	int status;
+
+	/* the rules check lowers the hard limit, so do it in a child */
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		checkrules();
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "rules check failed");
+	}
+
+	status = runchild(LIMIT / 2);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child within its limit did not exit cleanly");
+	}
+
+	status = runchild(NPAGES);
+	if (!WIFSIGNALED(status)) {
+		errx(1, "child over its limit was not killed");
+	}
+
+	printf("rsstest: passed\n");
+	return 0;
+}
@@ -366,7 +366,6 @@ read_string(char *buf, int length)
 	    i < length) {
 		buf[i] = (char) char_read;
 		i++;
-		putchar(char_read);
 	}
 
 	if (char_read == EOF)
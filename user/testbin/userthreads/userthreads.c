@@ -32,17 +32,10 @@
  * forks 3 threads off 2 to functions, each of which displays a string
  * every once in a while.
  *
- * This won't do much of anything unless you implement user-level
- * threads.
- *
- * It also makes various assumptions about the thread API. In
- * particular, it believes (1) that you create a thread by calling
- * "threadfork()" and passing the address for execution of the new
- * thread to begin at, (2) that if the parent thread exits any child
- * threads will keep running, and (3) child threads will exit if they
- * return from the function they started in. If any or all of these
- * assumptions are not met by your user-level threads, you will need
- * to patch this test accordingly.
+ * It uses the libc thread package (<uthread.h>). The threads are
+ * not preemptive, so each one yields after printing; the parent
+ * leaves with uthread_exit so that the others keep running, and each
+ * child exits by returning from the function it started in.
  *
  * This is also a rather basic test and you'll probably want to write
  * some more of your own.
@@ -51,6 +44,8 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <err.h>
+#include <uthread.h>
 
 #define NTHREADS  3
 #define MAX       1<<25
@@ -61,8 +56,8 @@
 volatile int count = 0;
 
 /* the 2 threads : */
-void ThreadRunner(void);
-void BladeRunner(void);
+void ThreadRunner(void *);
+void BladeRunner(void *);
 
 int
 main(int argc, char *argv[])
@@ -73,13 +68,18 @@ main(int argc, char *argv[])
     (void)argv;
 
     for (i=0; i<NTHREADS; i++) {
-	if (i)
-	    threadfork(ThreadRunner);
-        else
-	    threadfork(BladeRunner);
+	if (i) {
+	    if (uthread_create(NULL, ThreadRunner, NULL))
+		errx(1, "uthread_create failed");
+	}
+        else {
+	    if (uthread_create(NULL, BladeRunner, NULL))
+		errx(1, "uthread_create failed");
+	}
     }
 
     printf("Parent has left.\n");
+    uthread_exit();
     return 0;
 }
 
@@ -89,21 +89,27 @@ main(int argc, char *argv[])
 */
 
 void
-BladeRunner()
+BladeRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
-	if (count % 500 == 0)
+	if (count % 500 == 0) {
 	    printf("Blade ");
+	    uthread_yield();
+	}
 	count++;
     }
 }
 
 void
-ThreadRunner()
+ThreadRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
-	if (count % 513 == 0)
+	if (count % 513 == 0) {
 	    printf(" Runner\n");
+	    uthread_yield();
+	}
 	count++;
     }
 }
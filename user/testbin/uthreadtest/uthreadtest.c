@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * uthreadtest.c
+ *
+ * 	Tests the user-level thread library: a ring of threads passing
+ * 	a token by yielding, producers and consumers sharing a bounded
+ * 	buffer under a mutex and two condition variables, and joining.
+ */
+
+#include <stdio.h>
+#include <err.h>
+#include <uthread.h>
+
+#define NRING     8
+#define NLAPS     1000
+
+#define NPRODUCERS 4
+#define NCONSUMERS 3
+#define NITEMS     500		/* per producer */
+#define BUFSIZE    5
+
+/*
+ * Ring: each thread waits for the token to come round to it, bumps
+ * it, and yields. The token only ever moves one step at a time, so
+ * this checks that yield is round-robin.
+ */
+static unsigned token;
+
+static
+void
+ringthread(void *arg)
+{
+	unsigned me = (unsigned)arg;
+	unsigned lap;
+
+	for (lap=0; lap<NLAPS; lap++) {
+		while (token % NRING != me) {
+			uthread_yield();
+		}
+		if (token != lap * NRING + me) {
+			errx(1, "ring: thread %u saw token %u on lap %u",
+			     me, token, lap);
+		}
+		token++;
+		uthread_yield();
+	}
+}
+
+static
+void
+ringtest(void)
+{
+	struct uthread *t[NRING];
+	unsigned i;
+
+	token = 0;
+	for (i=0; i<NRING; i++) {
+		if (uthread_create(&t[i], ringthread, (void *)i)) {
+			errx(1, "uthread_create failed");
+		}
+	}
+	for (i=0; i<NRING; i++) {
+		uthread_join(t[i]);
+	}
+	if (token != NRING * NLAPS) {
+		errx(1, "ring: token is %u, expected %u", token,
+		     NRING * NLAPS);
+	}
+	printf("uthreadtest: ring passed\n");
+}
+
+/*
+ * Bounded buffer.
+ */
+static struct uthread_mutex buflock = UTHREAD_MUTEX_INITIALIZER;
+static struct uthread_cond notfull = UTHREAD_COND_INITIALIZER;
+static struct uthread_cond notempty = UTHREAD_COND_INITIALIZER;
+static unsigned buf[BUFSIZE];
+static unsigned bufhead, bufcount;
+static unsigned consumed, total, producersleft;
+
+static
+void
+producer(void *arg)
+{
+	unsigned base = (unsigned)arg * NITEMS;
+	unsigned i;
+
+	for (i=0; i<NITEMS; i++) {
+		uthread_mutex_lock(&buflock);
+		while (bufcount == BUFSIZE) {
+			uthread_cond_wait(&notfull, &buflock);
+		}
+		buf[(bufhead + bufcount) % BUFSIZE] = base + i;
+		bufcount++;
+		uthread_cond_signal(&notempty);
+		uthread_mutex_unlock(&buflock);
+		if (i % 7 == 0) {
+			uthread_yield();
+		}
+	}
+
+	uthread_mutex_lock(&buflock);
+	producersleft--;
+	uthread_cond_broadcast(&notempty);
+	uthread_mutex_unlock(&buflock);
+}
+
+static
+void
+consumer(void *arg)
+{
+	unsigned item;
+
+	(void)arg;
+
+	uthread_mutex_lock(&buflock);
+	while (1) {
+		while (bufcount == 0 && producersleft > 0) {
+			uthread_cond_wait(&notempty, &buflock);
+		}
+		if (bufcount == 0) {
+			break;
+		}
+		item = buf[bufhead];
+		bufhead = (bufhead + 1) % BUFSIZE;
+		bufcount--;
+		consumed++;
+		total += item;
+		uthread_cond_signal(&notfull);
+	}
+	uthread_mutex_unlock(&buflock);
+}
+
+static
+void
+buffertest(void)
+{
+	struct uthread *t[NPRODUCERS + NCONSUMERS];
+	unsigned i, n, expect;
+
+	producersleft = NPRODUCERS;
+	n = 0;
+	for (i=0; i<NCONSUMERS; i++) {
+		if (uthread_create(&t[n++], consumer, NULL)) {
+			errx(1, "uthread_create failed");
+		}
+	}
+	for (i=0; i<NPRODUCERS; i++) {
+		if (uthread_create(&t[n++], producer, (void *)i)) {
+			errx(1, "uthread_create failed");
+		}
+	}
+	for (i=0; i<n; i++) {
+		uthread_join(t[i]);
+	}
+
+	n = NPRODUCERS * NITEMS;
+	expect = n * (n - 1) / 2;
+	if (consumed != n || total != expect) {
+		errx(1, "buffer: consumed %u items totalling %u; "
+		     "expected %u totalling %u", consumed, total, n, expect);
+	}
+	if (uthread_mutex_trylock(&buflock) != 0) {
+		errx(1, "buffer: lock still held");
+	}
+	uthread_mutex_unlock(&buflock);
+	printf("uthreadtest: bounded buffer passed\n");
+}
+
+int
+main(void)
+{
+	ringtest();
+	buffertest();
+	printf("uthreadtest: passed\n");
+	return 0;
+}
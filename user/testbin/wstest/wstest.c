@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * wstest.c
+ *
+ * 	Checks the working-set estimate: touches a set of pages over and
+ * 	over for a couple of seconds and checks that getwsinfo reports
+ * 	a working set of about that size, then does the same with a
+ * 	smaller set and checks that the estimate comes down.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+
+#define PAGE      4096
+#define BIGSET    96
+#define SMALLSET  8
+
+static char buf[BIGSET * PAGE];
+
+/*
+ * Touch the first NPAGES pages of buf for about SECS seconds, then
+ * return the working set reported.
+ */
+static
+unsigned
+touch(unsigned npages, time_t secs)
+{
+	struct wsinfo wi;
+	time_t start;
+	unsigned i;
+
+	start = time(NULL);
+	while (time(NULL) - start < secs) {
+		for (i=0; i<npages; i++) {
+			buf[i * PAGE]++;
+		}
+	}
+	if (getwsinfo(&wi) < 0) {
+		err(1, "getwsinfo");
+	}
+	printf("wstest: touching %u pages: ws %u, faults/window %u, "
+	       "rss %u, system ws %u of %u\n", npages, wi.wi_ws,
+	       wi.wi_faults, wi.wi_rss, wi.wi_totalws, wi.wi_ram);
+	return wi.wi_ws;
+}
+
+int
+main(void)
+{
+	unsigned ws;
+
+	ws = touch(BIGSET, 2);
+	if (ws < BIGSET) {
+		errx(1, "working set %u is smaller than the %u pages touched",
+		     ws, BIGSET);
+	}
+
+	ws = touch(SMALLSET, 2);
+	if (ws >= BIGSET) {
+		errx(1, "working set %u did not shrink", ws);
+	}
+
+	printf("wstest: passed\n");
+	return 0;
+}